@@ -65,6 +65,13 @@
  */
 #define DATA_XFER_LIMIT  (64 * 1024)
 
+/**
+ * Maximum buffer size allowed for IPC_M_DATA_WRITE and
+ * IPC_M_DATA_READ requests with IPC_XF_DIRECT. This bounds the number of
+ * frames a single call keeps pinned.
+ */
+#define DATA_XFER_DIRECT_LIMIT  (1024 * 1024)
+
 /* Macros for manipulating calling data */
 #define IPC_SET_RETVAL(data, retval)  ((data).args[0] = (retval))
 #define IPC_SET_IMETHOD(data, val)    ((data).args[0] = (val))
@@ -101,6 +108,9 @@
 /** Restrict the transfer size if necessary. */
 #define IPC_XF_RESTRICT  (1 << 0)
 
+/** Transfer the data directly between the address spaces. */
+#define IPC_XF_DIRECT  (1 << 1)
+
 /** User-defined IPC methods */
 #define IPC_FIRST_USER_METHOD  1024
 
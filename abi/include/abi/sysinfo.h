@@ -47,6 +47,7 @@
 /** Maximum name sizes */
 #define TASK_NAME_BUFLEN  20
 #define EXC_NAME_BUFLEN   20
+#define SLAB_NAME_BUFLEN  20
 
 /** Item value type
  *
@@ -74,10 +75,13 @@ typedef struct {
  *
  */
 typedef struct {
-	uint64_t total;    /**< Total physical memory (bytes) */
-	uint64_t unavail;  /**< Unavailable (reserved, firmware) bytes */
-	uint64_t used;     /**< Allocated physical memory (bytes) */
-	uint64_t free;     /**< Free physical memory (bytes) */
+	uint64_t total;          /**< Total physical memory (bytes) */
+	uint64_t unavail;        /**< Unavailable (reserved, firmware) bytes */
+	uint64_t used;           /**< Allocated physical memory (bytes) */
+	uint64_t free;           /**< Free physical memory (bytes) */
+	uint64_t zeroed;         /**< Free memory zeroed in advance (bytes) */
+	uint64_t zeroed_hits;    /**< Zeroed frame requests served in advance */
+	uint64_t zeroed_misses;  /**< Zeroed frame requests zeroed on demand */
 } stats_physmem_t;
 
 /** IPC statistics
@@ -106,6 +110,7 @@ typedef struct {
 	uint64_t ucycles;             /**< Number of CPU cycles in user space */
 	uint64_t kcycles;             /**< Number of CPU cycles in kernel */
 	stats_ipc_t ipc_info;         /**< IPC statistics */
+	uint64_t page_faults;         /**< Number of serviced page faults */
 } stats_task_t;
 
 /** Statistics about a single thread
@@ -133,6 +138,20 @@ typedef struct {
 	uint64_t count;              /**< Number of handled exceptions */
 } stats_exc_t;
 
+/** Statistics about a single slab cache
+ *
+ */
+typedef struct {
+	char name[SLAB_NAME_BUFLEN];  /**< Cache name */
+	size_t size;                  /**< Object size (bytes) */
+	size_t mag_size;              /**< Current magazine size (objects) */
+	uint64_t allocated_objs;      /**< Allocated objects */
+	uint64_t cached_objs;         /**< Objects cached in magazines */
+	uint64_t depot_hits;          /**< Full magazines taken from depot */
+	uint64_t depot_misses;        /**< Depot found empty */
+	uint64_t depot_contention;    /**< Contended depot lock acquisitions */
+} stats_slab_t;
+
 /** Load fixed-point value */
 typedef uint32_t load_t;
 
@@ -148,6 +148,14 @@
 #define SET_FRAME_PRESENT_ARCH(ptl3, i) \
 	set_pt_present((pte_t *) (ptl3), (size_t) (i))
 
+/* Large pages mapped directly by PTL2 entries. */
+#define LARGE_PAGE_WIDTH  21
+
+#define GET_PTL3_LARGE_ARCH(ptl2, i) \
+	(((pte_t *) (ptl2))[(i)].large != 0)
+#define SET_PTL3_LARGE_ARCH(ptl2, i, x) \
+	(((pte_t *) (ptl2))[(i)].large = ((x) ? 1 : 0))
+
 /* Macros for querying the last-level PTE entries. */
 #define PTE_VALID_ARCH(p) \
 	((p)->soft_valid != 0)
@@ -197,7 +205,7 @@ typedef struct {
 	unsigned int page_cache_disable : 1;
 	unsigned int accessed : 1;
 	unsigned int dirty : 1;
-	unsigned int unused: 1;
+	unsigned int large : 1;  /**< PTL2 entry maps a large page. */
 	unsigned int global : 1;
 	unsigned int soft_valid : 1;  /**< Valid content even if present bit is cleared. */
 	unsigned int avl : 2;
@@ -54,6 +54,7 @@ void page_arch_init(void)
 	}
 
 	uintptr_t cur;
+	uintptr_t end = min(config.identity_size, config.physmem_end);
 	unsigned int identity_flags =
 	    PAGE_GLOBAL | PAGE_CACHEABLE | PAGE_EXEC | PAGE_WRITE | PAGE_READ;
 		
@@ -63,10 +64,20 @@ void page_arch_init(void)
 		
 	/*
 	 * PA2KA(identity) mapping for all low-memory frames.
+	 * Use large pages wherever possible to save TLB entries.
 	 */
-	for (cur = 0; cur < min(config.identity_size, config.physmem_end);
-	    cur += FRAME_SIZE)
+	for (cur = 0; cur < end; ) {
+		if ((IS_ALIGNED(cur, LARGE_PAGE_SIZE)) &&
+		    (end - cur >= LARGE_PAGE_SIZE) &&
+		    (page_mapping_insert_large(AS_KERNEL, PA2KA(cur), cur,
+		    identity_flags))) {
+			cur += LARGE_PAGE_SIZE;
+			continue;
+		}
+		
 		page_mapping_insert(AS_KERNEL, PA2KA(cur), cur, identity_flags);
+		cur += FRAME_SIZE;
+	}
 		
 	page_table_unlock(AS_KERNEL, true);
 		
@@ -40,6 +40,7 @@
 #include <mm/page.h>
 #include <mm/frame.h>
 #include <mm/km.h>
+#include <mm/tlb.h>
 #include <mm/as.h>
 #include <arch/mm/page.h>
 #include <arch/mm/as.h>
@@ -56,28 +57,39 @@ static void pt_mapping_remove(as_t *, uintptr_t);
 static bool pt_mapping_find(as_t *, uintptr_t, bool, pte_t *pte);
 static void pt_mapping_update(as_t *, uintptr_t, bool, pte_t *pte);
 static void pt_mapping_make_global(uintptr_t, size_t);
+#ifdef LARGE_PAGE_WIDTH
+static bool pt_mapping_insert_large(as_t *, uintptr_t, uintptr_t,
+    unsigned int);
+static void pt_mapping_split_large(as_t *, uintptr_t);
+static bool pt_mapping_remove_large(as_t *, uintptr_t);
+#endif
 
 page_mapping_operations_t pt_mapping_operations = {
 	.mapping_insert = pt_mapping_insert,
 	.mapping_remove = pt_mapping_remove,
 	.mapping_find = pt_mapping_find,
 	.mapping_update = pt_mapping_update,
-	.mapping_make_global = pt_mapping_make_global
+	.mapping_make_global = pt_mapping_make_global,
+#ifdef LARGE_PAGE_WIDTH
+	.mapping_insert_large = pt_mapping_insert_large,
+	.mapping_split_large = pt_mapping_split_large,
+	.mapping_remove_large = pt_mapping_remove_large
+#else
+	.mapping_insert_large = NULL,
+	.mapping_split_large = NULL,
+	.mapping_remove_large = NULL
+#endif
 };
 
-/** Map page to frame using hierarchical page tables.
+/** Get the PTL2 table covering a page, allocating the missing tables.
  *
- * Map virtual address page to physical address frame
- * using flags.
+ * @param as   Address space to wich page belongs.
+ * @param page Virtual address of the page.
  *
- * @param as    Address space to wich page belongs.
- * @param page  Virtual address of the page to be mapped.
- * @param frame Physical address of memory frame to which the mapping is done.
- * @param flags Flags to be used for mapping.
+ * @return PTL2 table covering page.
  *
  */
-void pt_mapping_insert(as_t *as, uintptr_t page, uintptr_t frame,
-    unsigned int flags)
+static pte_t *pt_ptl2_get(as_t *as, uintptr_t page)
 {
 	pte_t *ptl0 = (pte_t *) PA2KA((uintptr_t) as->genarch.page_table);
 
@@ -117,7 +129,246 @@ void pt_mapping_insert(as_t *as, uintptr_t page, uintptr_t frame,
 		SET_PTL2_PRESENT(ptl1, PTL1_INDEX(page));
 	}
 	
+	return (pte_t *) PA2KA(GET_PTL2_ADDRESS(ptl1, PTL1_INDEX(page)));
+}
+
+/** Free the empty PTL2 and PTL1 tables on the way to page.
+ *
+ * Called once the PTL3 table (or the large page mapping) in ptl2 has been
+ * removed. Tables needed for sharing the kernel non-identity mappings are
+ * kept.
+ *
+ * @param ptl0 PTL0 table of the address space.
+ * @param ptl1 PTL1 table on the way to page.
+ * @param ptl2 PTL2 table on the way to page.
+ * @param page Virtual address of the removed page.
+ *
+ */
+static void pt_upper_tables_free(pte_t *ptl0, pte_t *ptl1, pte_t *ptl2,
+    uintptr_t page)
+{
+	/* Check PTL2 */
+#if (PTL2_ENTRIES != 0)
+	for (unsigned int i = 0; i < PTL2_ENTRIES; i++) {
+		/*
+		 * PTL2 is not empty.
+		 * Therefore, there must be a path from PTL0 to PTL2 and
+		 * thus nothing to free in higher levels.
+		 */
+		if (PTE_VALID(&ptl2[i]))
+			return;
+	}
+	
+	/*
+	 * PTL2 is empty.
+	 * Release the frame and remove PTL2 pointer from the parent
+	 * table.
+	 */
+#if (PTL1_ENTRIES != 0)
+	memsetb(&ptl1[PTL1_INDEX(page)], sizeof(pte_t), 0);
+#else
+	if (km_is_non_identity(page))
+		return;
+
+	memsetb(&ptl0[PTL0_INDEX(page)], sizeof(pte_t), 0);
+#endif
+	frame_free(KA2PA((uintptr_t) ptl2), PTL2_FRAMES);
+#endif /* PTL2_ENTRIES != 0 */
+	
+	/* Check PTL1 */
+#if (PTL1_ENTRIES != 0)
+	for (unsigned int i = 0; i < PTL1_ENTRIES; i++) {
+		if (PTE_VALID(&ptl1[i]))
+			return;
+	}
+	
+	/*
+	 * PTL1 is empty.
+	 * Release the frame and remove PTL1 pointer from the parent
+	 * table.
+	 */
+	if (km_is_non_identity(page))
+		return;
+
+	memsetb(&ptl0[PTL0_INDEX(page)], sizeof(pte_t), 0);
+	frame_free(KA2PA((uintptr_t) ptl1), PTL1_FRAMES);
+#endif /* PTL1_ENTRIES != 0 */
+}
+
+#ifdef LARGE_PAGE_WIDTH
+
+/** Replace a large page mapping by a PTL3 table mapping the same frames.
+ *
+ * The mappings of the individual pages inherit the flags of the large
+ * page. Even though the translations do not change, the processor must
+ * not keep caching the large page translation next to the new small page
+ * ones, so it is invalidated in the local TLB. Other processors drop it
+ * during the TLB shootdown that follows the change of the mappings.
+ *
+ * May block while allocating the PTL3 table, so it must not be called
+ * within a TLB shootdown sequence.
+ *
+ * @param as    Address space to which the large page belongs.
+ * @param lpage Virtual address of the large page.
+ * @param ptl2  PTL2 table containing the large page mapping.
+ * @param i     Index of the large page mapping in ptl2.
+ *
+ */
+static void pt_large_split(as_t *as, uintptr_t lpage, pte_t *ptl2, size_t i)
+{
+	uintptr_t frame = (uintptr_t) GET_PTL3_ADDRESS(ptl2, i);
+	unsigned int flags = GET_PTL3_FLAGS(ptl2, i);
+	
+	pte_t *newpt = (pte_t *)
+	    PA2KA(frame_alloc(PTL3_FRAMES, FRAME_LOWMEM, PTL3_SIZE - 1));
+	memsetb(newpt, PTL3_SIZE, 0);
+	
+	for (size_t j = 0; j < PTL3_ENTRIES; j++) {
+		SET_FRAME_ADDRESS(newpt, j, frame + FRAMES2SIZE(j));
+		SET_FRAME_FLAGS(newpt, j, flags);
+	}
+	
+	/*
+	 * Switch the PTL2 entry to the new PTL3 in a single write, so that
+	 * a concurrent hardware page table walk sees either the large page
+	 * or the complete PTL3.
+	 */
+	pte_t entry;
+	memsetb(&entry, sizeof(pte_t), 0);
+	SET_PTL3_ADDRESS(&entry, 0, KA2PA(newpt));
+	SET_PTL3_FLAGS(&entry, 0, PAGE_PRESENT | PAGE_USER | PAGE_EXEC |
+	    PAGE_CACHEABLE | PAGE_WRITE);
+	
+	write_barrier();
+	ptl2[i] = entry;
+	
+	tlb_invalidate_pages(as->asid, lpage, 1);
+}
+
+/** Split the large page mapping containing page, if there is one.
+ *
+ * Callers removing only some pages of a large page split it first, so that
+ * pt_mapping_remove() does not need to allocate within the TLB shootdown
+ * sequence.
+ *
+ * @param as   Address space to which page belongs.
+ * @param page Virtual address within the large page.
+ *
+ */
+void pt_mapping_split_large(as_t *as, uintptr_t page)
+{
+	assert(page_table_locked(as));
+	
+	pte_t *ptl0 = (pte_t *) PA2KA((uintptr_t) as->genarch.page_table);
+	if (GET_PTL1_FLAGS(ptl0, PTL0_INDEX(page)) & PAGE_NOT_PRESENT)
+		return;
+	
+	pte_t *ptl1 = (pte_t *) PA2KA(GET_PTL1_ADDRESS(ptl0, PTL0_INDEX(page)));
+	if (GET_PTL2_FLAGS(ptl1, PTL1_INDEX(page)) & PAGE_NOT_PRESENT)
+		return;
+	
+	pte_t *ptl2 = (pte_t *) PA2KA(GET_PTL2_ADDRESS(ptl1, PTL1_INDEX(page)));
+	if ((!(GET_PTL3_FLAGS(ptl2, PTL2_INDEX(page)) & PAGE_NOT_PRESENT)) &&
+	    (GET_PTL3_LARGE(ptl2, PTL2_INDEX(page))))
+		pt_large_split(as, ALIGN_DOWN(page, LARGE_PAGE_SIZE), ptl2,
+		    PTL2_INDEX(page));
+}
+
+/** Remove the large page mapping containing page, if there is one.
+ *
+ * The mappings of all pages within the large page are removed at once,
+ * without allocating anything. TLB shootdown should follow in order to make
+ * effects of this call visible.
+ *
+ * @param as   Address space to which page belongs.
+ * @param page Virtual address within the large page.
+ *
+ * @return True if a large page mapping was removed, false if page is not
+ *         mapped by a large page.
+ *
+ */
+bool pt_mapping_remove_large(as_t *as, uintptr_t page)
+{
+	assert(page_table_locked(as));
+	
+	pte_t *ptl0 = (pte_t *) PA2KA((uintptr_t) as->genarch.page_table);
+	if (GET_PTL1_FLAGS(ptl0, PTL0_INDEX(page)) & PAGE_NOT_PRESENT)
+		return false;
+	
+	pte_t *ptl1 = (pte_t *) PA2KA(GET_PTL1_ADDRESS(ptl0, PTL0_INDEX(page)));
+	if (GET_PTL2_FLAGS(ptl1, PTL1_INDEX(page)) & PAGE_NOT_PRESENT)
+		return false;
+	
 	pte_t *ptl2 = (pte_t *) PA2KA(GET_PTL2_ADDRESS(ptl1, PTL1_INDEX(page)));
+	if ((GET_PTL3_FLAGS(ptl2, PTL2_INDEX(page)) & PAGE_NOT_PRESENT) ||
+	    (!GET_PTL3_LARGE(ptl2, PTL2_INDEX(page))))
+		return false;
+	
+	SET_PTL3_FLAGS(ptl2, PTL2_INDEX(page), PAGE_NOT_PRESENT);
+	memsetb(&ptl2[PTL2_INDEX(page)], sizeof(pte_t), 0);
+	
+	pt_upper_tables_free(ptl0, ptl1, ptl2, page);
+	return true;
+}
+
+/** Map a large page to a block of frames using hierarchical page tables.
+ *
+ * @param as    Address space to wich page belongs.
+ * @param page  Virtual address of the large page to be mapped.
+ * @param frame Physical address of the block of frames.
+ * @param flags Flags to be used for mapping.
+ *
+ * @return False if some page within the large page is already mapped.
+ *
+ */
+bool pt_mapping_insert_large(as_t *as, uintptr_t page, uintptr_t frame,
+    unsigned int flags)
+{
+	pte_t *ptl2 = pt_ptl2_get(as, page);
+	
+	/*
+	 * Any page mapped within the large page keeps its PTL3 (or large
+	 * page mapping) alive.
+	 */
+	if (!(GET_PTL3_FLAGS(ptl2, PTL2_INDEX(page)) & PAGE_NOT_PRESENT))
+		return false;
+	
+	SET_PTL3_ADDRESS(ptl2, PTL2_INDEX(page), frame);
+	SET_PTL3_FLAGS(ptl2, PTL2_INDEX(page), flags | PAGE_NOT_PRESENT);
+	SET_PTL3_LARGE(ptl2, PTL2_INDEX(page), true);
+	/*
+	 * Make the new mapping visible only after it is fully initialized.
+	 */
+	write_barrier();
+	SET_PTL3_PRESENT(ptl2, PTL2_INDEX(page));
+	
+	return true;
+}
+
+#endif /* LARGE_PAGE_WIDTH */
+
+/** Map page to frame using hierarchical page tables.
+ *
+ * Map virtual address page to physical address frame
+ * using flags.
+ *
+ * @param as    Address space to wich page belongs.
+ * @param page  Virtual address of the page to be mapped.
+ * @param frame Physical address of memory frame to which the mapping is done.
+ * @param flags Flags to be used for mapping.
+ *
+ */
+void pt_mapping_insert(as_t *as, uintptr_t page, uintptr_t frame,
+    unsigned int flags)
+{
+	pte_t *ptl2 = pt_ptl2_get(as, page);
+	
+#ifdef LARGE_PAGE_WIDTH
+	if ((!(GET_PTL3_FLAGS(ptl2, PTL2_INDEX(page)) & PAGE_NOT_PRESENT)) &&
+	    (GET_PTL3_LARGE(ptl2, PTL2_INDEX(page))))
+		pt_large_split(as, ALIGN_DOWN(page, LARGE_PAGE_SIZE), ptl2,
+		    PTL2_INDEX(page));
+#endif
 	
 	if (GET_PTL3_FLAGS(ptl2, PTL2_INDEX(page)) & PAGE_NOT_PRESENT) {
 		pte_t *newpt = (pte_t *)
@@ -177,6 +428,18 @@ void pt_mapping_remove(as_t *as, uintptr_t page)
 	if (GET_PTL3_FLAGS(ptl2, PTL2_INDEX(page)) & PAGE_NOT_PRESENT)
 		return;
 	
+#ifdef LARGE_PAGE_WIDTH
+	/*
+	 * Large pages must have been split by page_mapping_split_large()
+	 * before the TLB shootdown sequence, allocating is not possible here.
+	 * Removing the whole large page instead would lose the mappings of
+	 * pages the caller still uses.
+	 */
+	if (GET_PTL3_LARGE(ptl2, PTL2_INDEX(page)))
+		panic("Removing page %p mapped by a large page.",
+		    (void *) page);
+#endif
+	
 	pte_t *ptl3 = (pte_t *) PA2KA(GET_PTL3_ADDRESS(ptl2, PTL2_INDEX(page)));
 	
 	/*
@@ -232,67 +495,24 @@ void pt_mapping_remove(as_t *as, uintptr_t page)
 		return;
 	}
 	
-	/* Check PTL2, empty is still true */
-#if (PTL2_ENTRIES != 0)
-	for (i = 0; i < PTL2_ENTRIES; i++) {
-		if (PTE_VALID(&ptl2[i])) {
-			empty = false;
-			break;
-		}
-	}
-	
-	if (empty) {
-		/*
-		 * PTL2 is empty.
-		 * Release the frame and remove PTL2 pointer from the parent
-		 * table.
-		 */
-#if (PTL1_ENTRIES != 0)
-		memsetb(&ptl1[PTL1_INDEX(page)], sizeof(pte_t), 0);
-#else
-		if (km_is_non_identity(page))
-			return;
-
-		memsetb(&ptl0[PTL0_INDEX(page)], sizeof(pte_t), 0);
-#endif
-		frame_free(KA2PA((uintptr_t) ptl2), PTL2_FRAMES);
-	} else {
-		/*
-		 * PTL2 is not empty.
-		 * Therefore, there must be a path from PTL0 to PTL2 and
-		 * thus nothing to free in higher levels.
-		 *
-		 */
-		return;
-	}
-#endif /* PTL2_ENTRIES != 0 */
-	
-	/* check PTL1, empty is still true */
-#if (PTL1_ENTRIES != 0)
-	for (i = 0; i < PTL1_ENTRIES; i++) {
-		if (PTE_VALID(&ptl1[i])) {
-			empty = false;
-			break;
-		}
-	}
-	
-	if (empty) {
-		/*
-		 * PTL1 is empty.
-		 * Release the frame and remove PTL1 pointer from the parent
-		 * table.
-		 */
-		if (km_is_non_identity(page))
-			return;
-
-		memsetb(&ptl0[PTL0_INDEX(page)], sizeof(pte_t), 0);
-		frame_free(KA2PA((uintptr_t) ptl1), PTL1_FRAMES);
-	}
-#endif /* PTL1_ENTRIES != 0 */
+	pt_upper_tables_free(ptl0, ptl1, ptl2, page);
 }
 
-static pte_t *pt_mapping_find_internal(as_t *as, uintptr_t page, bool nolock)
+/** Find the PTE mapping a virtual page.
+ *
+ * @param as         Address space to which page belongs.
+ * @param page       Virtual page.
+ * @param nolock     True if the page tables need not be locked.
+ * @param[out] large Set to true if the returned PTE maps a large page
+ *                   containing page.
+ *
+ * @return PTE mapping page or NULL if there is none.
+ */
+static pte_t *pt_mapping_find_internal(as_t *as, uintptr_t page, bool nolock,
+    bool *large)
 {
+	*large = false;
+	
 	assert(nolock || page_table_locked(as));
 
 	pte_t *ptl0 = (pte_t *) PA2KA((uintptr_t) as->genarch.page_table);
@@ -316,6 +536,13 @@ static pte_t *pt_mapping_find_internal(as_t *as, uintptr_t page, bool nolock)
 	if (GET_PTL3_FLAGS(ptl2, PTL2_INDEX(page)) & PAGE_NOT_PRESENT)
 		return NULL;
 
+#ifdef LARGE_PAGE_WIDTH
+	if (GET_PTL3_LARGE(ptl2, PTL2_INDEX(page))) {
+		*large = true;
+		return &ptl2[PTL2_INDEX(page)];
+	}
+#endif
+
 #if (PTL2_ENTRIES != 0)
 	/*
 	 * Always read ptl3 only after we are sure it is present.
@@ -339,10 +566,25 @@ static pte_t *pt_mapping_find_internal(as_t *as, uintptr_t page, bool nolock)
  */
 bool pt_mapping_find(as_t *as, uintptr_t page, bool nolock, pte_t *pte)
 {
-	pte_t *t = pt_mapping_find_internal(as, page, nolock);
-	if (t)
-		*pte = *t;
-	return t != NULL;
+	bool large;
+	pte_t *t = pt_mapping_find_internal(as, page, nolock, &large);
+	if (!t)
+		return false;
+	
+	*pte = *t;
+	
+#ifdef LARGE_PAGE_WIDTH
+	/*
+	 * Present the page within a large page as if it was mapped by itself.
+	 */
+	if (large) {
+		SET_FRAME_ADDRESS(pte, 0, PTE_GET_FRAME(t) +
+		    ALIGN_DOWN(page & (LARGE_PAGE_SIZE - 1), PAGE_SIZE));
+		SET_PTL3_LARGE(pte, 0, false);
+	}
+#endif
+	
+	return true;
 }
 
 /** Update mapping for virtual page in hierarchical page tables.
@@ -354,17 +596,31 @@ bool pt_mapping_find(as_t *as, uintptr_t page, bool nolock, pte_t *pte)
  */
 void pt_mapping_update(as_t *as, uintptr_t page, bool nolock, pte_t *pte)
 {
-	pte_t *t = pt_mapping_find_internal(as, page, nolock);
+	bool large;
+	pte_t *t = pt_mapping_find_internal(as, page, nolock, &large);
 	if (!t)
 		panic("Updating non-existent PTE");	
 
-	assert(PTE_VALID(t) == PTE_VALID(pte));
-	assert(PTE_PRESENT(t) == PTE_PRESENT(pte));
-	assert(PTE_GET_FRAME(t) == PTE_GET_FRAME(pte));
-	assert(PTE_WRITABLE(t) == PTE_WRITABLE(pte));
-	assert(PTE_EXECUTABLE(t) == PTE_EXECUTABLE(pte));
+	pte_t entry = *pte;
+
+#ifdef LARGE_PAGE_WIDTH
+	/*
+	 * The update applies to the whole large page, which is mapped
+	 * by a different frame address than the page itself.
+	 */
+	if (large) {
+		SET_FRAME_ADDRESS(&entry, 0, PTE_GET_FRAME(t));
+		SET_PTL3_LARGE(&entry, 0, true);
+	}
+#endif
+
+	assert(PTE_VALID(t) == PTE_VALID(&entry));
+	assert(PTE_PRESENT(t) == PTE_PRESENT(&entry));
+	assert(PTE_GET_FRAME(t) == PTE_GET_FRAME(&entry));
+	assert(PTE_WRITABLE(t) == PTE_WRITABLE(&entry));
+	assert(PTE_EXECUTABLE(t) == PTE_EXECUTABLE(&entry));
 
-	*t = *pte;
+	*t = entry;
 }
 
 /** Return the size of the region mapped by a single PTL0 entry.
@@ -36,6 +36,7 @@
 #define KERN_CPU_H_
 
 #include <mm/tlb.h>
+#include <mm/frame.h>
 #include <synch/spinlock.h>
 #include <synch/rcu_types.h>
 #include <proc/scheduler.h>
@@ -107,6 +108,9 @@ typedef struct cpu {
 	/** RCU per-cpu data. Uses own locking. */
 	rcu_cpu_data_t rcu;
 	
+	/** Free frames cached by this CPU. */
+	frame_cache_t frame_cache;
+	
 	/**
 	 * Stack used by scheduler when there is no running thread.
 	 */
@@ -43,6 +43,7 @@
 #include <typedefs.h>
 #include <mm/slab.h>
 #include <cap/cap.h>
+#include <ipc/pin.h>
 
 struct answerbox;
 struct task;
@@ -170,6 +171,9 @@ typedef struct call {
 
 	/** Buffer for IPC_M_DATA_WRITE and IPC_M_DATA_READ. */
 	uint8_t *buffer;
+
+	/** Pinned sender's buffer for direct IPC_M_DATA_WRITE and READ. */
+	ipc_pin_t *pin;
 } call_t;
 
 extern slab_cache_t *phone_cache;
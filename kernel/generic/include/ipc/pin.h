@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup genericipc
+ * @{
+ */
+/** @file
+ */
+
+#ifndef KERN_IPC_PIN_H_
+#define KERN_IPC_PIN_H_
+
+#include <typedefs.h>
+#include <stdbool.h>
+
+/** Physical frames pinned for a direct IPC data transfer. */
+typedef struct {
+	/** Offset of the data within the first frame. */
+	size_t offset;
+	/** Size of the pinned data. */
+	size_t size;
+	/** Number of pinned frames. */
+	size_t count;
+	/** Physical addresses of the pinned frames. */
+	uintptr_t frame[];
+} ipc_pin_t;
+
+extern int ipc_pin(uintptr_t, size_t, bool, ipc_pin_t **);
+extern void ipc_unpin(ipc_pin_t *);
+extern int ipc_pin_copy_from_uspace(ipc_pin_t *, const void *, size_t);
+extern int ipc_pin_copy_to_uspace(void *, ipc_pin_t *, size_t);
+
+#endif
+
+/** @}
+ */
@@ -50,6 +50,8 @@
 
 #define AS                   THE->as
 
+struct cpu_mask;
+
 
 /**
  * Defined to be true if user address space and kernel address space shadow each
@@ -101,6 +103,15 @@ typedef struct as {
 	 */
 	size_t cpu_refcount;
 	
+	/**
+	 * Processors which may hold TLB entries of this
+	 * address space, i.e. the recipients of its TLB
+	 * shootdowns. NULL for the kernel address space,
+	 * which is present on all processors. Modified
+	 * under asidlock.
+	 */
+	struct cpu_mask *cpu_mask;
+	
 	/** Address space identifier.
 	 *
 	 * Constant on architectures that do not
@@ -245,7 +256,8 @@ typedef struct mem_backend {
 	bool (* is_shareable)(as_area_t *);
 
 	int (* page_fault)(as_area_t *, uintptr_t, pf_access_t);
-	void (* frame_free)(as_area_t *, uintptr_t, uintptr_t);
+	void (* frame_free)(as_area_t *, uintptr_t, uintptr_t, size_t);
+	size_t (* populate)(as_area_t *, uintptr_t, size_t);
 
 	bool (* create_shared_data)(as_area_t *);
 	void (* destroy_shared_data)(void *);
@@ -275,6 +287,7 @@ extern int as_area_change_flags(as_t *, unsigned int, uintptr_t);
 
 extern unsigned int as_area_get_flags(as_area_t *);
 extern bool as_area_check_access(as_area_t *, pf_access_t);
+extern bool as_area_large_page(as_area_t *, uintptr_t, uintptr_t *);
 extern size_t as_area_get_size(uintptr_t);
 extern bool used_space_insert(as_area_t *, uintptr_t, size_t);
 extern bool used_space_remove(as_area_t *, uintptr_t, size_t);
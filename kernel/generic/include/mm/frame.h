@@ -41,12 +41,28 @@
 #include <adt/bitmap.h>
 #include <adt/list.h>
 #include <synch/spinlock.h>
+#include <synch/waitq.h>
 #include <arch/mm/page.h>
 #include <arch/mm/frame.h>
 
 /** Maximum number of zones in the system. */
 #define ZONES_MAX  32
 
+/** Number of block sizes kept in per-CPU frame caches (1, 2 and 4 frames). */
+#define FRAME_CACHE_ORDERS  3
+
+/** Maximum number of blocks of one size in a per-CPU frame cache. */
+#define FRAME_CACHE_SIZE  32
+
+/** Number of blocks moved between a per-CPU frame cache and the zones. */
+#define FRAME_CACHE_BATCH  16
+
+/** Maximum number of pre-zeroed frames kept by each CPU. */
+#define FRAME_ZERO_POOL_SIZE  128
+
+/** Number of pre-zeroed frames below which the pool is refilled. */
+#define FRAME_ZERO_POOL_LOW  32
+
 typedef uint8_t frame_flags_t;
 
 #define FRAME_NONE        0x00
@@ -60,6 +76,8 @@ typedef uint8_t frame_flags_t;
 #define FRAME_LOWMEM      0x08
 /** Allocate a frame which cannot be identity-mapped. */
 #define FRAME_HIGHMEM     0x10
+/** Allocate zero-filled frames which can be identity-mapped. */
+#define FRAME_ZERO        0x20
 
 typedef uint8_t zone_flags_t;
 
@@ -116,6 +134,40 @@ typedef struct {
 	frame_t *frames;
 } zone_t;
 
+/** Per-CPU cache of free low memory frame blocks
+ *
+ * The cached blocks are allocated from the point of view of their zones
+ * (their frames have the reference count of one), so that they can be
+ * handed out and taken back without touching zones.lock.
+ */
+typedef struct {
+	IRQ_SPINLOCK_DECLARE(lock);
+	
+	/** Number of cached blocks of each size */
+	size_t count[FRAME_CACHE_ORDERS];
+	
+	/** First frames of the cached blocks */
+	pfn_t blocks[FRAME_CACHE_ORDERS][FRAME_CACHE_SIZE];
+	
+	/** Number of pre-zeroed frames */
+	size_t zeroed_count;
+	
+	/** Pre-zeroed frames filled in by the zeroing thread of the CPU */
+	pfn_t zeroed[FRAME_ZERO_POOL_SIZE];
+	
+	/** Number of zero-filled frame requests served from the pool */
+	uint64_t zeroed_hits;
+	
+	/** Number of zero-filled frame requests which found the pool empty */
+	uint64_t zeroed_misses;
+	
+	/** True if the zeroing thread has already been asked to refill */
+	bool zeroed_wakeup;
+	
+	/** Wait queue of the zeroing thread */
+	waitq_t zeroed_wq;
+} frame_cache_t;
+
 /*
  * The zoneinfo.lock must be locked when accessing zoneinfo structure.
  * Some of the attributes in zone_t structures are 'read-only'
@@ -129,6 +181,10 @@ typedef struct {
 extern zones_t zones;
 
 extern void frame_init(void);
+extern void frame_cache_init(frame_cache_t *);
+extern size_t frame_cache_drain(void);
+extern void frame_zero_worker(void *);
+extern void frame_zero_stats(size_t *, uint64_t *, uint64_t *);
 extern bool frame_adjust_zone_bounds(bool, uintptr_t *, size_t *);
 extern uintptr_t frame_alloc_generic(size_t, frame_flags_t, uintptr_t,
     size_t *);
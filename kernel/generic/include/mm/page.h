@@ -43,6 +43,16 @@
 #define P2SZ(pages) \
 	((pages) << PAGE_WIDTH)	
 
+/** Size of a large page or zero if large pages are not supported. */
+#ifdef LARGE_PAGE_WIDTH
+#define LARGE_PAGE_SIZE  (((uintptr_t) 1) << LARGE_PAGE_WIDTH)
+#else
+#define LARGE_PAGE_SIZE  0
+#endif
+
+/** Number of pages in a large page. */
+#define LARGE_PAGE_PAGES  (LARGE_PAGE_SIZE >> PAGE_WIDTH)
+
 /** Operations to manipulate page mappings. */
 typedef struct {
 	void (* mapping_insert)(as_t *, uintptr_t, uintptr_t, unsigned int);
@@ -50,6 +60,9 @@ typedef struct {
 	bool (* mapping_find)(as_t *, uintptr_t, bool, pte_t *);
 	void (* mapping_update)(as_t *, uintptr_t, bool, pte_t *);
 	void (* mapping_make_global)(uintptr_t, size_t);
+	bool (* mapping_insert_large)(as_t *, uintptr_t, uintptr_t, unsigned int);
+	void (* mapping_split_large)(as_t *, uintptr_t);
+	bool (* mapping_remove_large)(as_t *, uintptr_t);
 } page_mapping_operations_t;
 
 extern page_mapping_operations_t *page_mapping_operations;
@@ -59,6 +72,10 @@ extern void page_table_lock(as_t *, bool);
 extern void page_table_unlock(as_t *, bool);
 extern bool page_table_locked(as_t *);
 extern void page_mapping_insert(as_t *, uintptr_t, uintptr_t, unsigned int);
+extern bool page_mapping_insert_large(as_t *, uintptr_t, uintptr_t,
+    unsigned int);
+extern void page_mapping_split_large(as_t *, uintptr_t, size_t);
+extern bool page_mapping_remove_large(as_t *, uintptr_t);
 extern void page_mapping_remove(as_t *, uintptr_t);
 extern bool page_mapping_find(as_t *, uintptr_t, bool, pte_t *);
 extern void page_mapping_update(as_t *, uintptr_t, bool, pte_t *);
@@ -39,6 +39,7 @@
 #include <synch/spinlock.h>
 #include <atomic.h>
 #include <mm/frame.h>
+#include <abi/sysinfo.h>
 
 /** Minimum size to be allocated by malloc */
 #define SLAB_MIN_MALLOC_W  4
@@ -46,9 +47,12 @@
 /** Maximum size to be allocated by malloc */
 #define SLAB_MAX_MALLOC_W  22
 
-/** Initial Magazine size (TODO: dynamically growing magazines) */
+/** Initial magazine size */
 #define SLAB_MAG_SIZE  4
 
+/** Maximum magazine size (magazine sizes are powers of 2) */
+#define SLAB_MAG_SIZE_MAX  64
+
 /** If object size is less, store control structure inside SLAB */
 #define SLAB_INSIDE_SIZE  (PAGE_SIZE >> 3)
 
@@ -118,6 +122,16 @@ typedef struct {
 	list_t magazines;  /**< List o full magazines */
 	IRQ_SPINLOCK_DECLARE(maglock);
 	
+	/** Number of slots in newly allocated magazines */
+	size_t mag_size;
+	
+	/* Depot statistics (protected by maglock) */
+	uint64_t depot_hits;        /**< Full magazines taken from the list */
+	uint64_t depot_misses;      /**< No full magazine on the list */
+	uint64_t depot_contention;  /**< Contended maglock acquisitions */
+	size_t depot_ops;           /**< List operations in current window */
+	size_t depot_contended;     /**< Contended ones in current window */
+	
 	/** CPU cache */
 	slab_mag_cache_t *mag_cache;
 } slab_cache_t;
@@ -138,6 +152,9 @@ extern void slab_enable_cpucache(void);
 /* kconsole debug */
 extern void slab_print_list(void);
 
+/* sysinfo statistics */
+extern size_t slab_stats(stats_slab_t *, size_t);
+
 /* malloc support */
 extern void *malloc(size_t, unsigned int)
     __attribute__((malloc));
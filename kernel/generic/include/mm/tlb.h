@@ -38,6 +38,8 @@
 #include <arch/mm/asid.h>
 #include <typedefs.h>
 
+struct cpu_mask;
+
 /**
  * Number of TLB shootdown messages that can be queued in processor tlb_messages
  * queue.
@@ -68,11 +70,11 @@ extern void tlb_init(void);
 
 #ifdef CONFIG_SMP
 extern ipl_t tlb_shootdown_start(tlb_invalidate_type_t, asid_t, uintptr_t,
-    size_t);
+    size_t, struct cpu_mask *);
 extern void tlb_shootdown_finalize(ipl_t);
 extern void tlb_shootdown_ipi_recv(void);
 #else
-#define tlb_shootdown_start(w, x, y, z)	interrupts_disable()	
+#define tlb_shootdown_start(v, w, x, y, z)	interrupts_disable()
 #define tlb_shootdown_finalize(i)	(interrupts_restore(i));
 #define tlb_shootdown_ipi_recv()
 #endif /* CONFIG_SMP */
@@ -80,7 +82,7 @@ extern void tlb_shootdown_ipi_recv(void);
 /* Export TLB interface that each architecture must implement. */
 extern void tlb_arch_init(void);
 extern void tlb_print(void);
-extern void tlb_shootdown_ipi_send(void);
+extern void tlb_shootdown_ipi_send(struct cpu_mask *);
 
 extern void tlb_invalidate_all(void);
 extern void tlb_invalidate_asid(asid_t);
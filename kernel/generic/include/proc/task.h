@@ -143,6 +143,12 @@ typedef struct task {
 	/** Accumulated accounting. */
 	uint64_t ucycles;
 	uint64_t kcycles;
+	
+	/**
+	 * Number of page faults serviced by a memory backend.
+	 * Protected by lock.
+	 */
+	uint64_t page_faults;
 } task_t;
 
 IRQ_SPINLOCK_EXTERN(tasks_lock);
@@ -39,6 +39,7 @@
 
 extern void ipi_broadcast(int);
 extern void ipi_broadcast_arch(int);
+extern void ipi_unicast_arch(unsigned int, int);
 
 #else
 
@@ -84,6 +84,7 @@ static void _ipc_call_init(call_t *call)
 	call->sender = NULL;
 	call->callerbox = NULL;
 	call->buffer = NULL;
+	call->pin = NULL;
 }
 
 static void call_destroy(void *arg)
@@ -92,6 +93,8 @@ static void call_destroy(void *arg)
 
 	if (call->buffer)
 		free(call->buffer);
+	if (call->pin)
+		ipc_unpin(call->pin);
 	if (call->caller_phone)
 		kobject_put(call->caller_phone->kobject);
 	slab_free(call_cache, call);
@@ -42,17 +42,41 @@
 
 static int request_preprocess(call_t *call, phone_t *phone)
 {
+	uintptr_t dst = IPC_GET_ARG1(call->data);
 	size_t size = IPC_GET_ARG2(call->data);
+	int flags = IPC_GET_ARG3(call->data);
+	size_t limit = (flags & IPC_XF_DIRECT) ?
+	    DATA_XFER_DIRECT_LIMIT : DATA_XFER_LIMIT;
 
-	if (size > DATA_XFER_LIMIT) {
-		int flags = IPC_GET_ARG3(call->data);
-
-		if (flags & IPC_XF_RESTRICT)
-			IPC_SET_ARG2(call->data, DATA_XFER_LIMIT);
-		else
+	if (size > limit) {
+		if (flags & IPC_XF_RESTRICT) {
+			size = limit;
+			IPC_SET_ARG2(call->data, size);
+		} else
 			return ELIMIT;
 	}
 
+	if ((flags & IPC_XF_DIRECT) && (size > 0)) {
+		/*
+		 * Pin the destination buffer so that the recipient can copy
+		 * the data right into it.
+		 */
+		if (ipc_pin(dst, size, true, &call->pin) == EOK)
+			return EOK;
+
+		/*
+		 * The buffer cannot be pinned, fall back to copying the data
+		 * through a kernel buffer.
+		 */
+		if (size > DATA_XFER_LIMIT) {
+			if (!(flags & IPC_XF_RESTRICT))
+				return ELIMIT;
+
+			size = DATA_XFER_LIMIT;
+			IPC_SET_ARG2(call->data, size);
+		}
+	}
+
 	return EOK;
 }
 
@@ -73,7 +97,15 @@ static int answer_preprocess(call_t *answer, ipc_data_t *olddata)
 			 * information is not lost.
 			 */
 			IPC_SET_ARG1(answer->data, dst);
-				
+
+			if (answer->pin) {
+				int rc = ipc_pin_copy_from_uspace(answer->pin,
+				    (void *) src, size);
+				if (rc)
+					IPC_SET_RETVAL(answer->data, rc);
+				return EOK;
+			}
+
 			answer->buffer = malloc(size, 0);
 			int rc = copy_from_uspace(answer->buffer,
 			    (void *) src, size);
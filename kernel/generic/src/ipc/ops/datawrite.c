@@ -44,17 +44,39 @@ static int request_preprocess(call_t *call, phone_t *phone)
 {
 	uintptr_t src = IPC_GET_ARG1(call->data);
 	size_t size = IPC_GET_ARG2(call->data);
+	int flags = IPC_GET_ARG3(call->data);
+	size_t limit = (flags & IPC_XF_DIRECT) ?
+	    DATA_XFER_DIRECT_LIMIT : DATA_XFER_LIMIT;
 
-	if (size > DATA_XFER_LIMIT) {
-		int flags = IPC_GET_ARG3(call->data);
-
+	if (size > limit) {
 		if (flags & IPC_XF_RESTRICT) {
-			size = DATA_XFER_LIMIT;
+			size = limit;
 			IPC_SET_ARG2(call->data, size);
 		} else
 			return ELIMIT;
 	}
 
+	if ((flags & IPC_XF_DIRECT) && (size > 0)) {
+		/*
+		 * Pin the source buffer so that the recipient can copy the
+		 * data right out of it.
+		 */
+		if (ipc_pin(src, size, false, &call->pin) == EOK)
+			return EOK;
+
+		/*
+		 * The buffer cannot be pinned, fall back to copying it
+		 * through a kernel buffer.
+		 */
+		if (size > DATA_XFER_LIMIT) {
+			if (!(flags & IPC_XF_RESTRICT))
+				return ELIMIT;
+
+			size = DATA_XFER_LIMIT;
+			IPC_SET_ARG2(call->data, size);
+		}
+	}
+
 	call->buffer = (uint8_t *) malloc(size, 0);
 	int rc = copy_from_uspace(call->buffer, (void *) src, size);
 	if (rc != 0) {
@@ -70,7 +92,7 @@ static int request_preprocess(call_t *call, phone_t *phone)
 
 static int answer_preprocess(call_t *answer, ipc_data_t *olddata)
 {
-	assert(answer->buffer);
+	assert(answer->buffer || answer->pin);
 
 	if (!IPC_GET_RETVAL(answer->data)) {
 		/* The recipient agreed to receive data. */
@@ -79,8 +101,15 @@ static int answer_preprocess(call_t *answer, ipc_data_t *olddata)
 		size_t max_size = (size_t)IPC_GET_ARG2(*olddata);
 			
 		if (size <= max_size) {
-			int rc = copy_to_uspace((void *) dst,
-			    answer->buffer, size);
+			int rc;
+
+			if (answer->pin) {
+				rc = ipc_pin_copy_to_uspace((void *) dst,
+				    answer->pin, size);
+			} else {
+				rc = copy_to_uspace((void *) dst,
+				    answer->buffer, size);
+			}
 			if (rc)
 				IPC_SET_RETVAL(answer->data, rc);
 		} else {
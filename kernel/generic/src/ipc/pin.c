@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup genericipc
+ * @{
+ */
+/** @file
+ *
+ * Pinning of user memory for direct IPC data transfers.
+ *
+ * IPC_M_DATA_READ and IPC_M_DATA_WRITE requests carrying IPC_XF_DIRECT do not
+ * bounce the data through a kernel buffer. Instead, the pages of the sender's
+ * buffer are pinned while the request is being preprocessed and the recipient
+ * then copies the data directly from or to the pinned frames when it answers
+ * the call. The frames are unpinned when the call is destroyed.
+ *
+ * Buffers that cannot be pinned, e.g. physical memory mapped by physmem_map(),
+ * are copied through a kernel buffer instead, as without IPC_XF_DIRECT.
+ */
+
+#include <ipc/pin.h>
+#include <mm/as.h>
+#include <mm/page.h>
+#include <mm/frame.h>
+#include <mm/km.h>
+#include <mm/slab.h>
+#include <genarch/mm/page_pt.h>
+#include <genarch/mm/page_ht.h>
+#include <syscall/copy.h>
+#include <abi/errno.h>
+#include <config.h>
+#include <macros.h>
+#include <align.h>
+#include <arch.h>
+
+/** Pin the frame backing a page of the current address space.
+ *
+ * If the page is not present or not writable when it is supposed to be
+ * written to, it is faulted in by touching it from the kernel and the lookup
+ * is repeated.
+ *
+ * @param addr  User virtual address within the page.
+ * @param write True if the page is going to be written to.
+ * @param frame Place to store the physical address of the pinned frame.
+ *
+ * @return EOK on success or an error code.
+ *
+ */
+static int pin_frame(uintptr_t addr, bool write, uintptr_t *frame)
+{
+	for (unsigned int attempt = 0; attempt < 2; attempt++) {
+		pte_t pte;
+
+		page_table_lock(AS, true);
+		bool found = page_mapping_find(AS, ALIGN_DOWN(addr, PAGE_SIZE),
+		    false, &pte);
+		if (found && PTE_PRESENT(&pte) &&
+		    (!write || PTE_WRITABLE(&pte))) {
+			uintptr_t frm = PTE_GET_FRAME(&pte);
+
+			/*
+			 * Only frames managed by the frame allocator can be
+			 * kept alive by a reference. Firmware and reserved
+			 * zones, which can be mapped by physmem_map(), do not
+			 * track references at all.
+			 */
+			irq_spinlock_lock(&zones.lock, true);
+			size_t znum = find_zone(ADDR2PFN(frm), 1, 0);
+			bool available = (znum != (size_t) -1) &&
+			    (zones.info[znum].flags & ZONE_AVAILABLE);
+			irq_spinlock_unlock(&zones.lock, true);
+			
+			if (!available) {
+				page_table_unlock(AS, true);
+				return ENOTSUP;
+			}
+
+			frame_reference_add(ADDR2PFN(frm));
+			page_table_unlock(AS, true);
+
+			*frame = frm;
+			return EOK;
+		}
+		page_table_unlock(AS, true);
+
+		uint8_t byte;
+		int rc = copy_from_uspace(&byte, (void *) addr, 1);
+		if ((rc == EOK) && (write))
+			rc = copy_to_uspace((void *) addr, &byte, 1);
+		if (rc != EOK)
+			return rc;
+	}
+
+	/* The mapping keeps changing under our hands. */
+	return EAGAIN;
+}
+
+/** Pin a user buffer of the current address space.
+ *
+ * @param addr  User virtual address of the buffer.
+ * @param size  Size of the buffer. Must not be zero.
+ * @param write True if the buffer is going to be written to.
+ * @param pin   Place to store the pin descriptor.
+ *
+ * @return EOK on success or an error code.
+ *
+ */
+int ipc_pin(uintptr_t addr, size_t size, bool write, ipc_pin_t **pin)
+{
+	assert(size > 0);
+
+	if (addr + size < addr)
+		return EINVAL;
+
+	if (size > DATA_XFER_DIRECT_LIMIT)
+		return ELIMIT;
+
+	uintptr_t base = ALIGN_DOWN(addr, PAGE_SIZE);
+	size_t count = (ALIGN_UP(addr + size, PAGE_SIZE) - base) >> PAGE_WIDTH;
+
+	ipc_pin_t *p = malloc(sizeof(ipc_pin_t) + count * sizeof(uintptr_t),
+	    FRAME_ATOMIC);
+	if (!p)
+		return ENOMEM;
+
+	p->offset = addr - base;
+	p->size = size;
+	p->count = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		uintptr_t page = base + (i << PAGE_WIDTH);
+		int rc = pin_frame(max(page, addr), write, &p->frame[i]);
+		if (rc != EOK) {
+			ipc_unpin(p);
+			return rc;
+		}
+
+		p->count++;
+	}
+
+	*pin = p;
+	return EOK;
+}
+
+/** Unpin the frames of a pinned buffer and destroy the pin descriptor.
+ *
+ * @param pin Pin descriptor.
+ *
+ */
+void ipc_unpin(ipc_pin_t *pin)
+{
+	for (size_t i = 0; i < pin->count; i++)
+		frame_free_noreserve(pin->frame[i], 1);
+
+	free(pin);
+}
+
+/** Get a kernel address of a pinned frame.
+ *
+ * Frames from the identity mapped region are accessed directly, other frames
+ * are temporarily mapped.
+ *
+ */
+static uintptr_t pin_frame_map(uintptr_t frame)
+{
+	uintptr_t limit = KA2PA(config.identity_base) + config.identity_size;
+
+	if (frame < limit)
+		return PA2KA(frame);
+
+	return km_map(frame, PAGE_SIZE,
+	    PAGE_READ | PAGE_WRITE | PAGE_CACHEABLE);
+}
+
+/** Copy data between the current address space and a pinned buffer.
+ *
+ * @param pin   Pin descriptor.
+ * @param uspace User virtual address in the current address space.
+ * @param size  Number of bytes to copy.
+ * @param to    True to copy to the pinned buffer, false to copy from it.
+ *
+ * @return EOK on success or an error code.
+ *
+ */
+static int pin_copy(ipc_pin_t *pin, uintptr_t uspace, size_t size, bool to)
+{
+	if (size > pin->size)
+		return ELIMIT;
+
+	size_t offset = pin->offset;
+	size_t done = 0;
+
+	for (size_t i = 0; done < size; i++) {
+		assert(i < pin->count);
+
+		size_t chunk = min(PAGE_SIZE - offset, size - done);
+		uintptr_t page = pin_frame_map(pin->frame[i]);
+		if (!page)
+			return ENOMEM;
+
+		int rc;
+		if (to) {
+			rc = copy_from_uspace((void *) (page + offset),
+			    (void *) (uspace + done), chunk);
+		} else {
+			rc = copy_to_uspace((void *) (uspace + done),
+			    (void *) (page + offset), chunk);
+		}
+
+		km_temporary_page_put(page);
+		if (rc != EOK)
+			return rc;
+
+		done += chunk;
+		offset = 0;
+	}
+
+	return EOK;
+}
+
+/** Copy data from the current address space to a pinned buffer.
+ *
+ * @param pin Pin descriptor.
+ * @param src Source user virtual address.
+ * @param size Number of bytes to copy.
+ *
+ * @return EOK on success or an error code.
+ *
+ */
+int ipc_pin_copy_from_uspace(ipc_pin_t *pin, const void *src, size_t size)
+{
+	return pin_copy(pin, (uintptr_t) src, size, true);
+}
+
+/** Copy data from a pinned buffer to the current address space.
+ *
+ * @param dst Destination user virtual address.
+ * @param pin Pin descriptor.
+ * @param size Number of bytes to copy.
+ *
+ * @return EOK on success or an error code.
+ *
+ */
+int ipc_pin_copy_to_uspace(void *dst, ipc_pin_t *pin, size_t size)
+{
+	return pin_copy(pin, (uintptr_t) dst, size, false);
+}
+
+/** @}
+ */
@@ -42,6 +42,7 @@
 
 #include <mem.h>
 #include <typedefs.h>
+#include <stdbool.h>
 
 /** Fill block of memory.
  *
@@ -101,21 +102,59 @@ void *memmove(void *dst, const void *src, size_t cnt)
 	uint8_t *dp;
 	const uint8_t *sp;
 	
+	/*
+	 * If the addresses are congruent modulo the word size, the bulk
+	 * of the block can be moved word-by-word. Each word is loaded
+	 * before it is stored, so this is safe for any overlap.
+	 */
+	bool aligned = ((((uintptr_t) dst) ^ ((uintptr_t) src)) &
+	    (sizeof(unsigned long) - 1)) == 0;
+	
 	/* Which direction? */
 	if (src > dst) {
 		/* Forwards. */
 		dp = dst;
 		sp = src;
 		
+		if (aligned) {
+			while ((cnt != 0) &&
+			    (((uintptr_t) dp & (sizeof(unsigned long) - 1)) != 0)) {
+				*dp++ = *sp++;
+				cnt--;
+			}
+			
+			while (cnt >= sizeof(unsigned long)) {
+				*((unsigned long *) dp) = *((const unsigned long *) sp);
+				dp += sizeof(unsigned long);
+				sp += sizeof(unsigned long);
+				cnt -= sizeof(unsigned long);
+			}
+		}
+		
 		while (cnt-- != 0)
 			*dp++ = *sp++;
 	} else {
 		/* Backwards. */
-		dp = dst + (cnt - 1);
-		sp = src + (cnt - 1);
+		dp = dst + cnt;
+		sp = src + cnt;
+		
+		if (aligned) {
+			while ((cnt != 0) &&
+			    (((uintptr_t) dp & (sizeof(unsigned long) - 1)) != 0)) {
+				*--dp = *--sp;
+				cnt--;
+			}
+			
+			while (cnt >= sizeof(unsigned long)) {
+				dp -= sizeof(unsigned long);
+				sp -= sizeof(unsigned long);
+				*((unsigned long *) dp) = *((const unsigned long *) sp);
+				cnt -= sizeof(unsigned long);
+			}
+		}
 		
 		while (cnt-- != 0)
-			*dp-- = *sp--;
+			*--dp = *--sp;
 	}
 	
 	return dst;
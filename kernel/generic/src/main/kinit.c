@@ -161,6 +161,21 @@ void kinit(void *arg)
 	 */
 	ARCH_OP(post_smp_init);
 	
+	/*
+	 * For each CPU, create the thread filling its pool of pre-zeroed
+	 * frames.
+	 */
+	for (unsigned int i = 0; i < config.cpu_count; i++) {
+		thread = thread_create(frame_zero_worker, NULL, TASK,
+		    THREAD_FLAG_UNCOUNTED, "kzero");
+		if (thread != NULL) {
+			thread_wire(thread, &cpus[i]);
+			thread_ready(thread);
+		} else
+			log(LF_OTHER, LVL_ERROR,
+			    "Unable to create kzero thread for cpu%u", i);
+	}
+	
 	/* Start thread computing system load */
 	thread = thread_create(kload, NULL, TASK, THREAD_FLAG_NONE,
 	    "kload");
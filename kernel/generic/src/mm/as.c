@@ -52,6 +52,8 @@
 #include <mm/frame.h>
 #include <mm/slab.h>
 #include <mm/tlb.h>
+#include <cpu/cpu_mask.h>
+#include <arch/barrier.h>
 #include <arch/mm/page.h>
 #include <genarch/mm/page_pt.h>
 #include <genarch/mm/page_ht.h>
@@ -91,6 +93,15 @@ as_operations_t *as_operations = NULL;
  */
 static slab_cache_t *as_cache;
 
+/** Maximum number of used space intervals unmapped in one TLB shootdown. */
+#define AS_UNMAP_BATCH  16
+
+/** Interval of pages to be unmapped. */
+typedef struct {
+	uintptr_t page;
+	size_t count;
+} as_unmap_batch_t;
+
 /** ASID subsystem lock.
  *
  * This lock protects:
@@ -157,10 +168,14 @@ as_t *as_create(unsigned int flags)
 	
 	btree_create(&as->as_area_btree);
 	
-	if (flags & FLAG_AS_KERNEL)
+	if (flags & FLAG_AS_KERNEL) {
 		as->asid = ASID_KERNEL;
-	else
+		as->cpu_mask = NULL;
+	} else {
 		as->asid = ASID_INVALID;
+		as->cpu_mask = (cpu_mask_t *) malloc(cpu_mask_size(), 0);
+		cpu_mask_none(as->cpu_mask);
+	}
 	
 	atomic_set(&as->refcount, 0);
 	as->cpu_refcount = 0;
@@ -253,6 +268,9 @@ retry:
 	page_table_destroy(NULL);
 #endif
 	
+	if (as->cpu_mask != NULL)
+		free(as->cpu_mask);
+	
 	slab_free(as_cache, as);
 }
 
@@ -446,13 +464,15 @@ NO_TRACE static bool check_area_conflicts(as_t *as, uintptr_t addr,
  * @param bound   Lowest address bound.
  * @param size    Requested size of the allocation.
  * @param guarded True if the allocation must be protected by guard pages.
+ * @param align   Required alignment of the returned address (a multiple
+ *                of PAGE_SIZE).
  *
  * @return Address of the beginning of unmapped address space area.
  * @return -1 if no suitable address space area was found.
  *
  */
 NO_TRACE static uintptr_t as_get_unmapped_area(as_t *as, uintptr_t bound,
-    size_t size, bool guarded)
+    size_t size, bool guarded, uintptr_t align)
 {
 	assert(mutex_locked(&as->lock));
 	
@@ -482,7 +502,10 @@ NO_TRACE static uintptr_t as_get_unmapped_area(as_t *as, uintptr_t bound,
 			addr += P2SZ(1);
 		}
 
-		if (check_area_conflicts(as, addr, pages, guarded, NULL))
+		addr = ALIGN_UP(addr, align);
+
+		if ((addr >= bound) &&
+		    (check_area_conflicts(as, addr, pages, guarded, NULL)))
 			return addr;
 	}
 	
@@ -504,6 +527,8 @@ NO_TRACE static uintptr_t as_get_unmapped_area(as_t *as, uintptr_t bound,
 				addr += P2SZ(1);
 			}
 
+			addr = ALIGN_UP(addr, align);
+
 			bool avail =
 			    ((addr >= bound) && (addr >= area->base) &&
 			    (check_area_conflicts(as, addr, pages, guarded, area)));
@@ -602,7 +627,20 @@ as_area_t *as_area_create(as_t *as, unsigned int flags, size_t size,
 	mutex_lock(&as->lock);
 	
 	if (*base == (uintptr_t) AS_AREA_ANY) {
-		*base = as_get_unmapped_area(as, bound, size, guarded);
+		*base = (uintptr_t) -1;
+
+		/*
+		 * Prefer placing areas which can contain large pages at
+		 * the large page boundary.
+		 */
+		if ((LARGE_PAGE_SIZE != 0) && (size >= LARGE_PAGE_SIZE))
+			*base = as_get_unmapped_area(as, bound, size, guarded,
+			    LARGE_PAGE_SIZE);
+
+		if (*base == (uintptr_t) -1)
+			*base = as_get_unmapped_area(as, bound, size, guarded,
+			    PAGE_SIZE);
+
 		if (*base == (uintptr_t) -1) {
 			mutex_unlock(&as->lock);
 			return NULL;
@@ -678,6 +716,20 @@ as_area_t *as_area_create(as_t *as, unsigned int flags, size_t size,
 	btree_create(&area->used_space);
 	btree_insert(&as->as_area_btree, *base, (void *) area,
 	    NULL);
+
+	/*
+	 * Prefault the whole area if requested and supported by the backend.
+	 * This is only a hint, the pages which cannot be populated now will
+	 * be faulted in on demand.
+	 */
+	if ((flags & AS_AREA_POPULATE) && !(attrs & AS_AREA_ATTR_PARTIAL) &&
+	    (area->backend) && (area->backend->populate)) {
+		mutex_lock(&area->lock);
+		page_table_lock(as, false);
+		area->backend->populate(area, area->base, area->pages);
+		page_table_unlock(as, false);
+		mutex_unlock(&area->lock);
+	}
 	
 	mutex_unlock(&as->lock);
 	
@@ -747,6 +799,105 @@ NO_TRACE static as_area_t *find_area_and_lock(as_t *as, uintptr_t va)
 	return NULL;
 }
 
+/** Remove the mapping of a used page within a TLB shootdown sequence.
+ *
+ * A large page starting at page is removed as a whole if it lies within
+ * the remaining count pages. Otherwise only page is removed, which must
+ * not be mapped by a large page.
+ *
+ * @param as         Address space.
+ * @param page       Virtual address of the page.
+ * @param count      Number of used pages starting at page to be removed.
+ * @param[out] frame Frame mapped at page.
+ *
+ * @return Number of pages removed.
+ *
+ */
+static size_t used_page_remove(as_t *as, uintptr_t page, size_t count,
+    uintptr_t *frame)
+{
+	pte_t pte;
+	bool found = page_mapping_find(as, page, false, &pte);
+	
+	assert(found);
+	assert(PTE_VALID(&pte));
+	assert(PTE_PRESENT(&pte));
+	
+	*frame = PTE_GET_FRAME(&pte);
+	
+	if ((LARGE_PAGE_SIZE != 0) && (count >= LARGE_PAGE_PAGES) &&
+	    (IS_ALIGNED(page, LARGE_PAGE_SIZE)) &&
+	    (page_mapping_remove_large(as, page)))
+		return LARGE_PAGE_PAGES;
+	
+	page_mapping_remove(as, page);
+	return 1;
+}
+
+/** Unmap a batch of used space intervals of a shrinking area.
+ *
+ * All the intervals are unmapped within a single TLB shootdown sequence.
+ * The caller holds the page table lock and has already removed the
+ * intervals from the used space of the area.
+ *
+ * @param as    Address space.
+ * @param area  Address space area being shrunk.
+ * @param pages New number of pages of the area.
+ * @param batch Intervals to unmap.
+ * @param count Number of intervals in the batch.
+ *
+ */
+static void as_area_unmap_batch(as_t *as, as_area_t *area, size_t pages,
+    as_unmap_batch_t *batch, size_t count)
+{
+	/*
+	 * A large page crossing the new end of the area is partly removed,
+	 * split it before the shootdown as splitting may block. The large
+	 * pages beyond it are removed as a whole.
+	 */
+	if ((LARGE_PAGE_SIZE != 0) &&
+	    (!IS_ALIGNED(area->base + P2SZ(pages), LARGE_PAGE_SIZE)))
+		page_mapping_split_large(as, area->base + P2SZ(pages), 1);
+	
+	/*
+	 * Start TLB shootdown sequence.
+	 */
+	ipl_t ipl = tlb_shootdown_start(TLB_INVL_PAGES, as->asid,
+	    area->base + P2SZ(pages), area->pages - pages, as->cpu_mask);
+	
+	for (size_t j = 0; j < count; j++) {
+		size_t i = 0;
+		while (i < batch[j].count) {
+			uintptr_t page = batch[j].page + P2SZ(i);
+			uintptr_t frame;
+			size_t removed = used_page_remove(as, page,
+			    batch[j].count - i, &frame);
+			
+			if ((area->backend) && (area->backend->frame_free)) {
+				area->backend->frame_free(area, page, frame,
+				    removed);
+			}
+			
+			i += removed;
+		}
+	}
+	
+	/*
+	 * Finish TLB shootdown sequence.
+	 */
+	
+	tlb_invalidate_pages(as->asid, area->base + P2SZ(pages),
+	    area->pages - pages);
+	
+	/*
+	 * Invalidate software translation caches
+	 * (e.g. TSB on sparc64, PHT on ppc32).
+	 */
+	as_invalidate_translation_cache(as, area->base + P2SZ(pages),
+	    area->pages - pages);
+	tlb_shootdown_finalize(ipl);
+}
+
 /** Find address space area and change it.
  *
  * @param as      Address space.
@@ -824,6 +975,9 @@ int as_area_resize(as_t *as, uintptr_t address, size_t size, unsigned int flags)
 		 * is also the right way to remove part of the used_space
 		 * B+tree leaf list.
 		 */
+		as_unmap_batch_t batch[AS_UNMAP_BATCH];
+		size_t batched = 0;
+		
 		bool cond = true;
 		while (cond) {
 			assert(!list_empty(&area->used_space.leaf_list));
@@ -872,58 +1026,30 @@ int as_area_resize(as_t *as, uintptr_t address, size_t size, unsigned int flags)
 				}
 				
 				/*
-				 * Start TLB shootdown sequence.
-				 *
-				 * The sequence is rather short and can be
-				 * repeated multiple times. The reason is that
-				 * we don't want to have used_space_remove()
-				 * inside the sequence as it may use a blocking
-				 * memory allocation for its B+tree. Blocking
-				 * while holding the tlblock spinlock is
-				 * forbidden and would hit a kernel assertion.
+				 * Remember the pages to be unmapped. They are
+				 * unmapped in batches, one TLB shootdown
+				 * sequence for several intervals. We don't
+				 * want to have used_space_remove() inside the
+				 * sequence as it may use a blocking memory
+				 * allocation for its B+tree. Blocking while
+				 * holding the tlblock spinlock is forbidden
+				 * and would hit a kernel assertion.
 				 */
-
-				ipl_t ipl = tlb_shootdown_start(TLB_INVL_PAGES,
-				    as->asid, area->base + P2SZ(pages),
-				    area->pages - pages);
-		
-				for (; i < node_size; i++) {
-					pte_t pte;
-					bool found = page_mapping_find(as,
-					    ptr + P2SZ(i), false, &pte);
-					
-					assert(found);
-					assert(PTE_VALID(&pte));
-					assert(PTE_PRESENT(&pte));
-					
-					if ((area->backend) &&
-					    (area->backend->frame_free)) {
-						area->backend->frame_free(area,
-						    ptr + P2SZ(i),
-						    PTE_GET_FRAME(&pte));
-					}
-					
-					page_mapping_remove(as, ptr + P2SZ(i));
+				batch[batched].page = ptr + P2SZ(i);
+				batch[batched].count = node_size - i;
+				batched++;
+				
+				if (batched == AS_UNMAP_BATCH) {
+					as_area_unmap_batch(as, area, pages,
+					    batch, batched);
+					batched = 0;
 				}
-		
-				/*
-				 * Finish TLB shootdown sequence.
-				 */
-		
-				tlb_invalidate_pages(as->asid,
-				    area->base + P2SZ(pages),
-				    area->pages - pages);
-		
-				/*
-				 * Invalidate software translation caches
-				 * (e.g. TSB on sparc64, PHT on ppc32).
-				 */
-				as_invalidate_translation_cache(as,
-				    area->base + P2SZ(pages),
-				    area->pages - pages);
-				tlb_shootdown_finalize(ipl);
 			}
 		}
+		
+		if (batched > 0)
+			as_area_unmap_batch(as, area, pages, batch, batched);
+		
 		page_table_unlock(as, false);
 	} else {
 		/*
@@ -989,10 +1115,11 @@ int as_area_destroy(as_t *as, uintptr_t address)
 	 * Start TLB shootdown sequence.
 	 */
 	ipl_t ipl = tlb_shootdown_start(TLB_INVL_PAGES, as->asid, area->base,
-	    area->pages);
+	    area->pages, as->cpu_mask);
 	
 	/*
-	 * Visit only the pages mapped by used_space B+tree.
+	 * Visit only the pages mapped by used_space B+tree. Large pages lie
+	 * entirely within the area and are removed as a whole.
 	 */
 	list_foreach(area->used_space.leaf_list, leaf_link, btree_node_t,
 	    node) {
@@ -1000,25 +1127,21 @@ int as_area_destroy(as_t *as, uintptr_t address)
 		
 		for (i = 0; i < node->keys; i++) {
 			uintptr_t ptr = node->key[i];
-			size_t size;
+			size_t size = 0;
 			
-			for (size = 0; size < (size_t) node->value[i]; size++) {
-				pte_t pte;
-				bool found = page_mapping_find(as,
-				     ptr + P2SZ(size), false, &pte);
-				
-				assert(found);
-				assert(PTE_VALID(&pte));
-				assert(PTE_PRESENT(&pte));
+			while (size < (size_t) node->value[i]) {
+				uintptr_t frame;
+				size_t removed = used_page_remove(as,
+				    ptr + P2SZ(size),
+				    (size_t) node->value[i] - size, &frame);
 				
 				if ((area->backend) &&
 				    (area->backend->frame_free)) {
 					area->backend->frame_free(area,
-					    ptr + P2SZ(size),
-					    PTE_GET_FRAME(&pte));
+					    ptr + P2SZ(size), frame, removed);
 				}
 				
-				page_mapping_remove(as, ptr + P2SZ(size));
+				size += removed;
 			}
 		}
 	}
@@ -1290,8 +1413,12 @@ int as_area_change_flags(as_t *as, unsigned int flags, uintptr_t address)
 			used_pages += (size_t) node->value[i];
 	}
 	
-	/* An array for storing frame numbers */
+	/*
+	 * Arrays for storing frame numbers and marking the first pages of
+	 * large pages
+	 */
 	uintptr_t *old_frame = malloc(used_pages * sizeof(uintptr_t), 0);
+	bool *old_large = malloc(used_pages * sizeof(bool), 0);
 	
 	page_table_lock(as, false);
 	
@@ -1299,11 +1426,12 @@ int as_area_change_flags(as_t *as, unsigned int flags, uintptr_t address)
 	 * Start TLB shootdown sequence.
 	 */
 	ipl_t ipl = tlb_shootdown_start(TLB_INVL_PAGES, as->asid, area->base,
-	    area->pages);
+	    area->pages, as->cpu_mask);
 	
 	/*
 	 * Remove used pages from page tables and remember their frame
-	 * numbers.
+	 * numbers. Large pages are removed as a whole and remembered so
+	 * that they can be mapped back as large pages.
 	 */
 	size_t frame_idx = 0;
 	
@@ -1313,21 +1441,23 @@ int as_area_change_flags(as_t *as, unsigned int flags, uintptr_t address)
 		
 		for (i = 0; i < node->keys; i++) {
 			uintptr_t ptr = node->key[i];
-			size_t size;
+			size_t size = 0;
 			
-			for (size = 0; size < (size_t) node->value[i]; size++) {
-				pte_t pte;
-				bool found = page_mapping_find(as,
-				    ptr + P2SZ(size), false, &pte);
+			while (size < (size_t) node->value[i]) {
+				uintptr_t frame;
 				
-				assert(found);
-				assert(PTE_VALID(&pte));
-				assert(PTE_PRESENT(&pte));
+				/* Remove old mapping */
+				size_t removed = used_page_remove(as,
+				    ptr + P2SZ(size),
+				    (size_t) node->value[i] - size, &frame);
 				
-				old_frame[frame_idx++] = PTE_GET_FRAME(&pte);
+				for (size_t j = 0; j < removed; j++) {
+					old_frame[frame_idx] = frame + P2SZ(j);
+					old_large[frame_idx++] =
+					    ((j == 0) && (removed > 1));
+				}
 				
-				/* Remove old mapping */
-				page_mapping_remove(as, ptr + P2SZ(size));
+				size += removed;
 			}
 		}
 	}
@@ -1365,20 +1495,30 @@ int as_area_change_flags(as_t *as, unsigned int flags, uintptr_t address)
 		
 		for (i = 0; i < node->keys; i++) {
 			uintptr_t ptr = node->key[i];
-			size_t size;
+			size_t size = 0;
 			
-			for (size = 0; size < (size_t) node->value[i]; size++) {
+			while (size < (size_t) node->value[i]) {
 				page_table_lock(as, false);
 				
 				/* Insert the new mapping */
-				page_mapping_insert(as, ptr + P2SZ(size),
-				    old_frame[frame_idx++], page_flags);
+				if ((old_large[frame_idx]) &&
+				    (page_mapping_insert_large(as,
+				    ptr + P2SZ(size), old_frame[frame_idx],
+				    page_flags))) {
+					size += LARGE_PAGE_PAGES;
+					frame_idx += LARGE_PAGE_PAGES;
+				} else {
+					page_mapping_insert(as, ptr + P2SZ(size),
+					    old_frame[frame_idx++], page_flags);
+					size++;
+				}
 				
 				page_table_unlock(as, false);
 			}
 		}
 	}
 	
+	free(old_large);
 	free(old_frame);
 	
 	mutex_unlock(&area->lock);
@@ -1481,6 +1621,12 @@ int as_page_fault(uintptr_t address, pf_access_t access, istate_t *istate)
 	page_table_unlock(AS, false);
 	mutex_unlock(&area->lock);
 	mutex_unlock(&AS->lock);
+	
+	/* Threads of the task can fault concurrently. */
+	irq_spinlock_lock(&TASK->lock, true);
+	TASK->page_faults++;
+	irq_spinlock_unlock(&TASK->lock, true);
+	
 	return AS_PF_OK;
 	
 page_fault:
@@ -1572,6 +1718,22 @@ retry:
 			new_as->asid = asid_get();
 	}
 	
+#ifdef CONFIG_SMP
+	/*
+	 * Make this processor a recipient of TLB shootdowns of the new
+	 * address space before any of its translations can be cached here.
+	 * A shootdown which has sampled the mask without this processor
+	 * must complete first, otherwise the processor could cache
+	 * a translation that is just being removed.
+	 */
+	if ((new_as->cpu_mask != NULL) &&
+	    (!cpu_mask_is_set(new_as->cpu_mask, CPU->id))) {
+		cpu_mask_set(new_as->cpu_mask, CPU->id);
+		memory_barrier();
+		tlb_shootdown_ipi_recv();
+	}
+#endif
+	
 #ifdef AS_PAGE_TABLE
 	SET_PTL0_ADDRESS(new_as->genarch.page_table);
 #endif
@@ -1710,6 +1872,85 @@ size_t as_area_get_size(uintptr_t base)
 	return size;
 }
 
+/** Check that a portion of address space area is not used.
+ *
+ * The address space area must be already locked.
+ *
+ * @param area  Address space area.
+ * @param page  First page of the portion.
+ * @param count Number of pages in the portion.
+ *
+ * @return True if no page of the portion is marked as used.
+ *
+ */
+NO_TRACE static bool used_space_unused(as_area_t *area, uintptr_t page,
+    size_t count)
+{
+	btree_node_t *leaf;
+	if (btree_search(&area->used_space, page, &leaf))
+		return false;
+	
+	/*
+	 * The intervals overlapping the portion, if any, are the last
+	 * interval starting below the portion and the intervals starting
+	 * inside of it. They are found in the leaf, or at the edges of its
+	 * neighbours.
+	 */
+	btree_node_t *left = btree_leaf_node_left_neighbour(&area->used_space,
+	    leaf);
+	if ((left) && (left->keys > 0) &&
+	    (overlaps(page, P2SZ(count), left->key[left->keys - 1],
+	    P2SZ((size_t) left->value[left->keys - 1]))))
+		return false;
+	
+	for (btree_key_t i = 0; i < leaf->keys; i++) {
+		if (overlaps(page, P2SZ(count), leaf->key[i],
+		    P2SZ((size_t) leaf->value[i])))
+			return false;
+	}
+	
+	btree_node_t *right = btree_leaf_node_right_neighbour(&area->used_space,
+	    leaf);
+	if ((right) && (right->keys > 0) &&
+	    (overlaps(page, P2SZ(count), right->key[0],
+	    P2SZ((size_t) right->value[0]))))
+		return false;
+	
+	return true;
+}
+
+/** Find an unused large page of an address space area.
+ *
+ * The address space area must be already locked.
+ *
+ * @param area       Address space area.
+ * @param page       Page within the area.
+ * @param[out] lpage Virtual address of the large page containing page.
+ *
+ * @return True if the large page containing page lies entirely within
+ *         the area and none of its pages is in use. False otherwise or if
+ *         large pages are not supported.
+ *
+ */
+bool as_area_large_page(as_area_t *area, uintptr_t page, uintptr_t *lpage)
+{
+	assert(mutex_locked(&area->lock));
+	
+	if (LARGE_PAGE_SIZE == 0)
+		return false;
+	
+	uintptr_t base = ALIGN_DOWN(page, LARGE_PAGE_SIZE);
+	if ((base < area->base) ||
+	    (base - area->base + LARGE_PAGE_SIZE > P2SZ(area->pages)))
+		return false;
+	
+	if (!used_space_unused(area, base, LARGE_PAGE_PAGES))
+		return false;
+	
+	*lpage = base;
+	return true;
+}
+
 /** Mark portion of address space area as used.
  *
  * The address space area must be already locked.
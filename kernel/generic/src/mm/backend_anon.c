@@ -54,6 +54,12 @@
 #include <mem.h>
 #include <arch.h>
 
+/** Number of pages populated around a faulting page of a private area.
+ *
+ * Must be a power of two. The window is aligned to its own size.
+ */
+#define ANON_FAULT_AROUND  16
+
 static bool anon_create(as_area_t *);
 static bool anon_resize(as_area_t *, size_t);
 static void anon_share(as_area_t *);
@@ -63,7 +69,8 @@ static bool anon_is_resizable(as_area_t *);
 static bool anon_is_shareable(as_area_t *);
 
 static int anon_page_fault(as_area_t *, uintptr_t, pf_access_t);
-static void anon_frame_free(as_area_t *, uintptr_t, uintptr_t);
+static void anon_frame_free(as_area_t *, uintptr_t, uintptr_t, size_t);
+static size_t anon_populate(as_area_t *, uintptr_t, size_t);
 
 mem_backend_t anon_backend = {
 	.create = anon_create,
@@ -76,6 +83,7 @@ mem_backend_t anon_backend = {
 
 	.page_fault = anon_page_fault,
 	.frame_free = anon_frame_free,
+	.populate = anon_populate,
 
 	.create_shared_data = NULL,
 	.destroy_shared_data = NULL
@@ -174,6 +182,27 @@ bool anon_is_shareable(as_area_t *area)
 	return !(area->flags & AS_AREA_LATE_RESERVE);
 }
 
+/** Allocate a zero-filled frame for an anonymous page.
+ *
+ * Frames zeroed in advance by the idle CPUs are preferred. When there is no
+ * low memory left, a high memory frame is zeroed through a temporary page.
+ *
+ * @return Physical address of the allocated frame.
+ */
+static uintptr_t anon_frame_alloc(void)
+{
+	uintptr_t frame = frame_alloc(1, FRAME_ZERO | FRAME_ATOMIC |
+	    FRAME_NO_RECLAIM | FRAME_NO_RESERVE, 0);
+	if (frame)
+		return frame;
+
+	uintptr_t kpage = km_temporary_page_get(&frame, FRAME_NO_RESERVE);
+	memsetb((void *) kpage, PAGE_SIZE, 0);
+	km_temporary_page_put(kpage);
+
+	return frame;
+}
+
 /** Service a page fault in the anonymous memory address space area.
  *
  * The address space area and page tables must be already locked.
@@ -187,8 +216,8 @@ bool anon_is_shareable(as_area_t *area)
  */
 int anon_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 {
-	uintptr_t kpage;
 	uintptr_t frame;
+	bool shared;
 
 	assert(page_table_locked(AS));
 	assert(mutex_locked(&area->lock));
@@ -198,7 +227,8 @@ int anon_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 		return AS_PF_FAULT;
 
 	mutex_lock(&area->sh_info->lock);
-	if (area->sh_info->shared) {
+	shared = area->sh_info->shared;
+	if (shared) {
 		btree_node_t *leaf;
 		
 		/*
@@ -225,10 +255,7 @@ int anon_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 				}
 			}
 			if (allocate) {
-				kpage = km_temporary_page_get(&frame,
-				    FRAME_NO_RESERVE);
-				memsetb((void *) kpage, PAGE_SIZE, 0);
-				km_temporary_page_put(kpage);
+				frame = anon_frame_alloc();
 				
 				/*
 				 * Insert the address of the newly allocated
@@ -256,6 +283,33 @@ int anon_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 		 *   the different causes
 		 */
 
+		/*
+		 * Back the whole surrounding large page at once if it lies
+		 * within the area and none of its pages is used yet. Late
+		 * reserve areas (e.g. stacks) are meant to commit their memory
+		 * page by page, so they are left alone.
+		 */
+		uintptr_t lpage;
+		if ((!(area->flags & AS_AREA_LATE_RESERVE)) &&
+		    (as_area_large_page(area, upage, &lpage))) {
+			frame = frame_alloc(LARGE_PAGE_PAGES, FRAME_ZERO |
+			    FRAME_ATOMIC | FRAME_NO_RECLAIM | FRAME_NO_RESERVE,
+			    LARGE_PAGE_SIZE - 1);
+			if (frame) {
+				if (page_mapping_insert_large(AS, lpage, frame,
+				    as_area_get_flags(area))) {
+					mutex_unlock(&area->sh_info->lock);
+					if (!used_space_insert(area, lpage,
+					    LARGE_PAGE_PAGES))
+						panic("Cannot insert used space.");
+					
+					return AS_PF_OK;
+				}
+				
+				frame_free_noreserve(frame, LARGE_PAGE_PAGES);
+			}
+		}
+
 		if (area->flags & AS_AREA_LATE_RESERVE) {
 			/*
 			 * Reserve the memory for this page now.
@@ -266,9 +320,7 @@ int anon_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 			}
 		}
 
-		kpage = km_temporary_page_get(&frame, FRAME_NO_RESERVE);
-		memsetb((void *) kpage, PAGE_SIZE, 0);
-		km_temporary_page_put(kpage);
+		frame = anon_frame_alloc();
 	}
 	mutex_unlock(&area->sh_info->lock);
 	
@@ -280,19 +332,108 @@ int anon_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 	page_mapping_insert(AS, upage, frame, as_area_get_flags(area));
 	if (!used_space_insert(area, upage, 1))
 		panic("Cannot insert used space.");
+
+	/*
+	 * Private anonymous memory is typically touched sequentially, so
+	 * populate the surrounding aligned window as well. This saves the
+	 * subsequent page faults at the cost of possibly allocating a few
+	 * pages which will never be used.
+	 */
+	if (!shared) {
+		uintptr_t start = ALIGN_DOWN(upage, P2SZ(ANON_FAULT_AROUND));
+		uintptr_t end = start + P2SZ(ANON_FAULT_AROUND);
+		uintptr_t area_end = area->base + P2SZ(area->pages);
+
+		if (start < area->base)
+			start = area->base;
+		if ((end > area_end) || (end < start))
+			end = area_end;
+
+		(void) anon_populate(area, start, (end - start) >> PAGE_WIDTH);
+	}
 		
 	return AS_PF_OK;
 }
 
-/** Free a frame that is backed by the anonymous memory backend.
+/** Map zeroed frames to the not yet mapped pages of an anonymous area.
+ *
+ * Consecutive unmapped pages are backed by a single contiguous zero-filled
+ * allocation. The population is merely an optimization, so
+ * it stops silently when the memory cannot be reserved or allocated without
+ * blocking; the remaining pages will be faulted in on demand.
+ *
+ * The address space area and page tables must be already locked and the area
+ * must not be shared.
+ *
+ * @param area  Address space area to populate.
+ * @param page  First page of the range to populate.
+ * @param count Number of pages in the range.
+ *
+ * @return Number of newly mapped pages.
+ */
+size_t anon_populate(as_area_t *area, uintptr_t page, size_t count)
+{
+	unsigned int flags = as_area_get_flags(area);
+	size_t populated = 0;
+	size_t i = 0;
+
+	assert(page_table_locked(area->as));
+	assert(mutex_locked(&area->lock));
+	assert(IS_ALIGNED(page, PAGE_SIZE));
+
+	while (i < count) {
+		pte_t pte;
+
+		/* Skip the pages which are already mapped. */
+		if (page_mapping_find(area->as, page + P2SZ(i), false, &pte)) {
+			i++;
+			continue;
+		}
+
+		/* Find the extent of the unmapped run. */
+		size_t run = 1;
+		while ((i + run < count) && (!page_mapping_find(area->as,
+		    page + P2SZ(i + run), false, &pte)))
+			run++;
+
+		if ((area->flags & AS_AREA_LATE_RESERVE) &&
+		    (!reserve_try_alloc(run)))
+			break;
+
+		uintptr_t frame = frame_alloc(run,
+		    FRAME_ZERO | FRAME_ATOMIC | FRAME_NO_RESERVE, 0);
+		if (!frame) {
+			if (area->flags & AS_AREA_LATE_RESERVE)
+				reserve_free(run);
+			break;
+		}
+
+		for (size_t j = 0; j < run; j++) {
+			page_mapping_insert(area->as, page + P2SZ(i + j),
+			    frame + P2SZ(j), flags);
+		}
+		if (!used_space_insert(area, page + P2SZ(i), run))
+			panic("Cannot insert used space.");
+
+		populated += run;
+		i += run;
+	}
+
+	return populated;
+}
+
+/** Free frames that are backed by the anonymous memory backend.
  *
  * The address space area and page tables must be already locked.
  *
  * @param area Ignored.
  * @param page Virtual address of the page corresponding to the frame.
  * @param frame Frame to be released.
+ * @param count Number of contiguous frames to be released, more than one
+ *              for a large page.
  */
-void anon_frame_free(as_area_t *area, uintptr_t page, uintptr_t frame)
+void anon_frame_free(as_area_t *area, uintptr_t page, uintptr_t frame,
+    size_t count)
 {
 	assert(page_table_locked(area->as));
 	assert(mutex_locked(&area->lock));
@@ -303,14 +444,14 @@ void anon_frame_free(as_area_t *area, uintptr_t page, uintptr_t frame)
 		 * be unreserved when the area is destroyed so we need to use
 		 * the normal unreserving frame_free().
 		 */
-		frame_free(frame, 1);
+		frame_free(frame, count);
 	} else {
 		/*
 		 * The reserve will be given back when the area is destroyed or
 		 * resized, so use the frame_free_noreserve() which does not
 		 * manipulate the reserve or it would be given back twice.
 		 */
-		frame_free_noreserve(frame, 1);
+		frame_free_noreserve(frame, count);
 	}
 }
 
@@ -61,7 +61,7 @@ static bool elf_is_resizable(as_area_t *);
 static bool elf_is_shareable(as_area_t *);
 
 static int elf_page_fault(as_area_t *, uintptr_t, pf_access_t);
-static void elf_frame_free(as_area_t *, uintptr_t, uintptr_t);
+static void elf_frame_free(as_area_t *, uintptr_t, uintptr_t, size_t);
 
 mem_backend_t elf_backend = {
 	.create = elf_create,
@@ -416,15 +416,19 @@ int elf_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
  * @param page		Page that is mapped to frame. Must be aligned to
  * 			PAGE_SIZE.
  * @param frame		Frame to be released.
+ * @param count		Number of frames, always one as the ELF backend does
+ *			not map large pages.
  *
  */
-void elf_frame_free(as_area_t *area, uintptr_t page, uintptr_t frame)
+void elf_frame_free(as_area_t *area, uintptr_t page, uintptr_t frame,
+    size_t count)
 {
 	elf_segment_header_t *entry = area->backend_data.segment;
 	uintptr_t start_anon;
 
 	assert(page_table_locked(area->as));
 	assert(mutex_locked(&area->lock));
+	assert(count == 1);
 
 	assert(page >= ALIGN_DOWN(entry->p_vaddr, PAGE_SIZE));
 	assert(page < entry->p_vaddr + entry->p_memsz);
@@ -142,6 +142,22 @@ int phys_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 		return AS_PF_FAULT;
 
 	assert(upage - area->base < area->backend_data.frames * FRAME_SIZE);
+
+	/*
+	 * The physical memory is contiguous, so map the whole surrounding
+	 * large page if it fits in the area and the frames are aligned.
+	 */
+	uintptr_t lpage;
+	if ((as_area_large_page(area, upage, &lpage)) &&
+	    (IS_ALIGNED(base + (lpage - area->base), LARGE_PAGE_SIZE)) &&
+	    (page_mapping_insert_large(AS, lpage, base + (lpage - area->base),
+	    as_area_get_flags(area)))) {
+		if (!used_space_insert(area, lpage, LARGE_PAGE_PAGES))
+			panic("Cannot insert used space.");
+
+		return AS_PF_OK;
+	}
+
 	page_mapping_insert(AS, upage, base + (upage - area->base),
 	    as_area_get_flags(area));
 	
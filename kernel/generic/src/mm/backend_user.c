@@ -56,7 +56,7 @@ static bool user_is_resizable(as_area_t *);
 static bool user_is_shareable(as_area_t *);
 
 static int user_page_fault(as_area_t *, uintptr_t, pf_access_t);
-static void user_frame_free(as_area_t *, uintptr_t, uintptr_t);
+static void user_frame_free(as_area_t *, uintptr_t, uintptr_t, size_t);
 
 mem_backend_t user_backend = {
 	.create = user_create,
@@ -158,11 +158,15 @@ int user_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
  * @param area Ignored.
  * @param page Virtual address of the page corresponding to the frame.
  * @param frame Frame to be released.
+ * @param count Number of frames, always one as the user memory backend
+ *              does not map large pages.
  */
-void user_frame_free(as_area_t *area, uintptr_t page, uintptr_t frame)
+void user_frame_free(as_area_t *area, uintptr_t page, uintptr_t frame,
+    size_t count)
 {
 	assert(page_table_locked(area->as));
 	assert(mutex_locked(&area->lock));
+	assert(count == 1);
 
 	pfn_t pfn = ADDR2PFN(frame);
 	if (find_zone(pfn, 1, 0) != (size_t) -1) {
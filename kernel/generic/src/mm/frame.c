@@ -38,6 +38,10 @@
  *
  * This file contains the physical frame allocator and memory zone management.
  * The frame allocator is built on top of the two-level bitmap structure.
+ * Small blocks of low memory frames are additionally cached per CPU, so
+ * that the common allocations and deallocations do not need zones.lock.
+ * Each CPU also keeps a pool of frames zeroed in advance by a thread which
+ * runs when the CPU has nothing else to do.
  *
  */
 
@@ -60,8 +64,17 @@
 #include <macros.h>
 #include <config.h>
 #include <str.h>
+#include <cpu.h>
+#include <mem.h>
+#include <atomic.h>
 #include <proc/thread.h> /* THREAD */
 
+/** Period of checking the pool of pre-zeroed frames (in microseconds). */
+#define FRAME_ZERO_PERIOD  100000
+
+/** Number of free frames below which the pre-zeroed frame pool is not filled. */
+#define FRAME_ZERO_MIN_FREE  4096
+
 zones_t zones;
 
 /*
@@ -147,6 +160,29 @@ NO_TRACE static size_t zones_insert_zone(pfn_t base, size_t count,
 	return i;
 }
 
+/** Get number of frames in all per-CPU frame caches.
+ *
+ * The caches are not locked, the result is only informative.
+ *
+ */
+NO_TRACE static size_t frame_cache_count(void)
+{
+	size_t total = 0;
+	
+	if (cpus == NULL)
+		return 0;
+	
+	for (size_t i = 0; i < config.cpu_count; i++) {
+		for (unsigned int order = 0; order < FRAME_CACHE_ORDERS;
+		    order++)
+			total += cpus[i].frame_cache.count[order] << order;
+		
+		total += cpus[i].frame_cache.zeroed_count;
+	}
+	
+	return total;
+}
+
 /** Get total available frames.
  *
  * Assume interrupts are disabled and zones lock is
@@ -157,7 +193,7 @@ NO_TRACE static size_t zones_insert_zone(pfn_t base, size_t count,
  */
 NO_TRACE static size_t frame_total_free_get_internal(void)
 {
-	size_t total = 0;
+	size_t total = frame_cache_count();
 	size_t i;
 
 	for (i = 0; i < zones.count; i++)
@@ -815,6 +851,457 @@ void *frame_get_parent(pfn_t pfn, size_t hint)
 	return res;
 }
 
+/** Wake up threads waiting for free frames.
+ *
+ * @param freed Number of frames which have been freed.
+ *
+ */
+NO_TRACE static void frame_avail_signal(size_t freed)
+{
+	/*
+	 * Since the mem_avail_mtx is an active mutex,
+	 * we need to disable interruptsto prevent deadlock
+	 * with TLB shootdown.
+	 */
+	ipl_t ipl = interrupts_disable();
+	mutex_lock(&mem_avail_mtx);
+	
+	if (mem_avail_req > 0)
+		mem_avail_req -= min(mem_avail_req, freed);
+	
+	if (mem_avail_req == 0) {
+		mem_avail_gen++;
+		condvar_broadcast(&mem_avail_cv);
+	}
+	
+	mutex_unlock(&mem_avail_mtx);
+	interrupts_restore(ipl);
+}
+
+/************************/
+/* Per-CPU frame caches */
+/************************/
+
+/** Return per-CPU frame cache order of a block of frames.
+ *
+ * @param count Number of frames in the block.
+ *
+ * @return Order of the block or FRAME_CACHE_ORDERS if blocks of
+ *         the given size are not cached.
+ *
+ */
+NO_TRACE static unsigned int frame_cache_order(size_t count)
+{
+	if ((count & (count - 1)) != 0)
+		return FRAME_CACHE_ORDERS;
+	
+	unsigned int order = fnzb(count);
+	return min(order, FRAME_CACHE_ORDERS);
+}
+
+/** Initialize per-CPU frame cache.
+ *
+ * @param cache Frame cache to be initialized.
+ *
+ */
+void frame_cache_init(frame_cache_t *cache)
+{
+	irq_spinlock_initialize(&cache->lock, "cpus[].frame_cache.lock");
+	
+	for (unsigned int order = 0; order < FRAME_CACHE_ORDERS; order++)
+		cache->count[order] = 0;
+	
+	cache->zeroed_count = 0;
+	cache->zeroed_hits = 0;
+	cache->zeroed_misses = 0;
+	cache->zeroed_wakeup = false;
+	waitq_initialize(&cache->zeroed_wq);
+}
+
+/** Move blocks from the zones to a per-CPU frame cache.
+ *
+ * Assume interrupts are disabled and the cache is locked.
+ *
+ * @param cache Frame cache to be refilled.
+ * @param order Order of the blocks to be moved.
+ *
+ */
+NO_TRACE static void frame_cache_refill(frame_cache_t *cache,
+    unsigned int order)
+{
+	size_t count = 1 << order;
+	
+	irq_spinlock_lock(&zones.lock, false);
+	
+	while (cache->count[order] < FRAME_CACHE_BATCH) {
+		size_t znum = find_free_zone(count,
+		    FRAME_TO_ZONE_FLAGS(FRAME_LOWMEM), 0, 0);
+		if (znum == (size_t) -1)
+			break;
+		
+		pfn_t pfn = zone_frame_alloc(&zones.info[znum], count, 0) +
+		    zones.info[znum].base;
+		
+		cache->blocks[order][cache->count[order]++] = pfn;
+	}
+	
+	irq_spinlock_unlock(&zones.lock, false);
+}
+
+/** Move blocks from a per-CPU frame cache back to the zones.
+ *
+ * Assume interrupts are disabled and the cache is locked.
+ *
+ * @param cache Frame cache to be flushed.
+ * @param order Order of the blocks to be moved.
+ * @param keep  Number of blocks to keep in the cache.
+ *
+ * @return Number of frames returned to the zones.
+ *
+ */
+NO_TRACE static size_t frame_cache_flush(frame_cache_t *cache,
+    unsigned int order, size_t keep)
+{
+	size_t count = 1 << order;
+	size_t freed = 0;
+	
+	irq_spinlock_lock(&zones.lock, false);
+	
+	while (cache->count[order] > keep) {
+		pfn_t pfn = cache->blocks[order][--cache->count[order]];
+		size_t znum = find_zone(pfn, count, 0);
+		
+		assert(znum != (size_t) -1);
+		
+		for (size_t i = 0; i < count; i++)
+			freed += zone_frame_free(&zones.info[znum],
+			    pfn + i - zones.info[znum].base);
+		
+	}
+	
+	irq_spinlock_unlock(&zones.lock, false);
+	
+	return freed;
+}
+
+/** Allocate a block of frames from the per-CPU frame cache.
+ *
+ * @param order Order of the block.
+ * @param pzone Preferred zone (can be NULL).
+ *
+ * @return Physical address of the allocated block or 0 if
+ *         the cache could not be used.
+ *
+ */
+NO_TRACE static uintptr_t frame_cache_alloc(unsigned int order,
+    size_t *pzone)
+{
+	ipl_t ipl = interrupts_disable();
+	
+	if (CPU == NULL) {
+		interrupts_restore(ipl);
+		return 0;
+	}
+	
+	frame_cache_t *cache = &CPU->frame_cache;
+	irq_spinlock_lock(&cache->lock, false);
+	
+	if (cache->count[order] == 0)
+		frame_cache_refill(cache, order);
+	
+	if (cache->count[order] == 0) {
+		irq_spinlock_unlock(&cache->lock, false);
+		interrupts_restore(ipl);
+		return 0;
+	}
+	
+	pfn_t pfn = cache->blocks[order][--cache->count[order]];
+	
+	irq_spinlock_unlock(&cache->lock, false);
+	interrupts_restore(ipl);
+	
+	/*
+	 * The zones do not change once the system is up and running,
+	 * so they can be searched without zones.lock.
+	 */
+	if (pzone)
+		*pzone = find_zone(pfn, 1 << order, *pzone);
+	
+	return PFN2ADDR(pfn);
+}
+
+/** Free a block of frames into the per-CPU frame cache.
+ *
+ * Only blocks of low memory frames which are not shared (their
+ * reference count is one) can be cached. The frames of the cached
+ * block keep their reference count.
+ *
+ * @param pfn   First frame of the block.
+ * @param order Order of the block.
+ *
+ * @return True if the block was cached, false if it has to be freed
+ *         the usual way.
+ *
+ */
+NO_TRACE static bool frame_cache_free(pfn_t pfn, unsigned int order)
+{
+	size_t count = 1 << order;
+	
+	ipl_t ipl = interrupts_disable();
+	
+	/*
+	 * Threads waiting for memory are only woken up by frames freed
+	 * to the zones.
+	 */
+	if ((CPU == NULL) || (mem_avail_req > 0)) {
+		interrupts_restore(ipl);
+		return false;
+	}
+	
+	size_t znum = find_zone(pfn, count, 0);
+	if ((znum == (size_t) -1) ||
+	    (!(zones.info[znum].flags & ZONE_LOWMEM))) {
+		interrupts_restore(ipl);
+		return false;
+	}
+	
+	for (size_t i = 0; i < count; i++) {
+		frame_t *frame = zone_get_frame(&zones.info[znum],
+		    pfn + i - zones.info[znum].base);
+		if (frame->refcount != 1) {
+			interrupts_restore(ipl);
+			return false;
+		}
+	}
+	
+	frame_cache_t *cache = &CPU->frame_cache;
+	irq_spinlock_lock(&cache->lock, false);
+	
+	size_t freed = 0;
+	if (cache->count[order] == FRAME_CACHE_SIZE)
+		freed = frame_cache_flush(cache, order,
+		    FRAME_CACHE_SIZE - FRAME_CACHE_BATCH);
+	
+	cache->blocks[order][cache->count[order]++] = pfn;
+	
+	irq_spinlock_unlock(&cache->lock, false);
+	interrupts_restore(ipl);
+	
+	if (freed > 0)
+		frame_avail_signal(freed);
+	
+	return true;
+}
+
+/** Return all pre-zeroed frames of a per-CPU frame cache to the zones.
+ *
+ * Assume interrupts are disabled and the cache is locked.
+ *
+ * @param cache Frame cache to be flushed.
+ *
+ * @return Number of frames returned to the zones.
+ *
+ */
+NO_TRACE static size_t frame_zero_flush(frame_cache_t *cache)
+{
+	size_t freed = 0;
+	
+	irq_spinlock_lock(&zones.lock, false);
+	
+	while (cache->zeroed_count > 0) {
+		pfn_t pfn = cache->zeroed[--cache->zeroed_count];
+		size_t znum = find_zone(pfn, 1, 0);
+		
+		assert(znum != (size_t) -1);
+		
+		freed += zone_frame_free(&zones.info[znum],
+		    pfn - zones.info[znum].base);
+	}
+	
+	irq_spinlock_unlock(&zones.lock, false);
+	
+	return freed;
+}
+
+/** Allocate a frame from the per-CPU pool of pre-zeroed frames.
+ *
+ * The zeroing thread of the CPU is woken up when the pool runs low.
+ *
+ * @param pzone Preferred zone (can be NULL).
+ *
+ * @return Physical address of the allocated frame or 0 if
+ *         the pool is empty.
+ *
+ */
+NO_TRACE static uintptr_t frame_zero_alloc(size_t *pzone)
+{
+	ipl_t ipl = interrupts_disable();
+	
+	if (CPU == NULL) {
+		interrupts_restore(ipl);
+		return 0;
+	}
+	
+	frame_cache_t *cache = &CPU->frame_cache;
+	irq_spinlock_lock(&cache->lock, false);
+	
+	pfn_t pfn = 0;
+	if (cache->zeroed_count > 0) {
+		pfn = cache->zeroed[--cache->zeroed_count];
+		cache->zeroed_hits++;
+	} else
+		cache->zeroed_misses++;
+	
+	bool wakeup = false;
+	if ((cache->zeroed_count < FRAME_ZERO_POOL_LOW) &&
+	    (!cache->zeroed_wakeup)) {
+		cache->zeroed_wakeup = true;
+		wakeup = true;
+	}
+	
+	irq_spinlock_unlock(&cache->lock, false);
+	
+	if (wakeup)
+		waitq_wakeup(&cache->zeroed_wq, WAKEUP_FIRST);
+	
+	interrupts_restore(ipl);
+	
+	/* Frame zero is never allocated. */
+	if (pfn == 0)
+		return 0;
+	
+	if (pzone)
+		*pzone = find_zone(pfn, 1, *pzone);
+	
+	return PFN2ADDR(pfn);
+}
+
+/** Fill the pool of pre-zeroed frames of the current CPU.
+ *
+ * The frames are only zeroed while there is no other thread ready
+ * to run on the CPU and while there is enough free memory.
+ *
+ * @param cache Frame cache of the current CPU.
+ *
+ */
+static void frame_zero_refill(frame_cache_t *cache)
+{
+	while (true) {
+		irq_spinlock_lock(&cache->lock, true);
+		cache->zeroed_wakeup = false;
+		size_t count = cache->zeroed_count;
+		irq_spinlock_unlock(&cache->lock, true);
+		
+		if (count >= FRAME_ZERO_POOL_SIZE)
+			break;
+		
+		if (atomic_get(&CPU->nrdy) > 0)
+			break;
+		
+		if ((mem_avail_req > 0) ||
+		    (frame_total_free_get() < FRAME_ZERO_MIN_FREE))
+			break;
+		
+		uintptr_t frame = frame_alloc(1, FRAME_LOWMEM | FRAME_ATOMIC |
+		    FRAME_NO_RECLAIM | FRAME_NO_RESERVE, 0);
+		if (frame == 0)
+			break;
+		
+		memsetb((void *) PA2KA(frame), FRAME_SIZE, 0);
+		
+		irq_spinlock_lock(&cache->lock, true);
+		
+		if (cache->zeroed_count < FRAME_ZERO_POOL_SIZE) {
+			cache->zeroed[cache->zeroed_count++] = ADDR2PFN(frame);
+			frame = 0;
+		}
+		
+		irq_spinlock_unlock(&cache->lock, true);
+		
+		if (frame != 0) {
+			frame_free_noreserve(frame, 1);
+			break;
+		}
+	}
+}
+
+/** Thread filling the pool of pre-zeroed frames of a CPU.
+ *
+ * The thread must be wired to the CPU whose pool it fills.
+ *
+ * @param arg Not used.
+ *
+ */
+void frame_zero_worker(void *arg)
+{
+	frame_cache_t *cache = &CPU->frame_cache;
+	
+	while (true) {
+		frame_zero_refill(cache);
+		(void) waitq_sleep_timeout(&cache->zeroed_wq,
+		    FRAME_ZERO_PERIOD, SYNCH_FLAGS_NONE);
+	}
+}
+
+/** Get statistics of the pools of pre-zeroed frames.
+ *
+ * The pools are not locked, the result is only informative.
+ *
+ * @param count  Place to store the number of pre-zeroed frames.
+ * @param hits   Place to store the number of requests served from the pools.
+ * @param misses Place to store the number of requests which found
+ *               the pools empty.
+ *
+ */
+void frame_zero_stats(size_t *count, uint64_t *hits, uint64_t *misses)
+{
+	*count = 0;
+	*hits = 0;
+	*misses = 0;
+	
+	if (cpus == NULL)
+		return;
+	
+	for (size_t i = 0; i < config.cpu_count; i++) {
+		*count += cpus[i].frame_cache.zeroed_count;
+		*hits += cpus[i].frame_cache.zeroed_hits;
+		*misses += cpus[i].frame_cache.zeroed_misses;
+	}
+}
+
+/** Return all blocks from all per-CPU frame caches to the zones.
+ *
+ * Called when the zones run out of free frames.
+ *
+ * @return Number of frames returned to the zones.
+ *
+ */
+size_t frame_cache_drain(void)
+{
+	size_t freed = 0;
+	
+	if (cpus == NULL)
+		return 0;
+	
+	for (size_t i = 0; i < config.cpu_count; i++) {
+		if (!cpus[i].active)
+			continue;
+		
+		frame_cache_t *cache = &cpus[i].frame_cache;
+		irq_spinlock_lock(&cache->lock, true);
+		
+		for (unsigned int order = 0; order < FRAME_CACHE_ORDERS;
+		    order++)
+			freed += frame_cache_flush(cache, order, 0);
+		
+		freed += frame_zero_flush(cache);
+		
+		irq_spinlock_unlock(&cache->lock, true);
+	}
+	
+	return freed;
+}
+
 /** Allocate frames of physical memory.
  *
  * @param count      Number of continuous frames to allocate.
@@ -831,6 +1318,30 @@ uintptr_t frame_alloc_generic(size_t count, frame_flags_t flags,
 {
 	assert(count > 0);
 	
+	/*
+	 * Single zero-filled frames are preferably taken from the pool
+	 * of frames zeroed in advance, otherwise they are zeroed here.
+	 */
+	if (flags & FRAME_ZERO) {
+		if ((count == 1) && (constraint == 0)) {
+			uintptr_t addr = frame_zero_alloc(pzone);
+			if (addr != 0) {
+				if (!(flags & FRAME_NO_RESERVE))
+					reserve_force_alloc(count);
+				
+				return addr;
+			}
+		}
+		
+		flags &= ~(FRAME_ZERO | FRAME_HIGHMEM);
+		uintptr_t addr = frame_alloc_generic(count, flags | FRAME_LOWMEM,
+		    constraint, pzone);
+		if (addr != 0)
+			memsetb((void *) PA2KA(addr), FRAMES2SIZE(count), 0);
+		
+		return addr;
+	}
+	
 	size_t hint = pzone ? (*pzone) : 0;
 	pfn_t frame_constraint = ADDR2PFN(constraint);
 	
@@ -840,6 +1351,18 @@ uintptr_t frame_alloc_generic(size_t count, frame_flags_t flags,
 	if (!(flags & FRAME_NO_RESERVE))
 		reserve_force_alloc(count);
 	
+	/*
+	 * Small unconstrained blocks of low memory are taken from
+	 * the per-CPU frame cache.
+	 */
+	unsigned int order = frame_cache_order(count);
+	if ((order < FRAME_CACHE_ORDERS) && (!(flags & FRAME_HIGHMEM)) &&
+	    (frame_constraint == 0)) {
+		uintptr_t addr = frame_cache_alloc(order, pzone);
+		if (addr != 0)
+			return addr;
+	}
+	
 loop:
 	irq_spinlock_lock(&zones.lock, true);
 	
@@ -873,6 +1396,20 @@ loop:
 		}
 	}
 	
+	/*
+	 * As the last resort, return the frames cached by the CPUs
+	 * (including the slab memory reclaimed above).
+	 */
+	if (znum == (size_t) -1) {
+		irq_spinlock_unlock(&zones.lock, true);
+		size_t freed = frame_cache_drain();
+		irq_spinlock_lock(&zones.lock, true);
+		
+		if (freed > 0)
+			znum = find_free_zone(count, FRAME_TO_ZONE_FLAGS(flags),
+			    frame_constraint, hint);
+	}
+	
 	if (znum == (size_t) -1) {
 		if (flags & FRAME_ATOMIC) {
 			irq_spinlock_unlock(&zones.lock, true);
@@ -960,6 +1497,15 @@ void frame_free_generic(uintptr_t start, size_t count, frame_flags_t flags)
 {
 	size_t freed = 0;
 	
+	unsigned int order = frame_cache_order(count);
+	if ((order < FRAME_CACHE_ORDERS) &&
+	    (frame_cache_free(ADDR2PFN(start), order))) {
+		if (!(flags & FRAME_NO_RESERVE))
+			reserve_free(count);
+		
+		return;
+	}
+	
 	irq_spinlock_lock(&zones.lock, true);
 	
 	for (size_t i = 0; i < count; i++) {
@@ -979,24 +1525,8 @@ void frame_free_generic(uintptr_t start, size_t count, frame_flags_t flags)
 	
 	/*
 	 * Signal that some memory has been freed.
-	 * Since the mem_avail_mtx is an active mutex,
-	 * we need to disable interruptsto prevent deadlock
-	 * with TLB shootdown.
 	 */
-	
-	ipl_t ipl = interrupts_disable();
-	mutex_lock(&mem_avail_mtx);
-	
-	if (mem_avail_req > 0)
-		mem_avail_req -= min(mem_avail_req, freed);
-	
-	if (mem_avail_req == 0) {
-		mem_avail_gen++;
-		condvar_broadcast(&mem_avail_cv);
-	}
-	
-	mutex_unlock(&mem_avail_mtx);
-	interrupts_restore(ipl);
+	frame_avail_signal(freed);
 	
 	if (!(flags & FRAME_NO_RESERVE))
 		reserve_free(freed);
@@ -1174,6 +1704,11 @@ void zones_stats(uint64_t *total, uint64_t *unavail, uint64_t *busy,
 			*unavail += (uint64_t) FRAMES2SIZE(zones.info[i].count);
 	}
 	
+	/* Frames in the per-CPU caches are free, not busy */
+	uint64_t cached = FRAMES2SIZE(frame_cache_count());
+	*busy -= min(*busy, cached);
+	*free += cached;
+	
 	irq_spinlock_unlock(&zones.lock, true);
 }
 
@@ -1296,6 +1831,17 @@ void zones_print_list(void)
 	    false);
 	printf("Available high priority: %zu frames (%" PRIu64 " %s)\n",
 	    free_highprio, size, size_suffix);
+	
+	size_t zeroed;
+	uint64_t hits;
+	uint64_t misses;
+	frame_zero_stats(&zeroed, &hits, &misses);
+	
+	bin_order_suffix(FRAMES2SIZE(zeroed), &size, &size_suffix,
+	    false);
+	printf("Pre-zeroed:              %zu frames (%" PRIu64 " %s), "
+	    "%" PRIu64 " hits, %" PRIu64 " misses\n",
+	    zeroed, size, size_suffix, hits, misses);
 }
 
 /** Prints zone details.
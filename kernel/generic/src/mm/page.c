@@ -109,6 +109,109 @@ NO_TRACE void page_mapping_insert(as_t *as, uintptr_t page, uintptr_t frame,
 	memory_barrier();
 }
 
+/** Insert mapping of a large page to a block of frames.
+ *
+ * Map LARGE_PAGE_SIZE bytes of virtual memory starting at page to
+ * the physically contiguous memory starting at frame using a single
+ * page table entry. Both addresses must be aligned to LARGE_PAGE_SIZE.
+ * The mappings of the individual pages within the large page can be
+ * found and removed as usual.
+ *
+ * @param as    Address space to which page belongs.
+ * @param page  Virtual address of the large page to be mapped.
+ * @param frame Physical address of the first frame of the block.
+ * @param flags Flags to be used for mapping.
+ *
+ * @return True if the large page was mapped. False if large pages are
+ *         not supported or if some page within the large page is
+ *         already mapped.
+ *
+ */
+NO_TRACE bool page_mapping_insert_large(as_t *as, uintptr_t page,
+    uintptr_t frame, unsigned int flags)
+{
+	assert(page_table_locked(as));
+	
+	assert(page_mapping_operations);
+	
+	if (!page_mapping_operations->mapping_insert_large)
+		return false;
+	
+	assert(IS_ALIGNED(page, LARGE_PAGE_SIZE));
+	assert(IS_ALIGNED(frame, LARGE_PAGE_SIZE));
+	
+	if (!page_mapping_operations->mapping_insert_large(as, page, frame,
+	    flags))
+		return false;
+	
+	/* Repel prefetched accesses to the old mapping. */
+	memory_barrier();
+	
+	return true;
+}
+
+/** Split large page mappings overlapping a range of pages.
+ *
+ * Large pages overlapping the range are replaced by mappings of the
+ * individual pages, so that the pages can be removed one by one by
+ * page_mapping_remove(). This is only needed for large pages of which some
+ * pages are to stay mapped, large pages removed as a whole are better
+ * removed by page_mapping_remove_large(). Splitting may need to allocate
+ * page tables and block, so it must be called before starting the TLB
+ * shootdown sequence that covers the removal. That shootdown also flushes
+ * the large page translations from the TLBs of other processors.
+ *
+ * @param as    Address space to which the pages belong.
+ * @param page  Virtual address of the first page of the range.
+ * @param count Number of pages in the range.
+ *
+ */
+NO_TRACE void page_mapping_split_large(as_t *as, uintptr_t page, size_t count)
+{
+	assert(page_table_locked(as));
+	
+	assert(page_mapping_operations);
+	
+	if ((!page_mapping_operations->mapping_split_large) || (count == 0))
+		return;
+	
+	uintptr_t end = ALIGN_DOWN(page, PAGE_SIZE) + P2SZ(count);
+	for (uintptr_t lpage = ALIGN_DOWN(page, LARGE_PAGE_SIZE); lpage < end;
+	    lpage += LARGE_PAGE_SIZE)
+		page_mapping_operations->mapping_split_large(as, lpage);
+}
+
+/** Remove the large page mapping containing page.
+ *
+ * The mappings of all pages within the large page are removed without
+ * allocating any memory. TLB shootdown should follow in order to make
+ * effects of this call visible.
+ *
+ * @param as   Address space to which page belongs.
+ * @param page Virtual address within the large page.
+ *
+ * @return True if the large page mapping was removed. False if large pages
+ *         are not supported or if page is not mapped by a large page.
+ *
+ */
+NO_TRACE bool page_mapping_remove_large(as_t *as, uintptr_t page)
+{
+	assert(page_table_locked(as));
+	
+	assert(page_mapping_operations);
+	
+	if (!page_mapping_operations->mapping_remove_large)
+		return false;
+	
+	if (!page_mapping_operations->mapping_remove_large(as, page))
+		return false;
+	
+	/* Repel prefetched accesses to the old mapping. */
+	memory_barrier();
+	
+	return true;
+}
+
 /** Remove mapping of page.
  *
  * Remove any mapping of page within address space as.
@@ -45,8 +45,13 @@
  *
  * Following features are not currently supported but would be easy to do:
  * @li cache coloring
- * @li dynamic magazine growing (different magazine sizes are already
- *     supported, but we would need to adjust allocation strategy)
+ *
+ * Magazines grow dynamically as in Solaris. Every cache starts with
+ * SLAB_MAG_SIZE slots per magazine. Whenever too many of the recent
+ * operations on the cpu-shared magazine list (the depot) find its lock
+ * contended, the size of newly allocated magazines is doubled, up to
+ * SLAB_MAG_SIZE_MAX. Magazines of different sizes coexist in the depot.
+ * Brutal reclaim resets the cache to the initial magazine size.
  *
  * The slab allocator supports per-CPU caches ('magazines') to facilitate
  * good SMP scaling.
@@ -114,12 +119,30 @@
 #include <bitops.h>
 #include <macros.h>
 #include <cpu.h>
+#include <str.h>
+
+/** Number of depot operations over which contention is sampled */
+#define SLAB_MAG_WINDOW  64
+
+/** Contended depot operations per window that make magazines grow */
+#define SLAB_MAG_CONTENTION  4
+
+/** Number of magazine sizes from SLAB_MAG_SIZE to SLAB_MAG_SIZE_MAX */
+#define SLAB_MAG_CLASSES  5
 
 IRQ_SPINLOCK_STATIC_INITIALIZE(slab_cache_lock);
 static LIST_INITIALIZE(slab_cache_list);
 
-/** Magazine cache */
-static slab_cache_t mag_cache;
+/** Magazine caches, one for each magazine size */
+static slab_cache_t mag_caches[SLAB_MAG_CLASSES];
+
+static const char *mag_names[] = {
+	"slab_magazine_t-4",
+	"slab_magazine_t-8",
+	"slab_magazine_t-16",
+	"slab_magazine_t-32",
+	"slab_magazine_t-64"
+};
 
 /** Cache for cache descriptors */
 static slab_cache_t slab_cache_cache;
@@ -346,9 +369,59 @@ NO_TRACE static void *slab_obj_create(slab_cache_t *cache, unsigned int flags)
 /* CPU-Cache slab functions */
 /****************************/
 
+/** Return index of the magazine cache for magazines of given size
+ *
+ */
+NO_TRACE static inline unsigned int mag_class(size_t size)
+{
+	return fnzb(size) - fnzb(SLAB_MAG_SIZE);
+}
+
+/** Lock the magazine list of a cache and account for contention
+ *
+ * Every SLAB_MAG_WINDOW operations the number of contended lock
+ * acquisitions is checked. If it reached SLAB_MAG_CONTENTION, the
+ * size of newly allocated magazines is doubled so that the CPUs
+ * need to visit the magazine list less often.
+ *
+ * @return Interrupt level to be passed to depot_unlock().
+ *
+ */
+NO_TRACE static ipl_t depot_lock(slab_cache_t *cache)
+{
+	ipl_t ipl = interrupts_disable();
+	
+	if (!irq_spinlock_trylock(&cache->maglock)) {
+		irq_spinlock_lock(&cache->maglock, false);
+		cache->depot_contention++;
+		cache->depot_contended++;
+	}
+	
+	if (++cache->depot_ops == SLAB_MAG_WINDOW) {
+		if ((cache->depot_contended >= SLAB_MAG_CONTENTION) &&
+		    (cache->mag_size < SLAB_MAG_SIZE_MAX))
+			cache->mag_size <<= 1;
+		
+		cache->depot_ops = 0;
+		cache->depot_contended = 0;
+	}
+	
+	return ipl;
+}
+
+/** Unlock the magazine list of a cache
+ *
+ */
+NO_TRACE static void depot_unlock(slab_cache_t *cache, ipl_t ipl)
+{
+	irq_spinlock_unlock(&cache->maglock, false);
+	interrupts_restore(ipl);
+}
+
 /** Find a full magazine in cache, take it from list and return it
  *
- * @param first If true, return first, else last mag.
+ * @param first If true, return first, else last mag. Only the
+ *              former is accounted as a depot hit or miss.
  *
  */
 NO_TRACE static slab_magazine_t *get_mag_from_cache(slab_cache_t *cache,
@@ -357,7 +430,7 @@ NO_TRACE static slab_magazine_t *get_mag_from_cache(slab_cache_t *cache,
 	slab_magazine_t *mag = NULL;
 	link_t *cur;
 	
-	irq_spinlock_lock(&cache->maglock, true);
+	ipl_t ipl = depot_lock(cache);
 	if (!list_empty(&cache->magazines)) {
 		if (first)
 			cur = list_first(&cache->magazines);
@@ -368,7 +441,14 @@ NO_TRACE static slab_magazine_t *get_mag_from_cache(slab_cache_t *cache,
 		list_remove(&mag->link);
 		atomic_dec(&cache->magazine_counter);
 	}
-	irq_spinlock_unlock(&cache->maglock, true);
+	
+	if (first) {
+		if (mag)
+			cache->depot_hits++;
+		else
+			cache->depot_misses++;
+	}
+	depot_unlock(cache, ipl);
 
 	return mag;
 }
@@ -379,12 +459,12 @@ NO_TRACE static slab_magazine_t *get_mag_from_cache(slab_cache_t *cache,
 NO_TRACE static void put_mag_to_cache(slab_cache_t *cache,
     slab_magazine_t *mag)
 {
-	irq_spinlock_lock(&cache->maglock, true);
+	ipl_t ipl = depot_lock(cache);
 	
 	list_prepend(&mag->link, &cache->magazines);
 	atomic_inc(&cache->magazine_counter);
 	
-	irq_spinlock_unlock(&cache->maglock, true);
+	depot_unlock(cache, ipl);
 }
 
 /** Free all objects in magazine and free memory associated with magazine
@@ -403,7 +483,7 @@ NO_TRACE static size_t magazine_destroy(slab_cache_t *cache,
 		atomic_dec(&cache->cached_objs);
 	}
 	
-	slab_free(&mag_cache, mag);
+	slab_free(&mag_caches[mag_class(mag->size)], mag);
 	
 	return frames;
 }
@@ -504,12 +584,13 @@ NO_TRACE static slab_magazine_t *make_empty_current_mag(slab_cache_t *cache)
 	 * this would deadlock.
 	 *
 	 */
-	slab_magazine_t *newmag = slab_alloc(&mag_cache,
+	size_t size = cache->mag_size;
+	slab_magazine_t *newmag = slab_alloc(&mag_caches[mag_class(size)],
 	    FRAME_ATOMIC | FRAME_NO_RECLAIM);
 	if (!newmag)
 		return NULL;
 	
-	newmag->size = SLAB_MAG_SIZE;
+	newmag->size = size;
 	newmag->busy = 0;
 	
 	/* Flush last to magazine list */
@@ -623,6 +704,7 @@ NO_TRACE static void _slab_cache_create(slab_cache_t *cache, const char *name,
 	cache->constructor = constructor;
 	cache->destructor = destructor;
 	cache->flags = flags;
+	cache->mag_size = SLAB_MAG_SIZE;
 	
 	list_initialize(&cache->full_slabs);
 	list_initialize(&cache->partial_slabs);
@@ -698,6 +780,11 @@ NO_TRACE static size_t _slab_reclaim(slab_cache_t *cache, unsigned int flags)
 	}
 	
 	if (flags & SLAB_RECLAIM_ALL) {
+		/* Start over with small magazines */
+		ipl_t ipl = depot_lock(cache);
+		cache->mag_size = SLAB_MAG_SIZE;
+		depot_unlock(cache, ipl);
+		
 		/* Free cpu-bound magazines */
 		/* Destroy CPU magazines */
 		size_t i;
@@ -821,7 +908,7 @@ size_t slab_reclaim(unsigned int flags)
 void slab_print_list(void)
 {
 	printf("[cache name      ] [size  ] [pages ] [obj/pg] [slabs ]"
-	    " [cached] [alloc ] [ctl]\n");
+	    " [cached] [alloc ] [ctl] [mag] [dhits ] [dmiss ] [dcont ]\n");
 	
 	size_t skip = 0;
 	while (true) {
@@ -873,23 +960,73 @@ void slab_print_list(void)
 		long cached_objs = atomic_get(&cache->cached_objs);
 		long allocated_objs = atomic_get(&cache->allocated_objs);
 		unsigned int flags = cache->flags;
+		size_t mag_size = cache->mag_size;
+		uint64_t depot_hits = cache->depot_hits;
+		uint64_t depot_misses = cache->depot_misses;
+		uint64_t depot_contention = cache->depot_contention;
 		
 		irq_spinlock_unlock(&slab_cache_lock, true);
 		
-		printf("%-18s %8zu %8zu %8zu %8ld %8ld %8ld %-5s\n",
+		printf("%-18s %8zu %8zu %8zu %8ld %8ld %8ld %-5s %5zu"
+		    " %8" PRIu64 " %8" PRIu64 " %8" PRIu64 "\n",
 		    name, size, frames, objects, allocated_slabs,
 		    cached_objs, allocated_objs,
-		    flags & SLAB_CACHE_SLINSIDE ? "in" : "out");
+		    flags & SLAB_CACHE_SLINSIDE ? "in" : "out",
+		    (flags & SLAB_CACHE_NOMAGAZINE) ? 0 : mag_size,
+		    depot_hits, depot_misses, depot_contention);
+	}
+}
+
+/** Gather statistics about slab caches
+ *
+ * @param stats Array to be filled in (can be NULL if count is zero).
+ * @param count Number of items in the array.
+ *
+ * @return Total number of slab caches, which can be larger than count.
+ *
+ */
+size_t slab_stats(stats_slab_t *stats, size_t count)
+{
+	size_t i = 0;
+	
+	irq_spinlock_lock(&slab_cache_lock, true);
+	
+	list_foreach(slab_cache_list, link, slab_cache_t, cache) {
+		if (i < count) {
+			str_cpy(stats[i].name, SLAB_NAME_BUFLEN, cache->name);
+			stats[i].size = cache->size;
+			stats[i].mag_size =
+			    (cache->flags & SLAB_CACHE_NOMAGAZINE) ?
+			    0 : cache->mag_size;
+			stats[i].allocated_objs =
+			    atomic_get(&cache->allocated_objs);
+			stats[i].cached_objs = atomic_get(&cache->cached_objs);
+			stats[i].depot_hits = cache->depot_hits;
+			stats[i].depot_misses = cache->depot_misses;
+			stats[i].depot_contention = cache->depot_contention;
+		}
+		
+		i++;
 	}
+	
+	irq_spinlock_unlock(&slab_cache_lock, true);
+	
+	return i;
 }
 
 void slab_cache_init(void)
 {
-	/* Initialize magazine cache */
-	_slab_cache_create(&mag_cache, "slab_magazine_t",
-	    sizeof(slab_magazine_t) + SLAB_MAG_SIZE * sizeof(void *),
-	    sizeof(uintptr_t), NULL, NULL, SLAB_CACHE_NOMAGAZINE |
-	    SLAB_CACHE_SLINSIDE);
+	/* Initialize magazine caches */
+	size_t i;
+	size_t size;
+	
+	for (i = 0, size = SLAB_MAG_SIZE; i < SLAB_MAG_CLASSES;
+	    i++, size <<= 1) {
+		_slab_cache_create(&mag_caches[i], mag_names[i],
+		    sizeof(slab_magazine_t) + size * sizeof(void *),
+		    sizeof(uintptr_t), NULL, NULL, SLAB_CACHE_NOMAGAZINE |
+		    SLAB_CACHE_SLINSIDE);
+	}
 	
 	/* Initialize slab_cache cache */
 	_slab_cache_create(&slab_cache_cache, "slab_cache_cache",
@@ -901,9 +1038,6 @@ void slab_cache_init(void)
 	    NULL, NULL, SLAB_CACHE_SLINSIDE | SLAB_CACHE_MAGDEFERRED);
 	
 	/* Initialize structures for malloc */
-	size_t i;
-	size_t size;
-	
 	for (i = 0, size = (1 << SLAB_MIN_MALLOC_W);
 	    i < (SLAB_MAX_MALLOC_W - SLAB_MIN_MALLOC_W + 1);
 	    i++, size <<= 1) {
@@ -35,8 +35,10 @@
  * @brief Generic TLB shootdown algorithm.
  *
  * The algorithm implemented here is based on the CMU TLB shootdown
- * algorithm and is further simplified (e.g. all CPUs receive all TLB
- * shootdown messages).
+ * algorithm and is further simplified (e.g. there is only one shootdown
+ * in progress at a time). Messages are sent only to the processors which
+ * may cache translations of the affected address space, other processors
+ * are not interrupted.
  */
 
 #include <mm/tlb.h>
@@ -51,6 +53,7 @@
 #include <arch.h>
 #include <panic.h>
 #include <cpu.h>
+#include <cpu/cpu_mask.h>
 
 void tlb_init(void)
 {
@@ -70,28 +73,39 @@ IRQ_SPINLOCK_STATIC_INITIALIZE(tlblock);
 /** Send TLB shootdown message.
  *
  * This function attempts to deliver TLB shootdown message
- * to all other processors.
+ * to other processors. If @a targets is not NULL, only processors
+ * in the mask are interrupted, others continue their work undisturbed.
  *
- * @param type  Type describing scope of shootdown.
- * @param asid  Address space, if required by type.
- * @param page  Virtual page address, if required by type.
- * @param count Number of pages, if required by type.
+ * @param type    Type describing scope of shootdown.
+ * @param asid    Address space, if required by type.
+ * @param page    Virtual page address, if required by type.
+ * @param count   Number of pages, if required by type.
+ * @param targets Processors which may cache the affected translations
+ *                or NULL for all processors. The mask is sampled while
+ *                holding tlblock.
  *
  * @return The interrupt priority level as it existed prior to this call.
  *
  */
 ipl_t tlb_shootdown_start(tlb_invalidate_type_t type, asid_t asid,
-    uintptr_t page, size_t count)
+    uintptr_t page, size_t count, cpu_mask_t *targets)
 {
 	ipl_t ipl = interrupts_disable();
 	CPU->tlb_active = false;
 	irq_spinlock_lock(&tlblock, false);
 	
+	DEFINE_CPU_MASK(pending);
+	cpu_mask_none(pending);
+	
+	size_t recipients = 0;
 	size_t i;
 	for (i = 0; i < config.cpu_count; i++) {
 		if (i == CPU->id)
 			continue;
 		
+		if ((targets != NULL) && (!cpu_mask_is_set(targets, i)))
+			continue;
+		
 		cpu_t *cpu = &cpus[i];
 		
 		irq_spinlock_lock(&cpu->lock, false);
@@ -116,13 +130,23 @@ ipl_t tlb_shootdown_start(tlb_invalidate_type_t type, asid_t asid,
 			cpu->tlb_messages[idx].count = count;
 		}
 		irq_spinlock_unlock(&cpu->lock, false);
+		
+		cpu_mask_set(pending, i);
+		recipients++;
 	}
 	
-	tlb_shootdown_ipi_send();
+	if (recipients == 0)
+		return ipl;
+	
+	/* Interrupting everybody else is cheaper with a broadcast */
+	if (recipients + 1 == config.cpu_count)
+		tlb_shootdown_ipi_send(NULL);
+	else
+		tlb_shootdown_ipi_send(pending);
 	
 busy_wait:
-	for (i = 0; i < config.cpu_count; i++) {
-		if (cpus[i].tlb_active)
+	cpu_mask_for_each(*pending, cpu_id) {
+		if (cpus[cpu_id].tlb_active)
 			goto busy_wait;
 	}
 	
@@ -141,9 +165,21 @@ void tlb_shootdown_finalize(ipl_t ipl)
 	interrupts_restore(ipl);
 }
 
-void tlb_shootdown_ipi_send(void)
+/** Interrupt processors to process their TLB shootdown messages.
+ *
+ * @param targets Processors to interrupt or NULL for all processors
+ *                except the current one.
+ *
+ */
+void tlb_shootdown_ipi_send(cpu_mask_t *targets)
 {
-	ipi_broadcast(VECTOR_TLB_SHOOTDOWN_IPI);
+	if (targets == NULL) {
+		ipi_broadcast(VECTOR_TLB_SHOOTDOWN_IPI);
+		return;
+	}
+	
+	cpu_mask_for_each(*targets, cpu_id)
+		ipi_unicast_arch(cpu_id, VECTOR_TLB_SHOOTDOWN_IPI);
 }
 
 /** Receive TLB shootdown message.
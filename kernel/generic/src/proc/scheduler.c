@@ -35,7 +35,9 @@
  * @brief Scheduler and load balancing.
  *
  * This file contains the scheduler and kcpulb kernel thread which
- * performs load-balancing of per-CPU run queues.
+ * performs load-balancing of per-CPU run queues. An otherwise idle
+ * CPU steals work from the busiest CPU on its own before it goes to
+ * sleep, kcpulb only evens out the load among busy CPUs.
  */
 
 #include <assert.h>
@@ -66,6 +68,9 @@
 #include <log.h>
 #include <stacktrace.h>
 
+/** Period of the kcpulb load balancing thread (in seconds). */
+#define KCPULB_PERIOD  4
+
 static void scheduler_separated_stack(void);
 
 atomic_t nrdy;  /**< Number of ready threads in the system. */
@@ -188,6 +193,116 @@ void scheduler_init(void)
 {
 }
 
+#ifdef CONFIG_SMP
+/** Remove a migratable thread from a run queue
+ *
+ * The run queue is searched from the back so that the threads which
+ * are to run soonest stay on their CPU.
+ *
+ * @param cpu CPU owning the run queue.
+ * @param rq  Index of the run queue. Its lock must be held.
+ *
+ * @return Removed thread or NULL if there was no thread which could
+ *         be migrated.
+ *
+ */
+static thread_t *rq_steal(cpu_t *cpu, int rq)
+{
+	link_t *link = cpu->rq[rq].rq.head.prev;
+	
+	while (link != &(cpu->rq[rq].rq.head)) {
+		thread_t *thread = (thread_t *) list_get_instance(link,
+		    thread_t, rq_link);
+		
+		/*
+		 * Do not steal CPU-wired threads, threads already stolen,
+		 * threads for which migration was temporarily disabled or
+		 * threads whose FPU context is still in the CPU.
+		 */
+		irq_spinlock_lock(&thread->lock, false);
+		
+		if ((!thread->wired) && (!thread->stolen) &&
+		    (!thread->nomigrate) && (!thread->fpu_context_engaged)) {
+			/*
+			 * Remove thread from ready queue.
+			 */
+			irq_spinlock_unlock(&thread->lock, false);
+			
+			atomic_dec(&cpu->nrdy);
+			atomic_dec(&nrdy);
+			
+			cpu->rq[rq].n--;
+			list_remove(&thread->rq_link);
+			
+			return thread;
+		}
+		
+		irq_spinlock_unlock(&thread->lock, false);
+		link = link->prev;
+	}
+	
+	return NULL;
+}
+
+/** Steal a ready thread for an idle CPU
+ *
+ * Take a thread from the lowest-priority non-empty run queue of the
+ * busy CPU with the most ready threads. CPUs which are idle themselves
+ * are left alone as they are about to run their own threads.
+ *
+ * @param rq Place to store the index of the run queue the thread
+ *           was taken from.
+ *
+ * @return Stolen thread or NULL if there was nothing to steal.
+ *
+ */
+static thread_t *steal_thread(int *rq)
+{
+	cpu_t *victim = NULL;
+	atomic_count_t most = 0;
+	size_t acpu;
+	
+	/*
+	 * Start with our neighbour so that several idle CPUs do not
+	 * all pick the same victim on a tie.
+	 */
+	for (acpu = 1; acpu < config.cpu_active; acpu++) {
+		cpu_t *cpu = &cpus[(CPU->id + acpu) % config.cpu_active];
+		
+		if (cpu->idle)
+			continue;
+		
+		atomic_count_t rdy = atomic_get(&cpu->nrdy);
+		if (rdy > most) {
+			most = rdy;
+			victim = cpu;
+		}
+	}
+	
+	if (victim == NULL)
+		return NULL;
+	
+	int i;
+	for (i = RQ_COUNT - 1; i >= 0; i--) {
+		irq_spinlock_lock(&(victim->rq[i].lock), false);
+		if (victim->rq[i].n == 0) {
+			irq_spinlock_unlock(&(victim->rq[i].lock), false);
+			continue;
+		}
+		
+		thread_t *thread = rq_steal(victim, i);
+		irq_spinlock_unlock(&(victim->rq[i].lock), false);
+		
+		if (thread) {
+			*rq = i;
+			return thread;
+		}
+	}
+	
+	return NULL;
+}
+#endif /* CONFIG_SMP */
+
 /** Get thread to be scheduled
  *
  * Get the optimal thread to be scheduled
@@ -204,6 +319,27 @@ static thread_t *find_best_thread(void)
 loop:
 	
 	if (atomic_get(&CPU->nrdy) == 0) {
+#ifdef CONFIG_SMP
+		/*
+		 * Rather than waiting for kcpulb, try to take over
+		 * some work from a busy CPU right away.
+		 */
+		int rq;
+		thread_t *thread = steal_thread(&rq);
+		if (thread) {
+			irq_spinlock_lock(&thread->lock, false);
+			
+			thread->cpu = CPU;
+			thread->ticks = us2ticks((rq + 1) * 10000);
+			thread->priority = rq;
+			thread->stolen = false;
+			
+			irq_spinlock_unlock(&thread->lock, false);
+			
+			return thread;
+		}
+#endif
+		
 		/*
 		 * For there was nothing to run, the CPU goes to sleep
 		 * until a hardware interrupt or an IPI comes.
@@ -557,7 +693,9 @@ repeat:
 /** Load balancing thread
  *
  * SMP load balancing thread, supervising thread supplies
- * for the CPU it's wired to.
+ * for the CPU it's wired to. Idle CPUs steal work in
+ * find_best_thread(), so kcpulb only slowly rebalances
+ * the load among CPUs which are all busy.
  *
  * @param arg Generic thread argument (unused).
  *
@@ -574,9 +712,9 @@ void kcpulb(void *arg)
 	
 loop:
 	/*
-	 * Work in 1s intervals.
+	 * Work in KCPULB_PERIOD intervals.
 	 */
-	thread_sleep(1);
+	thread_sleep(KCPULB_PERIOD);
 	
 not_satisfied:
 	/*
@@ -623,46 +761,7 @@ not_satisfied:
 				continue;
 			}
 			
-			thread_t *thread = NULL;
-			
-			/* Search rq from the back */
-			link_t *link = cpu->rq[rq].rq.head.prev;
-			
-			while (link != &(cpu->rq[rq].rq.head)) {
-				thread = (thread_t *) list_get_instance(link,
-				    thread_t, rq_link);
-				
-				/*
-				 * Do not steal CPU-wired threads, threads
-				 * already stolen, threads for which migration
-				 * was temporarily disabled or threads whose
-				 * FPU context is still in the CPU.
-				 */
-				irq_spinlock_lock(&thread->lock, false);
-				
-				if ((!thread->wired) && (!thread->stolen) &&
-				    (!thread->nomigrate) &&
-				    (!thread->fpu_context_engaged)) {
-					/*
-					 * Remove thread from ready queue.
-					 */
-					irq_spinlock_unlock(&thread->lock,
-					    false);
-					
-					atomic_dec(&cpu->nrdy);
-					atomic_dec(&nrdy);
-					
-					cpu->rq[rq].n--;
-					list_remove(&thread->rq_link);
-					
-					break;
-				}
-				
-				irq_spinlock_unlock(&thread->lock, false);
-				
-				link = link->prev;
-				thread = NULL;
-			}
+			thread_t *thread = rq_steal(cpu, rq);
 			
 			if (thread) {
 				/*
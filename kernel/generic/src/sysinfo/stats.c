@@ -42,11 +42,13 @@
 #include <synch/mutex.h>
 #include <time/clock.h>
 #include <mm/frame.h>
+#include <mm/slab.h>
 #include <proc/task.h>
 #include <proc/thread.h>
 #include <interrupt.h>
 #include <stdbool.h>
 #include <str.h>
+#include <macros.h>
 #include <errno.h>
 #include <cpu.h>
 #include <arch.h>
@@ -242,6 +244,7 @@ static void produce_stats_task(task_t *task, stats_task_t *stats_task)
 	task_get_accounting(task, &(stats_task->ucycles),
 	    &(stats_task->kcycles));
 	stats_task->ipc_info = task->ipc_info;
+	stats_task->page_faults = task->page_faults;
 }
 
 /** Gather statistics of all tasks
@@ -721,9 +724,49 @@ static void *get_stats_physmem(struct sysinfo_item *item, size_t *size,
 	zones_stats(&(stats_physmem->total), &(stats_physmem->unavail),
 	    &(stats_physmem->used), &(stats_physmem->free));
 	
+	size_t zeroed;
+	frame_zero_stats(&zeroed, &(stats_physmem->zeroed_hits),
+	    &(stats_physmem->zeroed_misses));
+	stats_physmem->zeroed = FRAMES2SIZE(zeroed);
+	
 	return ((void *) stats_physmem);
 }
 
+/** Get slab allocator statistics
+ *
+ * @param item    Sysinfo item (unused).
+ * @param size    Size of the returned data.
+ * @param dry_run Do not get the data, just calculate the size.
+ * @param data    Unused.
+ *
+ * @return Data containing several stats_slab_t structures.
+ *         If the return value is not NULL, it should be freed
+ *         in the context of the sysinfo request.
+ */
+static void *get_stats_slabs(struct sysinfo_item *item, size_t *size,
+    bool dry_run, void *data)
+{
+	size_t count = slab_stats(NULL, 0);
+	*size = sizeof(stats_slab_t) * count;
+	
+	if ((dry_run) || (count == 0))
+		return NULL;
+	
+	stats_slab_t *stats_slabs =
+	    (stats_slab_t *) malloc(*size, FRAME_ATOMIC);
+	if (stats_slabs == NULL) {
+		/* No free space for allocation */
+		*size = 0;
+		return NULL;
+	}
+	
+	/* Caches might have been destroyed in the meantime */
+	count = min(count, slab_stats(stats_slabs, count));
+	*size = sizeof(stats_slab_t) * count;
+	
+	return ((void *) stats_slabs);
+}
+
 /** Get system load
  *
  * @param item    Sysinfo item (unused).
@@ -811,6 +854,7 @@ void stats_init(void)
 	sysinfo_set_item_gen_data("system.tasks", NULL, get_stats_tasks, NULL);
 	sysinfo_set_item_gen_data("system.threads", NULL, get_stats_threads, NULL);
 	sysinfo_set_item_gen_data("system.exceptions", NULL, get_stats_exceptions, NULL);
+	sysinfo_set_item_gen_data("system.slabs", NULL, get_stats_slabs, NULL);
 	sysinfo_set_subtree_fn("system.tasks", NULL, get_stats_task, NULL);
 	sysinfo_set_subtree_fn("system.threads", NULL, get_stats_thread, NULL);
 	sysinfo_set_subtree_fn("system.exceptions", NULL, get_stats_exception, NULL);
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <print.h>
+#include <test.h>
+#include <mm/page.h>
+#include <mm/frame.h>
+#include <mm/slab.h>
+#include <arch/mm/page.h>
+#include <typedefs.h>
+#include <atomic.h>
+#include <proc/thread.h>
+#include <arch/cycle.h>
+#include <config.h>
+#include <cpu.h>
+#include <arch.h>
+
+#define MAX_BLOCKS  64
+#define MAX_ORDER   2
+#define TEST_RUNS   256
+
+static atomic_t thread_count;
+static atomic_t thread_fail;
+
+static void falloc(void *arg)
+{
+	uint64_t *rate = (uint64_t *) arg;
+	
+	uintptr_t *frames = (uintptr_t *)
+	    malloc(MAX_BLOCKS * sizeof(uintptr_t), FRAME_ATOMIC);
+	if (frames == NULL) {
+		TPRINTF("Thread #%" PRIu64 " (cpu%u): "
+		    "Unable to allocate frames\n", THREAD->tid, CPU->id);
+		atomic_inc(&thread_fail);
+		atomic_dec(&thread_count);
+		return;
+	}
+	
+	thread_detach(THREAD);
+	
+	uint64_t ops = 0;
+	uint64_t start = get_cycle();
+	
+	for (unsigned int run = 0; run < TEST_RUNS; run++) {
+		for (size_t count = 1; count <= (1 << MAX_ORDER); count <<= 1) {
+			unsigned int allocated = 0;
+			for (unsigned int i = 0; i < MAX_BLOCKS; i++) {
+				frames[allocated] =
+				    frame_alloc(count, FRAME_ATOMIC, 0);
+				if (frames[allocated] == 0)
+					break;
+				
+				*((uint64_t *) PA2KA(frames[allocated])) =
+				    THREAD->tid;
+				allocated++;
+			}
+			
+			for (unsigned int i = 0; i < allocated; i++) {
+				if (*((uint64_t *) PA2KA(frames[i])) !=
+				    THREAD->tid) {
+					TPRINTF("Thread #%" PRIu64 " (cpu%u): "
+					    "Block %p allocated twice\n",
+					    THREAD->tid, CPU->id,
+					    (void *) frames[i]);
+					atomic_inc(&thread_fail);
+					goto cleanup;
+				}
+				
+				frame_free(frames[i], count);
+			}
+			
+			ops += allocated;
+		}
+	}
+	
+	uint64_t cycles = get_cycle() - start;
+	uint64_t us = (CPU->frequency_mhz != 0) ?
+	    cycles / CPU->frequency_mhz : 0;
+	
+	if (us > 0) {
+		*rate = ops * 1000000 / us;
+		
+		TPRINTF("Thread #%" PRIu64 " (cpu%u): %" PRIu64 " alloc/free "
+		    "pairs in %" PRIu64 " us (%" PRIu64 " pairs/s)\n",
+		    THREAD->tid, CPU->id, ops, us, *rate);
+	} else
+		TPRINTF("Thread #%" PRIu64 " (cpu%u): %" PRIu64 " alloc/free "
+		    "pairs in %" PRIu64 " cycles\n", THREAD->tid, CPU->id,
+		    ops, cycles);
+	
+cleanup:
+	free(frames);
+	atomic_dec(&thread_count);
+}
+
+const char *test_falloc3(void)
+{
+	uint64_t *rates = (uint64_t *)
+	    malloc(config.cpu_count * sizeof(uint64_t), FRAME_ATOMIC);
+	if (rates == NULL)
+		return "Unable to allocate rates";
+	
+	atomic_set(&thread_count, 0);
+	atomic_set(&thread_fail, 0);
+	
+	for (unsigned int i = 0; i < config.cpu_count; i++) {
+		if (!cpus[i].active)
+			continue;
+		
+		rates[i] = 0;
+		
+		thread_t *thrd = thread_create(falloc, &rates[i], TASK,
+		    THREAD_FLAG_NONE, "falloc3");
+		if (!thrd) {
+			TPRINTF("Could not create thread %u\n", i);
+			break;
+		}
+		
+		thread_wire(thrd, &cpus[i]);
+		atomic_inc(&thread_count);
+		thread_ready(thrd);
+	}
+	
+	while (atomic_get(&thread_count) > 0) {
+		TPRINTF("Threads left: %" PRIua "\n",
+		    atomic_get(&thread_count));
+		thread_sleep(1);
+	}
+	
+	uint64_t total = 0;
+	for (unsigned int i = 0; i < config.cpu_count; i++) {
+		if (cpus[i].active)
+			total += rates[i];
+	}
+	
+	free(rates);
+	
+	if (atomic_get(&thread_fail) != 0)
+		return "Test failed";
+	
+	TPRINTF("Total: %" PRIu64 " alloc/free pairs/s\n", total);
+	
+	return NULL;
+}
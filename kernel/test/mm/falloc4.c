@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <print.h>
+#include <test.h>
+#include <mm/frame.h>
+#include <mm/slab.h>
+#include <arch/mm/page.h>
+#include <typedefs.h>
+#include <proc/thread.h>
+#include <mem.h>
+
+#define MAX_FRAMES  256
+#define TEST_RUNS   4
+
+/** Check that a block of frames is filled with zeroes. */
+static bool frames_zeroed(uintptr_t frame, size_t count)
+{
+	uint64_t *data = (uint64_t *) PA2KA(frame);
+	
+	for (size_t i = 0; i < FRAMES2SIZE(count) / sizeof(uint64_t); i++) {
+		if (data[i] != 0)
+			return false;
+	}
+	
+	return true;
+}
+
+const char *test_falloc4(void)
+{
+	uintptr_t *frames = (uintptr_t *)
+	    malloc(MAX_FRAMES * sizeof(uintptr_t), 0);
+	if (frames == NULL)
+		return "Unable to allocate frames";
+	
+	const char *result = NULL;
+	
+	for (unsigned int run = 0; run < TEST_RUNS; run++) {
+		size_t zeroed;
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t hits_prev;
+		uint64_t misses_prev;
+		
+		/* Give the zeroing threads a chance to refill the pools. */
+		thread_usleep(200000);
+		frame_zero_stats(&zeroed, &hits_prev, &misses_prev);
+		TPRINTF("Run %u: %zu frames zeroed in advance\n", run, zeroed);
+		
+		for (size_t count = 1; count <= 2; count++) {
+			/* Dirty some frames so that they are reused. */
+			unsigned int allocated = 0;
+			for (unsigned int i = 0; i < MAX_FRAMES; i++) {
+				frames[allocated] = frame_alloc(count,
+				    FRAME_LOWMEM | FRAME_ATOMIC, 0);
+				if (frames[allocated] == 0)
+					break;
+				
+				memsetb((void *) PA2KA(frames[allocated]),
+				    FRAMES2SIZE(count), 0xa5);
+				allocated++;
+			}
+			
+			for (unsigned int i = 0; i < allocated; i++)
+				frame_free(frames[i], count);
+			
+			allocated = 0;
+			for (unsigned int i = 0; i < MAX_FRAMES; i++) {
+				frames[allocated] = frame_alloc(count,
+				    FRAME_ZERO | FRAME_ATOMIC, 0);
+				if (frames[allocated] == 0)
+					break;
+				
+				allocated++;
+			}
+			
+			TPRINTF("Allocated %u zero-filled %zu frame blocks\n",
+			    allocated, count);
+			
+			for (unsigned int i = 0; i < allocated; i++) {
+				if ((result == NULL) &&
+				    (!frames_zeroed(frames[i], count)))
+					result = "Frame not zero-filled";
+				
+				frame_free(frames[i], count);
+			}
+			
+			if (result != NULL)
+				break;
+		}
+		
+		frame_zero_stats(&zeroed, &hits, &misses);
+		TPRINTF("Run %u: %" PRIu64 " hits, %" PRIu64 " misses\n",
+		    run, hits - hits_prev, misses - misses_prev);
+		
+		if (result != NULL)
+			break;
+	}
+	
+	free(frames);
+	return result;
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <print.h>
+#include <test.h>
+#include <mm/as.h>
+#include <mm/tlb.h>
+#include <cpu/cpu_mask.h>
+#include <typedefs.h>
+#include <atomic.h>
+#include <proc/task.h>
+#include <proc/thread.h>
+#include <arch/cycle.h>
+#include <config.h>
+#include <cpu.h>
+#include <arch.h>
+
+#define AREA_PAGES  16
+#define TEST_RUNS   1000
+
+static atomic_t busy_count;
+static volatile bool busy_stop;
+
+/** Keep the processor busy in the address space of the thread's task. */
+static void busy(void *arg)
+{
+	thread_detach(THREAD);
+	atomic_inc(&busy_count);
+	
+	while (!busy_stop);
+	
+	atomic_dec(&busy_count);
+}
+
+static uint64_t cycles2us(uint64_t cycles)
+{
+	return (CPU->frequency_mhz != 0) ? cycles / CPU->frequency_mhz : 0;
+}
+
+/** Time a TLB shootdown sequence of the tested address space.
+ *
+ * @param as      Tested address space.
+ * @param targets Processors to shoot down, NULL for all.
+ *
+ * @return Cycles per shootdown sequence.
+ *
+ */
+static uint64_t shootdown_time(as_t *as, cpu_mask_t *targets)
+{
+	uint64_t cycles = 0;
+	
+	for (unsigned int run = 0; run < TEST_RUNS; run++) {
+		uint64_t start = get_cycle();
+		ipl_t ipl = tlb_shootdown_start(TLB_INVL_PAGES, as->asid,
+		    PAGE_SIZE, AREA_PAGES, targets);
+		tlb_invalidate_pages(as->asid, PAGE_SIZE, AREA_PAGES);
+		tlb_shootdown_finalize(ipl);
+		cycles += get_cycle() - start;
+	}
+	
+	return cycles / TEST_RUNS;
+}
+
+const char *test_shootdown1(void)
+{
+	if (config.cpu_active < 2) {
+		TPRINTF("Only one CPU active, nothing to measure.\n");
+		return NULL;
+	}
+	
+	atomic_set(&busy_count, 0);
+	busy_stop = false;
+	
+	const char *result = NULL;
+	as_t *as = as_create(0);
+	as_hold(as);
+	
+	task_t *task = task_create(as, "shootdown1");
+	if (task == NULL) {
+		as_release(as);
+		return "Unable to create task";
+	}
+	
+	/*
+	 * Make the tested address space active on the first half of the
+	 * other processors by running threads of a task using it there. Keep
+	 * the remaining processors busy with threads of the kernel task, i.e.
+	 * in an unrelated address space.
+	 */
+	unsigned int others = config.cpu_active - 1;
+	unsigned int users = (others + 1) / 2;
+	unsigned int started = 0;
+	unsigned int as_cpus = 0;
+	
+	DEFINE_CPU_MASK(as_cpu);
+	cpu_mask_none(as_cpu);
+	
+	for (unsigned int i = 0; i < config.cpu_count; i++) {
+		if ((!cpus[i].active) || (i == CPU->id))
+			continue;
+		
+		task_t *owner = (started < users) ? task : TASK;
+		thread_t *thrd = thread_create(busy, NULL, owner,
+		    THREAD_FLAG_NONE, "shootdown1");
+		if (!thrd) {
+			TPRINTF("Could not create thread %u\n", i);
+			break;
+		}
+		
+		thread_wire(thrd, &cpus[i]);
+		thread_ready(thrd);
+		
+		if (owner == task) {
+			cpu_mask_set(as_cpu, i);
+			as_cpus++;
+		}
+		
+		started++;
+	}
+	
+	if (as_cpus == 0) {
+		/* The task has no thread which would destroy it */
+		task_destroy(task);
+		result = "Unable to create threads";
+		goto cleanup;
+	}
+	
+	while (atomic_get(&busy_count) < started)
+		thread_usleep(1000);
+	
+	TPRINTF("Address space active on %u CPUs, %u CPUs busy in unrelated "
+	    "threads\n", as_cpus, started - as_cpus);
+	
+#ifdef CONFIG_SMP
+	/* Exactly the processors running the task may be targets */
+	for (unsigned int i = 0; i < config.cpu_count; i++) {
+		if (cpu_mask_is_set(as->cpu_mask, i) !=
+		    cpu_mask_is_set(as_cpu, i)) {
+			result = "Shootdown recipients do not match the CPUs "
+			    "using the address space";
+			goto cleanup;
+		}
+	}
+#endif
+	
+	uint64_t targeted = shootdown_time(as, as->cpu_mask);
+	uint64_t bcast = shootdown_time(as, NULL);
+	
+	TPRINTF("Shootdown to %u CPUs using the address space: %" PRIu64
+	    " cycles (%" PRIu64 " us) per run\n", as_cpus, targeted,
+	    cycles2us(targeted));
+	TPRINTF("Shootdown to all %u other CPUs: %" PRIu64 " cycles (%" PRIu64
+	    " us) per run\n", others, bcast, cycles2us(bcast));
+	
+cleanup:
+	busy_stop = true;
+	while (atomic_get(&busy_count) > 0)
+		thread_usleep(1000);
+	
+	as_release(as);
+	
+	return result;
+}
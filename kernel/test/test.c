@@ -47,9 +47,12 @@ test_t tests[] = {
 #include <fault/fault1.def>
 #include <mm/falloc1.def>
 #include <mm/falloc2.def>
+#include <mm/falloc3.def>
+#include <mm/falloc4.def>
 #include <mm/mapping1.def>
 #include <mm/slab1.def>
 #include <mm/slab2.def>
+#include <mm/shootdown1.def>
 #include <synch/semaphore1.def>
 #include <synch/semaphore2.def>
 #include <synch/rcu1.def>
@@ -61,6 +64,7 @@ test_t tests[] = {
 #include <print/print4.def>
 #include <print/print5.def>
 #include <thread/thread1.def>
+#include <thread/thread2.def>
 #include <smpcall/smpcall1.def>
 	{
 		.name = NULL,
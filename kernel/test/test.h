@@ -63,10 +63,13 @@ extern const char *test_mips1(void);
 extern const char *test_fault1(void);
 extern const char *test_falloc1(void);
 extern const char *test_falloc2(void);
+extern const char *test_falloc3(void);
+extern const char *test_falloc4(void);
 extern const char *test_mapping1(void);
 extern const char *test_purge1(void);
 extern const char *test_slab1(void);
 extern const char *test_slab2(void);
+extern const char *test_shootdown1(void);
 extern const char *test_semaphore1(void);
 extern const char *test_semaphore2(void);
 extern const char *test_print1(void);
@@ -75,6 +78,7 @@ extern const char *test_print3(void);
 extern const char *test_print4(void);
 extern const char *test_print5(void);
 extern const char *test_thread1(void);
+extern const char *test_thread2(void);
 extern const char *test_smpcall1(void);
 extern const char *test_workqueue_all(void);
 extern const char *test_workqueue3(void);
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <print.h>
+#include <test.h>
+#include <atomic.h>
+#include <config.h>
+#include <cpu.h>
+#include <preemption.h>
+#include <proc/thread.h>
+#include <time/clock.h>
+#include <arch/cycle.h>
+#include <arch.h>
+
+#define ROUNDS   16
+#define TIMEOUT  5  /* seconds */
+
+static atomic_t started;
+static atomic_t finished;
+static volatile unsigned int runner;
+
+static void worker(void *data)
+{
+	thread_detach(THREAD);
+	
+	runner = CPU->id;
+	atomic_set(&started, 1);
+	atomic_inc(&finished);
+}
+
+/** Measure the time it takes an idle CPU to pick up a ready thread
+ *
+ * The worker is readied on this CPU while it spins with preemption
+ * disabled, so that the worker can only run if another CPU steals it.
+ * Both time stamps are taken on this CPU.
+ *
+ */
+const char *test_thread2(void)
+{
+	if (config.cpu_active < 2) {
+		TPRINTF("Only one CPU active, nothing to measure\n");
+		return NULL;
+	}
+	
+	uint64_t min = (uint64_t) -1;
+	uint64_t max = 0;
+	uint64_t total = 0;
+	atomic_count_t created = 0;
+	const char *err = NULL;
+	
+	atomic_set(&finished, 0);
+	
+	unsigned int i;
+	for (i = 0; i < ROUNDS; i++) {
+		thread_t *t = thread_create(worker, NULL, TASK,
+		    THREAD_FLAG_NONE, "thread2");
+		if (t == NULL) {
+			TPRINTF("Could not create thread %u\n", i);
+			break;
+		}
+		
+		created++;
+		atomic_set(&started, 0);
+		
+		/* Let the other CPUs go idle. */
+		thread_usleep(20000);
+		
+		preemption_disable();
+		
+		unsigned int home = CPU->id;
+		sysarg_t deadline =
+		    *((volatile sysarg_t *) &uptime->seconds1) + TIMEOUT;
+		
+		uint64_t start = get_cycle();
+		thread_ready(t);
+		
+		while (atomic_get(&started) == 0) {
+			if (*((volatile sysarg_t *) &uptime->seconds1) >
+			    deadline)
+				break;
+		}
+		
+		uint64_t delta = get_cycle() - start;
+		bool stolen = (atomic_get(&started) != 0);
+		uint16_t mhz = CPU->frequency_mhz;
+		
+		preemption_enable();
+		
+		if (!stolen) {
+			err = "Ready thread not picked up by an idle CPU";
+			break;
+		}
+		
+		if (mhz != 0)
+			delta /= mhz;
+		
+		TPRINTF("Round %u: cpu%u -> cpu%u in %" PRIu64 " %s\n", i,
+		    home, runner, delta, (mhz != 0) ? "us" : "cycles");
+		
+		if (delta < min)
+			min = delta;
+		if (delta > max)
+			max = delta;
+		total += delta;
+	}
+	
+	while (atomic_get(&finished) < created)
+		thread_usleep(10000);
+	
+	if ((err == NULL) && (i > 0))
+		TPRINTF("Idle to run latency: min %" PRIu64 ", avg %" PRIu64
+		    ", max %" PRIu64 "\n", min, total / i, max);
+	
+	return err;
+}
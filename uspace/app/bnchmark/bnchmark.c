@@ -47,11 +47,32 @@
 #include <errno.h>
 #include <time.h>
 #include <dirent.h>
+#include <block.h>
+#include <vfs/vfs.h>
+#include <vfs/ring.h>
 
 #define NAME	"bnchmark"
 #define BUFSIZE 8096
 #define MBYTE (1024*1024)
 
+/** Number of metadata blocks in the mixed block cache trace */
+#define TRACE_HOT_BLOCKS 7
+/** Number of streamed data blocks between two metadata accesses */
+#define TRACE_STREAM_RUN 2
+/** Number of streamed data blocks in the mixed block cache trace */
+#define TRACE_STREAM_BLOCKS 4096
+
+/** Size of the file written and read by the VFS read/write benchmarks */
+#define RDWR_FILE_SIZE (8 * MBYTE)
+/** Size of a single read or write in the VFS read/write benchmarks */
+#define RDWR_CHUNK 4096
+/** Size of a single read or write in the large-request benchmark */
+#define RDWR_LARGE_CHUNK MBYTE
+/** Number of requests queued at once in the VFS ring benchmark */
+#define RDWR_RING_ENTRIES 64
+/** Number of times the path is opened by the VFS lookup benchmark */
+#define LOOKUP_ITERATIONS 10000
+
 typedef int(*measure_func_t)(void *);
 typedef unsigned long umseconds_t; /* milliseconds */
 
@@ -127,6 +148,284 @@ static int sequential_read_dir(void *data)
 	return EOK;
 }
 
+/** Replay a mixed metadata and streaming trace through the block cache.
+ *
+ * Every TRACE_STREAM_RUN streamed data blocks are followed by an access to
+ * one of a set of frequently used metadata blocks, much like a file system
+ * reading a large file and consulting its allocation tables. The cache hit
+ * ratio is printed.
+ *
+ * A metadata block is reused only after TRACE_HOT_BLOCKS * (1 +
+ * TRACE_STREAM_RUN) - 1 other blocks, more than LRU keeps even at the high
+ * watermark of the cache, while the metadata blocks alone fit in the main
+ * part of a 2Q cache. The stream skips every other block so that read-ahead
+ * does not kick in.
+ */
+static int block_cache_trace(const char *path, enum cache_mode mode)
+{
+	service_id_t service_id;
+	aoff64_t nblocks;
+	size_t bsize;
+	block_t *block;
+	unsigned i;
+	int rc;
+	
+	rc = loc_service_get_id(path, &service_id, 0);
+	if (rc != EOK) {
+		fprintf(stderr, "Failed resolving device: %s\n", path);
+		return rc;
+	}
+	
+	rc = block_init(service_id, 2048);
+	if (rc != EOK) {
+		fprintf(stderr, "Failed opening device: %s\n", path);
+		return rc;
+	}
+	
+	rc = block_get_bsize(service_id, &bsize);
+	if (rc == EOK)
+		rc = block_get_nblocks(service_id, &nblocks);
+	if (rc == EOK && nblocks < 2 * TRACE_HOT_BLOCKS) {
+		fprintf(stderr, "Device too small: %s\n", path);
+		rc = EINVAL;
+	}
+	if (rc == EOK)
+		rc = block_cache_init(service_id, bsize, 0, mode);
+	if (rc != EOK) {
+		block_fini(service_id);
+		return rc;
+	}
+	
+	for (i = 0; i < TRACE_STREAM_BLOCKS; i++) {
+		aoff64_t ba = TRACE_HOT_BLOCKS +
+		    2 * i % (nblocks - TRACE_HOT_BLOCKS - 1);
+		
+		rc = block_get(&block, service_id, ba, BLOCK_FLAGS_NONE);
+		if (rc != EOK)
+			break;
+		block_put(block);
+		
+		if ((i + 1) % TRACE_STREAM_RUN != 0)
+			continue;
+		
+		rc = block_get(&block, service_id,
+		    i / TRACE_STREAM_RUN % TRACE_HOT_BLOCKS, BLOCK_FLAGS_NONE);
+		if (rc != EOK)
+			break;
+		block_put(block);
+	}
+	
+	block_cache_stats_t stats;
+	if (rc == EOK)
+		rc = block_cache_get_stats(service_id, &stats);
+	
+	block_fini(service_id);
+	
+	if (rc != EOK) {
+		fprintf(stderr, "Failed reading device: %s\n", path);
+		return rc;
+	}
+	
+	uint64_t total = stats.hits + stats.misses;
+	printf("hits %" PRIu64 ", misses %" PRIu64 ", hit ratio %" PRIu64
+	    "%%\n", stats.hits, stats.misses,
+	    total > 0 ? stats.hits * 100 / total : 0);
+	return EOK;
+}
+
+static int block_cache_lru(void *data)
+{
+	return block_cache_trace((const char *) data, CACHE_MODE_WT);
+}
+
+static int block_cache_2q(void *data)
+{
+	return block_cache_trace((const char *) data,
+	    CACHE_MODE_WT | CACHE_MODE_2Q);
+}
+
+/** Write and read back a file in small chunks, one request per IPC call. */
+static int vfs_rdwr_plain(void *data)
+{
+	char *path = (char *) data;
+	char *buf = malloc(RDWR_CHUNK);
+	aoff64_t pos;
+	size_t n;
+	int rc;
+	
+	if (buf == NULL)
+		return ENOMEM;
+	
+	memset(buf, 0x5a, RDWR_CHUNK);
+	
+	int fd = vfs_lookup_open(path, WALK_REGULAR | WALK_MAY_CREATE,
+	    MODE_READ | MODE_WRITE);
+	if (fd < 0) {
+		fprintf(stderr, "Failed opening file: %s\n", path);
+		free(buf);
+		return fd;
+	}
+	
+	rc = EOK;
+	for (pos = 0; (rc == EOK) && (pos < RDWR_FILE_SIZE); )
+		rc = vfs_write(fd, &pos, buf, RDWR_CHUNK, &n);
+	for (pos = 0; (rc == EOK) && (pos < RDWR_FILE_SIZE); ) {
+		rc = vfs_read(fd, &pos, buf, RDWR_CHUNK, &n);
+		if ((rc == EOK) && (n == 0))
+			rc = EIO;
+	}
+	
+	if (rc != EOK)
+		fprintf(stderr, "Failed accessing file: %s\n", path);
+	
+	vfs_put(fd);
+	vfs_unlink_path(path);
+	free(buf);
+	return rc;
+}
+
+/** Write and read back a file in large chunks spanning many blocks. */
+static int vfs_rdwr_large(void *data)
+{
+	char *path = (char *) data;
+	char *buf = malloc(RDWR_LARGE_CHUNK);
+	aoff64_t pos;
+	size_t n;
+	int rc;
+	
+	if (buf == NULL)
+		return ENOMEM;
+	
+	memset(buf, 0x5a, RDWR_LARGE_CHUNK);
+	
+	int fd = vfs_lookup_open(path, WALK_REGULAR | WALK_MAY_CREATE,
+	    MODE_READ | MODE_WRITE);
+	if (fd < 0) {
+		fprintf(stderr, "Failed opening file: %s\n", path);
+		free(buf);
+		return fd;
+	}
+	
+	rc = EOK;
+	for (pos = 0; (rc == EOK) && (pos < RDWR_FILE_SIZE); )
+		rc = vfs_write(fd, &pos, buf, RDWR_LARGE_CHUNK, &n);
+	if (rc == EOK)
+		rc = vfs_sync(fd);
+	for (pos = 0; (rc == EOK) && (pos < RDWR_FILE_SIZE); ) {
+		rc = vfs_read(fd, &pos, buf, RDWR_LARGE_CHUNK, &n);
+		if ((rc == EOK) && (n == 0))
+			rc = EIO;
+	}
+	
+	if (rc != EOK)
+		fprintf(stderr, "Failed accessing file: %s\n", path);
+	
+	vfs_put(fd);
+	vfs_unlink_path(path);
+	free(buf);
+	return rc;
+}
+
+/** Transfer a file in small chunks through a VFS ring. */
+static int vfs_ring_transfer(vfs_ring_t *ring, int fd, bool read)
+{
+	aoff64_t pos = 0;
+	size_t pending = 0;
+	vfs_ring_cqe_t cqe;
+	int rc;
+	
+	while ((pos < RDWR_FILE_SIZE) || (pending > 0)) {
+		while ((pos < RDWR_FILE_SIZE) &&
+		    (pending < RDWR_RING_ENTRIES)) {
+			size_t offset = (pos / RDWR_CHUNK % RDWR_RING_ENTRIES) *
+			    RDWR_CHUNK;
+			if (read) {
+				rc = vfs_ring_read(ring, fd, pos, offset,
+				    RDWR_CHUNK, pos);
+			} else {
+				rc = vfs_ring_write(ring, fd, pos, offset,
+				    RDWR_CHUNK, pos);
+			}
+			if (rc != EOK)
+				return rc;
+			
+			pos += RDWR_CHUNK;
+			pending++;
+		}
+		
+		rc = vfs_ring_submit(ring, NULL);
+		if (rc != EOK)
+			return rc;
+		
+		while (vfs_ring_complete(ring, &cqe)) {
+			if (cqe.rc != EOK)
+				return cqe.rc;
+			if (cqe.bytes != RDWR_CHUNK)
+				return EIO;
+			pending--;
+		}
+	}
+	
+	return EOK;
+}
+
+/** Write and read back a file in small chunks, many requests per IPC call. */
+static int vfs_rdwr_ring(void *data)
+{
+	char *path = (char *) data;
+	vfs_ring_t *ring;
+	int rc;
+	
+	rc = vfs_ring_create(RDWR_RING_ENTRIES,
+	    RDWR_RING_ENTRIES * RDWR_CHUNK, &ring);
+	if (rc != EOK) {
+		fprintf(stderr, "Failed creating VFS ring\n");
+		return rc;
+	}
+	
+	memset(vfs_ring_data(ring, NULL), 0x5a,
+	    RDWR_RING_ENTRIES * RDWR_CHUNK);
+	
+	int fd = vfs_lookup_open(path, WALK_REGULAR | WALK_MAY_CREATE,
+	    MODE_READ | MODE_WRITE);
+	if (fd < 0) {
+		fprintf(stderr, "Failed opening file: %s\n", path);
+		vfs_ring_destroy(ring);
+		return fd;
+	}
+	
+	rc = vfs_ring_transfer(ring, fd, false);
+	if (rc == EOK)
+		rc = vfs_ring_transfer(ring, fd, true);
+	
+	if (rc != EOK)
+		fprintf(stderr, "Failed accessing file: %s\n", path);
+	
+	vfs_put(fd);
+	vfs_unlink_path(path);
+	vfs_ring_destroy(ring);
+	return rc;
+}
+
+/** Repeatedly open and close the same path. */
+static int vfs_lookup_path(void *data)
+{
+	char *path = (char *) data;
+	int i;
+	
+	for (i = 0; i < LOOKUP_ITERATIONS; i++) {
+		int fd = vfs_lookup(path, WALK_REGULAR);
+		if (fd < 0) {
+			fprintf(stderr, "Failed looking up file: %s\n", path);
+			return fd;
+		}
+		
+		vfs_put(fd);
+	}
+	
+	return EOK;
+}
+
 int main(int argc, char **argv)
 {
 	int rc;
@@ -176,6 +475,24 @@ int main(int argc, char **argv)
 	else if (str_cmp(test_type, "sequential-dir-read") == 0) {
 		fn = sequential_read_dir;
 	}
+	else if (str_cmp(test_type, "block-cache-lru") == 0) {
+		fn = block_cache_lru;
+	}
+	else if (str_cmp(test_type, "block-cache-2q") == 0) {
+		fn = block_cache_2q;
+	}
+	else if (str_cmp(test_type, "vfs-rdwr") == 0) {
+		fn = vfs_rdwr_plain;
+	}
+	else if (str_cmp(test_type, "vfs-rdwr-large") == 0) {
+		fn = vfs_rdwr_large;
+	}
+	else if (str_cmp(test_type, "vfs-ring") == 0) {
+		fn = vfs_rdwr_ring;
+	}
+	else if (str_cmp(test_type, "vfs-lookup") == 0) {
+		fn = vfs_lookup_path;
+	}
 	else {
 		fprintf(stderr, "Error, unknown test type\n");
 		syntax_print();
@@ -190,6 +507,12 @@ int main(int argc, char **argv)
 		}
 	
 		printf("%s;%s;%s;%lu;ms\n", test_type, path, log_str, milliseconds_taken);
+		if ((fn == vfs_rdwr_large) && (milliseconds_taken > 0)) {
+			/* The file is written once and read once */
+			printf("%s;%s;%s;%lu;MB/s\n", test_type, path, log_str,
+			    (umseconds_t) (2 * RDWR_FILE_SIZE / MBYTE * 1000 /
+			    milliseconds_taken));
+		}
 	}
 
 	return 0;
@@ -203,8 +526,14 @@ static void syntax_print(void)
 	fprintf(stderr, "  <test-type>     one of:\n");
 	fprintf(stderr, "                    sequential-file-read\n");
 	fprintf(stderr, "                    sequential-dir-read\n");
+	fprintf(stderr, "                    block-cache-lru\n");
+	fprintf(stderr, "                    block-cache-2q\n");
+	fprintf(stderr, "                    vfs-rdwr\n");
+	fprintf(stderr, "                    vfs-rdwr-large\n");
+	fprintf(stderr, "                    vfs-ring\n");
+	fprintf(stderr, "                    vfs-lookup\n");
 	fprintf(stderr, "  <log-str>       a string to attach to results\n");
-	fprintf(stderr, "  <path>          file/directory to use for testing\n");
+	fprintf(stderr, "  <path>          file/directory/block device to use for testing\n");
 }
 
 /**
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup netspeed
+ * @{
+ */
+/** @file Network UDP datagram rate benchmark.
+ *
+ * One instance receives datagrams and reports the number of datagrams and
+ * bytes received per second, another one sends datagrams as fast as
+ * possible. Both can run on the same machine talking over 127.0.0.1, which
+ * exercises the whole receive path including inetsrv and udp.
+ */
+
+#include <async.h>
+#include <errno.h>
+#include <fibril_synch.h>
+#include <inet/endpoint.h>
+#include <inet/hostport.h>
+#include <inet/udp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include <sys/time.h>
+
+#define NAME "netspeed"
+
+/** Default number of datagrams to send */
+#define DEFAULT_COUNT  100000
+
+/** Default datagram payload size */
+#define DEFAULT_SIZE  64
+
+/** Maximum datagram payload size */
+#define MAX_SIZE  1472
+
+static FIBRIL_MUTEX_INITIALIZE(stats_lock);
+static uint64_t recv_msgs;
+static uint64_t recv_bytes;
+
+static void netspeed_recv_msg(udp_assoc_t *, udp_rmsg_t *);
+static void netspeed_recv_err(udp_assoc_t *, udp_rerr_t *);
+static void netspeed_link_state(udp_assoc_t *, udp_link_state_t);
+
+static udp_cb_t netspeed_udp_cb = {
+	.recv_msg = netspeed_recv_msg,
+	.recv_err = netspeed_recv_err,
+	.link_state = netspeed_link_state
+};
+
+static void netspeed_recv_msg(udp_assoc_t *assoc, udp_rmsg_t *rmsg)
+{
+	fibril_mutex_lock(&stats_lock);
+	recv_msgs++;
+	recv_bytes += udp_rmsg_size(rmsg);
+	fibril_mutex_unlock(&stats_lock);
+}
+
+static void netspeed_recv_err(udp_assoc_t *assoc, udp_rerr_t *rerr)
+{
+}
+
+static void netspeed_link_state(udp_assoc_t *assoc, udp_link_state_t lstate)
+{
+}
+
+static void print_syntax(void)
+{
+	printf("syntax:\n");
+	printf("\t%s -l <port>\n", NAME);
+	printf("\t%s -d <host>:<port> [-n <count>] [-s <size>]\n", NAME);
+}
+
+/** Receive datagrams and print the receive rate once a second. */
+static int netspeed_listen(const char *port_s)
+{
+	char *endptr;
+	uint16_t port = strtol(port_s, &endptr, 10);
+	if (*endptr != '\0') {
+		printf("Invalid port number %s\n", port_s);
+		return EINVAL;
+	}
+	
+	inet_ep2_t epp;
+	inet_ep2_init(&epp);
+	epp.local.port = port;
+	
+	udp_t *udp;
+	int rc = udp_create(&udp);
+	if (rc != EOK) {
+		printf("Error initializing UDP: %s\n", str_error(rc));
+		return rc;
+	}
+	
+	udp_assoc_t *assoc;
+	rc = udp_assoc_create(udp, &epp, &netspeed_udp_cb, NULL, &assoc);
+	if (rc != EOK) {
+		printf("Error creating association: %s\n", str_error(rc));
+		udp_destroy(udp);
+		return rc;
+	}
+	
+	printf("Listening on port %u\n", port);
+	
+	uint64_t last_msgs = 0;
+	uint64_t last_bytes = 0;
+	struct timeval last;
+	getuptime(&last);
+	
+	while (true) {
+		async_usleep(1000000);
+		
+		fibril_mutex_lock(&stats_lock);
+		uint64_t msgs = recv_msgs;
+		uint64_t bytes = recv_bytes;
+		fibril_mutex_unlock(&stats_lock);
+		
+		struct timeval now;
+		getuptime(&now);
+		
+		uint64_t usec = tv_sub_diff(&now, &last);
+		if (usec == 0)
+			usec = 1;
+		
+		if (msgs != last_msgs) {
+			printf("%" PRIu64 " datagrams/s, %" PRIu64 " KiB/s\n",
+			    (msgs - last_msgs) * 1000000 / usec,
+			    (bytes - last_bytes) * 1000000 / usec / 1024);
+		}
+		
+		last_msgs = msgs;
+		last_bytes = bytes;
+		last = now;
+	}
+	
+	return EOK;
+}
+
+/** Send @a count datagrams of @a size bytes and print the send rate. */
+static int netspeed_send(const char *hostport, size_t count, size_t size)
+{
+	inet_ep2_t epp;
+	const char *errmsg;
+	
+	inet_ep2_init(&epp);
+	int rc = inet_hostport_plookup_one(hostport, ip_any, &epp.remote, NULL,
+	    &errmsg);
+	if (rc != EOK) {
+		printf("Error: %s (host:port %s).\n", errmsg, hostport);
+		return rc;
+	}
+	
+	uint8_t *data = calloc(1, size);
+	if (data == NULL) {
+		printf("Out of memory.\n");
+		return ENOMEM;
+	}
+	
+	udp_t *udp;
+	rc = udp_create(&udp);
+	if (rc != EOK) {
+		printf("Error initializing UDP: %s\n", str_error(rc));
+		free(data);
+		return rc;
+	}
+	
+	udp_assoc_t *assoc;
+	rc = udp_assoc_create(udp, &epp, &netspeed_udp_cb, NULL, &assoc);
+	if (rc != EOK) {
+		printf("Error creating association: %s\n", str_error(rc));
+		udp_destroy(udp);
+		free(data);
+		return rc;
+	}
+	
+	printf("Sending %zu datagrams of %zu bytes to %s\n", count, size,
+	    hostport);
+	
+	struct timeval start;
+	getuptime(&start);
+	
+	size_t sent;
+	for (sent = 0; sent < count; sent++) {
+		rc = udp_assoc_send_msg(assoc, &epp.remote, data, size);
+		if (rc != EOK) {
+			printf("Error sending datagram: %s\n", str_error(rc));
+			break;
+		}
+	}
+	
+	struct timeval end;
+	getuptime(&end);
+	
+	uint64_t usec = tv_sub_diff(&end, &start);
+	if (usec == 0)
+		usec = 1;
+	
+	printf("Sent %zu datagrams in %" PRIu64 " ms, %" PRIu64
+	    " datagrams/s\n", sent, usec / 1000,
+	    (uint64_t) sent * 1000000 / usec);
+	
+	udp_assoc_destroy(assoc);
+	udp_destroy(udp);
+	free(data);
+	
+	return rc;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t count = DEFAULT_COUNT;
+	size_t size = DEFAULT_SIZE;
+	char *endptr;
+	
+	if (argc < 3) {
+		print_syntax();
+		return 1;
+	}
+	
+	if (str_cmp(argv[1], "-l") == 0) {
+		if (argc != 3) {
+			print_syntax();
+			return 1;
+		}
+		
+		return netspeed_listen(argv[2]) == EOK ? 0 : 1;
+	}
+	
+	if (str_cmp(argv[1], "-d") != 0) {
+		print_syntax();
+		return 1;
+	}
+	
+	for (int i = 3; i < argc; i += 2) {
+		if (i + 1 >= argc) {
+			print_syntax();
+			return 1;
+		}
+		
+		unsigned long val = strtoul(argv[i + 1], &endptr, 10);
+		if (*endptr != '\0') {
+			printf("Invalid number %s\n", argv[i + 1]);
+			return 1;
+		}
+		
+		if (str_cmp(argv[i], "-n") == 0) {
+			count = val;
+		} else if (str_cmp(argv[i], "-s") == 0) {
+			if (val == 0 || val > MAX_SIZE) {
+				printf("Size must be between 1 and %d\n",
+				    MAX_SIZE);
+				return 1;
+			}
+			
+			size = val;
+		} else {
+			print_syntax();
+			return 1;
+		}
+	}
+	
+	return netspeed_send(argv[2], count, size) == EOK ? 0 : 1;
+}
+
+/** @}
+ */
@@ -51,6 +51,7 @@ typedef struct {
 	nic_unicast_mode_t unicast_mode;
 	nic_multicast_mode_t multicast_mode;
 	nic_broadcast_mode_t broadcast_mode;
+	nic_device_stats_t stats;
 	int speed;
 } nic_info_t;
 
@@ -172,6 +173,13 @@ static int nic_get_info(service_id_t svc_id, char *svc_name,
 		goto error;
 	}
 
+	rc = nic_get_stats(sess, &info->stats);
+	if (rc != EOK) {
+		printf("Error getting NIC statistics.\n");
+		rc = EIO;
+		goto error;
+	}
+
 	return EOK;
 error:
 	return rc;
@@ -305,6 +313,13 @@ static int nic_list(void)
 			    nic_duplex_mode_str(nic_info.duplex));
 		}
 
+		printf("\tFrames received: %lu, sent: %lu\n",
+		    nic_info.stats.receive_packets,
+		    nic_info.stats.send_packets);
+		printf("\tReceive interrupts: %lu, polls: %lu\n",
+		    nic_info.stats.receive_interrupts,
+		    nic_info.stats.receive_polls);
+
 		free(svc_name);
 		free(addr_str);
 	}
@@ -64,7 +64,7 @@ static void list_tasks(void)
 	}
 	
 	printf("[taskid] [thrds] [resident] [virtual] [ucycles]"
-	    " [kcycles] [name\n");
+	    " [kcycles] [faults] [name\n");
 	
 	size_t i;
 	for (i = 0; i < count; i++) {
@@ -83,10 +83,11 @@ static void list_tasks(void)
 		order_suffix(stats_tasks[i].kcycles, &kcycles, &ksuffix);
 		
 		printf("%-8" PRIu64 " %7zu %7" PRIu64 "%s %6" PRIu64 "%s"
-		    " %8" PRIu64 "%c %8" PRIu64 "%c %s\n",
+		    " %8" PRIu64 "%c %8" PRIu64 "%c %8" PRIu64 " %s\n",
 		    stats_tasks[i].task_id, stats_tasks[i].threads,
 		    resmem, resmem_suffix, virtmem, virtmem_suffix,
-		    ucycles, usuffix, kcycles, ksuffix, stats_tasks[i].name);
+		    ucycles, usuffix, kcycles, ksuffix,
+		    stats_tasks[i].page_faults, stats_tasks[i].name);
 	}
 	
 	free(stats_tasks);
@@ -163,6 +164,31 @@ static void list_cpus(void)
 	free(cpus);
 }
 
+static void list_slabs(void)
+{
+	size_t count;
+	stats_slab_t *slabs = stats_get_slabs(&count);
+	
+	if (slabs == NULL) {
+		fprintf(stderr, "%s: Unable to get slab statistics\n", NAME);
+		return;
+	}
+	
+	printf("[cache name        ] [size  ] [mag] [alloc   ] [cached  ]"
+	    " [dhits   ] [dmiss   ] [dcont   ]\n");
+	
+	size_t i;
+	for (i = 0; i < count; i++) {
+		printf("%-20s %8zu %5zu %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+		    " %10" PRIu64 " %10" PRIu64 "\n", slabs[i].name,
+		    slabs[i].size, slabs[i].mag_size, slabs[i].allocated_objs,
+		    slabs[i].cached_objs, slabs[i].depot_hits,
+		    slabs[i].depot_misses, slabs[i].depot_contention);
+	}
+	
+	free(slabs);
+}
+
 static void print_load(void)
 {
 	size_t count;
@@ -201,7 +227,7 @@ static void print_uptime(void)
 static void usage(const char *name)
 {
 	printf(
-	    "Usage: %s [-t task_id] [-a] [-c] [-l] [-u]\n" \
+	    "Usage: %s [-t task_id] [-a] [-c] [-s] [-l] [-u]\n" \
 	    "\n" \
 	    "Options:\n" \
 	    "\t-t task_id\n" \
@@ -216,6 +242,10 @@ static void usage(const char *name)
 	    "\t--cpus\n" \
 	    "\t\tList CPUs\n" \
 	    "\n" \
+	    "\t-s\n" \
+	    "\t--slabs\n" \
+	    "\t\tList kernel slab caches\n" \
+	    "\n" \
 	    "\t-l\n" \
 	    "\t--load\n" \
 	    "\t\tPrint system load\n" \
@@ -239,6 +269,7 @@ int main(int argc, char *argv[])
 	bool toggle_threads = false;
 	bool toggle_all = false;
 	bool toggle_cpus = false;
+	bool toggle_slabs = false;
 	bool toggle_load = false;
 	bool toggle_uptime = false;
 	
@@ -269,6 +300,13 @@ int main(int argc, char *argv[])
 			continue;
 		}
 		
+		/* Slab caches */
+		if ((off = arg_parse_short_long(argv[i], "-s", "--slabs")) != -1) {
+			toggle_tasks = false;
+			toggle_slabs = true;
+			continue;
+		}
+		
 		/* Threads */
 		if ((off = arg_parse_short_long(argv[i], "-t", "--task=")) != -1) {
 			// TODO: Support for 64b range
@@ -310,6 +348,9 @@ int main(int argc, char *argv[])
 	if (toggle_cpus)
 		list_cpus();
 	
+	if (toggle_slabs)
+		list_slabs();
+	
 	if (toggle_load)
 		print_load();
 	
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <adt/checksum.h>
+#include <sys/time.h>
+#include "../tester.h"
+
+/** Size of the checksummed buffer */
+#define BUFFER_SIZE  (64 * 1024)
+
+/** Amount of data checksummed for each variant */
+#define VOLUME  (64 * 1024 * 1024)
+
+/** Byte-at-a-time table-driven CRC32 as a reference. */
+static uint32_t crc32_bytewise(const uint8_t *data, size_t length)
+{
+	static uint32_t table[256];
+	
+	if (table[1] == 0) {
+		for (unsigned int i = 0; i < 256; i++) {
+			uint32_t crc = i;
+			
+			for (unsigned int bit = 0; bit < 8; bit++)
+				crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+			
+			table[i] = crc;
+		}
+	}
+	
+	uint32_t crc = ~0;
+	
+	while (length-- > 0)
+		crc = table[(uint8_t) crc ^ *data++] ^ (crc >> 8);
+	
+	return ~crc;
+}
+
+static uint32_t crc32_bytewise_wrapper(uint8_t *data, size_t length)
+{
+	return crc32_bytewise(data, length);
+}
+
+typedef struct {
+	const char *name;
+	uint32_t (*fn)(uint8_t *, size_t);
+} variant_t;
+
+static variant_t variants[] = {
+	{ "CRC32 (byte-at-a-time)", crc32_bytewise_wrapper },
+	{ "CRC32", compute_crc32 },
+	{ "CRC32C", compute_crc32c }
+};
+
+const char *test_checksum1(void)
+{
+	uint8_t *buffer = malloc(BUFFER_SIZE);
+	if (buffer == NULL)
+		return "Cannot allocate buffer";
+	
+	for (size_t i = 0; i < BUFFER_SIZE; i++)
+		buffer[i] = (uint8_t) (i * 31 + 7);
+	
+	if (compute_crc32(buffer, BUFFER_SIZE) !=
+	    crc32_bytewise(buffer, BUFFER_SIZE)) {
+		free(buffer);
+		return "CRC32 result mismatch";
+	}
+	
+	for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+		uint32_t crc = 0;
+		
+		struct timeval start;
+		getuptime(&start);
+		
+		for (size_t done = 0; done < VOLUME; done += BUFFER_SIZE)
+			crc ^= variants[v].fn(buffer, BUFFER_SIZE);
+		
+		struct timeval end;
+		getuptime(&end);
+		
+		suseconds_t duration = tv_sub_diff(&end, &start);
+		
+		TPRINTF("%-24s %" PRIu64 " MiB in %ld us", variants[v].name,
+		    (uint64_t) VOLUME / (1024 * 1024), (long) duration);
+		if (duration > 0) {
+			TPRINTF(", %" PRIu64 " MiB/s", (uint64_t) VOLUME *
+			    1000000 / (uint64_t) duration / (1024 * 1024));
+		}
+		TPRINTF(" (%08" PRIx32 ")\n", crc);
+	}
+	
+	free(buffer);
+	return NULL;
+}
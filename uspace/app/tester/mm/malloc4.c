@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <atomic.h>
+#include <errno.h>
+#include <malloc.h>
+#include <thread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include "../tester.h"
+
+/** Maximum number of concurrently running threads */
+#define MAX_THREADS  8
+
+/** Number of blocks each thread keeps allocated at once */
+#define BLOCKS  64
+
+/** Number of allocation rounds per thread */
+#define ROUNDS  2000
+
+/** Largest block size used by the test */
+#define MAX_SIZE  512
+
+static atomic_t threads_finished;
+static atomic_t threads_failed;
+
+static void malloc_thread(void *arg)
+{
+	void *blocks[BLOCKS];
+	uint32_t seed = (uint32_t) (uintptr_t) arg;
+	
+	thread_detach(thread_get_id());
+	
+	for (unsigned int round = 0; round < ROUNDS; round++) {
+		for (unsigned int i = 0; i < BLOCKS; i++) {
+			/* Simple linear congruential generator */
+			seed = seed * 1103515245 + 12345;
+			size_t size = 1 + (seed >> 16) % MAX_SIZE;
+			
+			blocks[i] = malloc(size);
+			if (blocks[i] == NULL) {
+				atomic_inc(&threads_failed);
+				
+				while (i > 0)
+					free(blocks[--i]);
+				
+				atomic_inc(&threads_finished);
+				return;
+			}
+			
+			*((uint8_t *) blocks[i]) = (uint8_t) i;
+		}
+		
+		for (unsigned int i = 0; i < BLOCKS; i++)
+			free(blocks[i]);
+	}
+	
+	atomic_inc(&threads_finished);
+}
+
+const char *test_malloc4(void)
+{
+	for (unsigned int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+		atomic_set(&threads_finished, 0);
+		atomic_set(&threads_failed, 0);
+		
+		struct timeval start;
+		getuptime(&start);
+		
+		unsigned int total = 0;
+		for (unsigned int i = 0; i < threads; i++) {
+			if (thread_create(malloc_thread, (void *) (uintptr_t) (i + 1),
+			    "malloc4", NULL) != EOK)
+				break;
+			total++;
+		}
+		
+		while (atomic_get(&threads_finished) < total)
+			thread_usleep(10000);
+		
+		struct timeval end;
+		getuptime(&end);
+		
+		if (total < threads)
+			return "Failed to create threads";
+		
+		if (atomic_get(&threads_failed) > 0)
+			return "Failed to allocate memory";
+		
+		suseconds_t duration = tv_sub_diff(&end, &start);
+		uint64_t ops = (uint64_t) threads * ROUNDS * BLOCKS;
+		
+		TPRINTF("%u thread(s): %" PRIu64 " malloc/free pairs in %ld us",
+		    threads, ops, (long) duration);
+		if (duration > 0) {
+			TPRINTF(", %" PRIu64 " pairs/s",
+			    ops * 1000000 / (uint64_t) duration);
+		}
+		TPRINTF("\n");
+	}
+	
+	if (heap_check() != NULL)
+		return "Heap inconsistency detected";
+	
+	return NULL;
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <mem.h>
+#include <sys/time.h>
+#include "../tester.h"
+
+/** Smallest measured block size */
+#define MIN_SIZE  8
+
+/** Largest measured block size */
+#define MAX_SIZE  (1024 * 1024)
+
+/** Amount of data moved for each block size */
+#define VOLUME  (64 * 1024 * 1024)
+
+/** Offset of the source in the memmove() test */
+#define MOVE_OFFSET  3
+
+/** Start of the moved block in verify(), leaves room for moving it down */
+#define MOVE_BASE  32
+
+/** Distances by which verify() moves overlapping blocks */
+static const int move_deltas[] = { -16, -8, -1, 1, 8, 16 };
+
+typedef enum {
+	OP_MEMCPY,
+	OP_MEMMOVE,
+	OP_MEMSET,
+	OP_BYTES
+} op_t;
+
+static const char *op_names[] = {
+	[OP_MEMCPY] = "memcpy",
+	[OP_MEMMOVE] = "memmove",
+	[OP_MEMSET] = "memset",
+	[OP_BYTES] = "byte loop"
+};
+
+/** Copy byte-by-byte as a reference.
+ *
+ * The destination is accessed through a volatile pointer so that the
+ * compiler cannot turn the loop into a memcpy() call.
+ *
+ */
+static void copy_bytes(void *dst, const void *src, size_t size)
+{
+	volatile uint8_t *dp = (volatile uint8_t *) dst;
+	const uint8_t *sp = (const uint8_t *) src;
+	
+	for (size_t i = 0; i < size; i++)
+		dp[i] = sp[i];
+}
+
+/** Run one operation repeatedly and return the duration in microseconds. */
+static suseconds_t measure(op_t op, uint8_t *dst, const uint8_t *src,
+    size_t size, size_t count)
+{
+	struct timeval start;
+	getuptime(&start);
+	
+	for (size_t i = 0; i < count; i++) {
+		switch (op) {
+		case OP_MEMCPY:
+			memcpy(dst, src, size);
+			break;
+		case OP_MEMMOVE:
+			memmove(dst, dst + MOVE_OFFSET, size);
+			break;
+		case OP_MEMSET:
+			memset(dst, (int) i, size);
+			break;
+		case OP_BYTES:
+			copy_bytes(dst, src, size);
+			break;
+		}
+	}
+	
+	struct timeval end;
+	getuptime(&end);
+	
+	return tv_sub_diff(&end, &start);
+}
+
+/** Check the results of the functions on unaligned blocks. */
+static const char *verify(uint8_t *dst, const uint8_t *src)
+{
+	for (size_t size = 0; size < 300; size++) {
+		for (size_t offset = 0; offset < 8; offset++) {
+			memset(dst, 0, size + 16);
+			memcpy(dst + offset, src + 1, size);
+			if (memcmp(dst + offset, src + 1, size) != 0)
+				return "memcpy() result mismatch";
+			
+			memset(dst + offset, 0x5a, size);
+			for (size_t i = 0; i < size; i++) {
+				if (dst[offset + i] != 0x5a)
+					return "memset() result mismatch";
+			}
+			
+			if (dst[offset + size] != 0)
+				return "memset() overrun";
+			
+			/*
+			 * Overlapping moves in both directions, including
+			 * distances which keep source and destination equally
+			 * aligned to the word size.
+			 */
+			for (size_t d = 0; d < sizeof(move_deltas) /
+			    sizeof(move_deltas[0]); d++) {
+				size_t from = MOVE_BASE + offset;
+				size_t to = from + move_deltas[d];
+				
+				memcpy(dst, src, 2 * MOVE_BASE + size);
+				memmove(dst + to, dst + from, size);
+				if (memcmp(dst + to, src + from, size) != 0)
+					return "memmove() result mismatch";
+				
+				if ((dst[to - 1] != src[to - 1]) ||
+				    (dst[to + size] != src[to + size]))
+					return "memmove() overrun";
+			}
+		}
+	}
+	
+	return NULL;
+}
+
+const char *test_memcpy1(void)
+{
+	uint8_t *src = malloc(MAX_SIZE + MOVE_OFFSET);
+	uint8_t *dst = malloc(MAX_SIZE + MOVE_OFFSET);
+	if ((src == NULL) || (dst == NULL)) {
+		free(src);
+		free(dst);
+		return "Cannot allocate buffers";
+	}
+	
+	for (size_t i = 0; i < MAX_SIZE + MOVE_OFFSET; i++)
+		src[i] = (uint8_t) (i * 31 + 7);
+	
+	const char *err = verify(dst, src);
+	if (err != NULL) {
+		free(src);
+		free(dst);
+		return err;
+	}
+	
+	TPRINTF("%10s", "size");
+	for (op_t op = OP_MEMCPY; op <= OP_BYTES; op++)
+		TPRINTF(" %12s", op_names[op]);
+	TPRINTF("  [MiB/s]\n");
+	
+	for (size_t size = MIN_SIZE; size <= MAX_SIZE; size *= 2) {
+		size_t count = VOLUME / size;
+		
+		TPRINTF("%10zu", size);
+		
+		for (op_t op = OP_MEMCPY; op <= OP_BYTES; op++) {
+			suseconds_t duration = measure(op, dst, src, size, count);
+			
+			if (duration > 0) {
+				TPRINTF(" %12" PRIu64, (uint64_t) VOLUME * 1000000 /
+				    (uint64_t) duration / (1024 * 1024));
+			} else
+				TPRINTF(" %12s", "-");
+		}
+		
+		TPRINTF("\n");
+	}
+	
+	free(src);
+	free(dst);
+	return NULL;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <as.h>
+#include <errno.h>
+#include <sys/time.h>
+#include "../tester.h"
+
+/** Size of the walked buffer */
+#define BUFFER_SIZE  (1024 * 1024 * 1024)
+
+/** Smallest buffer size tried when memory is scarce */
+#define MIN_BUFFER_SIZE  (64 * 1024 * 1024)
+
+/** Number of random accesses per walk */
+#define ACCESSES  (4 * 1024 * 1024)
+
+/** Size of the accessed unit (a cache line) */
+#define STRIDE  64
+
+/** Walk a buffer in random order and return the duration in microseconds. */
+static suseconds_t walk(volatile uint8_t *buffer, size_t size,
+    uint64_t *checksum)
+{
+	uint64_t seed = 1;
+	uint64_t sum = 0;
+	size_t lines = size / STRIDE;
+	
+	struct timeval start;
+	getuptime(&start);
+	
+	for (unsigned int i = 0; i < ACCESSES; i++) {
+		/* 64-bit linear congruential generator */
+		seed = seed * UINT64_C(6364136223846793005) +
+		    UINT64_C(1442695040888963407);
+		sum += buffer[((seed >> 24) % lines) * STRIDE];
+	}
+	
+	struct timeval end;
+	getuptime(&end);
+	
+	*checksum = sum;
+	return tv_sub_diff(&end, &start);
+}
+
+/** Create, populate and walk a buffer. */
+static const char *run(const char *name, unsigned int flags, size_t size)
+{
+	void *area = as_area_create(AS_AREA_ANY, size,
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE | flags,
+	    AS_AREA_UNPAGED);
+	if (area == AS_MAP_FAILED)
+		return "Unable to create address space area";
+	
+	volatile uint8_t *buffer = (volatile uint8_t *) area;
+	
+	/* Fault the buffer in first, so that only the walk is measured. */
+	struct timeval start;
+	getuptime(&start);
+	
+	for (size_t offset = 0; offset < size; offset += PAGE_SIZE)
+		buffer[offset] = (uint8_t) (offset / PAGE_SIZE);
+	
+	struct timeval end;
+	getuptime(&end);
+	
+	uint64_t checksum;
+	suseconds_t duration = walk(buffer, size, &checksum);
+	
+	TPRINTF("%s: populated in %ld us, %u accesses in %ld us",
+	    name, (long) tv_sub_diff(&end, &start), ACCESSES, (long) duration);
+	if (duration > 0) {
+		TPRINTF(", %" PRIu64 " ns/access",
+		    (uint64_t) duration * 1000 / ACCESSES);
+	}
+	TPRINTF(" (checksum %" PRIu64 ")\n", checksum);
+	
+	if (as_area_destroy(area) != EOK)
+		return "Unable to destroy address space area";
+	
+	return NULL;
+}
+
+const char *test_tlb1(void)
+{
+	size_t size = BUFFER_SIZE;
+	
+	/*
+	 * Find a buffer size which can be reserved. The late reserve
+	 * area used for the comparison below does not reserve its memory
+	 * in advance, so it must not be larger than what is available.
+	 */
+	while (true) {
+		void *area = as_area_create(AS_AREA_ANY, size,
+		    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE,
+		    AS_AREA_UNPAGED);
+		if (area != AS_MAP_FAILED) {
+			as_area_destroy(area);
+			break;
+		}
+		
+		if (size / 2 < MIN_BUFFER_SIZE)
+			return "Not enough memory";
+		
+		size /= 2;
+	}
+	
+	TPRINTF("Random walk over %zu MiB\n", size / (1024 * 1024));
+	
+	/* Anonymous areas are backed by large pages where supported. */
+	const char *err = run("Large pages", 0, size);
+	if (err != NULL)
+		return err;
+	
+	/* Late reserve areas commit their memory page by page. */
+	return run("Small pages", AS_AREA_LATE_RESERVE, size);
+}
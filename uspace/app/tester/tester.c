@@ -72,7 +72,11 @@ test_t tests[] = {
 #include "mm/malloc1.def"
 #include "mm/malloc2.def"
 #include "mm/malloc3.def"
+#include "mm/malloc4.def"
 #include "mm/mapping1.def"
+#include "mm/tlb1.def"
+#include "mm/memcpy1.def"
+#include "adt/checksum1.def"
 #include "mm/pager1.def"
 #include "hw/serial/serial1.def"
 #include "chardev/chardev1.def"
@@ -104,7 +104,11 @@ extern const char *test_loop1(void);
 extern const char *test_malloc1(void);
 extern const char *test_malloc2(void);
 extern const char *test_malloc3(void);
+extern const char *test_malloc4(void);
 extern const char *test_mapping1(void);
+extern const char *test_tlb1(void);
+extern const char *test_memcpy1(void);
+extern const char *test_checksum1(void);
 extern const char *test_pager1(void);
 extern const char *test_serial1(void);
 extern const char *test_devman1(void);
@@ -0,0 +1,413 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup webbench
+ * @{
+ */
+/** @file HTTP server benchmark.
+ *
+ * Several client fibrils each open a persistent connection and issue GET
+ * requests for the same URL, optionally pipelining several requests before
+ * waiting for the responses. The request rate and latency percentiles are
+ * printed at the end. Running it against websrv over 127.0.0.1 measures the
+ * server and the whole TCP loopback path.
+ */
+
+#include <errno.h>
+#include <fibril.h>
+#include <fibril_synch.h>
+#include <macros.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include <sys/time.h>
+
+#include <http/http.h>
+#include <uri.h>
+
+#define NAME "webbench"
+
+/** Default number of concurrent connections */
+#define DEFAULT_CONNS  4
+
+/** Default total number of requests */
+#define DEFAULT_REQUESTS  1000
+
+/** Default number of requests in flight on one connection */
+#define DEFAULT_DEPTH  1
+
+/** Buffer for discarding response bodies */
+#define BODY_BUFFER_SIZE  4096
+
+static char *host;
+static uint16_t port = 80;
+static char *path;
+
+static size_t requests = DEFAULT_REQUESTS;
+static size_t depth = DEFAULT_DEPTH;
+
+static FIBRIL_MUTEX_INITIALIZE(bench_lock);
+static FIBRIL_CONDVAR_INITIALIZE(bench_cv);
+/** Number of requests handed out to client fibrils */
+static size_t issued;
+/** Number of requests that failed */
+static size_t failed;
+/** Number of client fibrils still running */
+static size_t running;
+/** Latencies of completed requests in microseconds */
+static uint64_t *latency;
+static size_t latency_count;
+static uint64_t body_bytes;
+
+static void print_syntax(void)
+{
+	printf("syntax:\n");
+	printf("\t%s [-c <connections>] [-n <requests>] [-p <depth>] <url>\n",
+	    NAME);
+	printf("\n");
+	printf("\t-c\tnumber of concurrent connections (default %d)\n",
+	    DEFAULT_CONNS);
+	printf("\t-n\ttotal number of requests (default %d)\n",
+	    DEFAULT_REQUESTS);
+	printf("\t-p\tpipelined requests per connection (default %d)\n",
+	    DEFAULT_DEPTH);
+	printf("\n");
+	printf("example:\n");
+	printf("\t%s -c 8 -n 10000 -p 4 http://127.0.0.1:8080/index.html\n",
+	    NAME);
+}
+
+/** Receive one response and discard its body. */
+static int bench_response(http_t *http, char *buf, size_t *rsize)
+{
+	http_response_t *resp = NULL;
+	char *value;
+	uint64_t remaining;
+
+	int rc = http_receive_response(&http->recv_buffer, &resp, 16 * 1024,
+	    100);
+	if (rc != EOK)
+		return rc;
+
+	if (resp->status != 200) {
+		fprintf(stderr, "Server returned status %d %s\n", resp->status,
+		    resp->message);
+		rc = EIO;
+		goto out;
+	}
+
+	/* Keep-alive only works if we know where the body ends */
+	rc = http_headers_get(&resp->headers, "Content-Length", &value);
+	if (rc != EOK) {
+		fprintf(stderr, "Response has no Content-Length\n");
+		goto out;
+	}
+
+	while (*value == ' ')
+		value++;
+
+	rc = str_uint64_t(value, NULL, 10, false, &remaining);
+	if (rc != EOK)
+		goto out;
+
+	*rsize = remaining;
+	while (remaining > 0) {
+		size_t nrecv;
+
+		rc = recv_buffer(&http->recv_buffer, buf,
+		    min((uint64_t) BODY_BUFFER_SIZE, remaining), &nrecv);
+		if (rc != EOK)
+			goto out;
+
+		if (nrecv == 0) {
+			rc = EIO;
+			goto out;
+		}
+
+		remaining -= nrecv;
+	}
+
+out:
+	http_response_destroy(resp);
+	return rc;
+}
+
+/** Client fibril, runs requests on one connection until all are issued. */
+static int bench_client(void *arg)
+{
+	http_t *http = NULL;
+	http_request_t *req = NULL;
+	struct timeval *start = NULL;
+	char *buf = NULL;
+	size_t batch = 0;
+	size_t done = 0;
+	int rc;
+
+	start = calloc(depth, sizeof(struct timeval));
+	buf = malloc(BODY_BUFFER_SIZE);
+	if (start == NULL || buf == NULL) {
+		rc = ENOMEM;
+		goto out;
+	}
+
+	req = http_request_create("GET", path);
+	if (req == NULL) {
+		rc = ENOMEM;
+		goto out;
+	}
+
+	rc = http_headers_append(&req->headers, "Host", host);
+	if (rc != EOK)
+		goto out;
+
+	http = http_create(host, port);
+	if (http == NULL) {
+		rc = ENOMEM;
+		goto out;
+	}
+
+	rc = http_connect(http);
+	if (rc != EOK) {
+		fprintf(stderr, "Failed connecting: %s\n", str_error(rc));
+		goto out;
+	}
+
+	while (true) {
+		/* Claim the next batch of requests */
+		fibril_mutex_lock(&bench_lock);
+		batch = min(depth, requests - issued);
+		issued += batch;
+		fibril_mutex_unlock(&bench_lock);
+
+		if (batch == 0)
+			break;
+
+		/* Send the whole batch before reading any response */
+		for (size_t i = 0; i < batch; i++) {
+			getuptime(&start[i]);
+			rc = http_send_request(http, req);
+			if (rc != EOK) {
+				fprintf(stderr, "Failed sending request: %s\n",
+				    str_error(rc));
+				goto out;
+			}
+		}
+
+		for (done = 0; done < batch; done++) {
+			size_t rsize;
+
+			rc = bench_response(http, buf, &rsize);
+			if (rc != EOK) {
+				fprintf(stderr, "Failed receiving response: "
+				    "%s\n", str_error(rc));
+				goto out;
+			}
+
+			struct timeval end;
+			getuptime(&end);
+
+			fibril_mutex_lock(&bench_lock);
+			latency[latency_count++] = tv_sub_diff(&end,
+			    &start[done]);
+			body_bytes += rsize;
+			fibril_mutex_unlock(&bench_lock);
+		}
+
+		batch = 0;
+		done = 0;
+	}
+
+out:
+	fibril_mutex_lock(&bench_lock);
+	/* Account for the unfinished part of the current batch */
+	failed += batch - done;
+	running--;
+	fibril_condvar_broadcast(&bench_cv);
+	fibril_mutex_unlock(&bench_lock);
+
+	if (http != NULL)
+		http_destroy(http);
+	if (req != NULL)
+		http_request_destroy(req);
+	free(buf);
+	free(start);
+	return rc;
+}
+
+static int latency_cmp(const void *a, const void *b)
+{
+	uint64_t la = *(const uint64_t *) a;
+	uint64_t lb = *(const uint64_t *) b;
+
+	if (la < lb)
+		return -1;
+	if (la > lb)
+		return 1;
+	return 0;
+}
+
+static uint64_t latency_percentile(unsigned int pct)
+{
+	return latency[(latency_count - 1) * pct / 100];
+}
+
+/** Parse URL into host, port and path. */
+static int bench_parse_url(const char *url)
+{
+	uri_t *uri = uri_parse(url);
+	if (uri == NULL || !uri_validate(uri)) {
+		fprintf(stderr, "Invalid URL %s\n", url);
+		goto error;
+	}
+
+	if (str_cmp(uri->scheme, "http") != 0 || uri->host == NULL) {
+		fprintf(stderr, "Only http://host[:port]/path is supported\n");
+		goto error;
+	}
+
+	if (uri->port != NULL &&
+	    str_uint16_t(uri->port, NULL, 10, true, &port) != EOK) {
+		fprintf(stderr, "Invalid port number: %s\n", uri->port);
+		goto error;
+	}
+
+	host = str_dup(uri->host);
+	path = str_dup((uri->path == NULL || *uri->path == '\0') ?
+	    "/" : uri->path);
+	uri_destroy(uri);
+
+	if (host == NULL || path == NULL)
+		return ENOMEM;
+
+	return EOK;
+error:
+	if (uri != NULL)
+		uri_destroy(uri);
+	return EINVAL;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t conns = DEFAULT_CONNS;
+	char *endptr;
+	int i;
+
+	for (i = 1; i + 1 < argc; i += 2) {
+		if (argv[i][0] != '-')
+			break;
+
+		unsigned long val = strtoul(argv[i + 1], &endptr, 10);
+		if (*endptr != '\0' || val == 0) {
+			printf("Invalid number %s\n", argv[i + 1]);
+			return 1;
+		}
+
+		if (str_cmp(argv[i], "-c") == 0) {
+			conns = val;
+		} else if (str_cmp(argv[i], "-n") == 0) {
+			requests = val;
+		} else if (str_cmp(argv[i], "-p") == 0) {
+			depth = val;
+		} else {
+			print_syntax();
+			return 1;
+		}
+	}
+
+	if (i + 1 != argc) {
+		print_syntax();
+		return 1;
+	}
+
+	if (bench_parse_url(argv[i]) != EOK)
+		return 1;
+
+	latency = calloc(requests, sizeof(uint64_t));
+	if (latency == NULL) {
+		printf("Out of memory\n");
+		return 1;
+	}
+
+	printf("%s: %zu requests to %s:%" PRIu16 "%s over %zu connections, "
+	    "pipeline depth %zu\n", NAME, requests, host, port, path, conns,
+	    depth);
+
+	struct timeval start;
+	getuptime(&start);
+
+	for (size_t c = 0; c < conns; c++) {
+		fid_t fid = fibril_create(bench_client, NULL);
+		if (fid == 0) {
+			printf("Failed creating client fibril\n");
+			break;
+		}
+
+		fibril_mutex_lock(&bench_lock);
+		running++;
+		fibril_mutex_unlock(&bench_lock);
+		fibril_add_ready(fid);
+	}
+
+	fibril_mutex_lock(&bench_lock);
+	while (running > 0)
+		fibril_condvar_wait(&bench_cv, &bench_lock);
+	fibril_mutex_unlock(&bench_lock);
+
+	struct timeval end;
+	getuptime(&end);
+
+	uint64_t usec = tv_sub_diff(&end, &start);
+	if (usec == 0)
+		usec = 1;
+
+	printf("Completed %zu requests (%zu failed) in %" PRIu64 " ms, "
+	    "%" PRIu64 " bytes of content\n", latency_count, failed,
+	    usec / 1000, body_bytes);
+	printf("Requests per second: %" PRIu64 "\n",
+	    (uint64_t) latency_count * 1000000 / usec);
+
+	if (latency_count > 0) {
+		qsort(latency, latency_count, sizeof(uint64_t), latency_cmp);
+		printf("Latency [us]: p50 %" PRIu64 ", p90 %" PRIu64 ", p99 %"
+		    PRIu64 ", max %" PRIu64 "\n", latency_percentile(50),
+		    latency_percentile(90), latency_percentile(99),
+		    latency[latency_count - 1]);
+	}
+
+	free(latency);
+	free(host);
+	free(path);
+
+	return (failed == 0 && latency_count == requests) ? 0 : 1;
+}
+
+/** @}
+ */
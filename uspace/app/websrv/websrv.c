@@ -35,6 +35,7 @@
 
 #include <errno.h>
 #include <assert.h>
+#include <fibril_synch.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -52,16 +53,42 @@
 #include <macros.h>
 #include <str.h>
 #include <str_error.h>
+#include <sys/time.h>
 
 #define NAME  "websrv"
 
 #define DEFAULT_PORT  8080
 
+/** Default limit on the number of simultaneously served connections. */
+#define DEFAULT_MAX_CONNS  64
+
+/** Connections idle for this long are closed [us]. */
+#define CONN_IDLE_TIMEOUT_USEC  (10 * 1000000)
+
+/** Maximum number of requests served on one connection. */
+#define CONN_MAX_REQUESTS  100
+
 #define WEB_ROOT  "/data/web"
 
 /** Buffer for receiving the request. */
 #define BUFFER_SIZE  1024
 
+/** Default maximum number of files kept in the file cache. */
+#define DEFAULT_CACHE_ENTRIES  32
+
+/** Files up to this size are served from the file cache. */
+#define CACHE_FILE_SIZE_MAX  (64 * 1024)
+
+/** Cached files are checked against the file system this often [us]. */
+#define CACHE_VALIDATE_USEC  1000000
+
+/**
+ * Largest part of a file handed to the TCP service in one request. The
+ * service handles our requests one by one, so other connections wait while
+ * one piece is being queued.
+ */
+#define SEND_FILE_CHUNK  (256 * 1024)
+
 static void websrv_new_conn(tcp_listener_t *, tcp_conn_t *);
 
 static tcp_listen_cb_t listen_cb = {
@@ -74,6 +101,41 @@ static tcp_cb_t conn_cb = {
 
 static uint16_t port = DEFAULT_PORT;
 
+/** Number of connections currently being served. */
+static size_t conn_count = 0;
+static size_t max_conns = DEFAULT_MAX_CONNS;
+static FIBRIL_MUTEX_INITIALIZE(conn_lock);
+
+/** Cached file
+ *
+ * The shared buffer holds the complete keep-alive response, the header
+ * followed by the file contents.
+ */
+typedef struct {
+	/** Link to cache_lru */
+	link_t link;
+	char *fname;
+	/** File identity and size at the time of loading */
+	service_id_t service_id;
+	fs_index_t index;
+	aoff64_t size;
+	/** Time of the last check against the file system */
+	struct timeval validated;
+	const char *ctype;
+	tcp_shbuf_t *shbuf;
+	size_t hdr_size;
+	/** Number of requests using the entry */
+	unsigned int refcnt;
+	/** Entry is in the cache */
+	bool cached;
+} cache_entry_t;
+
+/** File cache, most recently used entries first. */
+static LIST_INITIALIZE(cache_lru);
+static size_t cache_count = 0;
+static size_t cache_max = DEFAULT_CACHE_ENTRIES;
+static FIBRIL_MUTEX_INITIALIZE(cache_lock);
+
 typedef struct {
 	tcp_conn_t *conn;
 
@@ -87,15 +149,28 @@ typedef struct {
 
 static bool verbose = false;
 
-/** Responses to send to client. */
+/** Content types by file name extension. */
+static struct {
+	const char *ext;
+	const char *type;
+} content_types[] = {
+	{ "html", "text/html" },
+	{ "htm", "text/html" },
+	{ "txt", "text/plain" },
+	{ "css", "text/css" },
+	{ "js", "application/javascript" },
+	{ "png", "image/png" },
+	{ "jpg", "image/jpeg" },
+	{ "jpeg", "image/jpeg" },
+	{ "gif", "image/gif" },
+	{ "svg", "image/svg+xml" },
+	{ "ico", "image/x-icon" },
+	{ NULL, NULL }
+};
 
-static const char *msg_ok =
-    "HTTP/1.0 200 OK\r\n"
-    "\r\n";
+/** Bodies of error responses to send to client. */
 
 static const char *msg_bad_request =
-    "HTTP/1.0 400 Bad Request\r\n"
-    "\r\n"
     "<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\r\n"
     "<html><head>\r\n"
     "<title>400 Bad Request</title>\r\n"
@@ -107,8 +182,6 @@ static const char *msg_bad_request =
     "</html>\r\n";
 
 static const char *msg_not_found =
-    "HTTP/1.0 404 Not Found\r\n"
-    "\r\n"
     "<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\r\n"
     "<html><head>\r\n"
     "<title>404 Not Found</title>\r\n"
@@ -120,8 +193,6 @@ static const char *msg_not_found =
     "</html>\r\n";
 
 static const char *msg_not_implemented =
-    "HTTP/1.0 501 Not Implemented\r\n"
-    "\r\n"
     "<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\r\n"
     "<html><head>\r\n"
     "<title>501 Not Implemented</title>\r\n"
@@ -132,6 +203,16 @@ static const char *msg_not_implemented =
     "</body>\r\n"
     "</html>\r\n";
 
+static const char *msg_service_unavailable =
+    "<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\r\n"
+    "<html><head>\r\n"
+    "<title>503 Service Unavailable</title>\r\n"
+    "</head>\r\n"
+    "<body>\r\n"
+    "<h1>Service Unavailable</h1>\r\n"
+    "<p>The server is serving too many connections.</p>\r\n"
+    "</body>\r\n"
+    "</html>\r\n";
 
 static int recv_create(tcp_conn_t *conn, recv_t **rrecv)
 {
@@ -155,57 +236,111 @@ static void recv_destroy(recv_t *recv)
 	free(recv);
 }
 
-/** Receive one character (with buffering) */
-static int recv_char(recv_t *recv, char *c)
+/** Refill the receive buffer
+ *
+ * @return EOK on success, EEMPTY if the client closed the connection,
+ *         ETIMEOUT if the client did not send anything for too long
+ */
+static int recv_fill(recv_t *recv)
 {
 	size_t nrecv;
 	int rc;
 	
-	if (recv->rbuf_out == recv->rbuf_in) {
-		recv->rbuf_out = 0;
-		recv->rbuf_in = 0;
-		
-		rc = tcp_conn_recv_wait(recv->conn, recv->rbuf, BUFFER_SIZE, &nrecv);
-		if (rc != EOK) {
-			fprintf(stderr, "tcp_conn_recv() failed (%d)\n", rc);
-			return rc;
-		}
-		
-		recv->rbuf_in = nrecv;
+	recv->rbuf_out = 0;
+	recv->rbuf_in = 0;
+	
+	rc = tcp_conn_recv_wait_timeout(recv->conn, recv->rbuf, BUFFER_SIZE,
+	    &nrecv, CONN_IDLE_TIMEOUT_USEC);
+	if (rc == ETIMEOUT)
+		return rc;
+	if (rc != EOK) {
+		fprintf(stderr, "tcp_conn_recv() failed (%d)\n", rc);
+		return rc;
 	}
 	
-	*c = recv->rbuf[recv->rbuf_out++];
+	if (nrecv == 0)
+		return EEMPTY;
+	
+	recv->rbuf_in = nrecv;
 	return EOK;
 }
 
-/** Receive one line with length limit */
+/** Receive one line with length limit
+ *
+ * Data following the line stays buffered, so that pipelined requests
+ * are picked up by the next call. The line terminator is stripped.
+ *
+ * @return EOK on success, EEMPTY if the client closed the connection
+ *         before sending anything, ELIMIT if the line is too long
+ */
 static int recv_line(recv_t *recv, char **rbuf)
 {
-	char *bp = recv->lbuf;
-	char c = '\0';
+	size_t used = 0;
+	bool eol = false;
+	int rc;
 	
-	while (bp < recv->lbuf + BUFFER_SIZE) {
-		char prev = c;
-		int rc = recv_char(recv, &c);
-		
-		if (rc != EOK)
-			return rc;
-		
-		*bp++ = c;
-		if ((prev == '\r') && (c == '\n'))
-			break;
+	while (!eol) {
+		if (recv->rbuf_out == recv->rbuf_in) {
+			rc = recv_fill(recv);
+			if (rc == EEMPTY && used > 0)
+				return EIO;
+			if (rc != EOK)
+				return rc;
+		}
+	
+		/* Copy the run up to and including the line feed at once */
+		size_t n = 0;
+		size_t avail = recv->rbuf_in - recv->rbuf_out;
+		const char *start = recv->rbuf + recv->rbuf_out;
+		while (n < avail) {
+			if (start[n++] == '\n') {
+				eol = true;
+				break;
+			}
+		}
+	
+		if (used + n > BUFFER_SIZE)
+			return ELIMIT;
+	
+		memcpy(recv->lbuf + used, start, n);
+		used += n;
+		recv->rbuf_out += n;
 	}
 	
-	recv->lbuf_used = bp - recv->lbuf;
-	*bp = '\0';
+	/* Strip CRLF (tolerate a bare LF) */
+	used--;
+	if (used > 0 && recv->lbuf[used - 1] == '\r')
+		used--;
 	
-	if (bp == recv->lbuf + BUFFER_SIZE)
-		return ELIMIT;
+	recv->lbuf[used] = '\0';
+	recv->lbuf_used = used;
 	
 	*rbuf = recv->lbuf;
 	return EOK;
 }
 
+/** Discard request body */
+static int recv_skip(recv_t *recv, uint64_t size)
+{
+	int rc;
+	
+	while (size > 0) {
+		if (recv->rbuf_out == recv->rbuf_in) {
+			rc = recv_fill(recv);
+			if (rc == EEMPTY)
+				return EIO;
+			if (rc != EOK)
+				return rc;
+		}
+	
+		size_t n = min((uint64_t) (recv->rbuf_in - recv->rbuf_out), size);
+		recv->rbuf_out += n;
+		size -= n;
+	}
+	
+	return EOK;
+}
+
 static bool uri_is_valid(char *uri)
 {
 	if (uri[0] != '/')
@@ -225,14 +360,61 @@ static bool uri_is_valid(char *uri)
 	return true;
 }
 
-static int send_response(tcp_conn_t *conn, const char *msg)
+/** Determine content type from file name extension */
+static const char *content_type_get(const char *fname)
+{
+	const char *dot = str_rchr(fname, '.');
+	if (dot == NULL)
+		return "application/octet-stream";
+	
+	for (size_t i = 0; content_types[i].ext != NULL; i++) {
+		if (str_casecmp(dot + 1, content_types[i].ext) == 0)
+			return content_types[i].type;
+	}
+	
+	return "application/octet-stream";
+}
+
+/** Format response header
+ *
+ * @return Number of bytes written to @a buf, negative if it did not fit
+ */
+static int header_format(char *buf, size_t size, const char *status,
+    const char *ctype, uint64_t length, bool keep_alive)
+{
+	int n = snprintf(buf, size,
+	    "HTTP/1.1 %s\r\n"
+	    "Content-Type: %s\r\n"
+	    "Content-Length: %" PRIu64 "\r\n"
+	    "Connection: %s\r\n"
+	    "\r\n", status, ctype, length,
+	    keep_alive ? "keep-alive" : "close");
+	
+	if (n < 0 || (size_t) n >= size)
+		return -1;
+	
+	return n;
+}
+
+/** Send error response including a short HTML body */
+static int send_error(tcp_conn_t *conn, const char *status, const char *body,
+    bool keep_alive)
 {
-	size_t response_size = str_size(msg);
+	char hdr[256];
+	char *msg;
 	
 	if (verbose)
-	    fprintf(stderr, "Sending response\n");
+	    fprintf(stderr, "Sending response %s\n", status);
 	
-	int rc = tcp_conn_send(conn, (void *) msg, response_size);
+	if (header_format(hdr, sizeof(hdr), status, "text/html",
+	    str_size(body), keep_alive) < 0)
+		return ENOMEM;
+	
+	if (asprintf(&msg, "%s%s", hdr, body) < 0)
+		return ENOMEM;
+	
+	int rc = tcp_conn_send(conn, msg, str_size(msg));
+	free(msg);
 	if (rc != EOK) {
 		fprintf(stderr, "tcp_conn_send() failed\n");
 		return rc;
@@ -241,20 +423,220 @@ static int send_response(tcp_conn_t *conn, const char *msg)
 	return EOK;
 }
 
-static int uri_get(const char *uri, tcp_conn_t *conn)
+/** Destroy cache entry */
+static void cache_entry_destroy(cache_entry_t *entry)
 {
-	char *fbuf = NULL;
-	char *fname = NULL;
-	int rc;
+	tcp_shbuf_destroy(entry->shbuf);
+	free(entry->fname);
+	free(entry);
+}
+
+/** Remove entry from the cache
+ *
+ * @return @c true if the caller should destroy the entry
+ */
+static bool cache_remove_locked(cache_entry_t *entry)
+{
+	assert(fibril_mutex_is_locked(&cache_lock));
+	
+	if (entry->cached) {
+		list_remove(&entry->link);
+		cache_count--;
+		entry->cached = false;
+	}
+	
+	return entry->refcnt == 0;
+}
+
+/** Drop reference to cache entry, optionally removing it from the cache */
+static void cache_entry_put(cache_entry_t *entry, bool evict)
+{
+	bool destroy;
+	
+	fibril_mutex_lock(&cache_lock);
+	entry->refcnt--;
+	if (evict)
+		(void) cache_remove_locked(entry);
+	destroy = !entry->cached && entry->refcnt == 0;
+	fibril_mutex_unlock(&cache_lock);
+	
+	if (destroy)
+		cache_entry_destroy(entry);
+}
+
+/** Find cached file and take a reference to it */
+static cache_entry_t *cache_find(const char *fname)
+{
+	fibril_mutex_lock(&cache_lock);
+	
+	list_foreach(cache_lru, link, cache_entry_t, entry) {
+		if (str_cmp(entry->fname, fname) == 0) {
+			/* Move to the head of the LRU list */
+			list_remove(&entry->link);
+			list_prepend(&entry->link, &cache_lru);
+			entry->refcnt++;
+			fibril_mutex_unlock(&cache_lock);
+			return entry;
+		}
+	}
+	
+	fibril_mutex_unlock(&cache_lock);
+	return NULL;
+}
+
+/** Determine if cache entry was validated recently enough */
+static bool cache_entry_fresh(cache_entry_t *entry)
+{
+	struct timeval now;
+	
+	getuptime(&now);
+	return tv_sub_diff(&now, &entry->validated) < CACHE_VALIDATE_USEC;
+}
+
+/** Determine if cache entry still describes the file
+ *
+ * VFS does not keep modification times, the file identity and size
+ * are compared instead.
+ */
+static bool cache_entry_valid(cache_entry_t *entry, struct stat *stat)
+{
+	return entry->service_id == stat->service_id &&
+	    entry->index == stat->index && entry->size == stat->size;
+}
+
+/** Load file into a new cache entry
+ *
+ * The shared buffer receives the complete keep-alive response, so that
+ * it can be sent with a single request to the TCP service.
+ *
+ * @return EOK on success, the new entry is inserted into the cache and
+ *         a reference is returned in @a rentry
+ */
+static int cache_load(tcp_conn_t *conn, const char *fname, int fd,
+    struct stat *stat, cache_entry_t **rentry)
+{
+	char hdr[256];
+	cache_entry_t *entry;
+	cache_entry_t *old = NULL;
+	cache_entry_t *victim = NULL;
+	aoff64_t pos = 0;
 	size_t nr;
-	int fd = -1;
+	int rc;
 	
-	fbuf = calloc(BUFFER_SIZE, 1);
-	if (fbuf == NULL) {
-		rc = ENOMEM;
-		goto out;
+	const char *ctype = content_type_get(fname);
+	int hlen = header_format(hdr, sizeof(hdr), "200 OK", ctype,
+	    stat->size, true);
+	if (hlen < 0)
+		return ENOMEM;
+	
+	entry = calloc(1, sizeof(cache_entry_t));
+	if (entry == NULL)
+		return ENOMEM;
+	
+	entry->fname = str_dup(fname);
+	if (entry->fname == NULL) {
+		free(entry);
+		return ENOMEM;
+	}
+	
+	rc = tcp_shbuf_create(conn->tcp, hlen + stat->size, &entry->shbuf);
+	if (rc != EOK) {
+		free(entry->fname);
+		free(entry);
+		return rc;
+	}
+	
+	memcpy(entry->shbuf->data, hdr, hlen);
+	while (pos < stat->size) {
+		rc = vfs_read(fd, &pos, entry->shbuf->data + hlen + pos,
+		    stat->size - pos, &nr);
+		if (rc == EOK && nr == 0)
+			rc = EIO;
+		if (rc != EOK) {
+			cache_entry_destroy(entry);
+			return rc;
+		}
+	}
+	
+	link_initialize(&entry->link);
+	entry->service_id = stat->service_id;
+	entry->index = stat->index;
+	entry->size = stat->size;
+	entry->ctype = ctype;
+	entry->hdr_size = hlen;
+	getuptime(&entry->validated);
+	
+	fibril_mutex_lock(&cache_lock);
+	
+	/* Another fibril may have loaded the same file meanwhile */
+	list_foreach(cache_lru, link, cache_entry_t, e) {
+		if (str_cmp(e->fname, fname) == 0) {
+			old = e;
+			break;
+		}
+	}
+	
+	if (old != NULL && !cache_remove_locked(old))
+		old = NULL;
+	
+	if (cache_count >= cache_max) {
+		victim = list_get_instance(list_last(&cache_lru),
+		    cache_entry_t, link);
+		if (!cache_remove_locked(victim))
+			victim = NULL;
 	}
 	
+	list_prepend(&entry->link, &cache_lru);
+	cache_count++;
+	entry->cached = true;
+	entry->refcnt = 1;
+	
+	fibril_mutex_unlock(&cache_lock);
+	
+	if (old != NULL)
+		cache_entry_destroy(old);
+	if (victim != NULL)
+		cache_entry_destroy(victim);
+	
+	*rentry = entry;
+	return EOK;
+}
+
+/** Send response for a cached file */
+static int cache_entry_send(cache_entry_t *entry, tcp_conn_t *conn,
+    bool keep_alive)
+{
+	char hdr[256];
+	int rc;
+	
+	if (keep_alive) {
+		return tcp_conn_send_shbuf(conn, entry->shbuf, 0,
+		    entry->hdr_size + entry->size);
+	}
+	
+	/* The cached header announces keep-alive, send a different one */
+	int hlen = header_format(hdr, sizeof(hdr), "200 OK", entry->ctype,
+	    entry->size, false);
+	if (hlen < 0)
+		return ENOMEM;
+	
+	rc = tcp_conn_send(conn, hdr, hlen);
+	if (rc != EOK)
+		return rc;
+	
+	return tcp_conn_send_shbuf(conn, entry->shbuf, entry->hdr_size,
+	    entry->size);
+}
+
+static int uri_get(const char *uri, tcp_conn_t *conn, bool keep_alive)
+{
+	char hdr[256];
+	char *fname = NULL;
+	cache_entry_t *entry = NULL;
+	int rc;
+	int fd = -1;
+	struct stat stat;
+	
 	if (str_cmp(uri, "/") == 0)
 		uri = "/index.html";
 	
@@ -264,79 +646,234 @@ static int uri_get(const char *uri, tcp_conn_t *conn)
 		goto out;
 	}
 	
+	entry = cache_find(fname);
+	if (entry != NULL && cache_entry_fresh(entry))
+		goto send_cached;
+	
 	fd = vfs_lookup_open(fname, WALK_REGULAR, MODE_READ);
 	if (fd < 0) {
-		rc = send_response(conn, msg_not_found);
+		if (entry != NULL) {
+			cache_entry_put(entry, true);
+			entry = NULL;
+		}
+	
+		rc = send_error(conn, "404 Not Found", msg_not_found,
+		    keep_alive);
 		goto out;
 	}
 	
-	free(fname);
-	fname = NULL;
-	
-	rc = send_response(conn, msg_ok);
+	rc = vfs_stat(fd, &stat);
 	if (rc != EOK)
 		goto out;
 	
+	if (entry != NULL) {
+		if (cache_entry_valid(entry, &stat)) {
+			getuptime(&entry->validated);
+			goto send_cached;
+		}
+	
+		cache_entry_put(entry, true);
+		entry = NULL;
+	}
+	
+	if (cache_max > 0 && stat.size <= CACHE_FILE_SIZE_MAX) {
+		rc = cache_load(conn, fname, fd, &stat, &entry);
+		if (rc == EOK)
+			goto send_cached;
+		entry = NULL;
+	}
+	
+	/* Too large or not cacheable, let the TCP service read the file */
+	int hlen = header_format(hdr, sizeof(hdr), "200 OK",
+	    content_type_get(fname), stat.size, keep_alive);
+	if (hlen < 0) {
+		rc = ENOMEM;
+		goto out;
+	}
+	
+	rc = tcp_conn_send(conn, hdr, hlen);
+	if (rc != EOK) {
+		fprintf(stderr, "tcp_conn_send() failed\n");
+		goto out;
+	}
+	
+	/* Send in pieces, the request carries the size in a single argument */
 	aoff64_t pos = 0;
-	while (true) {
-		rc = vfs_read(fd, &pos, fbuf, BUFFER_SIZE, &nr);
-		if (rc != EOK)
-			goto out;
-		
-		if (nr == 0)
-			break;
-		
-		rc = tcp_conn_send(conn, fbuf, nr);
+	while (pos < stat.size) {
+		size_t chunk = min(stat.size - pos, (aoff64_t) SEND_FILE_CHUNK);
+	
+		rc = tcp_conn_send_file(conn, fd, pos, chunk);
 		if (rc != EOK) {
-			fprintf(stderr, "tcp_conn_send() failed\n");
+			fprintf(stderr, "tcp_conn_send_file() failed\n");
 			goto out;
 		}
+	
+		pos += chunk;
 	}
 	
 	rc = EOK;
+	goto out;
+
+send_cached:
+	rc = cache_entry_send(entry, conn, keep_alive);
+	if (rc != EOK)
+		fprintf(stderr, "tcp_conn_send_shbuf() failed\n");
 out:
+	if (entry != NULL)
+		cache_entry_put(entry, false);
 	if (fd >= 0)
 		vfs_put(fd);
 	free(fname);
-	free(fbuf);
 	return rc;
 }
 
-static int req_process(tcp_conn_t *conn, recv_t *recv)
+/** Parse the value of the Connection header */
+static void conn_hdr_parse(char *value, bool *keep_alive)
 {
-	char *reqline = NULL;
+	char *next;
+	char *tok = str_tok(value, ", \t", &next);
+	
+	while (tok != NULL) {
+		if (str_casecmp(tok, "close") == 0)
+			*keep_alive = false;
+		else if (str_casecmp(tok, "keep-alive") == 0)
+			*keep_alive = true;
+	
+		tok = str_tok(next, ", \t", &next);
+	}
+}
 
+/** Receive and process one request
+ *
+ * The request line and all header lines are consumed, along with the body
+ * if the request announces one, so that the next pipelined request can
+ * follow on the same connection.
+ *
+ * @param conn       Connection
+ * @param recv       Receive buffer
+ * @param last       The connection is closed after this request
+ * @param keep_alive Place to store whether the connection should persist
+ *
+ * @return EOK on success, EEMPTY if the client closed the connection
+ *         between requests, ETIMEOUT if the connection was idle for too
+ *         long, other error code on failure
+ */
+static int req_process(tcp_conn_t *conn, recv_t *recv, bool last,
+    bool *keep_alive)
+{
+	char *reqline = NULL;
+	char *method = NULL;
+	char *uri;
+	uint64_t body_size = 0;
+	bool bad_request = false;
+	char *line;
+	
+	*keep_alive = false;
+	
 	int rc = recv_line(recv, &reqline);
+	if (rc == EEMPTY || rc == ETIMEOUT)
+		return rc;
 	if (rc != EOK) {
 		fprintf(stderr, "recv_line() failed\n");
 		return rc;
 	}
 	
 	if (verbose)
-		fprintf(stderr, "Request: %s", reqline);
+		fprintf(stderr, "Request: %s\n", reqline);
 	
-	if (str_lcmp(reqline, "GET ", 4) != 0) {
-		rc = send_response(conn, msg_not_implemented);
-		return rc;
+	/* The line buffer is reused for headers, keep a copy */
+	method = str_dup(reqline);
+	if (method == NULL)
+		return ENOMEM;
+	
+	uri = str_chr(method, ' ');
+	if (uri == NULL) {
+		bad_request = true;
+		uri = method + str_size(method);
+	} else {
+		*uri++ = '\0';
 	}
 	
-	char *uri = reqline + 4;
-	char *end_uri = str_chr(uri, ' ');
-	if (end_uri == NULL) {
-		end_uri = reqline + str_size(reqline) - 2;
-		assert(*end_uri == '\r');
+	char *version = str_chr(uri, ' ');
+	if (version != NULL) {
+		*version++ = '\0';
+		/* Persistent connections are the default since HTTP/1.1 */
+		if (str_cmp(version, "HTTP/1.0") == 0)
+			*keep_alive = false;
+		else if (str_lcmp(version, "HTTP/1.", 7) == 0)
+			*keep_alive = true;
+		else
+			bad_request = true;
+	
+		/* Request headers follow up to an empty line */
+		while (true) {
+			rc = recv_line(recv, &line);
+			if (rc == EEMPTY)
+				rc = EIO;
+			if (rc != EOK) {
+				fprintf(stderr, "recv_line() failed\n");
+				goto out;
+			}
+	
+			if (*line == '\0')
+				break;
+	
+			char *value = str_chr(line, ':');
+			if (value == NULL) {
+				bad_request = true;
+				continue;
+			}
+	
+			*value++ = '\0';
+	
+			if (str_casecmp(line, "Connection") == 0) {
+				conn_hdr_parse(value, keep_alive);
+			} else if (str_casecmp(line, "Content-Length") == 0) {
+				while (*value == ' ' || *value == '\t')
+					value++;
+				if (str_uint64_t(value, NULL, 10, false,
+				    &body_size) != EOK)
+					bad_request = true;
+			} else if (str_casecmp(line, "Transfer-Encoding") == 0) {
+				/* We cannot find the end of a chunked body */
+				*keep_alive = false;
+			}
+		}
+	}
+	
+	if (last)
+		*keep_alive = false;
+	
+	if (bad_request) {
+		rc = send_error(conn, "400 Bad Request", msg_bad_request,
+		    false);
+		*keep_alive = false;
+		goto out;
+	}
+	
+	rc = recv_skip(recv, body_size);
+	if (rc != EOK)
+		goto out;
+	
+	if (str_cmp(method, "GET") != 0) {
+		rc = send_error(conn, "501 Not Implemented",
+		    msg_not_implemented, *keep_alive);
+		goto out;
 	}
 	
-	*end_uri = '\0';
 	if (verbose)
 		fprintf(stderr, "Requested URI: %s\n", uri);
 	
 	if (!uri_is_valid(uri)) {
-		rc = send_response(conn, msg_bad_request);
-		return rc;
+		rc = send_error(conn, "400 Bad Request", msg_bad_request,
+		    *keep_alive);
+		goto out;
 	}
 	
-	return uri_get(uri, conn);
+	rc = uri_get(uri, conn, *keep_alive);
+out:
+	free(method);
+	return rc;
 }
 
 static void usage(void)
@@ -349,6 +886,14 @@ static void usage(void)
 	    "-p port_number | --port=port_number\n"
 	    "\tListening port (default " STRING(DEFAULT_PORT) ").\n"
 	    "\n"
+	    "-c count | --max-conn=count\n"
+	    "\tMaximum number of simultaneous connections (default "
+	    STRING(DEFAULT_MAX_CONNS) ").\n"
+	    "\n"
+	    "-C count | --cache=count\n"
+	    "\tMaximum number of cached files, 0 disables the cache (default "
+	    STRING(DEFAULT_CACHE_ENTRIES) ").\n"
+	    "\n"
 	    "-h | --help\n"
 	    "\tShow this application help.\n"
 	    "-v | --verbose\n"
@@ -361,6 +906,26 @@ static int parse_option(int argc, char *argv[], int *index)
 	int rc;
 	
 	switch (argv[*index][1]) {
+	case 'c':
+		rc = arg_parse_int(argc, argv, index, &value, 0);
+		if (rc != EOK)
+			return rc;
+	
+		if (value <= 0)
+			return EINVAL;
+	
+		max_conns = (size_t) value;
+		break;
+	case 'C':
+		rc = arg_parse_int(argc, argv, index, &value, 0);
+		if (rc != EOK)
+			return rc;
+	
+		if (value < 0)
+			return EINVAL;
+	
+		cache_max = (size_t) value;
+		break;
 	case 'h':
 		usage();
 		exit(0);
@@ -369,7 +934,7 @@ static int parse_option(int argc, char *argv[], int *index)
 		rc = arg_parse_int(argc, argv, index, &value, 0);
 		if (rc != EOK)
 			return rc;
-		
+	
 		port = (uint16_t) value;
 		break;
 	case 'v':
@@ -384,8 +949,26 @@ static int parse_option(int argc, char *argv[], int *index)
 			rc = arg_parse_int(argc, argv, index, &value, 7);
 			if (rc != EOK)
 				return rc;
-			
+	
 			port = (uint16_t) value;
+		} else if (str_lcmp(argv[*index] + 2, "max-conn=", 9) == 0) {
+			rc = arg_parse_int(argc, argv, index, &value, 11);
+			if (rc != EOK)
+				return rc;
+	
+			if (value <= 0)
+				return EINVAL;
+	
+			max_conns = (size_t) value;
+		} else if (str_lcmp(argv[*index] + 2, "cache=", 6) == 0) {
+			rc = arg_parse_int(argc, argv, index, &value, 8);
+			if (rc != EOK)
+				return rc;
+	
+			if (value < 0)
+				return EINVAL;
+	
+			cache_max = (size_t) value;
 		} else if (str_cmp(argv[*index] +2, "verbose") == 0) {
 			verbose = true;
 		} else {
@@ -405,6 +988,27 @@ static void websrv_new_conn(tcp_listener_t *lst, tcp_conn_t *conn)
 {
 	int rc;
 	recv_t *recv = NULL;
+	bool keep_alive;
+	unsigned int requests = 0;
+	
+	fibril_mutex_lock(&conn_lock);
+	if (conn_count >= max_conns) {
+		fibril_mutex_unlock(&conn_lock);
+	
+		if (verbose)
+			fprintf(stderr, "Too many connections, rejecting\n");
+	
+		rc = send_error(conn, "503 Service Unavailable",
+		    msg_service_unavailable, false);
+		if (rc == EOK)
+			rc = tcp_conn_send_fin(conn);
+		if (rc != EOK)
+			(void) tcp_conn_reset(conn);
+		return;
+	}
+	
+	conn_count++;
+	fibril_mutex_unlock(&conn_lock);
 	
 	if (verbose)
 		fprintf(stderr, "New connection, waiting for request\n");
@@ -415,27 +1019,47 @@ static void websrv_new_conn(tcp_listener_t *lst, tcp_conn_t *conn)
 		goto error;
 	}
 	
-	rc = req_process(conn, recv);
-	if (rc != EOK) {
-		fprintf(stderr, "Error processing request (%s)\n",
-		    str_error(rc));
-		goto error;
-	}
+	/* Serve requests until the client or the protocol ends the session */
+	do {
+		rc = req_process(conn, recv, ++requests >= CONN_MAX_REQUESTS,
+		    &keep_alive);
+		if (rc == EEMPTY) {
+			if (verbose)
+				fprintf(stderr, "Connection closed by client\n");
+			break;
+		}
+	
+		if (rc == ETIMEOUT) {
+			if (verbose)
+				fprintf(stderr, "Connection idle, closing\n");
+			break;
+		}
+	
+		if (rc != EOK) {
+			fprintf(stderr, "Error processing request (%s)\n",
+			    str_error(rc));
+			goto error;
+		}
+	} while (keep_alive);
 	
 	rc = tcp_conn_send_fin(conn);
 	if (rc != EOK) {
 		fprintf(stderr, "Error sending FIN.\n");
 		goto error;
 	}
-
+	
 	recv_destroy(recv);
-	return;
+	goto out;
 error:
 	rc = tcp_conn_reset(conn);
 	if (rc != EOK)
 		fprintf(stderr, "Error resetting connection.\n");
 	
 	recv_destroy(recv);
+out:
+	fibril_mutex_lock(&conn_lock);
+	conn_count--;
+	fibril_mutex_unlock(&conn_lock);
 }
 
 int main(int argc, char *argv[])
@@ -458,19 +1082,19 @@ int main(int argc, char *argv[])
 	}
 	
 	printf("%s: HelenOS web server\n", NAME);
-
+	
 	if (verbose)
 		fprintf(stderr, "Creating listener\n");
 	
 	inet_ep_init(&ep);
 	ep.port = port;
-
+	
 	rc = tcp_create(&tcp);
 	if (rc != EOK) {
 		fprintf(stderr, "Error initializing TCP.\n");
 		return 1;
 	}
-
+	
 	rc = tcp_listener_create(tcp, &ep, &listen_cb, NULL, &conn_cb, NULL,
 	    &lst);
 	if (rc != EOK) {
@@ -480,7 +1104,7 @@ int main(int argc, char *argv[])
 	
 	fprintf(stderr, "%s: Listening for connections at port %" PRIu16 "\n",
 	    NAME, port);
-
+	
 	task_retval(0);
 	async_manager();
 	
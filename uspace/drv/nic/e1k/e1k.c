@@ -54,9 +54,22 @@
 
 #define E1000_DEFAULT_INTERRUPT_INTERVAL_USEC  250
 
-/* Must be power of 8 */
-#define E1000_RX_FRAME_COUNT  128
-#define E1000_TX_FRAME_COUNT  128
+/*
+ * Default descriptor ring sizes, must be multiples of 8. The actual sizes
+ * are chosen per device in e1000_device_initialize().
+ */
+#define E1000_RX_FRAME_COUNT  256
+#define E1000_TX_FRAME_COUNT  256
+
+/* Ring sizes for the PCI Express devices */
+#define E1000_PCIE_RX_FRAME_COUNT  1024
+#define E1000_PCIE_TX_FRAME_COUNT  512
+
+/**
+ * Number of spare RX buffers. Received frames are passed up in the RX
+ * buffers themselves, while a spare buffer takes their place in the ring.
+ */
+#define E1000_RX_SPARE_COUNT  64
 
 #define E1000_RECEIVE_ADDRESS  16
 
@@ -65,6 +78,9 @@
 /** Maximum receiving frame size */
 #define E1000_MAX_RECEIVE_FRAME_SIZE  2048
 
+/** Number of RX buffers sharing one DMA area */
+#define E1000_RX_BUFFERS_PER_AREA  (PAGE_SIZE / E1000_MAX_RECEIVE_FRAME_SIZE)
+
 /** nic_driver_data_t* -> e1000_t* cast */
 #define DRIVER_DATA_NIC(nic) \
 	((e1000_t *) nic_get_specific(nic))
@@ -113,6 +129,14 @@
 #define E1000_REG_WRITE(e1000, reg, value) \
 	(pio_write_32(E1000_REG_ADDR(e1000, reg), value))
 
+/** RX buffer */
+typedef struct {
+	/** Physical address */
+	uintptr_t phys;
+	/** Virtual address */
+	void *virt;
+} e1000_rx_buffer_t;
+
 /** E1000 device data */
 typedef struct {
 	/** DDF device */
@@ -142,10 +166,18 @@ typedef struct {
 	/** Virtual rx ring address */
 	void *rx_ring_virt;
 	
-	/** Ring of RX frames, physical address */
-	uintptr_t *rx_frame_phys;
-	/** Ring of RX frames, virtual address */
-	void **rx_frame_virt;
+	/** All RX buffers */
+	e1000_rx_buffer_t *rx_buffers;
+	/** Number of RX buffers */
+	size_t rx_buffer_count;
+	/** RX buffer used by each receive descriptor */
+	e1000_rx_buffer_t **rx_frame_buffer;
+	/** Stack of spare RX buffers */
+	e1000_rx_buffer_t **rx_spare;
+	/** Number of spare RX buffers */
+	size_t rx_spare_count;
+	/** Lock for the spare RX buffers */
+	fibril_mutex_t rx_spare_lock;
 	
 	/** VLAN tag */
 	uint16_t vlan_tag;
@@ -168,6 +200,9 @@ typedef struct {
 	/** Lock for receiver */
 	fibril_mutex_t rx_lock;
 	
+	/** Receive interrupts disabled by the NAPI-style polling */
+	bool rx_irq_masked;
+	
 	/** Lock for transmitter */
 	fibril_mutex_t tx_lock;
 	
@@ -1082,7 +1117,7 @@ static int e1000_vlan_set_tag(ddf_fun_t *fun, uint16_t tag, bool add,
 
 /** Fill receive descriptor with new empty buffer
  *
- * Store frame in e1000->rx_frame_phys
+ * Use the buffer in e1000->rx_frame_buffer
  *
  * @param nic    NIC data stricture
  * @param offset Receive descriptor offset
@@ -1095,7 +1130,8 @@ static void e1000_fill_new_rx_descriptor(nic_t *nic, size_t offset)
 	e1000_rx_descriptor_t *rx_descriptor = (e1000_rx_descriptor_t *)
 	    (e1000->rx_ring_virt + offset * sizeof(e1000_rx_descriptor_t));
 	
-	rx_descriptor->phys_addr = PTR_TO_U64(e1000->rx_frame_phys[offset]);
+	rx_descriptor->phys_addr =
+	    PTR_TO_U64(e1000->rx_frame_buffer[offset]->phys);
 	rx_descriptor->length = 0;
 	rx_descriptor->checksum = 0;
 	rx_descriptor->status = 0;
@@ -1159,54 +1195,123 @@ static uint32_t e1000_inc_tail(uint32_t tail, uint32_t descriptors_count)
 		return tail + 1;
 }
 
+/** Take a spare RX buffer
+ *
+ * @param e1000 E1000 data
+ *
+ * @return Spare RX buffer or NULL if there is none
+ *
+ */
+static e1000_rx_buffer_t *e1000_rx_spare_get(e1000_t *e1000)
+{
+	e1000_rx_buffer_t *buffer = NULL;
+	
+	fibril_mutex_lock(&e1000->rx_spare_lock);
+	if (e1000->rx_spare_count > 0)
+		buffer = e1000->rx_spare[--e1000->rx_spare_count];
+	fibril_mutex_unlock(&e1000->rx_spare_lock);
+	
+	return buffer;
+}
+
+/** Return a spare RX buffer
+ *
+ * @param e1000  E1000 data
+ * @param buffer RX buffer not used by any descriptor nor frame
+ *
+ */
+static void e1000_rx_spare_put(e1000_t *e1000, e1000_rx_buffer_t *buffer)
+{
+	fibril_mutex_lock(&e1000->rx_spare_lock);
+	assert(e1000->rx_spare_count < E1000_RX_SPARE_COUNT);
+	e1000->rx_spare[e1000->rx_spare_count++] = buffer;
+	fibril_mutex_unlock(&e1000->rx_spare_lock);
+}
+
+/** Recycle the RX buffer of a released frame
+ *
+ * @param nic   NIC data
+ * @param frame Frame allocated by nic_alloc_frame_buffer()
+ *
+ */
+static void e1000_rx_buffer_release(nic_t *nic, nic_frame_t *frame)
+{
+	e1000_rx_spare_put(DRIVER_DATA_NIC(nic), frame->release_arg);
+}
+
 /** Receive frames
  *
- * @param nic NIC data
+ * @param nic    NIC data
+ * @param budget Maximal number of frames to receive
+ *
+ * @return Number of frames taken from the receive ring
  *
  */
-static void e1000_receive_frames(nic_t *nic)
+static size_t e1000_receive_frames(nic_t *nic, size_t budget)
 {
+	size_t received = 0;
 	e1000_t *e1000 = DRIVER_DATA_NIC(nic);
 	
 	fibril_mutex_lock(&e1000->rx_lock);
 	
+	unsigned int count = e1000->info.rx_frame_count;
 	uint32_t *tail_addr = E1000_REG_ADDR(e1000, E1000_RDT);
-	uint32_t next_tail = e1000_inc_tail(*tail_addr, E1000_RX_FRAME_COUNT);
+	uint32_t next_tail = e1000_inc_tail(*tail_addr, count);
 	
 	e1000_rx_descriptor_t *rx_descriptor = (e1000_rx_descriptor_t *)
 	    (e1000->rx_ring_virt + next_tail * sizeof(e1000_rx_descriptor_t));
 	
-	while (rx_descriptor->status & 0x01) {
+	while ((received < budget) && (rx_descriptor->status & 0x01)) {
 		uint32_t frame_size = rx_descriptor->length - E1000_CRC_SIZE;
+		e1000_rx_buffer_t *buffer = e1000->rx_frame_buffer[next_tail];
+		e1000_rx_buffer_t *spare = e1000_rx_spare_get(e1000);
+		nic_frame_t *frame = NULL;
 		
-		nic_frame_t *frame = nic_alloc_frame(nic, frame_size);
-		if (frame != NULL) {
-			memcpy(frame->data, e1000->rx_frame_virt[next_tail], frame_size);
-			nic_received_frame(nic, frame);
+		if (spare != NULL) {
+			/* Pass the buffer up, the spare one takes its place */
+			frame = nic_alloc_frame_buffer(nic, buffer->virt,
+			    frame_size, e1000_rx_buffer_release, buffer);
+			if (frame != NULL)
+				e1000->rx_frame_buffer[next_tail] = spare;
+			else
+				e1000_rx_spare_put(e1000, spare);
 		} else {
-			ddf_msg(LVL_ERROR, "Memory allocation failed. Frame dropped.");
+			/* All spare buffers are in use, copy the frame */
+			frame = nic_alloc_frame(nic, frame_size);
+			if (frame != NULL)
+				memcpy(frame->data, buffer->virt, frame_size);
 		}
 		
 		e1000_fill_new_rx_descriptor(nic, next_tail);
 		
-		*tail_addr = e1000_inc_tail(*tail_addr, E1000_RX_FRAME_COUNT);
-		next_tail = e1000_inc_tail(*tail_addr, E1000_RX_FRAME_COUNT);
+		if (frame != NULL)
+			nic_received_frame(nic, frame);
+		else
+			ddf_msg(LVL_ERROR, "Memory allocation failed. Frame dropped.");
+		
+		*tail_addr = e1000_inc_tail(*tail_addr, count);
+		next_tail = e1000_inc_tail(*tail_addr, count);
 		
 		rx_descriptor = (e1000_rx_descriptor_t *)
 		    (e1000->rx_ring_virt + next_tail * sizeof(e1000_rx_descriptor_t));
+		received++;
 	}
 	
 	fibril_mutex_unlock(&e1000->rx_lock);
+	return received;
 }
 
 /** Enable E1000 interupts
+ *
+ * The receive interrupts stay disabled while the NIC is being polled.
  *
  * @param e1000 E1000 data structure
  *
  */
 static void e1000_enable_interrupts(e1000_t *e1000)
 {
-	E1000_REG_WRITE(e1000, E1000_IMS, ICR_RXT0);
+	if (!e1000->rx_irq_masked)
+		E1000_REG_WRITE(e1000, E1000_IMS, ICR_RXT0);
 }
 
 /** Disable E1000 interupts
@@ -1216,22 +1321,25 @@ static void e1000_enable_interrupts(e1000_t *e1000)
  */
 static void e1000_disable_interrupts(e1000_t *e1000)
 {
-	E1000_REG_WRITE(e1000, E1000_IMS, 0);
+	E1000_REG_WRITE(e1000, E1000_IMC, ICR_RXT0);
 }
 
-/** Interrupt handler implementation
+/** Enable or disable the receive interrupts for the NAPI-style polling
  *
- * This function is called from e1000_interrupt_handler()
- * and e1000_poll()
- *
- * @param nic NIC data
- * @param icr ICR register value
+ * @param nic    NIC data
+ * @param enable Enable (true) or disable (false) the interrupts
  *
  */
-static void e1000_interrupt_handler_impl(nic_t *nic, uint32_t icr)
+static void e1000_napi_irq(nic_t *nic, bool enable)
 {
-	if (icr & ICR_RXT0)
-		e1000_receive_frames(nic);
+	e1000_t *e1000 = DRIVER_DATA_NIC(nic);
+	
+	e1000->rx_irq_masked = !enable;
+	
+	if (!enable)
+		e1000_disable_interrupts(e1000);
+	else if (nic_query_poll_mode(nic, NULL) != NIC_POLL_ON_DEMAND)
+		e1000_enable_interrupts(e1000);
 }
 
 /** Handle device interrupt
@@ -1247,7 +1355,9 @@ static void e1000_interrupt_handler(ipc_call_t *icall,
 	nic_t *nic = NIC_DATA_DEV(dev);
 	e1000_t *e1000 = DRIVER_DATA_NIC(nic);
 	
-	e1000_interrupt_handler_impl(nic, icr);
+	if (icr & ICR_RXT0)
+		nic_napi_interrupt(nic);
+	
 	e1000_enable_interrupts(e1000);
 }
 
@@ -1293,7 +1403,8 @@ static void e1000_poll(nic_t *nic)
 	assert(e1000);
 	
 	uint32_t icr = E1000_REG_READ(e1000, E1000_ICR);
-	e1000_interrupt_handler_impl(nic, icr);
+	if (icr & ICR_RXT0)
+		e1000_receive_frames(nic, SIZE_MAX);
 }
 
 /** Calculates ITR register interrupt from timeval structure
@@ -1353,16 +1464,112 @@ static int e1000_poll_mode_change(nic_t *nic, nic_poll_mode_t mode,
  */
 static void e1000_initialize_rx_registers(e1000_t *e1000)
 {
-	E1000_REG_WRITE(e1000, E1000_RDLEN, E1000_RX_FRAME_COUNT * 16);
+	E1000_REG_WRITE(e1000, E1000_RDLEN, e1000->info.rx_frame_count * 16);
 	E1000_REG_WRITE(e1000, E1000_RDH, 0);
 	
 	/* It is not posible to let HW use all descriptors */
-	E1000_REG_WRITE(e1000, E1000_RDT, E1000_RX_FRAME_COUNT - 1);
+	E1000_REG_WRITE(e1000, E1000_RDT, e1000->info.rx_frame_count - 1);
 	
 	/* Set Broadcast Enable Bit */
 	E1000_REG_WRITE(e1000, E1000_RCTL, RCTL_BAM);
 }
 
+/** Free RX buffers
+ *
+ * @param e1000 E1000 data
+ *
+ */
+static void e1000_free_rx_buffers(e1000_t *e1000)
+{
+	if (e1000->rx_buffers != NULL) {
+		/* Unmap the DMA areas, each starts with its first buffer */
+		for (size_t i = 0; i < e1000->rx_buffer_count;
+		    i += E1000_RX_BUFFERS_PER_AREA) {
+			if (e1000->rx_buffers[i].virt != NULL)
+				dmamem_unmap_anonymous(e1000->rx_buffers[i].virt);
+		}
+		
+		free(e1000->rx_buffers);
+		e1000->rx_buffers = NULL;
+	}
+	
+	if (e1000->rx_frame_buffer != NULL) {
+		free(e1000->rx_frame_buffer);
+		e1000->rx_frame_buffer = NULL;
+	}
+	
+	if (e1000->rx_spare != NULL) {
+		free(e1000->rx_spare);
+		e1000->rx_spare = NULL;
+	}
+	
+	e1000->rx_buffer_count = 0;
+	e1000->rx_spare_count = 0;
+}
+
+/** Allocate RX buffers
+ *
+ * Allocate a buffer for each receive descriptor and E1000_RX_SPARE_COUNT
+ * spare ones.
+ *
+ * @param e1000 E1000 data
+ *
+ * @return EOK if succeed
+ * @return Negative error code otherwise
+ *
+ */
+static int e1000_alloc_rx_buffers(e1000_t *e1000)
+{
+	unsigned int count = e1000->info.rx_frame_count;
+	size_t buffer_count = ALIGN_UP(count + E1000_RX_SPARE_COUNT,
+	    E1000_RX_BUFFERS_PER_AREA);
+	
+	e1000->rx_buffers = calloc(buffer_count, sizeof(e1000_rx_buffer_t));
+	e1000->rx_frame_buffer = calloc(count, sizeof(e1000_rx_buffer_t *));
+	e1000->rx_spare = calloc(E1000_RX_SPARE_COUNT,
+	    sizeof(e1000_rx_buffer_t *));
+	if ((e1000->rx_buffers == NULL) || (e1000->rx_frame_buffer == NULL) ||
+	    (e1000->rx_spare == NULL)) {
+		e1000_free_rx_buffers(e1000);
+		return ENOMEM;
+	}
+	
+	e1000->rx_buffer_count = buffer_count;
+	
+	for (size_t i = 0; i < buffer_count; i += E1000_RX_BUFFERS_PER_AREA) {
+		uintptr_t area_phys;
+		void *area_virt = AS_AREA_ANY;
+		
+		int rc = dmamem_map_anonymous(PAGE_SIZE,
+		    DMAMEM_4GiB, AS_AREA_READ | AS_AREA_WRITE, 0,
+		    &area_phys, &area_virt);
+		if (rc != EOK) {
+			e1000_free_rx_buffers(e1000);
+			return rc;
+		}
+		
+		for (size_t j = 0; j < E1000_RX_BUFFERS_PER_AREA; j++) {
+			size_t offset = j * E1000_MAX_RECEIVE_FRAME_SIZE;
+			
+			e1000->rx_buffers[i + j].phys = area_phys + offset;
+			e1000->rx_buffers[i + j].virt = area_virt + offset;
+		}
+	}
+	
+	for (size_t i = 0; i < count; i++)
+		e1000->rx_frame_buffer[i] = &e1000->rx_buffers[i];
+	
+	/* The buffers left over by the rounding are spare ones as well */
+	for (size_t i = count; i < buffer_count; i++) {
+		if (e1000->rx_spare_count < E1000_RX_SPARE_COUNT) {
+			e1000->rx_spare[e1000->rx_spare_count++] =
+			    &e1000->rx_buffers[i];
+		}
+	}
+	
+	return EOK;
+}
+
 /** Initialize receive structure
  *
  * @param nic NIC data
@@ -1378,69 +1585,34 @@ static int e1000_initialize_rx_structure(nic_t *nic)
 	
 	e1000->rx_ring_virt = AS_AREA_ANY;
 	int rc = dmamem_map_anonymous(
-	    E1000_RX_FRAME_COUNT * sizeof(e1000_rx_descriptor_t),
+	    e1000->info.rx_frame_count * sizeof(e1000_rx_descriptor_t),
 	    DMAMEM_4GiB, AS_AREA_READ | AS_AREA_WRITE, 0,
 	    &e1000->rx_ring_phys, &e1000->rx_ring_virt);
-	if (rc != EOK)
+	if (rc != EOK) {
+		fibril_mutex_unlock(&e1000->rx_lock);
 		return rc;
+	}
 	
 	E1000_REG_WRITE(e1000, E1000_RDBAH,
 	    (uint32_t) (PTR_TO_U64(e1000->rx_ring_phys) >> 32));
 	E1000_REG_WRITE(e1000, E1000_RDBAL,
 	    (uint32_t) PTR_TO_U64(e1000->rx_ring_phys));
 	
-	e1000->rx_frame_phys = (uintptr_t *)
-	    calloc(E1000_RX_FRAME_COUNT, sizeof(uintptr_t));
-	e1000->rx_frame_virt =
-	    calloc(E1000_RX_FRAME_COUNT, sizeof(void *));
-	if ((e1000->rx_frame_phys == NULL) || (e1000->rx_frame_virt == NULL)) {
-		rc = ENOMEM;
-		goto error;
-	}
-	
-	for (size_t i = 0; i < E1000_RX_FRAME_COUNT; i++) {
-		uintptr_t frame_phys;
-		void *frame_virt = AS_AREA_ANY;
-		
-		rc = dmamem_map_anonymous(E1000_MAX_SEND_FRAME_SIZE,
-		    DMAMEM_4GiB, AS_AREA_READ | AS_AREA_WRITE, 0,
-		    &frame_phys, &frame_virt);
-		if (rc != EOK)
-			goto error;
-		
-		e1000->rx_frame_phys[i] = frame_phys;
-		e1000->rx_frame_virt[i] = frame_virt;
+	rc = e1000_alloc_rx_buffers(e1000);
+	if (rc != EOK) {
+		dmamem_unmap_anonymous(e1000->rx_ring_virt);
+		fibril_mutex_unlock(&e1000->rx_lock);
+		return rc;
 	}
 	
 	/* Write descriptor */
-	for (size_t i = 0; i < E1000_RX_FRAME_COUNT; i++)
+	for (size_t i = 0; i < e1000->info.rx_frame_count; i++)
 		e1000_fill_new_rx_descriptor(nic, i);
 	
 	e1000_initialize_rx_registers(e1000);
 	
 	fibril_mutex_unlock(&e1000->rx_lock);
 	return EOK;
-	
-error:
-	for (size_t i = 0; i < E1000_RX_FRAME_COUNT; i++) {
-		if (e1000->rx_frame_virt[i] != NULL) {
-			dmamem_unmap_anonymous(e1000->rx_frame_virt[i]);
-			e1000->rx_frame_phys[i] = 0;
-			e1000->rx_frame_virt[i] = NULL;
-		}
-	}
-	
-	if (e1000->rx_frame_phys != NULL) {
-		free(e1000->rx_frame_phys);
-		e1000->rx_frame_phys = NULL;
-	}
-	
-	if (e1000->rx_frame_virt != NULL) {
-		free(e1000->rx_frame_virt);
-		e1000->rx_frame_virt = NULL;
-	}
-	
-	return rc;
 }
 
 /** Uninitialize receive structure
@@ -1452,18 +1624,7 @@ static void e1000_uninitialize_rx_structure(nic_t *nic)
 {
 	e1000_t *e1000 = DRIVER_DATA_NIC(nic);
 	
-	/* Write descriptor */
-	for (unsigned int offset = 0; offset < E1000_RX_FRAME_COUNT; offset++) {
-		dmamem_unmap_anonymous(e1000->rx_frame_virt[offset]);
-		e1000->rx_frame_phys[offset] = 0;
-		e1000->rx_frame_virt[offset] = NULL;
-	}
-	
-	free(e1000->rx_frame_virt);
-	
-	e1000->rx_frame_phys = NULL;
-	e1000->rx_frame_virt = NULL;
-	
+	e1000_free_rx_buffers(e1000);
 	dmamem_unmap_anonymous(e1000->rx_ring_virt);
 }
 
@@ -1476,7 +1637,7 @@ static void e1000_clear_rx_ring(e1000_t *e1000)
 {
 	/* Write descriptor */
 	for (unsigned int offset = 0;
-	    offset < E1000_RX_FRAME_COUNT;
+	    offset < e1000->info.rx_frame_count;
 	    offset++)
 		e1000_clear_rx_descriptor(e1000, offset);
 }
@@ -1545,7 +1706,7 @@ static void e1000_initialize_registers(e1000_t *e1000)
  */
 static void e1000_initialize_tx_registers(e1000_t *e1000)
 {
-	E1000_REG_WRITE(e1000, E1000_TDLEN, E1000_TX_FRAME_COUNT * 16);
+	E1000_REG_WRITE(e1000, E1000_TDLEN, e1000->info.tx_frame_count * 16);
 	E1000_REG_WRITE(e1000, E1000_TDH, 0);
 	E1000_REG_WRITE(e1000, E1000_TDT, 0);
 	
@@ -1578,26 +1739,26 @@ static int e1000_initialize_tx_structure(e1000_t *e1000)
 	e1000->tx_frame_virt = NULL;
 	
 	int rc = dmamem_map_anonymous(
-	    E1000_TX_FRAME_COUNT * sizeof(e1000_tx_descriptor_t),
+	    e1000->info.tx_frame_count * sizeof(e1000_tx_descriptor_t),
 	    DMAMEM_4GiB, AS_AREA_READ | AS_AREA_WRITE, 0,
 	    &e1000->tx_ring_phys, &e1000->tx_ring_virt);
 	if (rc != EOK)
 		goto error;
 	
 	memset(e1000->tx_ring_virt, 0,
-	    E1000_TX_FRAME_COUNT * sizeof(e1000_tx_descriptor_t));
+	    e1000->info.tx_frame_count * sizeof(e1000_tx_descriptor_t));
 	
 	e1000->tx_frame_phys = (uintptr_t *)
-	    calloc(E1000_TX_FRAME_COUNT, sizeof(uintptr_t));
+	    calloc(e1000->info.tx_frame_count, sizeof(uintptr_t));
 	e1000->tx_frame_virt =
-	    calloc(E1000_TX_FRAME_COUNT, sizeof(void *));
+	    calloc(e1000->info.tx_frame_count, sizeof(void *));
 
 	if ((e1000->tx_frame_phys == NULL) || (e1000->tx_frame_virt == NULL)) {
 		rc = ENOMEM;
 		goto error;
 	}
 	
-	for (i = 0; i < E1000_TX_FRAME_COUNT; i++) {
+	for (i = 0; i < e1000->info.tx_frame_count; i++) {
 		e1000->tx_frame_virt[i] = AS_AREA_ANY;
 		rc = dmamem_map_anonymous(E1000_MAX_SEND_FRAME_SIZE,
 		    DMAMEM_4GiB, AS_AREA_READ | AS_AREA_WRITE,
@@ -1623,7 +1784,7 @@ error:
 	}
 	
 	if ((e1000->tx_frame_phys != NULL) && (e1000->tx_frame_virt != NULL)) {
-		for (i = 0; i < E1000_TX_FRAME_COUNT; i++) {
+		for (i = 0; i < e1000->info.tx_frame_count; i++) {
 			if (e1000->tx_frame_virt[i] != NULL) {
 				dmamem_unmap_anonymous(e1000->tx_frame_virt[i]);
 				e1000->tx_frame_phys[i] = 0;
@@ -1654,7 +1815,7 @@ static void e1000_uninitialize_tx_structure(e1000_t *e1000)
 {
 	size_t i;
 	
-	for (i = 0; i < E1000_TX_FRAME_COUNT; i++) {
+	for (i = 0; i < e1000->info.tx_frame_count; i++) {
 		dmamem_unmap_anonymous(e1000->tx_frame_virt[i]);
 		e1000->tx_frame_phys[i] = 0;
 		e1000->tx_frame_virt[i] = NULL;
@@ -1680,9 +1841,11 @@ static void e1000_uninitialize_tx_structure(e1000_t *e1000)
  */
 static void e1000_clear_tx_ring(nic_t *nic)
 {
+	e1000_t *e1000 = DRIVER_DATA_NIC(nic);
+	
 	/* Write descriptor */
 	for (unsigned int offset = 0;
-	    offset < E1000_TX_FRAME_COUNT;
+	    offset < e1000->info.tx_frame_count;
 	    offset++)
 		e1000_clear_tx_descriptor(nic, offset);
 }
@@ -1896,9 +2059,11 @@ static e1000_t *e1000_create_dev_data(ddf_dev_t *dev)
 	    e1000_on_unicast_mode_change, e1000_on_multicast_mode_change,
 	    e1000_on_broadcast_mode_change, NULL, e1000_on_vlan_mask_change);
 	nic_set_poll_handlers(nic, e1000_poll_mode_change, e1000_poll);
+	nic_set_napi_handlers(nic, e1000_receive_frames, e1000_napi_irq);
 	
 	fibril_mutex_initialize(&e1000->ctrl_lock);
 	fibril_mutex_initialize(&e1000->rx_lock);
+	fibril_mutex_initialize(&e1000->rx_spare_lock);
 	fibril_mutex_initialize(&e1000->tx_lock);
 	fibril_mutex_initialize(&e1000->eeprom_lock);
 	
@@ -2086,6 +2251,8 @@ static int e1000_device_initialize(ddf_dev_t *dev)
 		e1000->info.eerd_done = 0x10;
 		e1000->info.eerd_address_offset = 8;
 		e1000->info.eerd_data_offset = 16;
+		e1000->info.rx_frame_count = E1000_RX_FRAME_COUNT;
+		e1000->info.tx_frame_count = E1000_TX_FRAME_COUNT;
 		break;
 	case E1000_82547:
 	case E1000_82572:
@@ -2094,6 +2261,14 @@ static int e1000_device_initialize(ddf_dev_t *dev)
 		e1000->info.eerd_done = 0x02;
 		e1000->info.eerd_address_offset = 2;
 		e1000->info.eerd_data_offset = 16;
+		
+		if (board == E1000_82547) {
+			e1000->info.rx_frame_count = E1000_RX_FRAME_COUNT;
+			e1000->info.tx_frame_count = E1000_TX_FRAME_COUNT;
+		} else {
+			e1000->info.rx_frame_count = E1000_PCIE_RX_FRAME_COUNT;
+			e1000->info.tx_frame_count = E1000_PCIE_TX_FRAME_COUNT;
+		}
 		break;
 	}
 	
@@ -2380,7 +2555,7 @@ static void e1000_send_frame(nic_t *nic, void *data, size_t size)
 	tx_descriptor_addr->checksum_start_field = 0;
 	
 	tdt++;
-	if (tdt == E1000_TX_FRAME_COUNT)
+	if (tdt == e1000->info.tx_frame_count)
 		tdt = 0;
 	
 	E1000_REG_WRITE(e1000, E1000_TDT, tdt);
@@ -99,6 +99,11 @@ typedef struct {
 	
 	uint32_t eerd_address_offset;
 	uint32_t eerd_data_offset;
+	
+	/** Number of receive descriptors (multiple of 8) */
+	unsigned int rx_frame_count;
+	/** Number of transmit descriptors (multiple of 8) */
+	unsigned int tx_frame_count;
 } e1000_info_t;
 
 /** VLAN tag bits */
@@ -125,12 +125,18 @@ inline static void rtl8139_unlock_all(rtl8139_t *rtl8139)
 
 
 /** Set interrupts on controller
+ *
+ *  The receive interrupt stays disabled while the card is being polled.
  *
  *  @param rtl8139  The card private structure
  */
 inline static void rtl8139_hw_int_set(rtl8139_t *rtl8139)
 {
-	pio_write_16(rtl8139->io_port + IMR, rtl8139->int_mask);
+	uint16_t int_mask = rtl8139->int_mask;
+	if (rtl8139->rx_irq_masked)
+		int_mask &= ~INT_ROK;
+
+	pio_write_16(rtl8139->io_port + IMR, int_mask);
 }
 
 /** Check on the controller if the receiving buffer is empty
@@ -522,14 +528,18 @@ static void rtl8139_rx_reset(rtl8139_t *rtl8139)
 	nic_report_receive_error(rtl8139->nic_data, NIC_REC_OTHER, 1);
 }
 
-/** Receive all frames in queue
+/** Receive frames in queue
  *
  *  @param nic_data  The controller data
+ *  @param budget    Maximal number of frames to receive
+ *  @param count     Number of frames taken from the buffer
  *  @return The linked list of nic_frame_list_t nodes, each containing one frame
  */
-static nic_frame_list_t *rtl8139_frame_receive(nic_t *nic_data)
+static nic_frame_list_t *rtl8139_frame_receive(nic_t *nic_data, size_t budget,
+    size_t *count)
 {
 	rtl8139_t *rtl8139 = nic_get_specific(nic_data);
+	*count = 0;
 	if (rtl8139_hw_buffer_empty(rtl8139))
 		return NULL;
 
@@ -557,7 +567,7 @@ static nic_frame_list_t *rtl8139_frame_receive(nic_t *nic_data)
 		max_read = bytes_received - rx_offset;
 
 	memory_barrier();
-	while (!rtl8139_hw_buffer_empty(rtl8139)) {
+	while (*count < budget && !rtl8139_hw_buffer_empty(rtl8139)) {
 		void *rx_ptr = rx_buffer + rx_offset % RxBUF_SIZE;
 		uint32_t frame_header = uint32_t_le2host( *((uint32_t*)rx_ptr) );
 		uint16_t size = frame_header >> 16;
@@ -597,6 +607,7 @@ static nic_frame_list_t *rtl8139_frame_receive(nic_t *nic_data)
 
 		/* Update offset */
 		rx_offset = ALIGN_UP(rx_offset + size + RTL_FRAME_HEADER_SIZE, 4);
+		(*count)++;
 
 		/* Write lesser value to prevent overflow into unread frame
 		 * (the recomendation from the RealTech rtl8139 programming guide)
@@ -719,23 +730,44 @@ static void rtl8139_tx_interrupt(nic_t *nic_data)
 	fibril_mutex_unlock(&rtl8139->tx_lock);
 }
 
-/** Receive all frames from the buffer
+/** Receive frames from the buffer
+ *
+ *  @param nic_data  Nic driver data
+ *  @param budget    Maximal number of frames to receive
  *
- *  @param rtl8139  driver private data
+ *  @return Number of frames taken from the buffer
  */
-static void rtl8139_receive_frames(nic_t *nic_data)
+static size_t rtl8139_receive_frames(nic_t *nic_data, size_t budget)
 {
 	assert(nic_data);
 
 	rtl8139_t *rtl8139 = nic_get_specific(nic_data);
 	assert(rtl8139);
 
+	size_t count;
 	fibril_mutex_lock(&rtl8139->rx_lock);
-	nic_frame_list_t *frames = rtl8139_frame_receive(nic_data);
+	nic_frame_list_t *frames = rtl8139_frame_receive(nic_data, budget,
+	    &count);
 	fibril_mutex_unlock(&rtl8139->rx_lock);
 
 	if (frames)
 		nic_received_frame_list(nic_data, frames);
+
+	return count;
+}
+
+/** Enable or disable the receive interrupt for the NAPI-style polling
+ *
+ *  @param nic_data  Nic driver data
+ *  @param enable    Enable (true) or disable (false) the interrupt
+ */
+static void rtl8139_napi_irq(nic_t *nic_data, bool enable)
+{
+	rtl8139_t *rtl8139 = nic_get_specific(nic_data);
+	assert(rtl8139);
+
+	rtl8139->rx_irq_masked = !enable;
+	rtl8139_hw_int_set(rtl8139);
 }
 
 
@@ -770,8 +802,10 @@ static int rtl8139_poll_interrupt(nic_t *nic_data)
  *
  *  @param nic_data  Driver data
  *  @param isr       Interrupt status register value
+ *  @param irq       Called from the interrupt handler, the frames are then
+ *                   received by the NAPI-style polling
  */
-static void rtl8139_interrupt_impl(nic_t *nic_data, uint16_t isr)
+static void rtl8139_interrupt_impl(nic_t *nic_data, uint16_t isr, bool irq)
 {
 	assert(nic_data);
 	
@@ -794,7 +828,10 @@ static void rtl8139_interrupt_impl(nic_t *nic_data, uint16_t isr)
 		rtl8139_tx_interrupt(nic_data);
 	}
 	if (isr & INT_ROK) {
-		rtl8139_receive_frames(nic_data);
+		if (irq)
+			nic_napi_interrupt(nic_data);
+		else
+			rtl8139_receive_frames(nic_data, SIZE_MAX);
 	}
 	if (isr & (INT_RER | INT_RXOVW | INT_FIFOOVW)) {
 		if (isr & INT_RER) {
@@ -828,7 +865,7 @@ static void rtl8139_interrupt_handler(ipc_call_t *icall, ddf_dev_t *dev)
 	nic_t *nic_data = nic_get_from_ddf_dev(dev);
 	rtl8139_t *rtl8139 = nic_get_specific(nic_data);
 
-	rtl8139_interrupt_impl(nic_data, isr);
+	rtl8139_interrupt_impl(nic_data, isr, true);
 
 	/* Turn the interrupts on again */
 	rtl8139_hw_int_set(rtl8139);
@@ -992,6 +1029,7 @@ static rtl8139_t *rtl8139_create_dev_data(ddf_dev_t *dev)
 	nic_set_wol_virtue_change_handlers(nic_data,
 		rtl8139_wol_virtue_add, rtl8139_wol_virtue_rem);
 	nic_set_poll_handlers(nic_data, rtl8139_poll_mode_change, rtl8139_poll);
+	nic_set_napi_handlers(nic_data, rtl8139_receive_frames, rtl8139_napi_irq);
 
 
 	fibril_mutex_initialize(&rtl8139->rx_lock);
@@ -2128,7 +2166,7 @@ static void rtl8139_poll(nic_t *nic_data)
 	uint16_t isr = pio_read_16(rtl8139->io_port + ISR);
 	pio_write_16(rtl8139->io_port + ISR, 0);
 
-	rtl8139_interrupt_impl(nic_data, isr);
+	rtl8139_interrupt_impl(nic_data, isr, false);
 }
 
 
@@ -29,6 +29,7 @@
 #ifndef RTL8139_DRIVER_H_
 #define RTL8139_DRIVER_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include "defs.h"
@@ -99,6 +100,8 @@ typedef struct rtl8139_data {
 
 	/** Mask of the turned interupts (IMR value) */
 	uint16_t int_mask;
+	/** INT_ROK disabled by the NAPI-style polling */
+	bool rx_irq_masked;
 
 	/** The memory allocated for the transmittion buffers
 	 *  Each buffer takes 2kB
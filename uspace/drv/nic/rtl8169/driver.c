@@ -72,6 +72,8 @@ static int rtl8169_on_activated(nic_t *nic_data);
 static int rtl8169_on_stopped(nic_t *nic_data);
 static void rtl8169_send_frame(nic_t *nic_data, void *data, size_t size);
 static void rtl8169_irq_handler(ipc_call_t *icall, ddf_dev_t *dev);
+static size_t rtl8169_receive_done(nic_t *nic_data, size_t budget);
+static void rtl8169_napi_irq(nic_t *nic_data, bool enable);
 static inline int rtl8169_register_int_handler(nic_t *nic_data);
 static inline void rtl8169_get_hwaddr(rtl8169_t *rtl8169, nic_address_t *addr);
 static inline void rtl8169_set_hwaddr(rtl8169_t *rtl8169, const nic_address_t *addr);
@@ -314,6 +316,8 @@ static rtl8169_t *rtl8169_create_dev_data(ddf_dev_t *dev)
 		rtl8169_unicast_set, rtl8169_multicast_set, rtl8169_broadcast_set,
 		NULL, NULL);
 
+	nic_set_napi_handlers(nic_data, rtl8169_receive_done, rtl8169_napi_irq);
+
 	fibril_mutex_initialize(&rtl8169->rx_lock);
 	fibril_mutex_initialize(&rtl8169->tx_lock);
 
@@ -972,9 +976,8 @@ static void rtl8169_transmit_done(ddf_dev_t *dev)
 	fibril_mutex_unlock(&rtl8169->tx_lock);
 }
 
-static void rtl8169_receive_done(ddf_dev_t *dev)
+static size_t rtl8169_receive_done(nic_t *nic_data, size_t budget)
 {
-	nic_t *nic_data = nic_get_from_ddf_dev(dev);
 	rtl8169_t *rtl8169 = nic_get_specific(nic_data);
 	rtl8169_descr_t *descr;
 	nic_frame_list_t *frames = nic_alloc_frame_list();
@@ -982,6 +985,7 @@ static void rtl8169_receive_done(ddf_dev_t *dev)
 	void *buffer;
 	unsigned int tail, fsidx = 0;
 	int frame_size;
+	size_t received = 0;
 
 	ddf_msg(LVL_DEBUG, "rtl8169_receive_done()");
 
@@ -989,7 +993,7 @@ static void rtl8169_receive_done(ddf_dev_t *dev)
 
 	tail = rtl8169->rx_tail;
 
-	for (;;) {
+	while (received < budget) {
 		descr = &rtl8169->rx_ring[tail];
 
 		if (descr->control & CONTROL_OWN)
@@ -1015,6 +1019,7 @@ static void rtl8169_receive_done(ddf_dev_t *dev)
 			frame = nic_alloc_frame(nic_data, frame_size);
 			memcpy(frame->data, buffer, frame_size);
 			nic_frame_list_append(frames, frame);
+			received++;
 		}
 
 		tail = (tail + 1) % RX_BUFFERS_COUNT;
@@ -1028,6 +1033,28 @@ static void rtl8169_receive_done(ddf_dev_t *dev)
 
 	nic_received_frame_list(nic_data, frames);
 
+	return received;
+}
+
+/** Set interrupts on controller
+ *
+ *  The receive interrupts stay disabled while the card is being polled.
+ */
+static void rtl8169_hw_int_set(rtl8169_t *rtl8169)
+{
+	uint16_t int_mask = 0xffff;
+	if (rtl8169->rx_irq_masked)
+		int_mask &= ~(INT_RER | INT_ROK);
+
+	pio_write_16(rtl8169->regs + IMR, int_mask);
+}
+
+static void rtl8169_napi_irq(nic_t *nic_data, bool enable)
+{
+	rtl8169_t *rtl8169 = nic_get_specific(nic_data);
+
+	rtl8169->rx_irq_masked = !enable;
+	rtl8169_hw_int_set(rtl8169);
 }
 
 static void rtl8169_irq_handler(ipc_call_t *icall, ddf_dev_t *dev)
@@ -1040,7 +1067,7 @@ static void rtl8169_irq_handler(ipc_call_t *icall, ddf_dev_t *dev)
 	rtl8169_t *rtl8169 = nic_get_specific(nic_data);
 
 	ddf_msg(LVL_DEBUG, "rtl8169_irq_handler(): isr=0x%04x", isr);
-	pio_write_16(rtl8169->regs + IMR, 0xffff);
+	rtl8169_hw_int_set(rtl8169);
 
 	while (isr != 0) {
 		ddf_msg(LVL_DEBUG, "irq handler: remaining isr=0x%04x", isr);
@@ -1069,11 +1096,15 @@ static void rtl8169_irq_handler(ipc_call_t *icall, ddf_dev_t *dev)
 		}
 
 		if (isr & (INT_RER | INT_ROK)) {
-			rtl8169_receive_done(dev);
 			pio_write_16(rtl8169->regs + ISR, (INT_RER | INT_ROK));
+			nic_napi_interrupt(nic_data);
 		}
 
 		isr = pio_read_16(rtl8169->regs + ISR) & INT_KNOWN;
+
+		/* Frames are being received by polling */
+		if (rtl8169->rx_irq_masked)
+			isr &= ~(INT_RER | INT_ROK);
 	}
 
 	pio_write_16(rtl8169->regs + ISR, 0xffff);
@@ -30,6 +30,7 @@
 #ifndef RTL8169_DRIVER_H_
 #define RTL8169_DRIVER_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include "defs.h"
@@ -63,6 +64,8 @@ typedef struct rtl8169_data {
 	uint16_t pci_pid;
 	/** Mask of the turned interupts (IMR value) */
 	uint16_t int_mask;
+	/** Receive interrupts disabled by the NAPI-style polling */
+	bool rx_irq_masked;
 	/** TX ring */
 	uintptr_t tx_ring_phys;
 	rtl8169_descr_t *tx_ring;
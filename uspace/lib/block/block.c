@@ -57,6 +57,15 @@
 
 #define MAX_WRITE_RETRIES 10
 
+/** Maximum read-ahead window in logical blocks. */
+#define CACHE_RA_MAX	32
+/** Initial read-ahead window in logical blocks. */
+#define CACHE_RA_MIN	4
+/** Maximum number of blocks written back in one request. */
+#define CACHE_WB_MAX	16
+/** Number of evicted block addresses remembered by the 2Q policy. */
+#define CACHE_2Q_GHOSTS	256
+
 /** Lock protecting the device connection list */
 static FIBRIL_MUTEX_INITIALIZE(dcl_lock);
 /** Device connection list head. */
@@ -72,8 +81,24 @@ typedef struct {
 	hash_table_t block_hash;
 	list_t free_list;
 	enum cache_mode mode;
+	bool twoq;                /**< Use 2Q instead of plain LRU. */
+	list_t a1in_list;         /**< Free blocks on probation (2Q). */
+	unsigned a1in_count;      /**< Blocks on probation (2Q). */
+	hash_table_t ghost_hash;  /**< Recently evicted blocks (2Q). */
+	list_t ghost_list;
+	unsigned ghost_count;
+	aoff64_t ra_next;         /**< Next block of a sequential access. */
+	unsigned ra_window;       /**< Current read-ahead window. */
+	block_cache_stats_t stats;
 } cache_t;
 
+/** Address of a block recently evicted from the probation queue. */
+typedef struct {
+	ht_link_t hash_link;
+	link_t link;
+	aoff64_t lba;
+} ghost_t;
+
 typedef struct {
 	link_t link;
 	service_id_t service_id;
@@ -88,6 +113,8 @@ typedef struct {
 
 static int read_blocks(devcon_t *, aoff64_t, size_t, void *, size_t);
 static int write_blocks(devcon_t *, aoff64_t, size_t, void *, size_t);
+static int cache_write_cluster(devcon_t *, cache_t *, block_t *);
+static block_t *cache_victim(cache_t *);
 static aoff64_t ba_ltop(devcon_t *, aoff64_t);
 
 static devcon_t *devcon_search(service_id_t service_id)
@@ -268,6 +295,27 @@ static hash_table_ops_t cache_ops = {
 	.remove_callback = NULL
 };
 
+static size_t ghost_hash(const ht_link_t *item)
+{
+	ghost_t *g = hash_table_get_inst(item, ghost_t, hash_link);
+	return g->lba;
+}
+
+static bool ghost_key_equal(void *key, const ht_link_t *item)
+{
+	aoff64_t *lba = (aoff64_t *) key;
+	ghost_t *g = hash_table_get_inst(item, ghost_t, hash_link);
+	return g->lba == *lba;
+}
+
+static hash_table_ops_t ghost_ops = {
+	.hash = ghost_hash,
+	.key_hash = cache_key_hash,
+	.key_equal = ghost_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
 int block_cache_init(service_id_t service_id, size_t size, unsigned blocks,
     enum cache_mode mode)
 {
@@ -283,10 +331,18 @@ int block_cache_init(service_id_t service_id, size_t size, unsigned blocks,
 	
 	fibril_mutex_initialize(&cache->lock);
 	list_initialize(&cache->free_list);
+	list_initialize(&cache->a1in_list);
+	list_initialize(&cache->ghost_list);
 	cache->lblock_size = size;
 	cache->block_count = blocks;
 	cache->blocks_cached = 0;
-	cache->mode = mode;
+	cache->mode = mode & CACHE_MODE_WB;
+	cache->twoq = (mode & CACHE_MODE_2Q) != 0;
+	cache->a1in_count = 0;
+	cache->ghost_count = 0;
+	cache->ra_next = 0;
+	cache->ra_window = 0;
+	memset(&cache->stats, 0, sizeof(cache->stats));
 
 	/* Allow 1:1 or small-to-large block size translation */
 	if (cache->lblock_size % devcon->pblock_size != 0) {
@@ -301,6 +357,13 @@ int block_cache_init(service_id_t service_id, size_t size, unsigned blocks,
 		return ENOMEM;
 	}
 
+	if (cache->twoq &&
+	    !hash_table_create(&cache->ghost_hash, 0, 0, &ghost_ops)) {
+		hash_table_destroy(&cache->block_hash);
+		free(cache);
+		return ENOMEM;
+	}
+
 	devcon->cache = cache;
 	return EOK;
 }
@@ -322,14 +385,13 @@ int block_cache_fini(service_id_t service_id)
 	 * free list, i.e. the block reference count should be zero. Do not
 	 * bother with the cache and block locks because we are single-threaded.
 	 */
-	while (!list_empty(&cache->free_list)) {
-		block_t *b = list_get_instance(list_first(&cache->free_list),
-		    block_t, free_link);
-
+	block_t *b;
+	while ((b = cache_victim(cache)) != NULL) {
 		list_remove(&b->free_link);
 		if (b->dirty) {
-			rc = write_blocks(devcon, b->pba, cache->blocks_cluster,
-			    b->data, b->size);
+			fibril_mutex_lock(&b->lock);
+			rc = cache_write_cluster(devcon, cache, b);
+			fibril_mutex_unlock(&b->lock);
 			if (rc != EOK)
 				return rc;
 		}
@@ -341,6 +403,17 @@ int block_cache_fini(service_id_t service_id)
 	}
 
 	hash_table_destroy(&cache->block_hash);
+
+	if (cache->twoq) {
+		while (!list_empty(&cache->ghost_list)) {
+			ghost_t *g = list_get_instance(
+			    list_first(&cache->ghost_list), ghost_t, link);
+			list_remove(&g->link);
+			free(g);
+		}
+		hash_table_destroy(&cache->ghost_hash);
+	}
+
 	devcon->cache = NULL;
 	free(cache);
 
@@ -353,11 +426,95 @@ static bool cache_can_grow(cache_t *cache)
 {
 	if (cache->blocks_cached < CACHE_LO_WATERMARK)
 		return true;
-	if (!list_empty(&cache->free_list))
+	if (!list_empty(&cache->free_list) || !list_empty(&cache->a1in_list))
 		return false;
 	return true;
 }
 
+/** Get the free list on which an unreferenced block belongs.
+ *
+ * With the 2Q policy, blocks which have been referenced only once recently
+ * are kept on a separate list so that a long scan through the device does
+ * not push frequently used blocks out of the cache.
+ */
+static list_t *cache_free_list(cache_t *cache, block_t *b)
+{
+	return b->probation ? &cache->a1in_list : &cache->free_list;
+}
+
+/** Choose a free block to be recycled.
+ *
+ * Blocks on probation are evicted first as long as they occupy more than a
+ * quarter of the cache.
+ *
+ * @return		Block or NULL if there are no free blocks.
+ */
+static block_t *cache_victim(cache_t *cache)
+{
+	list_t *list = &cache->free_list;
+
+	if (!list_empty(&cache->a1in_list) && (list_empty(list) ||
+	    cache->a1in_count > max(1, cache->blocks_cached / 4)))
+		list = &cache->a1in_list;
+
+	if (list_empty(list))
+		return NULL;
+
+	return list_get_instance(list_first(list), block_t, free_link);
+}
+
+/** Decide whether a newly instantiated block is put on probation.
+ *
+ * A block which was evicted from probation only recently is considered to be
+ * used frequently.
+ */
+static void cache_admit(cache_t *cache, block_t *b)
+{
+	if (!cache->twoq)
+		return;
+
+	ht_link_t *hlink = hash_table_find(&cache->ghost_hash, &b->lba);
+	if (hlink) {
+		ghost_t *g = hash_table_get_inst(hlink, ghost_t, hash_link);
+		hash_table_remove_item(&cache->ghost_hash, &g->hash_link);
+		list_remove(&g->link);
+		cache->ghost_count--;
+		free(g);
+		return;
+	}
+
+	b->probation = true;
+	cache->a1in_count++;
+}
+
+/** Account for a block which is about to change identity or to be freed. */
+static void cache_evict(cache_t *cache, block_t *b)
+{
+	if (!b->probation)
+		return;
+
+	b->probation = false;
+	cache->a1in_count--;
+
+	/* Remember the address of the evicted block. */
+	ghost_t *g;
+	if (cache->ghost_count >= CACHE_2Q_GHOSTS) {
+		g = list_get_instance(list_first(&cache->ghost_list), ghost_t,
+		    link);
+		hash_table_remove_item(&cache->ghost_hash, &g->hash_link);
+		list_remove(&g->link);
+	} else {
+		g = malloc(sizeof(ghost_t));
+		if (!g)
+			return;
+		cache->ghost_count++;
+	}
+
+	g->lba = b->lba;
+	hash_table_insert(&cache->ghost_hash, &g->hash_link);
+	list_append(&g->link, &cache->ghost_list);
+}
+
 static void block_initialize(block_t *b)
 {
 	fibril_mutex_initialize(&b->lock);
@@ -365,10 +522,337 @@ static void block_initialize(block_t *b)
 	b->write_failures = 0;
 	b->dirty = false;
 	b->toxic = false;
+	b->prefetched = false;
+	b->probation = false;
 	fibril_rwlock_initialize(&b->contents_lock);
 	link_initialize(&b->free_link);
 }
 
+/** Update the sequential access detector.
+ *
+ * Must be called with the cache lock held.
+ *
+ * @param cache		Cache.
+ * @param ba		Logical address of the block being requested.
+ */
+static void cache_ra_update(cache_t *cache, aoff64_t ba)
+{
+	if (ba == cache->ra_next) {
+		if (cache->ra_window < CACHE_RA_MIN)
+			cache->ra_window = CACHE_RA_MIN;
+	} else if (ba + 1 != cache->ra_next) {
+		/* Not a repeated request for the last block either. */
+		cache->ra_window = 0;
+	}
+
+	cache->ra_next = ba + 1;
+}
+
+/** Reserve blocks to be read ahead.
+ *
+ * Instantiate up to @a cnt uncached blocks following @a ba. A block is only
+ * reserved if this does not require any I/O, i.e. by growing the cache or by
+ * recycling a clean block from the free list. The reservation stops at the
+ * first block which is already cached or cannot be obtained so that the
+ * reserved blocks are always contiguous. The reserved blocks are returned
+ * locked and with one reference held.
+ *
+ * Must be called with the cache lock held.
+ *
+ * @param devcon	Device connection.
+ * @param ba		Logical address of the block being read on demand.
+ * @param cnt		Maximum number of blocks to reserve.
+ * @param ra		Array for storing the reserved blocks.
+ *
+ * @return		Number of reserved blocks.
+ */
+static size_t cache_ra_reserve(devcon_t *devcon, aoff64_t ba, size_t cnt,
+    block_t **ra)
+{
+	cache_t *cache = devcon->cache;
+	size_t i;
+
+	for (i = 0; i < cnt; i++) {
+		aoff64_t lba = ba + 1 + i;
+		block_t *b;
+
+		if (ba_ltop(devcon, lba) + cache->blocks_cluster >
+		    devcon->pblocks)
+			break;
+		if (hash_table_find(&cache->block_hash, &lba))
+			break;
+
+		if (cache_can_grow(cache)) {
+			b = malloc(sizeof(block_t));
+			if (!b)
+				break;
+			b->data = malloc(cache->lblock_size);
+			if (!b->data) {
+				free(b);
+				break;
+			}
+			cache->blocks_cached++;
+		} else {
+			b = cache_victim(cache);
+			if (!b)
+				break;
+
+			/*
+			 * Do not wait for the block and do not write it back.
+			 * Read-ahead is not worth it.
+			 */
+			if (!fibril_mutex_trylock(&b->lock))
+				break;
+			bool dirty = b->dirty;
+			fibril_mutex_unlock(&b->lock);
+			if (dirty)
+				break;
+
+			list_remove(&b->free_link);
+			hash_table_remove_item(&cache->block_hash,
+			    &b->hash_link);
+			cache_evict(cache, b);
+		}
+
+		block_initialize(b);
+		b->service_id = devcon->service_id;
+		b->size = cache->lblock_size;
+		b->lba = lba;
+		b->pba = ba_ltop(devcon, lba);
+		b->prefetched = true;
+		cache_admit(cache, b);
+		hash_table_insert(&cache->block_hash, &b->hash_link);
+		fibril_mutex_lock(&b->lock);
+		ra[i] = b;
+	}
+
+	return i;
+}
+
+/** Read a block together with the blocks reserved for read-ahead.
+ *
+ * All blocks are read from the device in a single request. If the request
+ * fails, only the block @a b is read again on its own. The reserved blocks
+ * are then marked toxic so that cache_ra_release() takes them out of the
+ * cache, while block_get() reads them on demand should it find them in the
+ * meantime. The reserved blocks are unlocked on return, but the references
+ * to them are still held.
+ *
+ * Must be called with @a b and the reserved blocks locked and the cache
+ * unlocked.
+ *
+ * @param devcon	Device connection.
+ * @param b		Block requested on demand.
+ * @param ra		Blocks reserved for read-ahead.
+ * @param cnt		Number of reserved blocks.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+static int cache_ra_read(devcon_t *devcon, block_t *b, block_t **ra,
+    size_t cnt)
+{
+	cache_t *cache = devcon->cache;
+	size_t size = (cnt + 1) * cache->lblock_size;
+	size_t i;
+	int rc;
+
+	uint8_t *buf = malloc(size);
+	if (buf) {
+		rc = read_blocks(devcon, b->pba,
+		    (cnt + 1) * cache->blocks_cluster, buf, size);
+	} else
+		rc = ENOMEM;
+
+	if (rc == EOK) {
+		memcpy(b->data, buf, cache->lblock_size);
+		for (i = 0; i < cnt; i++) {
+			memcpy(ra[i]->data, buf + (i + 1) * cache->lblock_size,
+			    cache->lblock_size);
+		}
+	}
+
+	free(buf);
+
+	for (i = 0; i < cnt; i++) {
+		if (rc != EOK)
+			ra[i]->toxic = true;
+		fibril_mutex_unlock(&ra[i]->lock);
+	}
+
+	if (rc != EOK) {
+		rc = read_blocks(devcon, b->pba, cache->blocks_cluster,
+		    b->data, cache->lblock_size);
+	}
+
+	return rc;
+}
+
+/** Drop the references to blocks reserved for read-ahead.
+ *
+ * Blocks which were read successfully are put on the free list. Blocks whose
+ * read-ahead failed are taken out of the cache unless somebody else has
+ * already found them.
+ *
+ * @param devcon	Device connection.
+ * @param ra		Blocks reserved for read-ahead.
+ * @param cnt		Number of reserved blocks.
+ */
+static void cache_ra_release(devcon_t *devcon, block_t **ra, size_t cnt)
+{
+	cache_t *cache = devcon->cache;
+	size_t i;
+
+	fibril_mutex_lock(&cache->lock);
+	for (i = 0; i < cnt; i++) {
+		block_t *b = ra[i];
+
+		fibril_mutex_lock(&b->lock);
+		if (!b->toxic)
+			cache->stats.prefetched++;
+		if (--b->refcnt > 0) {
+			fibril_mutex_unlock(&b->lock);
+			continue;
+		}
+
+		if (b->toxic) {
+			hash_table_remove_item(&cache->block_hash,
+			    &b->hash_link);
+			cache_evict(cache, b);
+			fibril_mutex_unlock(&b->lock);
+			free(b->data);
+			free(b);
+			cache->blocks_cached--;
+			continue;
+		}
+
+		list_append(&b->free_link, cache_free_list(cache, b));
+		fibril_mutex_unlock(&b->lock);
+	}
+	fibril_mutex_unlock(&cache->lock);
+}
+
+/** Find an unreferenced dirty block which can be written back.
+ *
+ * Must be called with the cache lock held.
+ *
+ * @param cache		Cache.
+ * @param lba		Logical address of the block.
+ *
+ * @return		Locked block or NULL.
+ */
+static block_t *cache_wb_candidate(cache_t *cache, aoff64_t lba)
+{
+	ht_link_t *hlink = hash_table_find(&cache->block_hash, &lba);
+	if (!hlink)
+		return NULL;
+
+	block_t *b = hash_table_get_inst(hlink, block_t, hash_link);
+	if (!fibril_mutex_trylock(&b->lock))
+		return NULL;
+
+	if ((b->refcnt != 0) || !b->dirty || b->toxic) {
+		fibril_mutex_unlock(&b->lock);
+		return NULL;
+	}
+
+	return b;
+}
+
+/** Write back a dirty block together with its dirty neighbours.
+ *
+ * Unreferenced dirty blocks adjacent to @a b are written to the device
+ * together with @a b in a single request. The neighbours are marked clean if
+ * the write succeeds. Dealing with the state of @a b is left to the caller.
+ * As the caller holds the lock of @a b, the cache lock is only tried here;
+ * if it is not available, @a b is written alone.
+ *
+ * Must be called with @a b locked and the cache unlocked.
+ *
+ * @param devcon	Device connection.
+ * @param cache		Cache.
+ * @param b		Dirty block.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+static int cache_write_cluster(devcon_t *devcon, cache_t *cache, block_t *b)
+{
+	block_t *run[2 * CACHE_WB_MAX];
+	size_t max = min(CACHE_WB_MAX, DATA_XFER_LIMIT / cache->lblock_size);
+	size_t before = 0;
+	size_t after = 0;
+	size_t i;
+	int rc;
+
+	if (!fibril_mutex_trylock(&cache->lock)) {
+		return write_blocks(devcon, b->pba, cache->blocks_cluster,
+		    b->data, b->size);
+	}
+
+	while ((1 + before + after < max) && (b->lba > before)) {
+		block_t *nb = cache_wb_candidate(cache, b->lba - before - 1);
+		if (!nb)
+			break;
+		run[CACHE_WB_MAX - 1 - before] = nb;
+		before++;
+	}
+
+	while (1 + before + after < max) {
+		block_t *nb = cache_wb_candidate(cache, b->lba + after + 1);
+		if (!nb)
+			break;
+		run[CACHE_WB_MAX + 1 + after] = nb;
+		after++;
+	}
+
+	run[CACHE_WB_MAX] = b;
+	block_t **blk = &run[CACHE_WB_MAX - before];
+	size_t cnt = before + 1 + after;
+
+	uint8_t *buf = NULL;
+	if (cnt > 1) {
+		buf = malloc(cnt * cache->lblock_size);
+		if (!buf) {
+			/* Fall back to writing the block alone. */
+			for (i = 0; i < cnt; i++) {
+				if (blk[i] != b)
+					fibril_mutex_unlock(&blk[i]->lock);
+			}
+			blk = &run[CACHE_WB_MAX];
+			cnt = 1;
+		}
+	}
+
+	cache->stats.writes++;
+	cache->stats.coalesced += cnt - 1;
+	fibril_mutex_unlock(&cache->lock);
+
+	if (cnt == 1) {
+		return write_blocks(devcon, b->pba, cache->blocks_cluster,
+		    b->data, b->size);
+	}
+
+	for (i = 0; i < cnt; i++) {
+		memcpy(buf + i * cache->lblock_size, blk[i]->data,
+		    cache->lblock_size);
+	}
+
+	rc = write_blocks(devcon, blk[0]->pba, cnt * cache->blocks_cluster,
+	    buf, cnt * cache->lblock_size);
+	free(buf);
+
+	for (i = 0; i < cnt; i++) {
+		if (blk[i] == b)
+			continue;
+		if (rc == EOK) {
+			blk[i]->dirty = false;
+			blk[i]->write_failures = 0;
+		}
+		fibril_mutex_unlock(&blk[i]->lock);
+	}
+
+	return rc;
+}
+
 /** Instantiate a block in memory and get a reference to it.
  *
  * @param block			Pointer to where the function will store the
@@ -386,8 +870,9 @@ int block_get(block_t **block, service_id_t service_id, aoff64_t ba, int flags)
 	devcon_t *devcon;
 	cache_t *cache;
 	block_t *b;
-	link_t *link;
 	aoff64_t p_ba;
+	block_t *ra[CACHE_RA_MAX];
+	size_t ra_cnt;
 	int rc;
 	
 	devcon = devcon_search(service_id);
@@ -411,8 +896,10 @@ int block_get(block_t **block, service_id_t service_id, aoff64_t ba, int flags)
 retry:
 	rc = EOK;
 	b = NULL;
+	ra_cnt = 0;
 
 	fibril_mutex_lock(&cache->lock);
+	cache_ra_update(cache, ba);
 	ht_link_t *hlink = hash_table_find(&cache->block_hash, &ba);
 	if (hlink) {
 found:
@@ -423,10 +910,29 @@ found:
 		fibril_mutex_lock(&b->lock);
 		if (b->refcnt++ == 0)
 			list_remove(&b->free_link);
-		if (b->toxic)
-			rc = EIO;
-		fibril_mutex_unlock(&b->lock);
+		/* A toxic prefetched block is one whose read-ahead failed. */
+		bool reread = b->toxic && b->prefetched;
+		if (reread) {
+			b->prefetched = false;
+			cache->stats.misses++;
+		} else {
+			if (b->toxic)
+				rc = EIO;
+			cache->stats.hits++;
+			if (b->prefetched) {
+				b->prefetched = false;
+				cache->stats.prefetch_hits++;
+			}
+		}
 		fibril_mutex_unlock(&cache->lock);
+
+		if (reread) {
+			rc = read_blocks(devcon, b->pba, cache->blocks_cluster,
+			    b->data, cache->lblock_size);
+			if (rc == EOK)
+				b->toxic = false;
+		}
+		fibril_mutex_unlock(&b->lock);
 	} else {
 		/*
 		 * The block was not found in the cache.
@@ -452,13 +958,12 @@ found:
 			 * Try to recycle a block from the free list.
 			 */
 recycle:
-			if (list_empty(&cache->free_list)) {
+			b = cache_victim(cache);
+			if (!b) {
 				fibril_mutex_unlock(&cache->lock);
 				rc = ENOMEM;
 				goto out;
 			}
-			link = list_first(&cache->free_list);
-			b = list_get_instance(link, block_t, free_link);
 
 			fibril_mutex_lock(&b->lock);
 			if (b->dirty) {
@@ -472,10 +977,10 @@ recycle:
 				 * block_get() draining the free list.
 				 */
 				list_remove(&b->free_link);
-				list_append(&b->free_link, &cache->free_list);
+				list_append(&b->free_link,
+				    cache_free_list(cache, b));
 				fibril_mutex_unlock(&cache->lock);
-				rc = write_blocks(devcon, b->pba,
-				    cache->blocks_cluster, b->data, b->size);
+				rc = cache_write_cluster(devcon, cache, b);
 				if (rc != EOK) {
 					/*
 					 * We did not manage to write the block
@@ -529,6 +1034,7 @@ recycle:
 			 */
 			list_remove(&b->free_link);
 			hash_table_remove_item(&cache->block_hash, &b->hash_link);
+			cache_evict(cache, b);
 		}
 
 		block_initialize(b);
@@ -536,7 +1042,24 @@ recycle:
 		b->size = cache->lblock_size;
 		b->lba = ba;
 		b->pba = ba_ltop(devcon, b->lba);
+		cache_admit(cache, b);
 		hash_table_insert(&cache->block_hash, &b->hash_link);
+		cache->stats.misses++;
+
+		/*
+		 * If the access pattern is sequential, reserve the following
+		 * blocks so that they can be read together with this one.
+		 */
+		if (!(flags & BLOCK_FLAGS_NOREAD) && (cache->ra_window > 0) &&
+		    (cache->lblock_size <= DATA_XFER_LIMIT / 2)) {
+			size_t ra_max = min(cache->ra_window,
+			    DATA_XFER_LIMIT / cache->lblock_size - 1);
+			ra_cnt = cache_ra_reserve(devcon, ba, ra_max, ra);
+			if (ra_cnt > 0) {
+				cache->ra_window = min(2 * cache->ra_window,
+				    CACHE_RA_MAX);
+			}
+		}
 
 		/*
 		 * Lock the block before releasing the cache lock. Thus we don't
@@ -551,14 +1074,22 @@ recycle:
 			 * The block contains old or no data. We need to read
 			 * the new contents from the device.
 			 */
-			rc = read_blocks(devcon, b->pba, cache->blocks_cluster,
-			    b->data, cache->lblock_size);
+			if (ra_cnt > 0) {
+				rc = cache_ra_read(devcon, b, ra, ra_cnt);
+			} else {
+				rc = read_blocks(devcon, b->pba,
+				    cache->blocks_cluster, b->data,
+				    cache->lblock_size);
+			}
 			if (rc != EOK) 
 				b->toxic = true;
 		} else
 			rc = EOK;
 
 		fibril_mutex_unlock(&b->lock);
+
+		if (ra_cnt > 0)
+			cache_ra_release(devcon, ra, ra_cnt);
 	}
 out:
 	if ((rc != EOK) && b) {
@@ -610,8 +1141,7 @@ retry:
 		block->dirty = false;	/* will not write back toxic block */
 	if (block->dirty && (block->refcnt == 1) &&
 	    (blocks_cached > CACHE_HI_WATERMARK || mode != CACHE_MODE_WB)) {
-		rc = write_blocks(devcon, block->pba, cache->blocks_cluster,
-		    block->data, block->size);
+		rc = cache_write_cluster(devcon, cache, block);
 		if (rc == EOK)
 			block->write_failures = 0;
 		block->dirty = false;
@@ -656,6 +1186,7 @@ retry:
 			 * Take the block out of the cache and free it.
 			 */
 			hash_table_remove_item(&cache->block_hash, &block->hash_link);
+			cache_evict(cache, block);
 			fibril_mutex_unlock(&block->lock);
 			free(block->data);
 			free(block);
@@ -676,7 +1207,7 @@ retry:
 			fibril_mutex_unlock(&cache->lock);
 			goto retry;
 		}
-		list_append(&block->free_link, &cache->free_list);
+		list_append(&block->free_link, cache_free_list(cache, block));
 	}
 	fibril_mutex_unlock(&block->lock);
 	fibril_mutex_unlock(&cache->lock);
@@ -684,6 +1215,28 @@ retry:
 	return rc;
 }
 
+/** Get block cache statistics.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param stats		Place to store the statistics.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+int block_cache_get_stats(service_id_t service_id, block_cache_stats_t *stats)
+{
+	devcon_t *devcon = devcon_search(service_id);
+	if (!devcon || !devcon->cache)
+		return ENOENT;
+
+	cache_t *cache = devcon->cache;
+
+	fibril_mutex_lock(&cache->lock);
+	*stats = cache->stats;
+	fibril_mutex_unlock(&cache->lock);
+
+	return EOK;
+}
+
 /** Read sequential data from a block device.
  *
  * @param service_id	Service ID of the block device.
@@ -749,6 +1302,166 @@ int block_seqread(service_id_t service_id, void *buf, size_t *bufpos,
 	return EOK;
 }
 
+/** Copy a logical block from or to the cache if it is cached.
+ *
+ * @param devcon	Device connection.
+ * @param ba		Logical block address.
+ * @param buf		Buffer for the block data.
+ * @param write		If true, overwrite the cached block with the contents
+ *			of @a buf instead of copying the block out to @a buf.
+ *
+ * @return		True if the block was cached.
+ */
+static bool cache_range_copy(devcon_t *devcon, aoff64_t ba, void *buf,
+    bool write)
+{
+	cache_t *cache = devcon->cache;
+	ht_link_t *hlink;
+	block_t *b;
+	bool cached = false;
+
+	fibril_mutex_lock(&cache->lock);
+	hlink = hash_table_find(&cache->block_hash, &ba);
+	if (hlink != NULL) {
+		b = hash_table_get_inst(hlink, block_t, hash_link);
+		fibril_mutex_lock(&b->lock);
+		if (write) {
+			/*
+			 * The caller writes the new contents to the device
+			 * right away, so the block is no longer dirty.
+			 */
+			memcpy(b->data, buf, cache->lblock_size);
+			b->toxic = false;
+			b->dirty = false;
+			cached = true;
+		} else if (!b->toxic) {
+			memcpy(buf, b->data, cache->lblock_size);
+			cached = true;
+		}
+		fibril_mutex_unlock(&b->lock);
+	}
+	fibril_mutex_unlock(&cache->lock);
+
+	return cached;
+}
+
+/** Read a range of logical blocks.
+ *
+ * Blocks present in the cache are copied from there, so that the caller
+ * sees the contents of dirty blocks. Each run of consecutive blocks which
+ * are not cached is read from the device with a single request of at most
+ * BLOCK_XFER_MAX bytes. Blocks read this way are not entered into the
+ * cache, which makes this suitable for large sequential reads of file data.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param ba		Address of the first logical block.
+ * @param cnt		Number of blocks.
+ * @param buf		Buffer for storing the data.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+int block_read_range(service_id_t service_id, aoff64_t ba, size_t cnt,
+    void *buf)
+{
+	devcon_t *devcon;
+	cache_t *cache;
+	size_t bsize;
+	size_t run_max;
+	size_t run;
+	size_t i;
+	int rc;
+
+	devcon = devcon_search(service_id);
+	assert(devcon);
+	assert(devcon->cache);
+
+	cache = devcon->cache;
+	bsize = cache->lblock_size;
+	run_max = max(BLOCK_XFER_MAX / bsize, 1);
+
+	if (ba_ltop(devcon, ba + cnt) > devcon->pblocks)
+		return EIO;
+
+	i = 0;
+	while (i < cnt) {
+		/* Gather a run of blocks which are not in the cache */
+		run = 0;
+		while (i + run < cnt && run < run_max) {
+			if (cache_range_copy(devcon, ba + i + run,
+			    buf + (i + run) * bsize, false))
+				break;
+			run++;
+		}
+
+		if (run == 0) {
+			/* Block i has been copied from the cache */
+			i++;
+			continue;
+		}
+
+		rc = read_blocks(devcon, ba_ltop(devcon, ba + i),
+		    run * cache->blocks_cluster, buf + i * bsize, run * bsize);
+		if (rc != EOK)
+			return rc;
+
+		i += run;
+	}
+
+	return EOK;
+}
+
+/** Write a range of logical blocks.
+ *
+ * Cached copies of the blocks are updated and the data is written to the
+ * device in requests of at most BLOCK_XFER_MAX bytes, regardless of the
+ * cache mode.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param ba		Address of the first logical block.
+ * @param cnt		Number of blocks.
+ * @param data		The data to be written.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+int block_write_range(service_id_t service_id, aoff64_t ba, size_t cnt,
+    const void *data)
+{
+	devcon_t *devcon;
+	cache_t *cache;
+	size_t bsize;
+	size_t run_max;
+	size_t run;
+	size_t i;
+	int rc;
+
+	devcon = devcon_search(service_id);
+	assert(devcon);
+	assert(devcon->cache);
+
+	cache = devcon->cache;
+	bsize = cache->lblock_size;
+	run_max = max(BLOCK_XFER_MAX / bsize, 1);
+
+	if (ba_ltop(devcon, ba + cnt) > devcon->pblocks)
+		return EIO;
+
+	for (i = 0; i < cnt; i += run) {
+		run = min(cnt - i, run_max);
+
+		for (size_t j = i; j < i + run; j++)
+			(void) cache_range_copy(devcon, ba + j,
+			    (void *) (data + j * bsize), true);
+
+		rc = write_blocks(devcon, ba_ltop(devcon, ba + i),
+		    run * cache->blocks_cluster, (void *) (data + i * bsize),
+		    run * bsize);
+		if (rc != EOK)
+			return rc;
+	}
+
+	return EOK;
+}
+
 /** Read blocks directly from device (bypass cache).
  *
  * @param service_id	Service ID of the block device.
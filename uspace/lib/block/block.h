@@ -61,6 +61,12 @@
  */
 #define BLOCK_FLAGS_NOREAD	1
 
+/**
+ * Maximum number of bytes block_read_range() and block_write_range()
+ * transfer from or to the device in one request.
+ */
+#define BLOCK_XFER_MAX		(1024 * 1024)
+
 typedef struct block {
 	/** Mutex protecting the reference count. */
 	fibril_mutex_t lock;
@@ -70,6 +76,10 @@ typedef struct block {
 	bool dirty;
 	/** If true, the blcok does not contain valid data. */
 	bool toxic;
+	/** If true, the block was read ahead and has not been used yet. */
+	bool prefetched;
+	/** If true, the block has been referenced only once recently. */
+	bool probation;
 	/** Readers / Writer lock protecting the contents of the block. */
 	fibril_rwlock_t contents_lock;
 	/** Service ID of service providing the block device. */
@@ -93,11 +103,29 @@ typedef struct block {
 /** Caching mode */
 enum cache_mode {
 	/** Write-Through */
-	CACHE_MODE_WT,
+	CACHE_MODE_WT = 0,
 	/** Write-Back */
-	CACHE_MODE_WB
+	CACHE_MODE_WB = 1,
+	/** Scan-resistant 2Q replacement, can be or-ed with the above */
+	CACHE_MODE_2Q = 2
 };
 
+/** Block cache statistics */
+typedef struct {
+	/** Number of block_get() requests satisfied from the cache. */
+	uint64_t hits;
+	/** Number of block_get() requests which instantiated a new block. */
+	uint64_t misses;
+	/** Number of blocks read ahead of demand. */
+	uint64_t prefetched;
+	/** Number of hits on blocks which were read ahead. */
+	uint64_t prefetch_hits;
+	/** Number of write requests issued by the cache. */
+	uint64_t writes;
+	/** Number of blocks written back together with another block. */
+	uint64_t coalesced;
+} block_cache_stats_t;
+
 extern int block_init(service_id_t, size_t);
 extern void block_fini(service_id_t);
 
@@ -106,6 +134,7 @@ extern void *block_bb_get(service_id_t);
 
 extern int block_cache_init(service_id_t, size_t, unsigned, enum cache_mode);
 extern int block_cache_fini(service_id_t);
+extern int block_cache_get_stats(service_id_t, block_cache_stats_t *);
 
 extern int block_get(block_t **, service_id_t, aoff64_t, int);
 extern int block_put(block_t *);
@@ -116,6 +145,8 @@ extern int block_seqread(service_id_t, void *, size_t *, size_t *, aoff64_t *,
 extern int block_get_bsize(service_id_t, size_t *);
 extern int block_get_nblocks(service_id_t, aoff64_t *);
 extern int block_read_toc(service_id_t, uint8_t, void *, size_t);
+extern int block_read_range(service_id_t, aoff64_t, size_t, void *);
+extern int block_write_range(service_id_t, aoff64_t, size_t, const void *);
 extern int block_read_direct(service_id_t, aoff64_t, size_t, void *);
 extern int block_read_bytes_direct(service_id_t, aoff64_t, size_t, void *);
 extern int block_write_direct(service_id_t, aoff64_t, size_t, const void *);
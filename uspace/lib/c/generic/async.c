@@ -120,6 +120,12 @@
 #include <abi/mm/as.h>
 #include "private/libc.h"
 
+/**
+ * Data transfers of at least this size are done directly between the address
+ * spaces instead of being copied through a kernel buffer.
+ */
+#define DATA_XFER_DIRECT_THRESHOLD  (DATA_XFER_LIMIT / 4)
+
 /** Session data */
 struct async_sess {
 	/** List of inactive exchanges */
@@ -2732,6 +2738,45 @@ int async_share_out_finalize(cap_handle_t chandle, void **dst)
 	return ipc_answer_2(chandle, EOK, (sysarg_t) __entry, (sysarg_t) dst);
 }
 
+/** Choose data transfer flags for a buffer of the given size.
+ *
+ * @param size Size of the buffer (in bytes).
+ *
+ * @return Data transfer flags.
+ *
+ */
+static sysarg_t async_data_xfer_flags(size_t size)
+{
+	return (size >= DATA_XFER_DIRECT_THRESHOLD) ?
+	    IPC_XF_DIRECT : IPC_XF_NONE;
+}
+
+/** Send IPC_M_DATA_READ or IPC_M_DATA_WRITE and wait for the answer.
+ *
+ * The kernel copies buffers that cannot be transferred directly (e.g.
+ * physical memory mapped by physmem_map()) through a kernel buffer, which
+ * limits them to DATA_XFER_LIMIT bytes.
+ *
+ * @param exch   Exchange for sending the message.
+ * @param method IPC_M_DATA_READ or IPC_M_DATA_WRITE.
+ * @param buf    Address of the buffer.
+ * @param size   Size of the buffer (in bytes).
+ * @param flags  IPC_XF_RESTRICT to let the kernel shorten the transfer
+ *               instead of failing with ELIMIT, or IPC_XF_NONE.
+ *
+ * @return Zero on success or a negative error code from errno.h.
+ *
+ */
+static int async_data_xfer_start(async_exch_t *exch, sysarg_t method,
+    sysarg_t buf, size_t size, sysarg_t flags)
+{
+	if (exch == NULL)
+		return ENOENT;
+	
+	return async_req_3_0(exch, method, buf, (sysarg_t) size,
+	    flags | async_data_xfer_flags(size));
+}
+
 /** Start IPC_M_DATA_READ using the async framework.
  *
  * @param exch    Exchange for sending the message.
@@ -2745,8 +2790,8 @@ int async_share_out_finalize(cap_handle_t chandle, void **dst)
 aid_t async_data_read(async_exch_t *exch, void *dst, size_t size,
     ipc_call_t *dataptr)
 {
-	return async_send_2(exch, IPC_M_DATA_READ, (sysarg_t) dst,
-	    (sysarg_t) size, dataptr);
+	return async_send_3(exch, IPC_M_DATA_READ, (sysarg_t) dst,
+	    (sysarg_t) size, async_data_xfer_flags(size), dataptr);
 }
 
 /** Wrapper for IPC_M_DATA_READ calls using the async framework.
@@ -2760,11 +2805,25 @@ aid_t async_data_read(async_exch_t *exch, void *dst, size_t size,
  */
 int async_data_read_start(async_exch_t *exch, void *dst, size_t size)
 {
-	if (exch == NULL)
-		return ENOENT;
-	
-	return async_req_2_0(exch, IPC_M_DATA_READ, (sysarg_t) dst,
-	    (sysarg_t) size);
+	return async_data_xfer_start(exch, IPC_M_DATA_READ, (sysarg_t) dst,
+	    size, IPC_XF_NONE);
+}
+
+/** Wrapper for IPC_M_DATA_READ calls with data transfer flags.
+ *
+ * @param exch  Exchange for sending the message.
+ * @param dst   Address of the beginning of the destination buffer.
+ * @param size  Size of the destination buffer.
+ * @param flags Data transfer flags (IPC_XF_RESTRICT or IPC_XF_NONE).
+ *
+ * @return Zero on success or a negative error code from errno.h.
+ *
+ */
+int async_data_read_start_generic(async_exch_t *exch, void *dst, size_t size,
+    sysarg_t flags)
+{
+	return async_data_xfer_start(exch, IPC_M_DATA_READ, (sysarg_t) dst,
+	    size, flags);
 }
 
 /** Wrapper for receiving the IPC_M_DATA_READ calls using the async framework.
@@ -2885,11 +2944,25 @@ int async_data_read_forward_fast(async_exch_t *exch, sysarg_t imethod,
  */
 int async_data_write_start(async_exch_t *exch, const void *src, size_t size)
 {
-	if (exch == NULL)
-		return ENOENT;
-	
-	return async_req_2_0(exch, IPC_M_DATA_WRITE, (sysarg_t) src,
-	    (sysarg_t) size);
+	return async_data_xfer_start(exch, IPC_M_DATA_WRITE, (sysarg_t) src,
+	    size, IPC_XF_NONE);
+}
+
+/** Wrapper for IPC_M_DATA_WRITE calls with data transfer flags.
+ *
+ * @param exch  Exchange for sending the message.
+ * @param src   Address of the beginning of the source buffer.
+ * @param size  Size of the source buffer.
+ * @param flags Data transfer flags (IPC_XF_RESTRICT or IPC_XF_NONE).
+ *
+ * @return Zero on success or a negative error code from errno.h.
+ *
+ */
+int async_data_write_start_generic(async_exch_t *exch, const void *src,
+    size_t size, sysarg_t flags)
+{
+	return async_data_xfer_start(exch, IPC_M_DATA_WRITE, (sysarg_t) src,
+	    size, flags);
 }
 
 /** Wrapper for receiving the IPC_M_DATA_WRITE calls using the async framework.
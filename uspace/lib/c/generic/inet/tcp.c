@@ -32,13 +32,18 @@
 /** @file TCP API
  */
 
+#include <align.h>
+#include <as.h>
 #include <errno.h>
 #include <fibril.h>
 #include <inet/endpoint.h>
 #include <inet/tcp.h>
 #include <ipc/services.h>
 #include <ipc/tcp.h>
+#include <macros.h>
 #include <stdlib.h>
+#include <sys/time.h>
+#include <vfs/vfs.h>
 
 static void tcp_cb_conn(ipc_callid_t, ipc_call_t *, void *);
 static int tcp_conn_fibril(void *);
@@ -472,6 +477,73 @@ int tcp_conn_send(tcp_conn_t *conn, const void *data, size_t bytes)
 	return rc;
 }
 
+/** Send data from a shared buffer over TCP connection.
+ *
+ * The TCP service takes the data directly from the memory shared with it,
+ * there is no IPC data transfer.
+ *
+ * @param conn   Connection
+ * @param shbuf  Shared buffer created by tcp_shbuf_create() on the same
+ *               TCP client as @a conn
+ * @param offset Offset of the data within the buffer
+ * @param bytes  Data size in bytes
+ *
+ * @return EOK on success or negative error code
+ */
+int tcp_conn_send_shbuf(tcp_conn_t *conn, tcp_shbuf_t *shbuf, size_t offset,
+    size_t bytes)
+{
+	async_exch_t *exch;
+
+	if (shbuf->tcp != conn->tcp)
+		return EINVAL;
+
+	exch = async_exchange_begin(conn->tcp->sess);
+	sysarg_t rc = async_req_4_0(exch, TCP_CONN_SEND_SHBUF, conn->id,
+	    shbuf->id, offset, bytes);
+	async_exchange_end(exch);
+
+	return rc;
+}
+
+/** Send file contents over TCP connection.
+ *
+ * The file handle is passed to the TCP service, which reads the data
+ * from the file system and queues it on the connection itself, so the data
+ * never passes through the caller.
+ *
+ * @param conn  Connection
+ * @param file  VFS file handle open for reading
+ * @param pos   Position in the file to start at
+ * @param bytes Number of bytes to send
+ *
+ * @return EOK on success or negative error code. EIO is returned if
+ *         the file ends before @a bytes bytes were sent.
+ */
+int tcp_conn_send_file(tcp_conn_t *conn, int file, aoff64_t pos, size_t bytes)
+{
+	async_exch_t *exch;
+	sysarg_t rc;
+
+	exch = async_exchange_begin(conn->tcp->sess);
+	aid_t req = async_send_4(exch, TCP_CONN_SEND_FILE, conn->id,
+	    LOWER32(pos), UPPER32(pos), bytes, NULL);
+
+	async_exch_t *vfs_exch = vfs_exchange_begin();
+	rc = vfs_pass_handle(vfs_exch, file, exch);
+	vfs_exchange_end(vfs_exch);
+
+	async_exchange_end(exch);
+
+	if (rc != EOK) {
+		async_forget(req);
+		return rc;
+	}
+
+	async_wait_for(req, &rc);
+	return rc;
+}
+
 /** Send FIN.
  *
  * Send FIN, indicating no more data will be send over the connection.
@@ -589,14 +661,54 @@ int tcp_conn_recv(tcp_conn_t *conn, void *buf, size_t bsize, size_t *nrecv)
  */
 int tcp_conn_recv_wait(tcp_conn_t *conn, void *buf, size_t bsize,
     size_t *nrecv)
+{
+	return tcp_conn_recv_wait_timeout(conn, buf, bsize, nrecv, 0);
+}
+
+/** Read received data from connection with blocking and a time limit.
+ *
+ * Same as tcp_conn_recv_wait(), but gives up if no data are received
+ * within @a timeout.
+ *
+ * @param conn    Connection
+ * @param buf     Buffer
+ * @param bsize   Buffer size
+ * @param nrecv   Place to store actual number of received bytes
+ * @param timeout Time limit in microseconds or zero to wait forever
+ *
+ * @return EOK on success, ETIMEOUT if no data were received in time
+ *         or negative error code
+ */
+int tcp_conn_recv_wait_timeout(tcp_conn_t *conn, void *buf, size_t bsize,
+    size_t *nrecv, suseconds_t timeout)
 {
 	async_exch_t *exch;
 	ipc_call_t answer;
+	struct timeval deadline;
+
+	if (timeout > 0) {
+		getuptime(&deadline);
+		tv_add_diff(&deadline, timeout);
+	}
 
 again:
 	fibril_mutex_lock(&conn->lock);
 	while (!conn->data_avail) {
-		fibril_condvar_wait(&conn->cv, &conn->lock);
+		suseconds_t left = 0;
+
+		if (timeout > 0) {
+			struct timeval now;
+
+			getuptime(&now);
+			left = tv_sub_diff(&deadline, &now);
+			if (left <= 0) {
+				fibril_mutex_unlock(&conn->lock);
+				return ETIMEOUT;
+			}
+		}
+
+		(void) fibril_condvar_wait_timeout(&conn->cv, &conn->lock,
+		    left);
 	}
 
 	exch = async_exchange_begin(conn->tcp->sess);
@@ -630,6 +742,81 @@ again:
 	return EOK;
 }
 
+/** Create buffer shared with the TCP service.
+ *
+ * @param tcp    TCP client
+ * @param size   Buffer size in bytes
+ * @param rshbuf Place to store pointer to new shared buffer
+ *
+ * @return EOK on success or negative error code
+ */
+int tcp_shbuf_create(tcp_t *tcp, size_t size, tcp_shbuf_t **rshbuf)
+{
+	tcp_shbuf_t *shbuf;
+	ipc_call_t answer;
+	sysarg_t retval;
+	int rc;
+
+	shbuf = calloc(1, sizeof(tcp_shbuf_t));
+	if (shbuf == NULL)
+		return ENOMEM;
+
+	shbuf->data = as_area_create(AS_AREA_ANY,
+	    ALIGN_UP(max(size, 1), PAGE_SIZE),
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE, AS_AREA_UNPAGED);
+	if (shbuf->data == AS_MAP_FAILED) {
+		free(shbuf);
+		return ENOMEM;
+	}
+
+	async_exch_t *exch = async_exchange_begin(tcp->sess);
+	aid_t req = async_send_0(exch, TCP_SHBUF_CREATE, &answer);
+	rc = async_share_out_start(exch, shbuf->data,
+	    AS_AREA_READ | AS_AREA_CACHEABLE);
+	async_exchange_end(exch);
+
+	if (rc != EOK) {
+		async_forget(req);
+		goto error;
+	}
+
+	async_wait_for(req, &retval);
+	if (retval != EOK) {
+		rc = retval;
+		goto error;
+	}
+
+	shbuf->tcp = tcp;
+	shbuf->id = IPC_GET_ARG1(answer);
+	shbuf->size = size;
+
+	*rshbuf = shbuf;
+	return EOK;
+error:
+	as_area_destroy(shbuf->data);
+	free(shbuf);
+	return rc;
+}
+
+/** Destroy buffer shared with the TCP service.
+ *
+ * @param shbuf Shared buffer or @c NULL
+ */
+void tcp_shbuf_destroy(tcp_shbuf_t *shbuf)
+{
+	async_exch_t *exch;
+
+	if (shbuf == NULL)
+		return;
+
+	exch = async_exchange_begin(shbuf->tcp->sess);
+	(void) async_req_1_0(exch, TCP_SHBUF_DESTROY, shbuf->id);
+	async_exchange_end(exch);
+
+	as_area_destroy(shbuf->data);
+	free(shbuf);
+}
+
 /** Connection established event.
  *
  * @param tcp TCP client
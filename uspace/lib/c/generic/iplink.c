@@ -44,8 +44,44 @@
 #include <loc.h>
 #include <stdlib.h>
 
+/** Number of slots of the receive ring shared with the link */
+#define IPLINK_RX_RING_SLOTS  256
+
+/** Maximum size of a datagram in the receive ring */
+#define IPLINK_RX_RING_SDU_SIZE  2048
+
 static void iplink_cb_conn(ipc_callid_t iid, ipc_call_t *icall, void *arg);
 
+/** Have received datagrams delivered through a shared ring.
+ *
+ * This is optional, datagrams are delivered by IPLINK_EV_RECV otherwise.
+ */
+static void iplink_rx_ring_setup(iplink_t *iplink)
+{
+	int rc = pkt_ring_create(&iplink->rx_ring, IPLINK_RX_RING_SLOTS,
+	    IPLINK_RX_RING_SDU_SIZE);
+	if (rc != EOK)
+		return;
+	
+	async_exch_t *exch = async_exchange_begin(iplink->sess);
+	
+	ipc_call_t answer;
+	aid_t req = async_send_0(exch, IPLINK_RX_RING_SET, &answer);
+	rc = pkt_ring_share(&iplink->rx_ring, exch);
+	
+	async_exchange_end(exch);
+	
+	sysarg_t retval;
+	async_wait_for(req, &retval);
+	
+	if ((rc != EOK) || (retval != EOK)) {
+		pkt_ring_destroy(&iplink->rx_ring);
+		return;
+	}
+	
+	iplink->rx_ring_active = true;
+}
+
 int iplink_open(async_sess_t *sess, iplink_ev_ops_t *ev_ops, void *arg,
     iplink_t **riplink)
 {
@@ -68,6 +104,8 @@ int iplink_open(async_sess_t *sess, iplink_ev_ops_t *ev_ops, void *arg,
 	if (rc != EOK)
 		goto error;
 	
+	iplink_rx_ring_setup(iplink);
+	
 	*riplink = iplink;
 	return EOK;
 	
@@ -81,6 +119,9 @@ error:
 void iplink_close(iplink_t *iplink)
 {
 	/* XXX Synchronize with iplink_cb_conn */
+	if (iplink->rx_ring_active)
+		pkt_ring_destroy(&iplink->rx_ring);
+	
 	free(iplink);
 }
 
@@ -263,6 +304,26 @@ static void iplink_ev_recv(iplink_t *iplink, ipc_callid_t iid,
 	async_answer_0(iid, rc);
 }
 
+static void iplink_ev_recv_ring(iplink_t *iplink, ipc_callid_t iid,
+    ipc_call_t *icall)
+{
+	iplink_recv_sdu_t sdu;
+	uint32_t ver;
+	
+	/* The link does not wait for the answer. */
+	async_answer_0(iid, EOK);
+	
+	if (!iplink->rx_ring_active)
+		return;
+	
+	pkt_ring_arm(&iplink->rx_ring);
+	
+	while (pkt_ring_get(&iplink->rx_ring, &sdu.data, &sdu.size, &ver)) {
+		(void) iplink->ev_ops->recv(iplink, &sdu, (ip_ver_t) ver);
+		pkt_ring_release(&iplink->rx_ring);
+	}
+}
+
 static void iplink_ev_change_addr(iplink_t *iplink, ipc_callid_t iid,
     ipc_call_t *icall)
 {
@@ -301,6 +362,9 @@ static void iplink_cb_conn(ipc_callid_t iid, ipc_call_t *icall, void *arg)
 		case IPLINK_EV_CHANGE_ADDR:
 			iplink_ev_change_addr(iplink, callid, &call);
 			break;
+		case IPLINK_EV_RECV_RING:
+			iplink_ev_recv_ring(iplink, callid, &call);
+			break;
 		default:
 			async_answer_0(callid, ENOTSUP);
 		}
@@ -220,6 +220,34 @@ static void iplink_send6_srv(iplink_srv_t *srv, ipc_callid_t iid,
 	async_answer_0(iid, rc);
 }
 
+static void iplink_rx_ring_set_srv(iplink_srv_t *srv, ipc_callid_t iid,
+    ipc_call_t *icall)
+{
+	ipc_callid_t callid;
+	size_t size;
+	unsigned int flags;
+	if (!async_share_out_receive(&callid, &size, &flags)) {
+		async_answer_0(iid, EINVAL);
+		return;
+	}
+	
+	fibril_mutex_lock(&srv->lock);
+	
+	if (srv->rx_ring_active) {
+		fibril_mutex_unlock(&srv->lock);
+		async_answer_0(callid, EEXIST);
+		async_answer_0(iid, EEXIST);
+		return;
+	}
+	
+	int rc = pkt_ring_attach(&srv->rx_ring, callid, size, flags);
+	if (rc == EOK)
+		srv->rx_ring_active = true;
+	
+	fibril_mutex_unlock(&srv->lock);
+	async_answer_0(iid, rc);
+}
+
 void iplink_srv_init(iplink_srv_t *srv)
 {
 	fibril_mutex_initialize(&srv->lock);
@@ -227,6 +255,7 @@ void iplink_srv_init(iplink_srv_t *srv)
 	srv->ops = NULL;
 	srv->arg = NULL;
 	srv->client_sess = NULL;
+	srv->rx_ring_active = false;
 }
 
 int iplink_conn(ipc_callid_t iid, ipc_call_t *icall, void *arg)
@@ -266,6 +295,10 @@ int iplink_conn(ipc_callid_t iid, ipc_call_t *icall, void *arg)
 			/* The other side has hung up */
 			fibril_mutex_lock(&srv->lock);
 			srv->connected = false;
+			if (srv->rx_ring_active) {
+				pkt_ring_destroy(&srv->rx_ring);
+				srv->rx_ring_active = false;
+			}
 			fibril_mutex_unlock(&srv->lock);
 			async_answer_0(callid, EOK);
 			break;
@@ -293,6 +326,9 @@ int iplink_conn(ipc_callid_t iid, ipc_call_t *icall, void *arg)
 		case IPLINK_ADDR_REMOVE:
 			iplink_addr_remove_srv(srv, callid, &call);
 			break;
+		case IPLINK_RX_RING_SET:
+			iplink_rx_ring_set_srv(srv, callid, &call);
+			break;
 		default:
 			async_answer_0(callid, EINVAL);
 		}
@@ -301,12 +337,41 @@ int iplink_conn(ipc_callid_t iid, ipc_call_t *icall, void *arg)
 	return srv->ops->close(srv);
 }
 
-/* XXX Version should be part of @a sdu */
+/** Pass a received datagram to the client.
+ *
+ * If the client has set up a receive ring, the datagram is queued to it and
+ * the client is notified only if it has not been notified yet. Datagrams
+ * that do not fit in the ring are delivered by IPLINK_EV_RECV, which also
+ * throttles the caller until the client catches up.
+ *
+ * XXX Version should be part of @a sdu
+ */
 int iplink_ev_recv(iplink_srv_t *srv, iplink_recv_sdu_t *sdu, ip_ver_t ver)
 {
 	if (srv->client_sess == NULL)
 		return EIO;
 	
+	bool queued = false;
+	bool notify = false;
+	
+	fibril_mutex_lock(&srv->lock);
+	if (srv->rx_ring_active) {
+		queued = pkt_ring_put(&srv->rx_ring, sdu->data, sdu->size,
+		    (uint32_t) ver, &notify) == EOK;
+	}
+	fibril_mutex_unlock(&srv->lock);
+	
+	if (queued) {
+		if (notify) {
+			async_exch_t *exch =
+			    async_exchange_begin(srv->client_sess);
+			async_msg_0(exch, IPLINK_EV_RECV_RING);
+			async_exchange_end(exch);
+		}
+		
+		return EOK;
+	}
+	
 	async_exch_t *exch = async_exchange_begin(srv->client_sess);
 	
 	ipc_call_t answer;
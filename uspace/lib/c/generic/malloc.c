@@ -75,6 +75,45 @@
  */
 #define SHRINK_GRANULARITY  (64 * PAGE_SIZE)
 
+/** Number of small block size classes
+ *
+ * Blocks with net size up to SMALL_MAX are sorted into
+ * size classes in steps of BASE_ALIGN. Released blocks
+ * of these sizes are not returned to the heap right
+ * away, but they are kept for reuse in the thread caches
+ * and in the global bins. Such blocks remain marked as
+ * used in the heap.
+ *
+ */
+#define SMALL_CLASSES  32
+
+/** Largest net size served from the size classes. */
+#define SMALL_MAX  (SMALL_CLASSES * BASE_ALIGN)
+
+/** Number of thread caches
+ *
+ * The caches are not bound to threads, since thread-local
+ * storage is not available while fibrils and threads are
+ * being set up. Each caller starts looking for an unlocked
+ * cache at a position derived from its stack pointer, so
+ * that concurrently running threads usually end up using
+ * different caches.
+ *
+ */
+#define THREAD_CACHES  8
+
+/** Log2 of the stack region mapped to the same thread cache. */
+#define THREAD_CACHE_SHIFT  20
+
+/** Maximum number of blocks in one size class of a thread cache. */
+#define THREAD_CACHE_BLOCKS  16
+
+/** Maximum number of blocks in one global bin. */
+#define BIN_BLOCKS  32
+
+/** Number of blocks moved between a thread cache and the heap at once. */
+#define CACHE_BATCH  8
+
 /** Overhead of each heap block. */
 #define STRUCT_OVERHEAD \
 	(sizeof(heap_block_head_t) + sizeof(heap_block_foot_t))
@@ -183,6 +222,36 @@ typedef struct {
 	uint32_t magic;
 } heap_block_foot_t;
 
+/** Released small block kept for reuse
+ *
+ * Stored in the data part of the block.
+ *
+ */
+typedef struct heap_cached {
+	struct heap_cached *next;
+} heap_cached_t;
+
+/** Thread cache of small blocks */
+typedef struct {
+	/** Futex protecting the cache */
+	futex_t futex;
+	
+	/** Cached blocks of each size class */
+	heap_cached_t *blocks[SMALL_CLASSES];
+	
+	/** Number of cached blocks of each size class */
+	size_t count[SMALL_CLASSES];
+} heap_cache_t;
+
+/** Thread caches */
+static heap_cache_t thread_caches[THREAD_CACHES];
+
+/** Global bins of small blocks (protected by the heap futex) */
+static heap_cached_t *bins[SMALL_CLASSES];
+
+/** Number of blocks in each global bin */
+static size_t bins_count[SMALL_CLASSES];
+
 /** First heap area */
 static heap_area_t *first_heap_area = NULL;
 
@@ -551,6 +620,9 @@ void __malloc_init(void)
 {
 	if (!area_create(PAGE_SIZE))
 		abort();
+	
+	for (size_t i = 0; i < THREAD_CACHES; i++)
+		futex_initialize(&thread_caches[i].futex, 1);
 }
 
 /** Split heap block and mark it as used.
@@ -821,6 +893,273 @@ static void *malloc_internal(const size_t size, const size_t align)
 	return heap_grow_and_alloc(gross_size, falign);
 }
 
+/** Free a memory block
+ *
+ * Should be called only inside the critical section.
+ *
+ * @param addr The address of the block.
+ *
+ */
+static void free_internal(const void *addr)
+{
+	/* Calculate the position of the header. */
+	heap_block_head_t *head
+	    = (heap_block_head_t *) (addr - sizeof(heap_block_head_t));
+	
+	block_check(head);
+	malloc_assert(!head->free);
+	
+	heap_area_t *area = head->area;
+	
+	area_check(area);
+	malloc_assert((void *) head >= (void *) AREA_FIRST_BLOCK_HEAD(area));
+	malloc_assert((void *) head < area->end);
+	
+	/* Mark the block itself as free. */
+	head->free = true;
+	
+	/* Look at the next block. If it is free, merge the two. */
+	heap_block_head_t *next_head
+	    = (heap_block_head_t *) (((void *) head) + head->size);
+	
+	if ((void *) next_head < area->end) {
+		block_check(next_head);
+		if (next_head->free)
+			block_init(head, head->size + next_head->size, true, area);
+	}
+	
+	/* Look at the previous block. If it is free, merge the two. */
+	if ((void *) head > (void *) AREA_FIRST_BLOCK_HEAD(area)) {
+		heap_block_foot_t *prev_foot =
+		    (heap_block_foot_t *) (((void *) head) - sizeof(heap_block_foot_t));
+		
+		heap_block_head_t *prev_head =
+		    (heap_block_head_t *) (((void *) head) - prev_foot->size);
+		
+		block_check(prev_head);
+		
+		if (prev_head->free)
+			block_init(prev_head, prev_head->size + head->size, true,
+			    area);
+	}
+	
+	heap_shrink(area);
+}
+
+/** Get the size class serving an allocation request.
+ *
+ * @param size Requested size (at most SMALL_MAX).
+ *
+ */
+static inline size_t small_class(size_t size)
+{
+	if (size == 0)
+		return 0;
+	
+	return ALIGN_UP(size, BASE_ALIGN) / BASE_ALIGN - 1;
+}
+
+/** Get the net size of blocks in a size class. */
+static inline size_t small_class_size(size_t cls)
+{
+	return (cls + 1) * BASE_ALIGN;
+}
+
+/** Get the size class of a used heap block.
+ *
+ * Blocks may be slightly larger than requested, since the
+ * heap does not split off remainders which are too small.
+ * Such blocks still belong to the size class they can serve.
+ *
+ * @param head Header of the block.
+ *
+ * @return Size class or SMALL_CLASSES if the block is not small.
+ *
+ */
+static size_t block_class(heap_block_head_t *head)
+{
+	if (head->magic != HEAP_BLOCK_HEAD_MAGIC)
+		return SMALL_CLASSES;
+	
+	size_t net = NET_SIZE(head->size);
+	if ((net < BASE_ALIGN) || (net > SMALL_MAX + STRUCT_OVERHEAD))
+		return SMALL_CLASSES;
+	
+	return min(net / BASE_ALIGN, SMALL_CLASSES) - 1;
+}
+
+/** Lock one of the thread caches.
+ *
+ * @return Locked thread cache or NULL if all caches are busy.
+ *
+ */
+static heap_cache_t *thread_cache_lock(void)
+{
+	uintptr_t sp = (uintptr_t) &sp;
+	size_t first = (sp >> THREAD_CACHE_SHIFT) % THREAD_CACHES;
+	
+	for (size_t i = 0; i < THREAD_CACHES; i++) {
+		heap_cache_t *cache =
+		    &thread_caches[(first + i) % THREAD_CACHES];
+		
+		if (futex_trydown(&cache->futex))
+			return cache;
+	}
+	
+	return NULL;
+}
+
+/** Unlock a thread cache. */
+static void thread_cache_unlock(heap_cache_t *cache)
+{
+	futex_up(&cache->futex);
+}
+
+/** Take a block from a global bin.
+ *
+ * Should be called only inside the critical section.
+ *
+ */
+static void *bin_pop(size_t cls)
+{
+	heap_cached_t *cached = bins[cls];
+	if (cached == NULL)
+		return NULL;
+	
+	bins[cls] = cached->next;
+	bins_count[cls]--;
+	return cached;
+}
+
+/** Return a small block to the heap.
+ *
+ * The block is put into the global bin unless the bin
+ * is full, in which case it is really freed.
+ * Should be called only inside the critical section.
+ *
+ */
+static void bin_push(size_t cls, void *addr)
+{
+	if (bins_count[cls] >= BIN_BLOCKS) {
+		free_internal(addr);
+		return;
+	}
+	
+	heap_cached_t *cached = (heap_cached_t *) addr;
+	cached->next = bins[cls];
+	bins[cls] = cached;
+	bins_count[cls]++;
+}
+
+/** Allocate a small block of the given size class.
+ *
+ * Should be called only inside the critical section.
+ *
+ */
+static void *bin_alloc(size_t cls)
+{
+	void *addr = bin_pop(cls);
+	if (addr == NULL)
+		addr = malloc_internal(small_class_size(cls), BASE_ALIGN);
+	
+	return addr;
+}
+
+/** Allocate a small block from a thread cache.
+ *
+ * An empty size class of the thread cache is refilled
+ * with a batch of blocks at once.
+ *
+ * @param size Number of bytes to allocate (at most SMALL_MAX).
+ *
+ * @return Allocated memory or NULL.
+ *
+ */
+static void *small_alloc(const size_t size)
+{
+	size_t cls = small_class(size);
+	heap_cache_t *cache = thread_cache_lock();
+	
+	if (cache == NULL) {
+		heap_lock();
+		void *addr = bin_alloc(cls);
+		heap_unlock();
+		
+		return addr;
+	}
+	
+	if (cache->count[cls] == 0) {
+		heap_lock();
+		
+		for (size_t i = 0; i < CACHE_BATCH; i++) {
+			heap_cached_t *cached = bin_alloc(cls);
+			if (cached == NULL)
+				break;
+			
+			cached->next = cache->blocks[cls];
+			cache->blocks[cls] = cached;
+			cache->count[cls]++;
+		}
+		
+		heap_unlock();
+	}
+	
+	heap_cached_t *cached = cache->blocks[cls];
+	if (cached != NULL) {
+		cache->blocks[cls] = cached->next;
+		cache->count[cls]--;
+	}
+	
+	thread_cache_unlock(cache);
+	return cached;
+}
+
+/** Release a small block into a thread cache.
+ *
+ * If the size class of the thread cache is full, a batch
+ * of blocks is returned to the heap at once.
+ *
+ * @param addr The address of the block.
+ *
+ * @return True if the block was cached.
+ *
+ */
+static bool small_free(const void *addr)
+{
+	heap_block_head_t *head =
+	    (heap_block_head_t *) (addr - sizeof(heap_block_head_t));
+	
+	size_t cls = block_class(head);
+	if (cls >= SMALL_CLASSES)
+		return false;
+	
+	heap_cache_t *cache = thread_cache_lock();
+	if (cache == NULL)
+		return false;
+	
+	if (cache->count[cls] >= THREAD_CACHE_BLOCKS) {
+		heap_lock();
+		
+		for (size_t i = 0; i < CACHE_BATCH; i++) {
+			heap_cached_t *cached = cache->blocks[cls];
+			cache->blocks[cls] = cached->next;
+			cache->count[cls]--;
+			
+			bin_push(cls, cached);
+		}
+		
+		heap_unlock();
+	}
+	
+	heap_cached_t *cached = (heap_cached_t *) addr;
+	cached->next = cache->blocks[cls];
+	cache->blocks[cls] = cached;
+	cache->count[cls]++;
+	
+	thread_cache_unlock(cache);
+	return true;
+}
+
 /** Allocate memory by number of elements
  *
  * @param nmemb Number of members to allocate.
@@ -850,6 +1189,12 @@ void *calloc(const size_t nmemb, const size_t size)
  */
 void *malloc(const size_t size)
 {
+	if (size <= SMALL_MAX) {
+		void *block = small_alloc(size);
+		if (block != NULL)
+			return block;
+	}
+	
 	heap_lock();
 	void *block = malloc_internal(size, BASE_ALIGN);
 	heap_unlock();
@@ -1002,55 +1347,70 @@ void free(const void *addr)
 	if (addr == NULL)
 		return;
 	
-	heap_lock();
-	
-	/* Calculate the position of the header. */
-	heap_block_head_t *head
-	    = (heap_block_head_t *) (addr - sizeof(heap_block_head_t));
-	
-	block_check(head);
-	malloc_assert(!head->free);
-	
-	heap_area_t *area = head->area;
-	
-	area_check(area);
-	malloc_assert((void *) head >= (void *) AREA_FIRST_BLOCK_HEAD(area));
-	malloc_assert((void *) head < area->end);
-	
-	/* Mark the block itself as free. */
-	head->free = true;
-	
-	/* Look at the next block. If it is free, merge the two. */
-	heap_block_head_t *next_head
-	    = (heap_block_head_t *) (((void *) head) + head->size);
-	
-	if ((void *) next_head < area->end) {
-		block_check(next_head);
-		if (next_head->free)
-			block_init(head, head->size + next_head->size, true, area);
-	}
+	if (small_free(addr))
+		return;
 	
-	/* Look at the previous block. If it is free, merge the two. */
-	if ((void *) head > (void *) AREA_FIRST_BLOCK_HEAD(area)) {
-		heap_block_foot_t *prev_foot =
-		    (heap_block_foot_t *) (((void *) head) - sizeof(heap_block_foot_t));
+	heap_lock();
+	free_internal(addr);
+	heap_unlock();
+}
+
+/** Check a list of cached small blocks
+ *
+ * Should be called only inside the critical section.
+ *
+ * @return NULL if the blocks are consistent or the address
+ *         of the first inconsistent header or footer.
+ *
+ */
+static void *cached_check(heap_cached_t *cached)
+{
+	for (; cached != NULL; cached = cached->next) {
+		heap_block_head_t *head = (heap_block_head_t *)
+		    (((void *) cached) - sizeof(heap_block_head_t));
 		
-		heap_block_head_t *prev_head =
-		    (heap_block_head_t *) (((void *) head) - prev_foot->size);
+		if ((head->magic != HEAP_BLOCK_HEAD_MAGIC) || (head->free))
+			return (void *) head;
 		
-		block_check(prev_head);
+		heap_block_foot_t *foot = BLOCK_FOOT(head);
 		
-		if (prev_head->free)
-			block_init(prev_head, prev_head->size + head->size, true,
-			    area);
+		if ((foot->magic != HEAP_BLOCK_FOOT_MAGIC) ||
+		    (head->size != foot->size))
+			return (void *) foot;
 	}
 	
-	heap_shrink(area);
+	return NULL;
+}
+
+/** Check the blocks in the thread caches and global bins
+ *
+ * Should be called only inside the critical section
+ * with all thread caches locked.
+ *
+ */
+static void *small_check(void)
+{
+	for (size_t cls = 0; cls < SMALL_CLASSES; cls++) {
+		void *bad = cached_check(bins[cls]);
+		if (bad != NULL)
+			return bad;
+		
+		for (size_t i = 0; i < THREAD_CACHES; i++) {
+			bad = cached_check(thread_caches[i].blocks[cls]);
+			if (bad != NULL)
+				return bad;
+		}
+	}
 	
-	heap_unlock();
+	return NULL;
 }
 
-void *heap_check(void)
+/** Check the heap consistency
+ *
+ * The thread caches must be locked by the caller.
+ *
+ */
+static void *heap_check_internal(void)
 {
 	heap_lock();
 	
@@ -1059,6 +1419,12 @@ void *heap_check(void)
 		return (void *) -1;
 	}
 	
+	void *bad = small_check();
+	if (bad != NULL) {
+		heap_unlock();
+		return bad;
+	}
+	
 	/* Walk all heap areas */
 	for (heap_area_t *area = first_heap_area; area != NULL;
 	    area = area->next) {
@@ -1099,5 +1465,18 @@ void *heap_check(void)
 	return NULL;
 }
 
+void *heap_check(void)
+{
+	for (size_t i = 0; i < THREAD_CACHES; i++)
+		futex_down(&thread_caches[i].futex);
+	
+	void *bad = heap_check_internal();
+	
+	for (size_t i = 0; i < THREAD_CACHES; i++)
+		thread_cache_unlock(&thread_caches[i]);
+	
+	return bad;
+}
+
 /** @}
  */
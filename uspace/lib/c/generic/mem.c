@@ -35,161 +35,16 @@
 
 #include <mem.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
-/** Fill memory block with a constant value. */
-void *memset(void *dest, int b, size_t n)
-{
-	char *pb;
-	unsigned long *pw;
-	size_t word_size;
-	size_t n_words;
-
-	unsigned long pattern;
-	size_t i;
-	size_t fill;
-
-	/* Fill initial segment. */
-	word_size = sizeof(unsigned long);
-	fill = word_size - ((uintptr_t) dest & (word_size - 1));
-	if (fill > n) fill = n;
-
-	pb = dest;
-
-	i = fill;
-	while (i-- != 0)
-		*pb++ = b;
-
-	/* Compute remaining size. */
-	n -= fill;
-	if (n == 0) return dest;
-
-	n_words = n / word_size;
-	n = n % word_size;
-	pw = (unsigned long *) pb;
-
-	/* Create word-sized pattern for aligned segment. */
-	pattern = 0;
-	i = word_size;
-	while (i-- != 0)
-		pattern = (pattern << 8) | (uint8_t) b;
-
-	/* Fill aligned segment. */
-	i = n_words;
-	while (i-- != 0)
-		*pw++ = pattern;
-
-	pb = (char *) pw;
-
-	/* Fill final segment. */
-	i = n;
-	while (i-- != 0)
-		*pb++ = b;
-
-	return dest;
-}
-
-struct along {
-	unsigned long n;
-} __attribute__ ((packed));
-
-static void *unaligned_memcpy(void *dst, const void *src, size_t n)
-{
-	size_t i, j;
-	struct along *adst = dst;
-	const struct along *asrc = src;
-
-	for (i = 0; i < n / sizeof(unsigned long); i++)
-		adst[i].n = asrc[i].n;
-		
-	for (j = 0; j < n % sizeof(unsigned long); j++)
-		((unsigned char *) (((unsigned long *) dst) + i))[j] =
-		    ((unsigned char *) (((unsigned long *) src) + i))[j];
-		
-	return (char *) dst;
-}
-
-/** Copy memory block. */
-void *memcpy(void *dst, const void *src, size_t n)
-{
-	size_t i;
-	size_t mod, fill;
-	size_t word_size;
-	size_t n_words;
-
-	const unsigned long *srcw;
-	unsigned long *dstw;
-	const uint8_t *srcb;
-	uint8_t *dstb;
-
-	word_size = sizeof(unsigned long);
-
-	/*
-	 * Are source and destination addresses congruent modulo word_size?
-	 * If not, use unaligned_memcpy().
-	 */
-
-	if (((uintptr_t) dst & (word_size - 1)) !=
-	    ((uintptr_t) src & (word_size - 1)))
- 		return unaligned_memcpy(dst, src, n);
-
-	/*
-	 * mod is the address modulo word size. fill is the length of the
-	 * initial buffer segment before the first word boundary.
-	 * If the buffer is very short, use unaligned_memcpy(), too.
-	 */
-
-	mod = (uintptr_t) dst & (word_size - 1);
-	fill = word_size - mod;
-	if (fill > n) fill = n;
-
-	/* Copy the initial segment. */
-
-	srcb = src;
-	dstb = dst;
-
-	i = fill;
-	while (i-- != 0)
-		*dstb++ = *srcb++;
-
-	/* Compute remaining length. */
-
-	n -= fill;
-	if (n == 0) return dst;
-
-	/* Pointers to aligned segment. */
-
-	dstw = (unsigned long *) dstb;
-	srcw = (const unsigned long *) srcb;
-
-	n_words = n / word_size;	/* Number of whole words to copy. */
-	n -= n_words * word_size;	/* Remaining bytes at the end. */
-
-	/* "Fast" copy. */
-	i = n_words;
-	while (i-- != 0)
-		*dstw++ = *srcw++;
-
-	/*
-	 * Copy the rest.
-	 */
-
-	srcb = (const uint8_t *) srcw;
-	dstb = (uint8_t *) dstw;
-
-	i = n;
-	while (i-- != 0)
-		*dstb++ = *srcb++;
-
-	return dst;
-}
-
 /** Move memory block with possible overlapping. */
 void *memmove(void *dst, const void *src, size_t n)
 {
 	const uint8_t *sp;
 	uint8_t *dp;
+	bool aligned;
 
 	/* Nothing to do? */
 	if (src == dst)
@@ -200,21 +55,59 @@ void *memmove(void *dst, const void *src, size_t n)
 		return memcpy(dst, src, n);
 	}
 
+	/*
+	 * If the addresses are congruent modulo the word size, the bulk
+	 * of the block can be moved word-by-word. Each word is loaded
+	 * before it is stored, so this is safe for any overlap.
+	 */
+	aligned = ((((uintptr_t) dst) ^ ((uintptr_t) src)) &
+	    (sizeof(unsigned long) - 1)) == 0;
+
 	/* Which direction? */
 	if (src > dst) {
 		/* Forwards. */
 		sp = src;
 		dp = dst;
 
+		if (aligned) {
+			while ((n != 0) &&
+			    (((uintptr_t) dp & (sizeof(unsigned long) - 1)) != 0)) {
+				*dp++ = *sp++;
+				n--;
+			}
+
+			while (n >= sizeof(unsigned long)) {
+				*((unsigned long *) dp) = *((const unsigned long *) sp);
+				dp += sizeof(unsigned long);
+				sp += sizeof(unsigned long);
+				n -= sizeof(unsigned long);
+			}
+		}
+
 		while (n-- != 0)
 			*dp++ = *sp++;
 	} else {
 		/* Backwards. */
-		sp = src + (n - 1);
-		dp = dst + (n - 1);
+		sp = src + n;
+		dp = dst + n;
+
+		if (aligned) {
+			while ((n != 0) &&
+			    (((uintptr_t) dp & (sizeof(unsigned long) - 1)) != 0)) {
+				*--dp = *--sp;
+				n--;
+			}
+
+			while (n >= sizeof(unsigned long)) {
+				dp -= sizeof(unsigned long);
+				sp -= sizeof(unsigned long);
+				*((unsigned long *) dp) = *((const unsigned long *) sp);
+				n -= sizeof(unsigned long);
+			}
+		}
 
 		while (n-- != 0)
-			*dp-- = *sp--;
+			*--dp = *--sp;
 	}
 
 	return dst;
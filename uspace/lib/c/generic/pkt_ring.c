@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libc
+ * @{
+ */
+/** @file
+ * @brief Shared-memory packet rings.
+ *
+ * A packet ring hands packets from one task to another through a memory
+ * area shared by both of them. The consumer creates the ring and shares it
+ * with the producer. The producer copies each packet into a free slot and
+ * notifies the consumer only if it has not been notified yet, so a single
+ * notification covers all packets queued until the consumer starts
+ * draining the ring. The consumer processes the packets in place.
+ *
+ * The consumer drains the ring as follows:
+ *
+ *	pkt_ring_arm(ring);
+ *	while (pkt_ring_get(ring, &data, &size, &arg)) {
+ *		process(data, size, arg);
+ *		pkt_ring_release(ring);
+ *	}
+ */
+
+#include <pkt_ring.h>
+#include <align.h>
+#include <as.h>
+#include <errno.h>
+#include <mem.h>
+#include <libarch/barrier.h>
+#include <libarch/config.h>
+
+/** Maximum number of slots of a ring */
+#define PKT_RING_SLOTS_MAX  4096
+
+/** Maximum size of a slot */
+#define PKT_RING_SLOT_SIZE_MAX  (64 * 1024)
+
+/** Offset of the first slot, the header has a cache line of its own */
+#define PKT_RING_SLOTS_OFFSET  ALIGN_UP(sizeof(pkt_ring_hdr_t), 64)
+
+static pkt_ring_hdr_t *pkt_ring_hdr(pkt_ring_t *ring)
+{
+	return (pkt_ring_hdr_t *) ring->area;
+}
+
+static pkt_ring_slot_t *pkt_ring_slot(pkt_ring_t *ring, uint32_t index)
+{
+	return (pkt_ring_slot_t *) ((uint8_t *) ring->area +
+	    PKT_RING_SLOTS_OFFSET +
+	    (size_t) (index & (ring->slots - 1)) * ring->slot_size);
+}
+
+static size_t pkt_ring_area_size(uint32_t slots, uint32_t slot_size)
+{
+	return ALIGN_UP(PKT_RING_SLOTS_OFFSET + (size_t) slots * slot_size,
+	    PAGE_SIZE);
+}
+
+/** Create a packet ring on the consumer side.
+ *
+ * @param ring     Ring to initialize.
+ * @param slots    Number of slots. Rounded up to a power of two.
+ * @param max_size Maximum size of a packet.
+ *
+ * @return EOK on success, EINVAL if the geometry is not supported or
+ *         ENOMEM if the area cannot be created.
+ */
+int pkt_ring_create(pkt_ring_t *ring, size_t slots, size_t max_size)
+{
+	if ((slots == 0) || (slots > PKT_RING_SLOTS_MAX) ||
+	    (max_size == 0) ||
+	    (max_size > PKT_RING_SLOT_SIZE_MAX - sizeof(pkt_ring_slot_t)))
+		return EINVAL;
+	
+	uint32_t n = 1;
+	while (n < slots)
+		n <<= 1;
+	
+	uint32_t slot_size = ALIGN_UP(sizeof(pkt_ring_slot_t) + max_size,
+	    sizeof(uint64_t));
+	size_t size = pkt_ring_area_size(n, slot_size);
+	
+	void *area = as_area_create(AS_AREA_ANY, size,
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE, AS_AREA_UNPAGED);
+	if (area == AS_MAP_FAILED)
+		return ENOMEM;
+	
+	ring->area = area;
+	ring->area_size = size;
+	ring->slots = n;
+	ring->slot_size = slot_size;
+	ring->index = 0;
+	fibril_mutex_initialize(&ring->lock);
+	
+	pkt_ring_hdr_t *hdr = pkt_ring_hdr(ring);
+	hdr->slots = n;
+	hdr->slot_size = slot_size;
+	hdr->head = 0;
+	hdr->tail = 0;
+	hdr->notify = 0;
+	
+	return EOK;
+}
+
+/** Share a ring with the producer.
+ *
+ * The caller sends the request which the producer answers by
+ * pkt_ring_attach(), then calls this function on the same exchange.
+ *
+ * @param ring Ring created by pkt_ring_create().
+ * @param exch Exchange to the producer.
+ *
+ * @return EOK on success or an error code.
+ */
+int pkt_ring_share(pkt_ring_t *ring, async_exch_t *exch)
+{
+	return async_share_out_start(exch, ring->area,
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE);
+}
+
+/** Attach to a ring shared by the consumer.
+ *
+ * @param ring   Ring to initialize.
+ * @param callid Share out call received by async_share_out_receive().
+ * @param size   Size of the shared area.
+ * @param flags  Flags of the shared area.
+ *
+ * @return EOK on success or an error code. The share out call is answered
+ *         in both cases.
+ */
+int pkt_ring_attach(pkt_ring_t *ring, cap_handle_t callid, size_t size,
+    unsigned int flags)
+{
+	if ((size < PKT_RING_SLOTS_OFFSET) ||
+	    ((flags & (AS_AREA_READ | AS_AREA_WRITE)) !=
+	    (AS_AREA_READ | AS_AREA_WRITE))) {
+		async_answer_0(callid, EINVAL);
+		return EINVAL;
+	}
+	
+	void *area;
+	int rc = async_share_out_finalize(callid, &area);
+	if ((rc != EOK) || (area == AS_MAP_FAILED))
+		return ENOMEM;
+	
+	pkt_ring_hdr_t *hdr = (pkt_ring_hdr_t *) area;
+	uint32_t slots = hdr->slots;
+	uint32_t slot_size = hdr->slot_size;
+	
+	if ((slots == 0) ||
+	    (slots > PKT_RING_SLOTS_MAX) || ((slots & (slots - 1)) != 0) ||
+	    (slot_size <= sizeof(pkt_ring_slot_t)) ||
+	    (slot_size > PKT_RING_SLOT_SIZE_MAX) ||
+	    (pkt_ring_area_size(slots, slot_size) > size)) {
+		as_area_destroy(area);
+		return EINVAL;
+	}
+	
+	ring->area = area;
+	ring->area_size = size;
+	ring->slots = slots;
+	ring->slot_size = slot_size;
+	ring->index = hdr->head;
+	fibril_mutex_initialize(&ring->lock);
+	
+	return EOK;
+}
+
+/** Unmap a ring.
+ *
+ * @param ring Ring created by pkt_ring_create() or pkt_ring_attach().
+ */
+void pkt_ring_destroy(pkt_ring_t *ring)
+{
+	as_area_destroy(ring->area);
+	ring->area = NULL;
+}
+
+/** Queue a packet to a ring.
+ *
+ * @param ring    Ring attached by pkt_ring_attach().
+ * @param data    Packet data.
+ * @param size    Packet size.
+ * @param arg     Argument passed to the consumer along with the packet.
+ * @param rnotify Set to @c true if the caller has to notify the consumer.
+ *
+ * @return EOK on success, ELIMIT if the ring is full or EINVAL if the
+ *         packet does not fit in a slot.
+ */
+int pkt_ring_put(pkt_ring_t *ring, const void *data, size_t size,
+    uint32_t arg, bool *rnotify)
+{
+	if (size > ring->slot_size - sizeof(pkt_ring_slot_t))
+		return EINVAL;
+	
+	pkt_ring_hdr_t *hdr = pkt_ring_hdr(ring);
+	
+	fibril_mutex_lock(&ring->lock);
+	
+	uint32_t head = ring->index;
+	if (head - hdr->tail >= ring->slots) {
+		fibril_mutex_unlock(&ring->lock);
+		return ELIMIT;
+	}
+	
+	pkt_ring_slot_t *slot = pkt_ring_slot(ring, head);
+	memcpy(slot + 1, data, size);
+	slot->size = size;
+	slot->arg = arg;
+	
+	/* Publish the slot before the new head. */
+	write_barrier();
+	ring->index = head + 1;
+	hdr->head = ring->index;
+	
+	/*
+	 * Pairs with the barrier in pkt_ring_arm(): either the consumer
+	 * sees the new head, or we see the cleared notification flag.
+	 */
+	memory_barrier();
+	
+	*rnotify = false;
+	if (hdr->notify == 0) {
+		hdr->notify = 1;
+		*rnotify = true;
+	}
+	
+	fibril_mutex_unlock(&ring->lock);
+	return EOK;
+}
+
+/** Prepare for draining a ring.
+ *
+ * Clears the notification flag so that packets queued from now on
+ * produce a new notification if the consumer misses them.
+ *
+ * @param ring Ring created by pkt_ring_create().
+ */
+void pkt_ring_arm(pkt_ring_t *ring)
+{
+	pkt_ring_hdr(ring)->notify = 0;
+	memory_barrier();
+}
+
+/** Get the oldest packet of a ring.
+ *
+ * The packet stays in the ring until it is released by pkt_ring_release().
+ *
+ * @param ring  Ring created by pkt_ring_create().
+ * @param rdata Place to store the address of the packet data.
+ * @param rsize Place to store the size of the packet.
+ * @param rarg  Place to store the packet argument.
+ *
+ * @return @c true if a packet was returned, @c false if the ring is empty.
+ */
+bool pkt_ring_get(pkt_ring_t *ring, void **rdata, size_t *rsize,
+    uint32_t *rarg)
+{
+	uint32_t tail = ring->index;
+	uint32_t head = pkt_ring_hdr(ring)->head;
+	
+	if ((head == tail) || (head - tail > ring->slots))
+		return false;
+	
+	/* Read the slot only after seeing the head which published it. */
+	read_barrier();
+	
+	pkt_ring_slot_t *slot = pkt_ring_slot(ring, tail);
+	size_t size = slot->size;
+	if (size > ring->slot_size - sizeof(pkt_ring_slot_t))
+		size = ring->slot_size - sizeof(pkt_ring_slot_t);
+	
+	*rdata = slot + 1;
+	*rsize = size;
+	*rarg = slot->arg;
+	return true;
+}
+
+/** Release the oldest packet of a ring.
+ *
+ * @param ring Ring created by pkt_ring_create().
+ */
+void pkt_ring_release(pkt_ring_t *ring)
+{
+	/* Finish reading the slot before handing it back. */
+	memory_barrier();
+	ring->index++;
+	pkt_ring_hdr(ring)->tail = ring->index;
+}
+
+/** @}
+ */
@@ -236,6 +236,32 @@ stats_exc_t *stats_get_exceptions(size_t *count)
 	return stats_exceptions;
 }
 
+/** Get slab allocator statistics.
+ *
+ * @param count Number of records returned.
+ *
+ * @return Array of stats_slab_t structures.
+ *         If non-NULL then it should be eventually freed
+ *         by free().
+ *
+ */
+stats_slab_t *stats_get_slabs(size_t *count)
+{
+	size_t size = 0;
+	stats_slab_t *stats_slabs =
+	    (stats_slab_t *) sysinfo_get_data("system.slabs", &size);
+	
+	if ((size % sizeof(stats_slab_t)) != 0) {
+		if (stats_slabs != NULL)
+			free(stats_slabs);
+		*count = 0;
+		return NULL;
+	}
+	
+	*count = size / sizeof(stats_slab_t);
+	return stats_slabs;
+}
+
 /** Get single exception statistics
  *
  * @param excn Exception number we are interested in.
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libc
+ * @{
+ */
+/** @file
+ * @brief Submission and completion rings shared with VFS.
+ *
+ * A ring lets a client queue many reads and writes and have all of them
+ * processed by VFS on behalf of a single IPC call. The data of the queued
+ * requests lives in the data area of the ring, which is shared with VFS.
+ *
+ * A ring must not be used by more fibrils at the same time.
+ */
+
+#include <vfs/ring.h>
+#include <vfs/vfs.h>
+#include <as.h>
+#include <align.h>
+#include <async.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <libarch/config.h>
+
+struct vfs_ring {
+	/** Ring identifier assigned by VFS. */
+	sysarg_t id;
+	/** Shared memory area. */
+	void *area;
+	/** Number of entries in each queue. */
+	uint32_t entries;
+	vfs_ring_hdr_t *hdr;
+	vfs_ring_sqe_t *sq;
+	vfs_ring_cqe_t *cq;
+	uint8_t *data;
+	size_t data_size;
+};
+
+/** Create a ring and share it with VFS.
+ *
+ * @param entries   Number of entries in each queue. Rounded up to a power
+ *                  of two.
+ * @param data_size Minimum size of the data area.
+ * @param rring     Place to store the new ring.
+ *
+ * @return EOK on success or a negative error code.
+ */
+int vfs_ring_create(size_t entries, size_t data_size, vfs_ring_t **rring)
+{
+	if ((entries == 0) || (entries > VFS_RING_ENTRIES_MAX))
+		return EINVAL;
+
+	uint32_t n = 1;
+	while (n < entries)
+		n <<= 1;
+
+	vfs_ring_t *ring = malloc(sizeof(vfs_ring_t));
+	if (!ring)
+		return ENOMEM;
+
+	size_t size = ALIGN_UP(VFS_RING_DATA_OFFSET(n) + data_size, PAGE_SIZE);
+	ring->area = as_area_create(AS_AREA_ANY, size,
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE, AS_AREA_UNPAGED);
+	if (ring->area == AS_MAP_FAILED) {
+		free(ring);
+		return ENOMEM;
+	}
+
+	ring->entries = n;
+	ring->hdr = (vfs_ring_hdr_t *) ring->area;
+	ring->sq = (vfs_ring_sqe_t *) ((uint8_t *) ring->area +
+	    VFS_RING_SQ_OFFSET);
+	ring->cq = (vfs_ring_cqe_t *) ((uint8_t *) ring->area +
+	    VFS_RING_CQ_OFFSET(n));
+	ring->data = (uint8_t *) ring->area + VFS_RING_DATA_OFFSET(n);
+	ring->data_size = size - VFS_RING_DATA_OFFSET(n);
+
+	ring->hdr->sq_head = 0;
+	ring->hdr->sq_tail = 0;
+	ring->hdr->cq_head = 0;
+	ring->hdr->cq_tail = 0;
+
+	async_exch_t *exch = vfs_exchange_begin();
+
+	ipc_call_t answer;
+	aid_t req = async_send_1(exch, VFS_IN_RING_SETUP, n, &answer);
+	int rc = async_share_out_start(exch, ring->area,
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE);
+
+	vfs_exchange_end(exch);
+
+	sysarg_t ret;
+	async_wait_for(req, &ret);
+
+	if (rc == EOK)
+		rc = (int) ret;
+
+	if (rc != EOK) {
+		as_area_destroy(ring->area);
+		free(ring);
+		return rc;
+	}
+
+	ring->id = IPC_GET_ARG1(answer);
+	*rring = ring;
+	return EOK;
+}
+
+/** Destroy a ring.
+ *
+ * @param ring Ring to destroy.
+ */
+void vfs_ring_destroy(vfs_ring_t *ring)
+{
+	async_exch_t *exch = vfs_exchange_begin();
+	(void) async_req_1_0(exch, VFS_IN_RING_DESTROY, ring->id);
+	vfs_exchange_end(exch);
+
+	as_area_destroy(ring->area);
+	free(ring);
+}
+
+/** Get the data area of a ring.
+ *
+ * @param ring  Ring.
+ * @param rsize Place to store the size of the data area or @c NULL.
+ *
+ * @return Beginning of the data area.
+ */
+void *vfs_ring_data(vfs_ring_t *ring, size_t *rsize)
+{
+	if (rsize)
+		*rsize = ring->data_size;
+
+	return ring->data;
+}
+
+static int vfs_ring_queue(vfs_ring_t *ring, vfs_ring_op_t op, int file,
+    aoff64_t pos, size_t offset, size_t size, uint64_t user)
+{
+	if ((offset > ring->data_size) || (size > ring->data_size - offset))
+		return EINVAL;
+
+	uint32_t tail = ring->hdr->sq_tail;
+	if (tail - ring->hdr->sq_head >= ring->entries)
+		return ELIMIT;
+
+	vfs_ring_sqe_t *sqe = &ring->sq[tail & (ring->entries - 1)];
+	sqe->op = op;
+	sqe->file = file;
+	sqe->pos = pos;
+	sqe->offset = offset;
+	sqe->size = size;
+	sqe->user = user;
+
+	ring->hdr->sq_tail = tail + 1;
+	return EOK;
+}
+
+/** Queue a read to a ring.
+ *
+ * Unlike vfs_read_short(), the read transfers the whole buffer unless the end
+ * of the file is reached or an error occurs.
+ *
+ * @param ring   Ring.
+ * @param file   File handle to read from.
+ * @param pos    Position to read from.
+ * @param offset Offset of the destination buffer within the data area.
+ * @param size   Number of bytes to read.
+ * @param user   Client data passed back in the completion entry.
+ *
+ * @return EOK on success, ELIMIT if the submission queue is full or EINVAL
+ *         if the buffer does not fit in the data area.
+ */
+int vfs_ring_read(vfs_ring_t *ring, int file, aoff64_t pos, size_t offset,
+    size_t size, uint64_t user)
+{
+	return vfs_ring_queue(ring, VFS_RING_OP_READ, file, pos, offset, size,
+	    user);
+}
+
+/** Queue a write to a ring.
+ *
+ * @param ring   Ring.
+ * @param file   File handle to write to.
+ * @param pos    Position to write to.
+ * @param offset Offset of the source buffer within the data area.
+ * @param size   Number of bytes to write.
+ * @param user   Client data passed back in the completion entry.
+ *
+ * @return EOK on success, ELIMIT if the submission queue is full or EINVAL
+ *         if the buffer does not fit in the data area.
+ */
+int vfs_ring_write(vfs_ring_t *ring, int file, aoff64_t pos, size_t offset,
+    size_t size, uint64_t user)
+{
+	return vfs_ring_queue(ring, VFS_RING_OP_WRITE, file, pos, offset, size,
+	    user);
+}
+
+/** Let VFS process the queued requests.
+ *
+ * VFS stops processing the submission queue when the completion queue
+ * becomes full. The remaining requests are processed by the next call after
+ * the completions are consumed.
+ *
+ * @param ring       Ring.
+ * @param rcompleted Place to store the number of processed requests or
+ *                   @c NULL.
+ *
+ * @return EOK on success or a negative error code.
+ */
+int vfs_ring_submit(vfs_ring_t *ring, size_t *rcompleted)
+{
+	async_exch_t *exch = vfs_exchange_begin();
+	sysarg_t completed;
+	int rc = async_req_1_1(exch, VFS_IN_RING_ENTER, ring->id, &completed);
+	vfs_exchange_end(exch);
+
+	if ((rc == EOK) && (rcompleted))
+		*rcompleted = completed;
+
+	return rc;
+}
+
+/** Consume a completion entry.
+ *
+ * @param ring Ring.
+ * @param cqe  Place to store the completion entry.
+ *
+ * @return True if an entry was consumed, false if the completion queue
+ *         is empty.
+ */
+bool vfs_ring_complete(vfs_ring_t *ring, vfs_ring_cqe_t *cqe)
+{
+	uint32_t head = ring->hdr->cq_head;
+	if (head == ring->hdr->cq_tail)
+		return false;
+
+	*cqe = ring->cq[head & (ring->entries - 1)];
+	ring->hdr->cq_head = head + 1;
+	return true;
+}
+
+/** @}
+ */
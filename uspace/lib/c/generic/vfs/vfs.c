@@ -861,14 +861,16 @@ int vfs_read_short(int file, aoff64_t pos, void *buf, size_t nbyte,
 	ipc_call_t answer;
 	aid_t req;
 	
-	if (nbyte > DATA_XFER_LIMIT)
-		nbyte = DATA_XFER_LIMIT;
+	if (nbyte > DATA_XFER_DIRECT_LIMIT)
+		nbyte = DATA_XFER_DIRECT_LIMIT;
 	
 	async_exch_t *exch = vfs_exchange_begin();
 	
 	req = async_send_3(exch, VFS_IN_READ, file, LOWER32(pos),
 	    UPPER32(pos), &answer);
-	rc = async_data_read_start(exch, (void *) buf, nbyte);
+	/* Buffers that cannot be transferred directly are read in part. */
+	rc = async_data_read_start_generic(exch, (void *) buf, nbyte,
+	    IPC_XF_RESTRICT);
 
 	vfs_exchange_end(exch);
 	
@@ -1305,14 +1307,16 @@ int vfs_write_short(int file, aoff64_t pos, const void *buf, size_t nbyte,
 	ipc_call_t answer;
 	aid_t req;
 	
-	if (nbyte > DATA_XFER_LIMIT)
-		nbyte = DATA_XFER_LIMIT;
+	if (nbyte > DATA_XFER_DIRECT_LIMIT)
+		nbyte = DATA_XFER_DIRECT_LIMIT;
 	
 	async_exch_t *exch = vfs_exchange_begin();
 	
 	req = async_send_3(exch, VFS_IN_WRITE, file, LOWER32(pos),
 	    UPPER32(pos), &answer);
-	rc = async_data_write_start(exch, (void *) buf, nbyte);
+	/* Buffers that cannot be transferred directly are written in part. */
+	rc = async_data_write_start_generic(exch, (void *) buf, nbyte,
+	    IPC_XF_RESTRICT);
 	
 	vfs_exchange_end(exch);
 	
@@ -422,6 +422,8 @@ extern int async_share_out_finalize(cap_handle_t, void **);
 
 extern aid_t async_data_read(async_exch_t *, void *, size_t, ipc_call_t *);
 extern int async_data_read_start(async_exch_t *, void *, size_t);
+extern int async_data_read_start_generic(async_exch_t *, void *, size_t,
+    sysarg_t);
 extern bool async_data_read_receive(cap_handle_t *, size_t *);
 extern bool async_data_read_receive_call(cap_handle_t *, ipc_call_t *, size_t *);
 extern int async_data_read_finalize(cap_handle_t, const void *, size_t);
@@ -461,6 +463,8 @@ extern int async_data_read_forward_fast(async_exch_t *, sysarg_t, sysarg_t,
 	    answer)
 
 extern int async_data_write_start(async_exch_t *, const void *, size_t);
+extern int async_data_write_start_generic(async_exch_t *, const void *, size_t,
+    sysarg_t);
 extern bool async_data_write_receive(cap_handle_t *, size_t *);
 extern bool async_data_write_receive_call(cap_handle_t *, ipc_call_t *, size_t *);
 extern int async_data_write_finalize(cap_handle_t, void *, size_t);
@@ -37,6 +37,8 @@
 
 #include <async.h>
 #include <inet/addr.h>
+#include <pkt_ring.h>
+#include <stdbool.h>
 
 struct iplink_ev_ops;
 
@@ -44,6 +46,10 @@ typedef struct {
 	async_sess_t *sess;
 	struct iplink_ev_ops *ev_ops;
 	void *arg;
+	/** Ring through which the link delivers received datagrams */
+	pkt_ring_t rx_ring;
+	/** The link accepted rx_ring */
+	bool rx_ring_active;
 } iplink_t;
 
 /** IPv4 link Service Data Unit */
@@ -40,6 +40,7 @@
 #include <stdbool.h>
 #include <inet/addr.h>
 #include <inet/iplink.h>
+#include <pkt_ring.h>
 
 struct iplink_ops;
 
@@ -49,6 +50,10 @@ typedef struct {
 	struct iplink_ops *ops;
 	void *arg;
 	async_sess_t *client_sess;
+	/** Ring for delivering received datagrams to the client */
+	pkt_ring_t rx_ring;
+	/** The client has set up rx_ring, protected by @c lock */
+	bool rx_ring_active;
 } iplink_srv_t;
 
 typedef struct iplink_ops {
@@ -39,6 +39,7 @@
 #include <inet/addr.h>
 #include <inet/endpoint.h>
 #include <inet/inet.h>
+#include <offset.h>
 
 /** TCP connection */
 typedef struct {
@@ -67,6 +68,20 @@ typedef struct {
 	void *cb_arg;
 } tcp_listener_t;
 
+/** Buffer shared with the TCP service
+ *
+ * Data placed in the buffer can be sent over any connection of the same
+ * TCP client without being copied through IPC.
+ */
+typedef struct {
+	struct tcp *tcp;
+	sysarg_t id;
+	/** Buffer data */
+	void *data;
+	/** Usable size of the buffer in bytes */
+	size_t size;
+} tcp_shbuf_t;
+
 /** TCP connection callbacks */
 typedef struct tcp_cb {
 	void (*connected)(tcp_conn_t *);
@@ -110,12 +125,19 @@ extern void *tcp_listener_userptr(tcp_listener_t *);
 
 extern int tcp_conn_wait_connected(tcp_conn_t *);
 extern int tcp_conn_send(tcp_conn_t *, const void *, size_t);
+extern int tcp_conn_send_shbuf(tcp_conn_t *, tcp_shbuf_t *, size_t, size_t);
+extern int tcp_conn_send_file(tcp_conn_t *, int, aoff64_t, size_t);
 extern int tcp_conn_send_fin(tcp_conn_t *);
 extern int tcp_conn_push(tcp_conn_t *);
 extern int tcp_conn_reset(tcp_conn_t *);
 
 extern int tcp_conn_recv(tcp_conn_t *, void *, size_t, size_t *);
 extern int tcp_conn_recv_wait(tcp_conn_t *, void *, size_t, size_t *);
+extern int tcp_conn_recv_wait_timeout(tcp_conn_t *, void *, size_t, size_t *,
+    suseconds_t);
+
+extern int tcp_shbuf_create(tcp_t *, size_t, tcp_shbuf_t **);
+extern void tcp_shbuf_destroy(tcp_shbuf_t *);
 
 
 #endif
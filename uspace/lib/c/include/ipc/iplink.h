@@ -44,12 +44,14 @@ typedef enum {
 	IPLINK_SEND,
 	IPLINK_SEND6,
 	IPLINK_ADDR_ADD,
-	IPLINK_ADDR_REMOVE
+	IPLINK_ADDR_REMOVE,
+	IPLINK_RX_RING_SET
 } iplink_request_t;
 
 typedef enum {
 	IPLINK_EV_RECV = IPC_FIRST_USER_METHOD,
 	IPLINK_EV_CHANGE_ADDR,
+	IPLINK_EV_RECV_RING
 } iplink_event_t;
 
 #endif
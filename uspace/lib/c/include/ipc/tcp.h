@@ -48,7 +48,11 @@ typedef enum {
 	TCP_CONN_PUSH,
 	TCP_CONN_RESET,
 	TCP_CONN_RECV,
-	TCP_CONN_RECV_WAIT
+	TCP_CONN_RECV_WAIT,
+	TCP_CONN_SEND_SHBUF,
+	TCP_CONN_SEND_FILE,
+	TCP_SHBUF_CREATE,
+	TCP_SHBUF_DESTROY
 } tcp_request_t;
 
 typedef enum {
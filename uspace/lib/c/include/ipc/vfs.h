@@ -61,6 +61,8 @@ typedef struct {
 	unsigned int instance;
 	bool concurrent_read_write;
 	bool write_retains_size;
+	/** The namespace changes only through VFS, lookups can be cached. */
+	bool cache_lookups;
 } vfs_info_t;
 
 /** Data returned by filesystem probe regarding a specific volume. */
@@ -80,6 +82,9 @@ typedef enum {
 	VFS_IN_REGISTER,
 	VFS_IN_RENAME,
 	VFS_IN_RESIZE,
+	VFS_IN_RING_DESTROY,
+	VFS_IN_RING_ENTER,
+	VFS_IN_RING_SETUP,
 	VFS_IN_STAT,
 	VFS_IN_STATFS,
 	VFS_IN_SYNC,
@@ -190,6 +195,75 @@ enum {
 	MODE_APPEND = 4,
 };
 
+/*
+ * Submission and completion ring shared between a client and VFS.
+ *
+ * The ring is a single shared memory area consisting of a header, an array of
+ * submission queue entries, an array of completion queue entries and a data
+ * area. Data of the queued reads and writes is transferred to and from the
+ * data area. The client produces submission entries and consumes completion
+ * entries, VFS does the opposite. VFS processes the submitted entries when
+ * the client asks it to with VFS_IN_RING_ENTER.
+ */
+
+/** Maximum number of entries in each queue of the ring. */
+#define VFS_RING_ENTRIES_MAX  1024
+
+typedef enum {
+	VFS_RING_OP_READ,
+	VFS_RING_OP_WRITE
+} vfs_ring_op_t;
+
+/** Submission queue entry. */
+typedef struct {
+	/** Operation, one of vfs_ring_op_t. */
+	uint32_t op;
+	/** File handle. */
+	int32_t file;
+	/** File position. */
+	uint64_t pos;
+	/** Offset of the buffer within the data area. */
+	uint64_t offset;
+	/** Number of bytes to transfer. */
+	uint64_t size;
+	/** Client data copied to the completion entry. */
+	uint64_t user;
+} vfs_ring_sqe_t;
+
+/** Completion queue entry. */
+typedef struct {
+	/** Client data of the submission entry. */
+	uint64_t user;
+	/** Number of bytes transferred. */
+	uint64_t bytes;
+	/** Return code of the operation. */
+	int32_t rc;
+	uint32_t pad;
+} vfs_ring_cqe_t;
+
+/** Ring header. */
+typedef struct {
+	/** Next submission entry to be processed by VFS. */
+	volatile uint32_t sq_head;
+	/** Next submission entry to be produced by the client. */
+	volatile uint32_t sq_tail;
+	/** Next completion entry to be consumed by the client. */
+	volatile uint32_t cq_head;
+	/** Next completion entry to be produced by VFS. */
+	volatile uint32_t cq_tail;
+} vfs_ring_hdr_t;
+
+/** Offset of the submission queue within the ring. */
+#define VFS_RING_SQ_OFFSET  (sizeof(vfs_ring_hdr_t))
+
+/** Offset of the completion queue within the ring. */
+#define VFS_RING_CQ_OFFSET(entries) \
+	(VFS_RING_SQ_OFFSET + (entries) * sizeof(vfs_ring_sqe_t))
+
+/** Offset of the data area within the ring. */
+#define VFS_RING_DATA_OFFSET(entries) \
+	(VFS_RING_CQ_OFFSET(entries) + (entries) * sizeof(vfs_ring_cqe_t))
+
 #endif
 
 /** @}
@@ -222,6 +222,13 @@ typedef struct nic_device_stats {
 	unsigned long receive_compressed;
 	/** Total compressed packet transmitted. */
 	unsigned long send_compressed;
+
+	/* receive interrupt moderation */
+
+	/** Receive interrupts handled. */
+	unsigned long receive_interrupts;
+	/** Polls of the receive buffers done with the interrupts disabled. */
+	unsigned long receive_polls;
 } nic_device_stats_t;
 
 /** Errors corresponding to those in the nic_device_stats_t */
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libc
+ * @{
+ */
+/** @file
+ */
+
+#ifndef LIBC_PKT_RING_H_
+#define LIBC_PKT_RING_H_
+
+#include <async.h>
+#include <fibril_synch.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Header of a packet ring, at the beginning of the shared area.
+ *
+ * The ring is a single-producer single-consumer queue of fixed-size slots.
+ * The producer only writes @c head and @c notify, the consumer only writes
+ * @c tail and clears @c notify.
+ */
+typedef struct {
+	/** Number of slots, a power of two */
+	uint32_t slots;
+	/** Size of a slot including the slot header */
+	uint32_t slot_size;
+	/** Number of packets produced so far */
+	volatile uint32_t head;
+	/** Number of packets consumed so far */
+	volatile uint32_t tail;
+	/** Consumer has been notified and has not started draining yet */
+	volatile uint32_t notify;
+} pkt_ring_hdr_t;
+
+/** Header of a single slot. */
+typedef struct {
+	/** Size of the packet */
+	uint32_t size;
+	/** Packet argument passed from the producer to the consumer */
+	uint32_t arg;
+} pkt_ring_slot_t;
+
+/** Local view of a packet ring.
+ *
+ * The geometry and the producer's or consumer's index are kept in private
+ * copies, so the other side cannot corrupt them through the shared area.
+ */
+typedef struct {
+	/** Shared memory area */
+	void *area;
+	/** Size of the area */
+	size_t area_size;
+	/** Number of slots */
+	uint32_t slots;
+	/** Size of a slot including the slot header */
+	uint32_t slot_size;
+	/** Private copy of the index written by this side */
+	uint32_t index;
+	/** Serializes producers sharing this side of the ring */
+	fibril_mutex_t lock;
+} pkt_ring_t;
+
+extern int pkt_ring_create(pkt_ring_t *, size_t, size_t);
+extern int pkt_ring_share(pkt_ring_t *, async_exch_t *);
+extern int pkt_ring_attach(pkt_ring_t *, cap_handle_t, size_t, unsigned int);
+extern void pkt_ring_destroy(pkt_ring_t *);
+
+extern int pkt_ring_put(pkt_ring_t *, const void *, size_t, uint32_t, bool *);
+
+extern void pkt_ring_arm(pkt_ring_t *);
+extern bool pkt_ring_get(pkt_ring_t *, void **, size_t *, uint32_t *);
+extern void pkt_ring_release(pkt_ring_t *);
+
+#endif
+
+/** @}
+ */
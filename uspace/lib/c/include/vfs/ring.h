@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libc
+ * @{
+ */
+/** @file
+ */
+
+#ifndef LIBC_VFS_RING_H_
+#define LIBC_VFS_RING_H_
+
+#include <ipc/vfs.h>
+#include <offset.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Submission and completion ring shared with VFS. */
+typedef struct vfs_ring vfs_ring_t;
+
+extern int vfs_ring_create(size_t, size_t, vfs_ring_t **);
+extern void vfs_ring_destroy(vfs_ring_t *);
+extern void *vfs_ring_data(vfs_ring_t *, size_t *);
+extern int vfs_ring_read(vfs_ring_t *, int, aoff64_t, size_t, size_t,
+    uint64_t);
+extern int vfs_ring_write(vfs_ring_t *, int, aoff64_t, size_t, size_t,
+    uint64_t);
+extern int vfs_ring_submit(vfs_ring_t *, size_t *);
+extern bool vfs_ring_complete(vfs_ring_t *, vfs_ring_cqe_t *);
+
+#endif
+
+/** @}
+ */
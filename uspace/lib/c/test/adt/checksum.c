@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <adt/checksum.h>
+#include <pcut/pcut.h>
+#include <stddef.h>
+#include <stdint.h>
+
+PCUT_INIT
+
+PCUT_TEST_SUITE(checksum);
+
+enum {
+	buffer_size = 1024
+};
+
+static uint8_t buffer[buffer_size];
+
+static uint8_t check_str[] = "123456789";
+
+/** Bit-by-bit reference implementation of a reflected CRC. */
+static uint32_t crc_ref(uint32_t poly, const uint8_t *data, size_t length,
+    uint32_t seed)
+{
+	uint32_t crc = ~seed;
+
+	while (length-- > 0) {
+		crc ^= *data++;
+		for (unsigned int bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ ((crc & 1) ? poly : 0);
+	}
+
+	return ~crc;
+}
+
+static void fill_buffer(void)
+{
+	uint32_t seed = 1;
+
+	for (size_t i = 0; i < buffer_size; i++) {
+		seed = seed * 1103515245 + 12345;
+		buffer[i] = seed >> 16;
+	}
+}
+
+/** Standard check values of the CRC catalogue. */
+PCUT_TEST(check_values)
+{
+	PCUT_ASSERT_INT_EQUALS(0xcbf43926, compute_crc32(check_str, 9));
+	PCUT_ASSERT_INT_EQUALS(0xe3069283, compute_crc32c(check_str, 9));
+	PCUT_ASSERT_INT_EQUALS(0, compute_crc32(check_str, 0));
+	PCUT_ASSERT_INT_EQUALS(0, compute_crc32c(check_str, 0));
+}
+
+/** Computing in pieces gives the same result as in one go. */
+PCUT_TEST(seed_chaining)
+{
+	fill_buffer();
+
+	for (size_t split = 0; split <= 64; split++) {
+		uint32_t crc = compute_crc32(buffer, split);
+		crc = compute_crc32_seed(buffer + split, 64 - split, crc);
+		PCUT_ASSERT_INT_EQUALS(compute_crc32(buffer, 64), crc);
+
+		crc = compute_crc32c(buffer, split);
+		crc = compute_crc32c_seed(buffer + split, 64 - split, crc);
+		PCUT_ASSERT_INT_EQUALS(compute_crc32c(buffer, 64), crc);
+	}
+}
+
+/** All lengths and alignments match the bitwise reference. */
+PCUT_TEST(reference)
+{
+	fill_buffer();
+
+	for (size_t offset = 0; offset < 8; offset++) {
+		for (size_t length = 0; length < 100; length++) {
+			PCUT_ASSERT_INT_EQUALS(
+			    crc_ref(0xedb88320, buffer + offset, length, 0),
+			    compute_crc32(buffer + offset, length));
+			PCUT_ASSERT_INT_EQUALS(
+			    crc_ref(0x82f63b78, buffer + offset, length, 0),
+			    compute_crc32c(buffer + offset, length));
+		}
+	}
+
+	PCUT_ASSERT_INT_EQUALS(crc_ref(0xedb88320, buffer, buffer_size, 0),
+	    compute_crc32(buffer, buffer_size));
+	PCUT_ASSERT_INT_EQUALS(crc_ref(0x82f63b78, buffer, buffer_size, 0),
+	    compute_crc32c(buffer, buffer_size));
+}
+
+PCUT_EXPORT(checksum);
@@ -31,6 +31,7 @@
 
 PCUT_INIT
 
+PCUT_IMPORT(checksum);
 PCUT_IMPORT(circ_buf);
 PCUT_IMPORT(fibril_timer);
 PCUT_IMPORT(odict);
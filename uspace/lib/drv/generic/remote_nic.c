@@ -85,7 +85,8 @@ typedef enum {
 	NIC_OFFLOAD_SET,
 	NIC_POLL_GET_MODE,
 	NIC_POLL_SET_MODE,
-	NIC_POLL_NOW
+	NIC_POLL_NOW,
+	NIC_RX_RING_SET
 } nic_funcs_t;
 
 /** Send frame from NIC
@@ -1335,6 +1336,39 @@ int nic_poll_now(async_sess_t *dev_sess)
 	return rc;
 }
 
+/** Deliver received frames through a packet ring.
+ *
+ * The driver copies the received frames into the ring and sends a single
+ * NIC_EV_RECEIVED_RING notification for all frames queued until the client
+ * starts draining the ring. Frames which do not fit in the ring are still
+ * delivered by NIC_EV_RECEIVED.
+ *
+ * @param[in] dev_sess
+ * @param[in] ring     Ring created by pkt_ring_create()
+ *
+ * @return EOK If the operation was successfully completed
+ *
+ */
+int nic_rx_ring_set(async_sess_t *dev_sess, pkt_ring_t *ring)
+{
+	async_exch_t *exch = async_exchange_begin(dev_sess);
+	
+	ipc_call_t answer;
+	aid_t req = async_send_1(exch, DEV_IFACE_ID(NIC_DEV_IFACE),
+	    NIC_RX_RING_SET, &answer);
+	int rc = pkt_ring_share(ring, exch);
+	
+	async_exchange_end(exch);
+	
+	sysarg_t retval;
+	async_wait_for(req, &retval);
+	
+	if (rc != EOK)
+		return rc;
+	
+	return (int) retval;
+}
+
 static void remote_nic_send_frame(ddf_fun_t *dev, void *iface,
     ipc_callid_t callid, ipc_call_t *call)
 {
@@ -2488,6 +2522,29 @@ static void remote_nic_poll_now(ddf_fun_t *dev, void *iface,
 	async_answer_0(callid, rc);
 }
 
+static void remote_nic_rx_ring_set(ddf_fun_t *dev, void *iface,
+    ipc_callid_t callid, ipc_call_t *call)
+{
+	nic_iface_t *nic_iface = (nic_iface_t *) iface;
+	
+	ipc_callid_t share_callid;
+	size_t size;
+	unsigned int flags;
+	if (!async_share_out_receive(&share_callid, &size, &flags)) {
+		async_answer_0(callid, EINVAL);
+		return;
+	}
+	
+	if (nic_iface->rx_ring_set == NULL) {
+		async_answer_0(share_callid, ENOTSUP);
+		async_answer_0(callid, ENOTSUP);
+		return;
+	}
+	
+	int rc = nic_iface->rx_ring_set(dev, share_callid, size, flags);
+	async_answer_0(callid, rc);
+}
+
 /** Remote NIC interface operations.
  *
  */
@@ -2532,7 +2589,8 @@ static const remote_iface_func_ptr_t remote_nic_iface_ops[] = {
 	[NIC_OFFLOAD_SET] = remote_nic_offload_set,
 	[NIC_POLL_GET_MODE] = remote_nic_poll_get_mode,
 	[NIC_POLL_SET_MODE] = remote_nic_poll_set_mode,
-	[NIC_POLL_NOW] = remote_nic_poll_now
+	[NIC_POLL_NOW] = remote_nic_poll_now,
+	[NIC_RX_RING_SET] = remote_nic_rx_ring_set
 };
 
 /** Remote NIC interface structure.
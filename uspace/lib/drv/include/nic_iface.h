@@ -38,12 +38,14 @@
 #include <async.h>
 #include <nic/nic.h>
 #include <ipc/common.h>
+#include <pkt_ring.h>
 
 
 typedef enum {
 	NIC_EV_ADDR_CHANGED = IPC_FIRST_USER_METHOD,
 	NIC_EV_RECEIVED,
-	NIC_EV_DEVICE_STATE
+	NIC_EV_DEVICE_STATE,
+	NIC_EV_RECEIVED_RING
 } nic_event_t;
 
 extern int nic_send_frame(async_sess_t *, void *, size_t);
@@ -110,6 +112,8 @@ extern int nic_poll_set_mode(async_sess_t *, nic_poll_mode_t,
     const struct timeval *);
 extern int nic_poll_now(async_sess_t *);
 
+extern int nic_rx_ring_set(async_sess_t *, pkt_ring_t *);
+
 #endif
 
 /** @}
@@ -107,6 +107,7 @@ typedef struct nic_iface {
 	int (*poll_set_mode)(ddf_fun_t *, nic_poll_mode_t,
 	    const struct timeval *);
 	int (*poll_now)(ddf_fun_t *);
+	int (*rx_ring_set)(ddf_fun_t *, cap_handle_t, size_t, unsigned int);
 } nic_iface_t;
 
 #endif
@@ -41,6 +41,12 @@ extern int ext4_balloc_free_blocks(ext4_inode_ref_t *, uint32_t, uint32_t);
 extern uint32_t ext4_balloc_get_first_data_block_in_group(ext4_superblock_t *,
     ext4_block_group_ref_t *);
 extern int ext4_balloc_alloc_block(ext4_inode_ref_t *, uint32_t *);
+extern int ext4_balloc_alloc_blocks(ext4_inode_ref_t *, uint32_t, uint32_t,
+    uint32_t *, uint32_t *);
+extern int ext4_balloc_prealloc_init(ext4_filesystem_t *);
+extern void ext4_balloc_prealloc_fini(ext4_filesystem_t *);
+extern int ext4_balloc_release_prealloc(ext4_filesystem_t *, uint32_t);
+extern int ext4_balloc_release_prealloc_all(ext4_filesystem_t *);
 extern int ext4_balloc_try_alloc_block(ext4_inode_ref_t *, uint32_t, bool *);
 
 #endif
@@ -63,6 +63,8 @@ extern void ext4_extent_header_set_generation(ext4_extent_header_t *, uint32_t);
 extern int ext4_extent_find_block(ext4_inode_ref_t *, uint32_t, uint32_t *);
 extern int ext4_extent_release_blocks_from(ext4_inode_ref_t *, uint32_t);
 
+extern int ext4_extent_append_blocks(ext4_inode_ref_t *, uint32_t *,
+    uint32_t *, uint32_t *, bool);
 extern int ext4_extent_append_block(ext4_inode_ref_t *, uint32_t *, uint32_t *,
     bool);
 
@@ -34,7 +34,9 @@
 #ifndef LIBEXT4_TYPES_H_
 #define LIBEXT4_TYPES_H_
 
+#include <adt/hash_table.h>
 #include <block.h>
+#include <fibril_synch.h>
 
 /*
  * Structure of the super block
@@ -229,8 +231,22 @@ typedef struct ext4_filesystem {
 	ext4_superblock_t *superblock;
 	aoff64_t inode_block_limits[4];
 	aoff64_t inode_blocks_per_level[4];
+	/* Preallocation windows of inodes, outliving the inode references */
+	hash_table_t prealloc_windows;
+	fibril_mutex_t prealloc_lock;
 } ext4_filesystem_t;
 
+/*
+ * Blocks reserved for the next appends to an inode, not yet mapped to it
+ */
+typedef struct ext4_prealloc {
+	ht_link_t link;
+	uint32_t index;   /* Index of the inode */
+	uint32_t iblock;  /* Logical block the window starts at */
+	uint32_t fblock;  /* Physical address of the window */
+	uint32_t count;   /* Number of blocks in the window */
+} ext4_prealloc_t;
+
 
 #define EXT4_BLOCK_GROUP_INODE_UNINIT   0x0001  /* Inode table/bitmap not in use */
 #define EXT4_BLOCK_GROUP_BLOCK_UNINIT   0x0002  /* Block bitmap not in use */
@@ -34,8 +34,12 @@
  * @brief Physical block allocator.
  */
 
+#include <adt/hash_table.h>
 #include <errno.h>
+#include <fibril_synch.h>
+#include <macros.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include "ext4/balloc.h"
 #include "ext4/bitmap.h"
 #include "ext4/block_group.h"
@@ -44,6 +48,12 @@
 #include "ext4/superblock.h"
 #include "ext4/types.h"
 
+/** Smallest preallocation request for regular files (in blocks) */
+#define EXT4_BALLOC_PREALLOC_MIN  16
+
+/** Requests are not rounded up beyond this size (in blocks) */
+#define EXT4_BALLOC_PREALLOC_MAX  2048
+
 /** Free block.
  *
  * @param inode_ref  Inode, where the block is allocated
@@ -117,10 +127,9 @@ int ext4_balloc_free_block(ext4_inode_ref_t *inode_ref, uint32_t block_addr)
 	return ext4_filesystem_put_block_group_ref(bg_ref);
 }
 
-static int ext4_balloc_free_blocks_internal(ext4_inode_ref_t *inode_ref,
-    uint32_t first, uint32_t count)
+static int ext4_balloc_free_blocks_internal(ext4_filesystem_t *fs,
+    ext4_inode_ref_t *inode_ref, uint32_t first, uint32_t count)
 {
-	ext4_filesystem_t *fs = inode_ref->fs;
 	ext4_superblock_t *sb = fs->superblock;
 
 	/* Compute indexes */
@@ -171,12 +180,14 @@ static int ext4_balloc_free_blocks_internal(ext4_inode_ref_t *inode_ref,
 	sb_free_blocks += count;
 	ext4_superblock_set_free_blocks_count(sb, sb_free_blocks);
 
-	/* Update inode blocks count */
-	uint64_t ino_blocks =
-	    ext4_inode_get_blocks_count(sb, inode_ref->inode);
-	ino_blocks -= count * (block_size / EXT4_INODE_BLOCK_SIZE);
-	ext4_inode_set_blocks_count(sb, inode_ref->inode, ino_blocks);
-	inode_ref->dirty = true;
+	/* Update inode blocks count, unless freeing a preallocation window */
+	if (inode_ref != NULL) {
+		uint64_t ino_blocks =
+		    ext4_inode_get_blocks_count(sb, inode_ref->inode);
+		ino_blocks -= count * (block_size / EXT4_INODE_BLOCK_SIZE);
+		ext4_inode_set_blocks_count(sb, inode_ref->inode, ino_blocks);
+		inode_ref->dirty = true;
+	}
 
 	/* Update block group free blocks count */
 	uint32_t free_blocks =
@@ -217,7 +228,7 @@ int ext4_balloc_free_blocks(ext4_inode_ref_t *inode_ref,
 			 */
 			uint32_t s = limit - first;
 
-			r = ext4_balloc_free_blocks_internal(inode_ref,
+			r = ext4_balloc_free_blocks_internal(fs, inode_ref,
 			    first, s);
 			if (r != EOK)
 				return r;
@@ -225,7 +236,7 @@ int ext4_balloc_free_blocks(ext4_inode_ref_t *inode_ref,
 			first = limit;
 			count -= s;
 		} else {
-			return ext4_balloc_free_blocks_internal(inode_ref,
+			return ext4_balloc_free_blocks_internal(fs, inode_ref,
 			    first, count);
 		}
 	}
@@ -615,6 +626,500 @@ success:
 	return rc;
 }
 
+/** Search one block group for a run of free blocks and allocate it.
+ *
+ * If @a goal lies in the group and is free, the run starting at the goal is
+ * taken regardless of its length. Otherwise the group is searched for a run
+ * of @a want blocks, starting at the goal and wrapping around to the first
+ * data block of the group. A shorter run is only taken if it has at least
+ * @a min_len blocks.
+ *
+ * @param inode_ref Inode to allocate blocks for
+ * @param bgid      Index of block group to search
+ * @param goal      Preferred block address (or 0 for none)
+ * @param want      Requested number of blocks
+ * @param min_len   Minimal acceptable number of blocks
+ * @param fblock    Output value - first allocated block address
+ * @param count     Output value - number of allocated blocks (0 if none)
+ *
+ * @return Error code
+ *
+ */
+static int ext4_balloc_alloc_run_in_group(ext4_inode_ref_t *inode_ref,
+    uint32_t bgid, uint32_t goal, uint32_t want, uint32_t min_len,
+    uint32_t *fblock, uint32_t *count)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
+	ext4_superblock_t *sb = fs->superblock;
+	
+	*count = 0;
+	
+	/* Load block group reference */
+	ext4_block_group_ref_t *bg_ref;
+	int rc = ext4_filesystem_get_block_group_ref(fs, bgid, &bg_ref);
+	if (rc != EOK)
+		return rc;
+	
+	uint32_t free_blocks =
+	    ext4_block_group_get_free_blocks_count(bg_ref->block_group, sb);
+	if (free_blocks < min_len) {
+		/* This group cannot satisfy the request */
+		return ext4_filesystem_put_block_group_ref(bg_ref);
+	}
+	
+	/* Compute indexes */
+	uint32_t first_in_group =
+	    ext4_balloc_get_first_data_block_in_group(sb, bg_ref);
+	uint32_t first_index =
+	    ext4_filesystem_blockaddr2_index_in_group(sb, first_in_group);
+	uint32_t blocks_in_group = ext4_superblock_get_blocks_in_group(sb, bgid);
+	
+	uint32_t start = first_index;
+	if ((goal != 0) && (ext4_filesystem_blockaddr2group(sb, goal) == bgid))
+		start = max(first_index,
+		    ext4_filesystem_blockaddr2_index_in_group(sb, goal));
+	
+	/* Load block with bitmap */
+	uint32_t bitmap_block_addr =
+	    ext4_block_group_get_block_bitmap(bg_ref->block_group, sb);
+	block_t *bitmap_block;
+	rc = block_get(&bitmap_block, fs->device, bitmap_block_addr,
+	    BLOCK_FLAGS_NONE);
+	if (rc != EOK) {
+		ext4_filesystem_put_block_group_ref(bg_ref);
+		return rc;
+	}
+	
+	uint32_t index = start;
+	uint32_t len = 0;
+	
+	if ((start < blocks_in_group) &&
+	    ext4_bitmap_is_free_bit(bitmap_block->data, start)) {
+		/* Goal is free, extend the run from it */
+		len = 1;
+		while ((len < want) && (start + len < blocks_in_group) &&
+		    ext4_bitmap_is_free_bit(bitmap_block->data, start + len))
+			len++;
+	} else {
+		/* Search the rest of the group, then wrap around */
+		len = ext4_bitmap_find_free_run(bitmap_block->data, start,
+		    blocks_in_group, want, &index);
+		
+		if ((len < want) && (start > first_index)) {
+			uint32_t index2;
+			uint32_t len2 = ext4_bitmap_find_free_run(
+			    bitmap_block->data, first_index, start, want,
+			    &index2);
+			if (len2 > len) {
+				index = index2;
+				len = len2;
+			}
+		}
+		
+		if (len < min_len)
+			len = 0;
+	}
+	
+	if (len > 0) {
+		ext4_bitmap_set_bits(bitmap_block->data, index, len);
+		bitmap_block->dirty = true;
+	}
+	
+	rc = block_put(bitmap_block);
+	if ((rc != EOK) || (len == 0)) {
+		int rc2 = ext4_filesystem_put_block_group_ref(bg_ref);
+		return rc != EOK ? rc : rc2;
+	}
+	
+	/* Update superblock free blocks count */
+	uint32_t sb_free_blocks = ext4_superblock_get_free_blocks_count(sb);
+	sb_free_blocks -= len;
+	ext4_superblock_set_free_blocks_count(sb, sb_free_blocks);
+	
+	/* Update block group free blocks count */
+	free_blocks -= len;
+	ext4_block_group_set_free_blocks_count(bg_ref->block_group, sb,
+	    free_blocks);
+	bg_ref->dirty = true;
+	
+	*fblock = ext4_filesystem_index_in_group2blockaddr(sb, index, bgid);
+	*count = len;
+	
+	return ext4_filesystem_put_block_group_ref(bg_ref);
+}
+
+/** Allocate a run of physically continuous blocks.
+ *
+ * The group of the goal is tried first, then the remaining groups are
+ * searched for a run of the requested length. If there is no such run
+ * on the filesystem, a shorter one is allocated. Inode blocks count is
+ * not updated.
+ *
+ * @param inode_ref Inode to allocate blocks for
+ * @param goal      Preferred address of the first block
+ * @param want      Requested number of blocks
+ * @param fblock    Output value - first allocated block address
+ * @param count     Output value - number of allocated blocks
+ *
+ * @return Error code
+ *
+ */
+static int ext4_balloc_alloc_run(ext4_inode_ref_t *inode_ref, uint32_t goal,
+    uint32_t want, uint32_t *fblock, uint32_t *count)
+{
+	ext4_superblock_t *sb = inode_ref->fs->superblock;
+	uint32_t block_group_count = ext4_superblock_get_block_group_count(sb);
+	uint32_t goal_group = ext4_filesystem_blockaddr2group(sb, goal);
+	
+	if (goal_group >= block_group_count)
+		goal_group = 0;
+	
+	/*
+	 * First pass looks for a run of the full length, second pass takes
+	 * whatever is left.
+	 */
+	uint32_t min_len = want;
+	for (unsigned int pass = 0; pass < 2; pass++) {
+		uint32_t bgid = goal_group;
+		for (uint32_t i = 0; i < block_group_count; i++) {
+			int rc = ext4_balloc_alloc_run_in_group(inode_ref, bgid,
+			    goal, want, min_len, fblock, count);
+			if (rc != EOK)
+				return rc;
+			
+			if (*count > 0)
+				return EOK;
+			
+			bgid = (bgid + 1) % block_group_count;
+		}
+		
+		min_len = 1;
+	}
+	
+	return ENOSPC;
+}
+
+/* Hash table interface for preallocation windows */
+
+static size_t prealloc_key_hash(void *key_arg)
+{
+	return *(uint32_t *) key_arg;
+}
+
+static size_t prealloc_hash(const ht_link_t *item)
+{
+	ext4_prealloc_t *window = hash_table_get_inst(item, ext4_prealloc_t,
+	    link);
+	return window->index;
+}
+
+static bool prealloc_key_equal(void *key_arg, const ht_link_t *item)
+{
+	ext4_prealloc_t *window = hash_table_get_inst(item, ext4_prealloc_t,
+	    link);
+	return window->index == *(uint32_t *) key_arg;
+}
+
+static hash_table_ops_t prealloc_ops = {
+	.hash = prealloc_hash,
+	.key_hash = prealloc_key_hash,
+	.key_equal = prealloc_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
+/** Initialize the table of preallocation windows.
+ *
+ * @param fs Filesystem
+ *
+ * @return Error code
+ *
+ */
+int ext4_balloc_prealloc_init(ext4_filesystem_t *fs)
+{
+	if (!hash_table_create(&fs->prealloc_windows, 0, 0, &prealloc_ops))
+		return ENOMEM;
+	
+	fibril_mutex_initialize(&fs->prealloc_lock);
+	return EOK;
+}
+
+static bool prealloc_forget(ht_link_t *item, void *arg)
+{
+	ext4_filesystem_t *fs = (ext4_filesystem_t *) arg;
+	ext4_prealloc_t *window = hash_table_get_inst(item, ext4_prealloc_t,
+	    link);
+	
+	hash_table_remove_item(&fs->prealloc_windows, item);
+	free(window);
+	return true;
+}
+
+/** Destroy the table of preallocation windows.
+ *
+ * Windows not released yet are forgotten, their blocks stay allocated.
+ *
+ * @param fs Filesystem
+ *
+ */
+void ext4_balloc_prealloc_fini(ext4_filesystem_t *fs)
+{
+	hash_table_apply(&fs->prealloc_windows, prealloc_forget, fs);
+	hash_table_destroy(&fs->prealloc_windows);
+}
+
+/** Remove the preallocation window of an inode from the table.
+ *
+ * @param fs    Filesystem
+ * @param index Index of the inode
+ *
+ * @return Window of the inode or NULL if it has none
+ *
+ */
+static ext4_prealloc_t *prealloc_take(ext4_filesystem_t *fs, uint32_t index)
+{
+	ext4_prealloc_t *window = NULL;
+	
+	fibril_mutex_lock(&fs->prealloc_lock);
+	
+	ht_link_t *item = hash_table_find(&fs->prealloc_windows, &index);
+	if (item != NULL) {
+		window = hash_table_get_inst(item, ext4_prealloc_t, link);
+		hash_table_remove_item(&fs->prealloc_windows, item);
+	}
+	
+	fibril_mutex_unlock(&fs->prealloc_lock);
+	return window;
+}
+
+/** Return the blocks of a preallocation window and free the window.
+ *
+ * @param fs     Filesystem
+ * @param window Window no longer in the table
+ *
+ * @return Error code
+ *
+ */
+static int prealloc_free(ext4_filesystem_t *fs, ext4_prealloc_t *window)
+{
+	/* The window never spans over block groups */
+	int rc = ext4_balloc_free_blocks_internal(fs, NULL, window->fblock,
+	    window->count);
+	
+	free(window);
+	return rc;
+}
+
+/** Insert the preallocation window of an inode into the table.
+ *
+ * @param fs     Filesystem
+ * @param window Window to insert
+ *
+ */
+static void prealloc_put(ext4_filesystem_t *fs, ext4_prealloc_t *window)
+{
+	fibril_mutex_lock(&fs->prealloc_lock);
+	
+	if (hash_table_find(&fs->prealloc_windows, &window->index) == NULL) {
+		hash_table_insert(&fs->prealloc_windows, &window->link);
+		window = NULL;
+	}
+	
+	fibril_mutex_unlock(&fs->prealloc_lock);
+	
+	/* Another window has been set up for the inode meanwhile */
+	if (window != NULL)
+		(void) prealloc_free(fs, window);
+}
+
+/** Release unused blocks preallocated for an inode.
+ *
+ * Called when the inode is closed or destroyed.
+ *
+ * @param fs    Filesystem
+ * @param index Index of the inode the blocks were preallocated for
+ *
+ * @return Error code
+ *
+ */
+int ext4_balloc_release_prealloc(ext4_filesystem_t *fs, uint32_t index)
+{
+	ext4_prealloc_t *window = prealloc_take(fs, index);
+	if (window == NULL)
+		return EOK;
+	
+	return prealloc_free(fs, window);
+}
+
+typedef struct {
+	ext4_filesystem_t *fs;
+	int rc;
+} prealloc_release_arg_t;
+
+static bool prealloc_release(ht_link_t *item, void *arg)
+{
+	prealloc_release_arg_t *rarg = (prealloc_release_arg_t *) arg;
+	ext4_prealloc_t *window = hash_table_get_inst(item, ext4_prealloc_t,
+	    link);
+	
+	hash_table_remove_item(&rarg->fs->prealloc_windows, item);
+	
+	int rc = prealloc_free(rarg->fs, window);
+	if (rarg->rc == EOK)
+		rarg->rc = rc;
+	
+	return true;
+}
+
+/** Release unused blocks preallocated for all inodes.
+ *
+ * Called before the filesystem is unmounted.
+ *
+ * @param fs Filesystem
+ *
+ * @return Error code
+ *
+ */
+int ext4_balloc_release_prealloc_all(ext4_filesystem_t *fs)
+{
+	prealloc_release_arg_t arg = {
+		.fs = fs,
+		.rc = EOK
+	};
+	
+	fibril_mutex_lock(&fs->prealloc_lock);
+	hash_table_apply(&fs->prealloc_windows, prealloc_release, &arg);
+	fibril_mutex_unlock(&fs->prealloc_lock);
+	
+	return arg.rc;
+}
+
+/** Allocate data blocks for a range of logical blocks.
+ *
+ * Allocates physically continuous blocks for logical blocks starting at
+ * @a iblock. Appends to a regular file are served from the preallocation
+ * window of the inode. When the window is empty, the request is rounded up
+ * and the blocks not needed now are kept in the window for the following
+ * appends, so that a file growing in small steps stays continuous on disk.
+ * The window is kept by the filesystem until the file is closed.
+ *
+ * Fewer blocks than requested may be allocated when free space is
+ * fragmented.
+ *
+ * @param inode_ref Inode to allocate blocks for
+ * @param iblock    First logical block to allocate for
+ * @param count     Number of blocks requested
+ * @param fblock    Output value - first allocated block address
+ * @param allocated Output value - number of allocated blocks
+ *
+ * @return Error code
+ *
+ */
+int ext4_balloc_alloc_blocks(ext4_inode_ref_t *inode_ref, uint32_t iblock,
+    uint32_t count, uint32_t *fblock, uint32_t *allocated)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
+	ext4_superblock_t *sb = fs->superblock;
+	uint32_t got;
+	int rc;
+	
+	assert(count > 0);
+	
+	ext4_prealloc_t *window = prealloc_take(fs, inode_ref->index);
+	if (window != NULL) {
+		if (window->iblock == iblock) {
+			/* Continue in the preallocation window */
+			got = min(count, window->count);
+			*fblock = window->fblock;
+			
+			window->iblock += got;
+			window->fblock += got;
+			window->count -= got;
+			
+			if (window->count > 0)
+				prealloc_put(fs, window);
+			else
+				free(window);
+			
+			goto success;
+		}
+		
+		/* Not an append to the window, give it up */
+		rc = prealloc_free(fs, window);
+		if (rc != EOK)
+			return rc;
+	}
+	
+	/* Place the blocks just after the preceding logical block */
+	uint32_t goal = 0;
+	if (iblock > 0) {
+		rc = ext4_filesystem_get_inode_data_block_index(inode_ref,
+		    iblock - 1, &goal);
+		if (rc != EOK)
+			return rc;
+		
+		if (goal != 0)
+			goal++;
+	}
+	
+	if (goal == 0) {
+		rc = ext4_balloc_find_goal(inode_ref, &goal);
+		if (rc != EOK)
+			return rc;
+	}
+	
+	/* Round regular file requests up to reserve space for appends */
+	uint32_t want = count;
+	if (ext4_inode_is_type(sb, inode_ref->inode, EXT4_INODE_MODE_FILE)) {
+		want = EXT4_BALLOC_PREALLOC_MIN;
+		while ((want < count) && (want < EXT4_BALLOC_PREALLOC_MAX))
+			want *= 2;
+		want = max(want, count);
+	}
+	
+	want = min(want, ext4_superblock_get_blocks_per_group(sb));
+	
+	rc = ext4_balloc_alloc_run(inode_ref, goal, want, fblock, &got);
+	if (rc != EOK)
+		return rc;
+	
+	if (got > count) {
+		/* Keep the rest for the following appends */
+		window = malloc(sizeof(ext4_prealloc_t));
+		if (window == NULL) {
+			rc = ext4_balloc_free_blocks_internal(fs, NULL,
+			    *fblock + count, got - count);
+			if (rc != EOK) {
+				ext4_balloc_free_blocks_internal(fs, NULL,
+				    *fblock, count);
+				return rc;
+			}
+		} else {
+			window->index = inode_ref->index;
+			window->iblock = iblock + count;
+			window->fblock = *fblock + count;
+			window->count = got - count;
+			prealloc_put(fs, window);
+		}
+		
+		got = count;
+	}
+	
+success:
+	;
+	
+	/* Update inode blocks (different block size!) count */
+	uint32_t block_size = ext4_superblock_get_block_size(sb);
+	uint64_t ino_blocks =
+	    ext4_inode_get_blocks_count(sb, inode_ref->inode);
+	ino_blocks += got * (block_size / EXT4_INODE_BLOCK_SIZE);
+	ext4_inode_set_blocks_count(sb, inode_ref->inode, ino_blocks);
+	inode_ref->dirty = true;
+	
+	*allocated = got;
+	return EOK;
+}
+
 /** Try to allocate concrete block.
  *
  * @param inode_ref Inode to allocate block for
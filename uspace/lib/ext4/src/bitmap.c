@@ -134,6 +134,91 @@ void ext4_bitmap_set_bit(uint8_t *bitmap, uint32_t index)
 	*target |= 1 << bit_index;
 }
 
+/** Set continous set of bits (set to 1).
+ *
+ * Index and count must be checked by caller, if they aren't out of bounds.
+ *
+ * @param bitmap Pointer to bitmap
+ * @param index  Index of first bit to set
+ * @param count  Number of bits to be set
+ *
+ */
+void ext4_bitmap_set_bits(uint8_t *bitmap, uint32_t index, uint32_t count)
+{
+	uint32_t idx = index;
+	uint32_t remaining = count;
+	
+	/* Set single bits up to the byte boundary */
+	while (((idx % 8) != 0) && (remaining > 0)) {
+		bitmap[idx / 8] |= 1 << (idx % 8);
+		idx++;
+		remaining--;
+	}
+	
+	/* Set the whole bytes */
+	while (remaining >= 8) {
+		bitmap[idx / 8] = 255;
+		idx += 8;
+		remaining -= 8;
+	}
+	
+	/* Set remaining bits */
+	while (remaining != 0) {
+		bitmap[idx / 8] |= 1 << (idx % 8);
+		idx++;
+		remaining--;
+	}
+}
+
+/** Find a run of free bits.
+ *
+ * Walk through bitmap and find the first run of at least @a want free bits.
+ * If there is no such run, the longest run found is returned. The bitmap
+ * is not modified.
+ *
+ * @param bitmap Pointer to bitmap
+ * @param start  Index of bit, where the algorithm will begin
+ * @param max    Maximum index of bit in bitmap
+ * @param want   Requested length of the run
+ * @param index  Output value - index of the first bit of the run
+ *
+ * @return Length of the run (at most @a want), zero if no free bit found
+ *
+ */
+uint32_t ext4_bitmap_find_free_run(uint8_t *bitmap, uint32_t start,
+    uint32_t max, uint32_t want, uint32_t *index)
+{
+	uint32_t best = 0;
+	uint32_t len = 0;
+	uint32_t idx = start;
+	
+	while (idx < max) {
+		/* Skip fully used bytes (255 = 11111111 binary) */
+		if (((idx % 8) == 0) && (idx + 8 <= max) &&
+		    (bitmap[idx / 8] == 255)) {
+			len = 0;
+			idx += 8;
+			continue;
+		}
+		
+		if (bitmap[idx / 8] & (1 << (idx % 8))) {
+			len = 0;
+		} else {
+			len++;
+			if (len > best) {
+				best = len;
+				*index = idx + 1 - len;
+				if (best == want)
+					return best;
+			}
+		}
+		
+		idx++;
+	}
+	
+	return best;
+}
+
 /** Check if requested bit is free.
  *
  * @param bitmap Pointer to bitmap
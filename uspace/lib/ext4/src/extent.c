@@ -36,6 +36,7 @@
 
 #include <byteorder.h>
 #include <errno.h>
+#include <macros.h>
 #include <mem.h>
 #include <stdlib.h>
 #include "ext4/balloc.h"
@@ -642,7 +643,7 @@ int ext4_extent_release_blocks_from(ext4_inode_ref_t *inode_ref,
 	uint16_t block_count = ext4_extent_get_block_count(path_ptr->extent);
 	
 	uint16_t delete_count = block_count -
-	    (ext4_extent_get_start(path_ptr->extent) - first_fblock);
+	    (first_fblock - ext4_extent_get_start(path_ptr->extent));
 	
 	/* Release all blocks */
 	rc = ext4_balloc_free_blocks(inode_ref, first_fblock, delete_count);
@@ -950,25 +951,35 @@ static int ext4_extent_append_extent(ext4_inode_ref_t *inode_ref,
 	return EOK;
 }
 
-/** Append data block to the i-node.
+/** Append data blocks to the i-node.
  *
- * This function allocates data block, tries to append it
+ * This function allocates a run of data blocks, tries to append it
  * to some existing extent or creates new extents.
  * It includes possible extent tree modifications (splitting).
- *<
- * @param inode_ref I-node to append block to
- * @param iblock    Output logical number of newly allocated block
- * @param fblock    Output physical block address of newly allocated block
+ *
+ * Less blocks than requested are appended if there is no continuous
+ * free space large enough, or if the extent would exceed its length limit.
+ *
+ * @param inode_ref   I-node to append blocks to
+ * @param iblock      Output logical number of the first new block
+ * @param fblock      Output physical block address of the first new block
+ * @param count       Input number of requested blocks,
+ *                    output number of really appended blocks
+ * @param update_size If true, i-node size is extended over the new blocks
  *
  * @return Error code
  *
  */
-int ext4_extent_append_block(ext4_inode_ref_t *inode_ref, uint32_t *iblock,
-    uint32_t *fblock, bool update_size)
+int ext4_extent_append_blocks(ext4_inode_ref_t *inode_ref, uint32_t *iblock,
+    uint32_t *fblock, uint32_t *count, bool update_size)
 {
 	ext4_superblock_t *sb = inode_ref->fs->superblock;
 	uint64_t inode_size = ext4_inode_get_size(sb, inode_ref->inode);
 	uint32_t block_size = ext4_superblock_get_block_size(sb);
+	uint16_t block_limit = (1 << 15);
+	uint32_t want = min(*count, block_limit);
+	
+	assert(want > 0);
 	
 	/* Calculate number of new logical block */
 	uint32_t new_block_idx = 0;
@@ -990,81 +1001,76 @@ int ext4_extent_append_block(ext4_inode_ref_t *inode_ref, uint32_t *iblock,
 	while (path_ptr->depth != 0)
 		path_ptr++;
 	
+	uint32_t phys_block = 0;
+	uint32_t allocated = 0;
+	
 	/* Add new extent to the node if not present */
 	if (path_ptr->extent == NULL)
 		goto append_extent;
 	
 	uint16_t block_count = ext4_extent_get_block_count(path_ptr->extent);
-	uint16_t block_limit = (1 << 15);
 	
-	uint32_t phys_block = 0;
 	if (block_count < block_limit) {
-		/* There is space for new block in the extent */
+		/* There is space for new blocks in the extent */
 		if (block_count == 0) {
 			/* Existing extent is empty */
-			rc = ext4_balloc_alloc_block(inode_ref, &phys_block);
+			rc = ext4_balloc_alloc_blocks(inode_ref, new_block_idx,
+			    want, &phys_block, &allocated);
 			if (rc != EOK)
 				goto finish;
 			
 			/* Initialize extent */
 			ext4_extent_set_first_block(path_ptr->extent, new_block_idx);
 			ext4_extent_set_start(path_ptr->extent, phys_block);
-			ext4_extent_set_block_count(path_ptr->extent, 1);
-			
-			/* Update i-node */
-			if (update_size) {
-				ext4_inode_set_size(inode_ref->inode, inode_size + block_size);
-				inode_ref->dirty = true;
-			}
+			ext4_extent_set_block_count(path_ptr->extent, allocated);
 			
 			path_ptr->block->dirty = true;
 			
-			goto finish;
+			goto update;
 		} else {
-			/* Existing extent contains some blocks */
-			phys_block = ext4_extent_get_start(path_ptr->extent);
-			phys_block += ext4_extent_get_block_count(path_ptr->extent);
+			/*
+			 * Existing extent contains some blocks, the allocator
+			 * prefers the block following it.
+			 */
+			uint32_t next = ext4_extent_get_start(path_ptr->extent) +
+			    block_count;
 			
-			/* Check if the following block is free for allocation */
-			bool free;
-			rc = ext4_balloc_try_alloc_block(inode_ref, phys_block, &free);
+			rc = ext4_balloc_alloc_blocks(inode_ref, new_block_idx,
+			    min(want, (uint32_t) (block_limit - block_count)),
+			    &phys_block, &allocated);
 			if (rc != EOK)
 				goto finish;
 			
-			if (!free) {
-				/* Target is not free, new block must be appended to new extent */
+			if (phys_block != next) {
+				/* Not continuous, blocks must be appended to new extent */
 				goto append_extent;
 			}
 			
 			/* Update extent */
-			ext4_extent_set_block_count(path_ptr->extent, block_count + 1);
-			
-			/* Update i-node */
-			if (update_size) {
-				ext4_inode_set_size(inode_ref->inode, inode_size + block_size);
-				inode_ref->dirty = true;
-			}
+			ext4_extent_set_block_count(path_ptr->extent,
+			    block_count + allocated);
 			
 			path_ptr->block->dirty = true;
 			
-			goto finish;
+			goto update;
 		}
 	}
 	
-	
 append_extent:
 	/* Append new extent to the tree */
-	phys_block = 0;
-	
-	/* Allocate new data block */
-	rc = ext4_balloc_alloc_block(inode_ref, &phys_block);
-	if (rc != EOK)
-		goto finish;
+	if (allocated == 0) {
+		/* Allocate new data blocks */
+		rc = ext4_balloc_alloc_blocks(inode_ref, new_block_idx, want,
+		    &phys_block, &allocated);
+		if (rc != EOK)
+			goto finish;
+	}
 	
-	/* Append extent for new block (includes tree splitting if needed) */
+	/* Append extent for new blocks (includes tree splitting if needed) */
 	rc = ext4_extent_append_extent(inode_ref, path, new_block_idx);
 	if (rc != EOK) {
-		ext4_balloc_free_block(inode_ref, phys_block);
+		ext4_balloc_free_blocks(inode_ref, phys_block, allocated);
+		allocated = 0;
 		goto finish;
 	}
 	
@@ -1072,18 +1078,20 @@ append_extent:
 	path_ptr = path + tree_depth;
 	
 	/* Initialize newly created extent */
-	ext4_extent_set_block_count(path_ptr->extent, 1);
+	ext4_extent_set_block_count(path_ptr->extent, allocated);
 	ext4_extent_set_first_block(path_ptr->extent, new_block_idx);
 	ext4_extent_set_start(path_ptr->extent, phys_block);
 	
+	path_ptr->block->dirty = true;
+	
+update:
 	/* Update i-node */
 	if (update_size) {
-		ext4_inode_set_size(inode_ref->inode, inode_size + block_size);
+		ext4_inode_set_size(inode_ref->inode,
+		    inode_size + (uint64_t) allocated * block_size);
 		inode_ref->dirty = true;
 	}
 	
-	path_ptr->block->dirty = true;
-	
 finish:
 	;
 
@@ -1092,6 +1100,7 @@ finish:
 	/* Set return values */
 	*iblock = new_block_idx;
 	*fblock = phys_block;
+	*count = allocated;
 	
 	/*
 	 * Put loaded blocks
@@ -1111,6 +1120,25 @@ finish:
 	return rc;
 }
 
+/** Append data block to the i-node.
+ *
+ * @param inode_ref   I-node to append block to
+ * @param iblock      Output logical number of newly allocated block
+ * @param fblock      Output physical block address of newly allocated block
+ * @param update_size If true, i-node size is extended over the new block
+ *
+ * @return Error code
+ *
+ */
+int ext4_extent_append_block(ext4_inode_ref_t *inode_ref, uint32_t *iblock,
+    uint32_t *fblock, bool update_size)
+{
+	uint32_t count = 1;
+	
+	return ext4_extent_append_blocks(inode_ref, iblock, fblock, &count,
+	    update_size);
+}
+
 /**
  * @}
  */
@@ -96,6 +96,10 @@ static int ext4_filesystem_init(ext4_filesystem_t *fs, service_id_t service_id,
 	if (rc != EOK)
 		goto err_1;
 
+	rc = ext4_balloc_prealloc_init(fs);
+	if (rc != EOK)
+		goto err_2;
+
 	/* Compute limits for indirect block levels */
 	uint32_t block_ids_per_block = block_size / sizeof(uint32_t);
 	fs->inode_block_limits[0] = EXT4_INODE_DIRECT_BLOCK_COUNT;
@@ -117,20 +121,22 @@ static int ext4_filesystem_init(ext4_filesystem_t *fs, service_id_t service_id,
 	    ((state & EXT4_SUPERBLOCK_STATE_ERROR_FS) ==
 	    EXT4_SUPERBLOCK_STATE_ERROR_FS)) {
 		rc = ENOTSUP;
-		goto err_2;
+		goto err_3;
 	}
 
 	rc = ext4_superblock_check_sanity(fs->superblock);
 	if (rc != EOK)
-		goto err_2;
+		goto err_3;
 
 	/* Check flags */
 	bool read_only;
 	rc = ext4_filesystem_check_features(fs, &read_only);
 	if (rc != EOK)
-		goto err_2;
+		goto err_3;
 
 	return EOK;
+err_3:
+	ext4_balloc_prealloc_fini(fs);
 err_2:
 	block_cache_fini(fs->device);
 err_1:
@@ -151,6 +157,8 @@ static void ext4_filesystem_fini(ext4_filesystem_t *fs)
 	/* Release memory space for superblock */
 	free(fs->superblock);
 
+	ext4_balloc_prealloc_fini(fs);
+
 	/* Finish work with block library */
 	block_cache_fini(fs->device);
 	block_fini(fs->device);
@@ -257,9 +265,14 @@ error:
  */
 int ext4_filesystem_close(ext4_filesystem_t *fs)
 {
+	/* Return unused preallocated blocks */
+	int rc = ext4_balloc_release_prealloc_all(fs);
+	if (rc != EOK)
+		return rc;
+
 	/* Write the superblock to the device */
 	ext4_superblock_set_state(fs->superblock, EXT4_SUPERBLOCK_STATE_VALID_FS);
-	int rc = ext4_superblock_write_direct(fs->device, fs->superblock);
+	rc = ext4_superblock_write_direct(fs->device, fs->superblock);
 	if (rc != EOK)
 		return rc;
 
@@ -61,6 +61,12 @@ static int ext4_read_directory(ipc_callid_t, aoff64_t, size_t,
     ext4_instance_t *, ext4_inode_ref_t *, size_t *);
 static int ext4_read_file(ipc_callid_t, aoff64_t, size_t, ext4_instance_t *,
     ext4_inode_ref_t *, size_t *);
+static int ext4_read_file_blocks(ipc_callid_t, aoff64_t, size_t,
+    ext4_instance_t *, ext4_inode_ref_t *, size_t *);
+static int ext4_write_map_block(ext4_inode_ref_t *, uint32_t, uint32_t,
+    uint32_t, uint32_t *, uint32_t *, bool *);
+static int ext4_write_blocks(ext4_inode_ref_t *, service_id_t, ipc_callid_t,
+    aoff64_t, size_t, size_t *);
 static bool ext4_is_dots(const uint8_t *, size_t);
 static int ext4_instance_get(service_id_t, ext4_instance_t **);
 
@@ -503,7 +509,14 @@ int ext4_destroy_node(fs_node_t *fn)
 	ext4_node_t *enode = EXT4_NODE(fn);
 	ext4_inode_ref_t *inode_ref = enode->inode_ref;
 	
-	/* Release data blocks */
+	/* Release preallocated and data blocks */
+	rc = ext4_balloc_release_prealloc(enode->instance->filesystem,
+	    inode_ref->index);
+	if (rc != EOK) {
+		ext4_node_put(fn);
+		return rc;
+	}
+	
 	rc = ext4_filesystem_truncate_inode(inode_ref, 0);
 	if (rc != EOK) {
 		ext4_node_put(fn);
@@ -1198,10 +1211,16 @@ int ext4_read_file(ipc_callid_t callid, aoff64_t pos, size_t size,
 		return EOK;
 	}
 	
-	/* For now, we only read data from one block at a time */
 	uint32_t block_size = ext4_superblock_get_block_size(sb);
 	aoff64_t file_block = pos / block_size;
 	uint32_t offset_in_block = pos % block_size;
+	
+	/* Requests spanning more blocks are served by one transfer */
+	if (offset_in_block + min(size, file_size - pos) > block_size) {
+		return ext4_read_file_blocks(callid, pos,
+		    min(size, file_size - pos), inst, inode_ref, rbytes);
+	}
+	
 	uint32_t bytes = min(block_size - offset_in_block, size);
 	
 	/* Handle end of file */
@@ -1263,6 +1282,357 @@ int ext4_read_file(ipc_callid_t callid, aoff64_t pos, size_t size,
 	return EOK;
 }
 
+/** Read data spanning several blocks from file.
+ *
+ * File blocks stored in consecutive filesystem blocks are read from
+ * the device with a single request. Unallocated blocks read as zeros.
+ *
+ * @param callid    IPC id of call (for communication)
+ * @param pos       Position to start reading from
+ * @param size      How many bytes to read (not beyond end of file)
+ * @param inst      Filesystem instance
+ * @param inode_ref Node to read data from
+ * @param rbytes    Output value to return real number of bytes was read
+ *
+ * @return Error code
+ *
+ */
+static int ext4_read_file_blocks(ipc_callid_t callid, aoff64_t pos,
+    size_t size, ext4_instance_t *inst, ext4_inode_ref_t *inode_ref,
+    size_t *rbytes)
+{
+	ext4_superblock_t *sb = inst->filesystem->superblock;
+	uint32_t block_size = ext4_superblock_get_block_size(sb);
+	
+	size_t bytes = min(size, BLOCK_XFER_MAX);
+	aoff64_t first_block = pos / block_size;
+	uint32_t offset_in_block = pos % block_size;
+	size_t count = (offset_in_block + bytes + block_size - 1) / block_size;
+	
+	uint8_t *buffer = malloc(count * block_size);
+	if (buffer == NULL) {
+		async_answer_0(callid, ENOMEM);
+		return ENOMEM;
+	}
+	
+	size_t i = 0;
+	while (i < count) {
+		uint32_t fs_block;
+		int rc = ext4_filesystem_get_inode_data_block_index(inode_ref,
+		    first_block + i, &fs_block);
+		if (rc != EOK) {
+			free(buffer);
+			async_answer_0(callid, rc);
+			return rc;
+		}
+		
+		/* Sparse file */
+		if (fs_block == 0) {
+			memset(buffer + i * block_size, 0, block_size);
+			i++;
+			continue;
+		}
+		
+		/* Find out how many of the following blocks are adjacent */
+		size_t run = 1;
+		while (i + run < count) {
+			uint32_t next;
+			rc = ext4_filesystem_get_inode_data_block_index(inode_ref,
+			    first_block + i + run, &next);
+			if ((rc != EOK) || (next != fs_block + run))
+				break;
+			
+			run++;
+		}
+		
+		rc = block_read_range(inst->service_id, fs_block, run,
+		    buffer + i * block_size);
+		if (rc != EOK) {
+			free(buffer);
+			async_answer_0(callid, rc);
+			return rc;
+		}
+		
+		i += run;
+	}
+	
+	int rc = async_data_read_finalize(callid, buffer + offset_in_block,
+	    bytes);
+	free(buffer);
+	if (rc != EOK)
+		return rc;
+	
+	*rbytes = bytes;
+	return EOK;
+}
+
+/** Get filesystem block for writing to a file block.
+ *
+ * The block is allocated if the file does not have it yet. In that case
+ * up to @a want blocks following it are allocated as well, preferably
+ * continuous on the device, so that large writes need not go through
+ * the allocator block by block.
+ *
+ * @param inode_ref I-node of the file
+ * @param iblock    Logical block index within the file
+ * @param want      Number of blocks that are going to be written
+ * @param end       Logical block following the blocks already mapped by
+ *                  the ongoing write, which the i-node size does not
+ *                  cover yet
+ * @param fblock    Output value - filesystem block
+ * @param count     Output value - number of blocks mapped continuously
+ *                  starting at @a fblock
+ * @param fresh     Output value - true if the blocks have just been allocated
+ *
+ * @return Error code
+ *
+ */
+static int ext4_write_map_block(ext4_inode_ref_t *inode_ref, uint32_t iblock,
+    uint32_t want, uint32_t end, uint32_t *fblock, uint32_t *count,
+    bool *fresh)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
+	uint32_t block_size = ext4_superblock_get_block_size(fs->superblock);
+	
+	*fresh = false;
+	*count = 1;
+	
+	int rc = ext4_filesystem_get_inode_data_block_index(inode_ref, iblock,
+	    fblock);
+	if (rc != EOK)
+		return rc;
+	
+	/* Check for sparse file */
+	if (*fblock != 0)
+		return EOK;
+	
+	if ((ext4_superblock_has_feature_incompatible(fs->superblock,
+	    EXT4_FEATURE_INCOMPAT_EXTENTS)) &&
+	    (ext4_inode_has_flag(inode_ref->inode, EXT4_INODE_FLAG_EXTENTS))) {
+		uint64_t size = ext4_inode_get_size(fs->superblock,
+		    inode_ref->inode);
+		uint32_t last_iblock = (size + block_size - 1) / block_size;
+		
+		/*
+		 * The extent code appends after the i-node size. Let it cover
+		 * the blocks mapped by this write until the blocks are appended.
+		 */
+		bool cover = end > last_iblock;
+		if (cover) {
+			last_iblock = end;
+			ext4_inode_set_size(inode_ref->inode,
+			    (uint64_t) end * block_size);
+		}
+		
+		/* Fill the gap up to the written block */
+		while (last_iblock < iblock) {
+			uint32_t gap = iblock - last_iblock;
+			rc = ext4_extent_append_blocks(inode_ref, &last_iblock,
+			    fblock, &gap, true);
+			if (rc != EOK)
+				return rc;
+			
+			last_iblock += gap;
+		}
+		
+		*count = want;
+		rc = ext4_extent_append_blocks(inode_ref, &last_iblock,
+		    fblock, count, false);
+		if (cover)
+			ext4_inode_set_size(inode_ref->inode, size);
+		if (rc != EOK)
+			return rc;
+	} else {
+		/* Only map the hole, not the blocks following it */
+		for (uint32_t i = 1; i < want; i++) {
+			uint32_t next;
+			rc = ext4_filesystem_get_inode_data_block_index(inode_ref,
+			    iblock + i, &next);
+			if (rc != EOK)
+				return rc;
+			
+			if (next != 0) {
+				want = i;
+				break;
+			}
+		}
+		
+		rc = ext4_balloc_alloc_blocks(inode_ref, iblock, want, fblock,
+		    count);
+		if (rc != EOK)
+			return rc;
+		
+		for (uint32_t i = 0; i < *count; i++) {
+			rc = ext4_filesystem_set_inode_data_block_index(inode_ref,
+			    iblock + i, *fblock + i);
+			if (rc != EOK) {
+				ext4_balloc_free_blocks(inode_ref, *fblock + i,
+				    *count - i);
+				if (i == 0)
+					return rc;
+				
+				*count = i;
+				break;
+			}
+		}
+	}
+	
+	*fresh = true;
+	inode_ref->dirty = true;
+	return EOK;
+}
+
+/** Write data spanning several blocks to file.
+ *
+ * Full blocks which are adjacent on the device are written with a single
+ * request. The i-node size is extended over the data which made it to the
+ * device once the writes are done.
+ *
+ * @param inode_ref  I-node of the file
+ * @param service_id Device identifier
+ * @param callid     IPC id of the data write call
+ * @param pos        Position in file to start writing at
+ * @param len        Number of bytes offered by the client
+ * @param wbytes     Output value - real number of written bytes
+ *
+ * @return Error code
+ *
+ */
+static int ext4_write_blocks(ext4_inode_ref_t *inode_ref,
+    service_id_t service_id, ipc_callid_t callid, aoff64_t pos, size_t len,
+    size_t *wbytes)
+{
+	ext4_superblock_t *sb = inode_ref->fs->superblock;
+	uint32_t block_size = ext4_superblock_get_block_size(sb);
+	size_t bytes = min(len, BLOCK_XFER_MAX);
+	
+	uint8_t *buffer = malloc(bytes);
+	if (buffer == NULL) {
+		async_answer_0(callid, ENOMEM);
+		return ENOMEM;
+	}
+	
+	int rc = async_data_write_finalize(callid, buffer, bytes);
+	if (rc != EOK) {
+		free(buffer);
+		return rc;
+	}
+	
+	/* Number of bytes written to the device */
+	size_t done = 0;
+	/* Pending run of full blocks starting at buffer offset done */
+	uint32_t run_start = 0;
+	size_t run = 0;
+	/* Last mapping obtained, blocks map_iblock + i are at map_fblock + i */
+	uint32_t map_iblock = 0;
+	uint32_t map_fblock = 0;
+	uint32_t map_count = 0;
+	bool map_fresh = false;
+	/* Logical block following the blocks allocated by this write */
+	uint32_t alloc_end = 0;
+	
+	uint32_t last_iblock = (pos + bytes - 1) / block_size;
+	
+	while (done + run * block_size < bytes) {
+		size_t offset = done + run * block_size;
+		uint32_t iblock = (pos + offset) / block_size;
+		uint32_t offset_in_block = (pos + offset) % block_size;
+		size_t chunk = min(block_size - offset_in_block, bytes - offset);
+		
+		if ((iblock < map_iblock) || (iblock >= map_iblock + map_count)) {
+			map_iblock = iblock;
+			rc = ext4_write_map_block(inode_ref, iblock,
+			    last_iblock - iblock + 1, alloc_end, &map_fblock,
+			    &map_count, &map_fresh);
+			if (rc != EOK) {
+				map_count = 0;
+				break;
+			}
+			
+			if (map_fresh)
+				alloc_end = iblock + map_count;
+		}
+		
+		uint32_t fblock = map_fblock + (iblock - map_iblock);
+		bool fresh = map_fresh;
+		
+		if ((chunk == block_size) && (run > 0) &&
+		    (fblock == run_start + run)) {
+			run++;
+			continue;
+		}
+		
+		if (run > 0) {
+			rc = block_write_range(service_id, run_start, run,
+			    buffer + done);
+			if (rc != EOK)
+				break;
+			
+			done += run * block_size;
+			run = 0;
+		}
+		
+		if (chunk == block_size) {
+			run_start = fblock;
+			run = 1;
+			continue;
+		}
+		
+		/* Partial block */
+		block_t *block;
+		rc = block_get(&block, service_id, fblock,
+		    fresh ? BLOCK_FLAGS_NOREAD : BLOCK_FLAGS_NONE);
+		if (rc != EOK)
+			break;
+		
+		if (fresh)
+			memset(block->data, 0, block_size);
+		
+		memcpy(block->data + offset_in_block, buffer + offset, chunk);
+		block->dirty = true;
+		
+		rc = block_put(block);
+		if (rc != EOK)
+			break;
+		
+		done += chunk;
+	}
+	
+	if (run > 0) {
+		int rc2 = block_write_range(service_id, run_start, run,
+		    buffer + done);
+		if (rc2 == EOK)
+			done += run * block_size;
+		else if (rc == EOK)
+			rc = rc2;
+	}
+	
+	free(buffer);
+	
+	uint64_t size = ext4_inode_get_size(sb, inode_ref->inode);
+	if (pos + done > size) {
+		size = pos + done;
+		ext4_inode_set_size(inode_ref->inode, size);
+		inode_ref->dirty = true;
+	}
+	
+	/* Return blocks appended beyond the data that made it to the device */
+	if ((rc != EOK) &&
+	    ext4_inode_has_flag(inode_ref->inode, EXT4_INODE_FLAG_EXTENTS)) {
+		uint32_t used = (size + block_size - 1) / block_size;
+		
+		if (alloc_end > used)
+			ext4_extent_release_blocks_from(inode_ref, used);
+	}
+	
+	/* Report a short write if some data made it to the device */
+	if (done == 0)
+		return rc;
+	
+	*wbytes = done;
+	return EOK;
+}
+
 /** Write bytes to file
  *
  * @param service_id Device identifier
@@ -1292,11 +1662,23 @@ static int ext4_write(service_id_t service_id, fs_index_t index, aoff64_t pos,
 	
 	ext4_node_t *enode = EXT4_NODE(fn);
 	ext4_filesystem_t *fs = enode->instance->filesystem;
+	ext4_inode_ref_t *inode_ref = enode->inode_ref;
 	
 	uint32_t block_size = ext4_superblock_get_block_size(fs->superblock);
 	
-	/* Prevent writing to more than one block */
-	uint32_t bytes = min(len, block_size - (pos % block_size));
+	/* Writes spanning more blocks are received in one transfer */
+	if (len > block_size - (pos % block_size)) {
+		rc = ext4_write_blocks(inode_ref, service_id, callid, pos, len,
+		    wbytes);
+		if (rc == EOK) {
+			*nsize = ext4_inode_get_size(fs->superblock,
+			    inode_ref->inode);
+		}
+		
+		goto exit;
+	}
+	
+	uint32_t bytes = len;
 	
 	int flags = BLOCK_FLAGS_NONE;
 	if (bytes == block_size)
@@ -1304,59 +1686,18 @@ static int ext4_write(service_id_t service_id, fs_index_t index, aoff64_t pos,
 	
 	uint32_t iblock =  pos / block_size;
 	uint32_t fblock;
+	uint32_t count;
+	bool fresh;
 	
-	/* Load inode */
-	ext4_inode_ref_t *inode_ref = enode->inode_ref;
-	rc = ext4_filesystem_get_inode_data_block_index(inode_ref, iblock,
-	    &fblock);
+	rc = ext4_write_map_block(inode_ref, iblock, 1, 0, &fblock, &count,
+	    &fresh);
 	if (rc != EOK) {
 		async_answer_0(callid, rc);
 		goto exit;
 	}
 	
-	/* Check for sparse file */
-	if (fblock == 0) {
-		if ((ext4_superblock_has_feature_incompatible(fs->superblock,
-		    EXT4_FEATURE_INCOMPAT_EXTENTS)) &&
-		    (ext4_inode_has_flag(inode_ref->inode, EXT4_INODE_FLAG_EXTENTS))) {
-			uint32_t last_iblock =
-			    ext4_inode_get_size(fs->superblock, inode_ref->inode) /
-			    block_size;
-			
-			while (last_iblock < iblock) {
-				rc = ext4_extent_append_block(inode_ref, &last_iblock,
-				    &fblock, true);
-				if (rc != EOK) {
-					async_answer_0(callid, rc);
-					goto exit;
-				}
-			}
-			
-			rc = ext4_extent_append_block(inode_ref, &last_iblock,
-			    &fblock, false);
-			if (rc != EOK) {
-				async_answer_0(callid, rc);
-				goto exit;
-			}
-		} else {
-			rc = ext4_balloc_alloc_block(inode_ref, &fblock);
-			if (rc != EOK) {
-				async_answer_0(callid, rc);
-				goto exit;
-			}
-			
-			rc = ext4_filesystem_set_inode_data_block_index(inode_ref,
-			    iblock, fblock);
-			if (rc != EOK) {
-				ext4_balloc_free_block(inode_ref, fblock);
-				async_answer_0(callid, rc);
-				goto exit;
-			}
-		}
-		
+	if (fresh)
 		flags = BLOCK_FLAGS_NOREAD;
-		inode_ref->dirty = true;
-	}
 	
 	/* Load target block */
 	block_t *write_block;
@@ -1438,7 +1779,13 @@ static int ext4_truncate(service_id_t service_id, fs_index_t index,
  */
 static int ext4_close(service_id_t service_id, fs_index_t index)
 {
-	return EOK;
+	ext4_instance_t *inst;
+	int rc = ext4_instance_get(service_id, &inst);
+	if (rc != EOK)
+		return rc;
+	
+	/* Return blocks preallocated for the appends to the file */
+	return ext4_balloc_release_prealloc(inst->filesystem, index);
 }
 
 /** Destroy node specified by index.
@@ -43,6 +43,7 @@
 #include <ddf/driver.h>
 #include <device/hw_res_parsed.h>
 #include <ops/nic.h>
+#include <stdbool.h>
 
 #define DEVICE_CATEGORY_NIC "nic"
 
@@ -61,13 +62,28 @@ typedef struct nic_wol_virtue {
 	struct nic_wol_virtue *next;
 } nic_wol_virtue_t;
 
+struct nic_frame;
+
+/**
+ * Handler returning a driver's buffer wrapped in a frame (see
+ * nic_alloc_frame_buffer) back to the driver.
+ *
+ * @param nic_data	NICF main structure
+ * @param frame		The frame being released
+ */
+typedef void (*nic_frame_release_handler)(nic_t *, struct nic_frame *);
+
 /**
  * Simple structure for sending lists of frames.
  */
-typedef struct {
+typedef struct nic_frame {
 	link_t link;
 	void *data;
 	size_t size;
+	/** Releases data owned by the driver, NULL if data is allocated */
+	nic_frame_release_handler release;
+	/** Argument for the release handler */
+	void *release_arg;
 } nic_frame_t;
 
 typedef list_t nic_frame_list_t;
@@ -205,6 +221,26 @@ typedef int (*poll_mode_change_handler)(nic_t *,
  */
 typedef void (*poll_request_handler)(nic_t *);
 
+/**
+ * Handler receiving at most the given number of frames from the NIC buffers,
+ * used by the NAPI-style polling (see nic_napi_interrupt).
+ *
+ * @param nic_data	NICF main structure
+ * @param budget	Maximal number of frames to receive
+ *
+ * @return Number of frames taken from the NIC buffers
+ */
+typedef size_t (*napi_poll_handler)(nic_t *, size_t);
+
+/**
+ * Handler enabling or disabling the receive interrupts of the NIC. Other
+ * interrupts should be left intact.
+ *
+ * @param nic_data	NICF main structure
+ * @param enable	Enable (true) or disable (false) the receive interrupts
+ */
+typedef void (*napi_irq_handler)(nic_t *, bool);
+
 /* nic_t allocation and deallocation */
 extern nic_t *nic_create_and_bind(ddf_dev_t *);
 extern void nic_unbind_and_destroy(ddf_dev_t *);
@@ -228,6 +264,8 @@ extern void nic_set_wol_virtue_change_handlers(nic_t *,
     wol_virtue_add_handler, wol_virtue_remove_handler);
 extern void nic_set_poll_handlers(nic_t *,
     poll_mode_change_handler, poll_request_handler);
+extern void nic_set_napi_handlers(nic_t *, napi_poll_handler,
+    napi_irq_handler);
 
 /* General driver functions */
 extern ddf_dev_t *nic_get_ddf_dev(nic_t *);
@@ -244,6 +282,7 @@ extern void nic_query_address(nic_t *, nic_address_t *);
 extern void nic_received_frame(nic_t *, nic_frame_t *);
 extern void nic_received_frame_list(nic_t *, nic_frame_list_t *);
 extern nic_poll_mode_t nic_query_poll_mode(nic_t *, struct timeval *);
+extern void nic_napi_interrupt(nic_t *);
 
 /* Statistics updates */
 extern void nic_report_send_ok(nic_t *, size_t, size_t);
@@ -254,6 +293,8 @@ extern void nic_report_collisions(nic_t *, unsigned);
 
 /* Frame / frame list allocation and deallocation */
 extern nic_frame_t *nic_alloc_frame(nic_t *, size_t);
+extern nic_frame_t *nic_alloc_frame_buffer(nic_t *, void *, size_t,
+    nic_frame_release_handler, void *);
 extern nic_frame_list_t *nic_alloc_frame_list(void);
 extern void nic_frame_list_append(nic_frame_list_t *, nic_frame_t *);
 extern void nic_release_frame(nic_t *, nic_frame_t *);
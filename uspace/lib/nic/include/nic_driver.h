@@ -45,6 +45,7 @@
 #include <fibril_synch.h>
 #include <nic/nic.h>
 #include <async.h>
+#include <pkt_ring.h>
 
 #include "nic.h"
 #include "nic_rx_control.h"
@@ -56,6 +57,17 @@ struct sw_poll_info {
 	volatile int running;
 };
 
+struct napi_info {
+	/** Polling fibril, created when the NIC is polled for the first time */
+	fid_t fibril;
+	/** Serializes the receiving from the NIC buffers */
+	fibril_mutex_t lock;
+	/** Signalled when the NIC switches to the polling mode */
+	fibril_condvar_t cv;
+	/** Receive interrupts are disabled and the NIC is being polled */
+	bool polling;
+};
+
 struct nic {
 	/**
 	 * Device from device manager's point of view.
@@ -79,6 +91,12 @@ struct nic {
 	nic_address_t default_mac;
 	/** Client callback session */
 	async_sess_t *client_session;
+	/** Ring for delivering received frames to the client */
+	pkt_ring_t rx_ring;
+	/** The client has set up rx_ring */
+	bool rx_ring_active;
+	/** Protects rx_ring and rx_ring_active */
+	fibril_mutex_t rx_ring_lock;
 	/** Current polling mode of the NIC */
 	nic_poll_mode_t poll_mode;
 	/** Polling period (applicable when poll_mode == NIC_POLL_PERIODIC) */
@@ -89,6 +107,8 @@ struct nic {
 	struct timeval default_poll_period;
 	/** Software period fibrill information */
 	struct sw_poll_info sw_poll_info;
+	/** NAPI-style polling information */
+	struct napi_info napi;
 	/**
 	 * Lock on everything but statistics, rx control and wol virtues. This lock
 	 * cannot be used if filters_lock or stats_lock is already held - you must
@@ -194,6 +214,16 @@ struct nic {
 	 * The implementation is optional.
 	 */
 	poll_request_handler on_poll_request;
+	/**
+	 * Handler receiving a limited number of frames, must be set in order
+	 * to use nic_napi_interrupt.
+	 */
+	napi_poll_handler on_napi_poll;
+	/**
+	 * Handler enabling or disabling the receive interrupts, must be set in
+	 * order to use nic_napi_interrupt.
+	 */
+	napi_irq_handler on_napi_irq;
 	/** Data specific for particular driver */
 	void *specific;
 };
@@ -79,6 +79,9 @@ extern int nic_poll_get_mode_impl(ddf_fun_t *,
 extern int nic_poll_set_mode_impl(ddf_fun_t *,
     nic_poll_mode_t, const struct timeval *);
 extern int nic_poll_now_impl(ddf_fun_t *);
+extern int nic_rx_ring_set_impl(ddf_fun_t *, cap_handle_t, size_t,
+    unsigned int);
+extern void nic_rx_ring_detach(nic_t *);
 
 extern void nic_default_handler_impl(ddf_fun_t *dev_fun,
 	ipc_callid_t callid, ipc_call_t *call);
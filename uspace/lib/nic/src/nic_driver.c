@@ -37,6 +37,7 @@
  */
 
 #include <assert.h>
+#include <async.h>
 #include <fibril_synch.h>
 #include <ns.h>
 #include <stdio.h>
@@ -53,6 +54,9 @@
 
 #define NIC_GLOBALS_MAX_CACHE_SIZE 16
 
+/** Maximal number of frames received in one NAPI-style poll */
+#define NIC_NAPI_BUDGET 64
+
 nic_globals_t nic_globals;
 
 /**
@@ -143,6 +147,8 @@ void nic_driver_implement(driver_ops_t *driver_ops, ddf_dev_ops_t *dev_ops,
 			iface->poll_set_mode = nic_poll_set_mode_impl;
 		if (!iface->poll_now)
 			iface->poll_now = nic_poll_now_impl;
+		if (!iface->rx_ring_set)
+			iface->rx_ring_set = nic_rx_ring_set_impl;
 	}
 }
 
@@ -232,6 +238,22 @@ void nic_set_poll_handlers(nic_t *nic_data,
 	nic_data->on_poll_request = on_poll_req;
 }
 
+/**
+ * Setup handlers for the NAPI-style polling (see nic_napi_interrupt).
+ * This function can be called only in the add_device handler. Both handlers
+ * must be set.
+ *
+ * @param on_napi_poll	Called to receive a limited number of frames
+ * @param on_napi_irq	Called to enable or disable the receive interrupts
+ */
+void nic_set_napi_handlers(nic_t *nic_data, napi_poll_handler on_napi_poll,
+	napi_irq_handler on_napi_irq)
+{
+	assert(on_napi_poll != NULL && on_napi_irq != NULL);
+	nic_data->on_napi_poll = on_napi_poll;
+	nic_data->on_napi_irq = on_napi_irq;
+}
+
 /**
  * Connect to the parent's driver and get HW resources list in parsed format.
  * Note: this function should be called only from add_device handler, therefore
@@ -255,13 +277,11 @@ int nic_get_resources(nic_t *nic_data, hw_res_list_parsed_t *resources)
 	return hw_res_get_list_parsed(parent_sess, resources, 0);
 }
 
-/** Allocate frame
+/** Allocate frame structure without data
  *
- *  @param nic_data 	The NIC driver data
- *  @param size	        Frame size in bytes
  *  @return pointer to allocated frame if success, NULL otherwise
  */
-nic_frame_t *nic_alloc_frame(nic_t *nic_data, size_t size)
+static nic_frame_t *nic_alloc_frame_struct(void)
 {
 	nic_frame_t *frame;
 	fibril_mutex_lock(&nic_globals.lock);
@@ -280,6 +300,23 @@ nic_frame_t *nic_alloc_frame(nic_t *nic_data, size_t size)
 		link_initialize(&frame->link);
 	}
 
+	frame->release = NULL;
+	frame->release_arg = NULL;
+	return frame;
+}
+
+/** Allocate frame
+ *
+ *  @param nic_data 	The NIC driver data
+ *  @param size	        Frame size in bytes
+ *  @return pointer to allocated frame if success, NULL otherwise
+ */
+nic_frame_t *nic_alloc_frame(nic_t *nic_data, size_t size)
+{
+	nic_frame_t *frame = nic_alloc_frame_struct();
+	if (!frame)
+		return NULL;
+
 	frame->data = malloc(size);
 	if (frame->data == NULL) {
 		free(frame);
@@ -290,6 +327,35 @@ nic_frame_t *nic_alloc_frame(nic_t *nic_data, size_t size)
 	return frame;
 }
 
+/** Allocate frame wrapping a buffer of the driver
+ *
+ *  This allows passing e.g. a DMA buffer up without copying the data. The
+ *  release handler is called to give the buffer back to the driver when the
+ *  frame is released.
+ *
+ *  @param nic_data 	The NIC driver data
+ *  @param data		The buffer with frame data
+ *  @param size	        Frame size in bytes
+ *  @param release	Handler called when the frame is released
+ *  @param arg		Argument for the release handler, stored in the frame
+ *  @return pointer to allocated frame if success, NULL otherwise
+ */
+nic_frame_t *nic_alloc_frame_buffer(nic_t *nic_data, void *data, size_t size,
+    nic_frame_release_handler release, void *arg)
+{
+	assert(release != NULL);
+
+	nic_frame_t *frame = nic_alloc_frame_struct();
+	if (!frame)
+		return NULL;
+
+	frame->data = data;
+	frame->size = size;
+	frame->release = release;
+	frame->release_arg = arg;
+	return frame;
+}
+
 /** Release frame
  *
  * @param nic_data	The driver data
@@ -300,7 +366,13 @@ void nic_release_frame(nic_t *nic_data, nic_frame_t *frame)
 	if (!frame)
 		return;
 
-	if (frame->data != NULL) {
+	if (frame->release != NULL) {
+		frame->release(nic_data, frame);
+		frame->release = NULL;
+		frame->release_arg = NULL;
+		frame->data = NULL;
+		frame->size = 0;
+	} else if (frame->data != NULL) {
 		free(frame->data);
 		frame->data = NULL;
 		frame->size = 0;
@@ -506,6 +578,42 @@ void nic_set_tx_busy(nic_t *nic_data, int busy)
 	nic_data->tx_busy = busy;
 }
 
+/**
+ * Pass a received frame to the client.
+ *
+ * If the client has set up a receive ring, the frame is queued to it and
+ * the client is notified only if it has not been notified yet. Frames that
+ * do not fit in the ring are delivered by a NIC_EV_RECEIVED call, which
+ * also throttles the driver until the client catches up. The client handles
+ * its callback calls in order, so frames are not reordered.
+ *
+ * @param nic_data
+ * @param frame		The received frame
+ */
+static void nic_deliver_frame(nic_t *nic_data, nic_frame_t *frame)
+{
+	fibril_mutex_lock(&nic_data->rx_ring_lock);
+	if (nic_data->rx_ring_active) {
+		bool notify;
+		int rc = pkt_ring_put(&nic_data->rx_ring, frame->data,
+		    frame->size, 0, &notify);
+		fibril_mutex_unlock(&nic_data->rx_ring_lock);
+		if (rc == EOK) {
+			if (notify)
+				nic_ev_received_ring(nic_data->client_session);
+			return;
+		}
+	} else
+		fibril_mutex_unlock(&nic_data->rx_ring_lock);
+	
+	int rc = nic_ev_received(nic_data->client_session, frame->data,
+	    frame->size);
+	
+	/* Nobody drains the ring of a client which has gone away */
+	if (rc == EHANGUP)
+		nic_rx_ring_detach(nic_data);
+}
+
 /**
  * This is the function that the driver should call when it receives a frame.
  * The frame is checked by filters and then sent up to the NIL layer or
@@ -540,8 +648,7 @@ void nic_received_frame(nic_t *nic_data, nic_frame_t *frame)
 			break;
 		}
 		fibril_rwlock_write_unlock(&nic_data->stats_lock);
-		nic_ev_received(nic_data->client_session, frame->data,
-		    frame->size);
+		nic_deliver_frame(nic_data, frame);
 	} else {
 		switch (frame_type) {
 		case NIC_FRAME_UNICAST:
@@ -606,6 +713,7 @@ static nic_t *nic_create(ddf_dev_t *dev)
 	nic_data->fun = NULL;
 	nic_data->state = NIC_STATE_STOPPED;
 	nic_data->client_session = NULL;
+	nic_data->rx_ring_active = false;
 	nic_data->poll_mode = NIC_POLL_IMMEDIATE;
 	nic_data->default_poll_mode = NIC_POLL_IMMEDIATE;
 	nic_data->send_frame = NULL;
@@ -618,6 +726,12 @@ static nic_t *nic_create(ddf_dev_t *dev)
 	fibril_rwlock_initialize(&nic_data->stats_lock);
 	fibril_rwlock_initialize(&nic_data->rxc_lock);
 	fibril_rwlock_initialize(&nic_data->wv_lock);
+	fibril_mutex_initialize(&nic_data->rx_ring_lock);
+	
+	nic_data->napi.fibril = 0;
+	nic_data->napi.polling = false;
+	fibril_mutex_initialize(&nic_data->napi.lock);
+	fibril_condvar_initialize(&nic_data->napi.cv);
 	
 	memset(&nic_data->mac, 0, sizeof(nic_address_t));
 	memset(&nic_data->default_mac, 0, sizeof(nic_address_t));
@@ -1127,5 +1241,136 @@ void nic_sw_period_stop(nic_t *nic_data)
 	nic_data->sw_poll_info.running = 0;
 }
 
+/** Update the receive interrupt and poll counters
+ *
+ *  @param nic_data    Nic data structure
+ *  @param interrupts  Number of interrupts to add
+ *  @param polls       Number of polls to add
+ */
+static void nic_napi_report(nic_t *nic_data, unsigned long interrupts,
+    unsigned long polls)
+{
+	fibril_rwlock_write_lock(&nic_data->stats_lock);
+	nic_data->stats.receive_interrupts += interrupts;
+	nic_data->stats.receive_polls += polls;
+	fibril_rwlock_write_unlock(&nic_data->stats_lock);
+}
+
+/** Leave the polling mode
+ *
+ *  Enables the receive interrupts and polls the NIC once more, since the
+ *  frames received since the last poll need not raise an interrupt. If that
+ *  poll exhausts the budget, the NIC stays in the polling mode.
+ *
+ *  @param nic_data  Nic data structure, with napi.lock held
+ */
+static void nic_napi_complete(nic_t *nic_data)
+{
+	nic_data->napi.polling = false;
+	nic_data->on_napi_irq(nic_data, true);
+	
+	size_t received = nic_data->on_napi_poll(nic_data, NIC_NAPI_BUDGET);
+	nic_napi_report(nic_data, 0, 1);
+	
+	if (received >= NIC_NAPI_BUDGET) {
+		nic_data->on_napi_irq(nic_data, false);
+		nic_data->napi.polling = true;
+	}
+}
+
+/** Main function of the NAPI polling fibril
+ *
+ *  While the NIC is in the polling mode, receives at most NIC_NAPI_BUDGET
+ *  frames at once and lets other fibrils and the async manager run in
+ *  between, so that the IPC of the driver is served meanwhile. Returns to
+ *  the interrupt mode when a poll does not exhaust the budget.
+ *
+ *  @param  data The NIC structure pointer
+ *
+ *  @return 0, never reached
+ */
+static int napi_fibril_fun(void *data)
+{
+	nic_t *nic_data = data;
+	struct napi_info *napi = &nic_data->napi;
+	
+	fibril_mutex_lock(&napi->lock);
+	while (true) {
+		while (!napi->polling)
+			fibril_condvar_wait(&napi->cv, &napi->lock);
+		
+		size_t received = nic_data->on_napi_poll(nic_data,
+		    NIC_NAPI_BUDGET);
+		nic_napi_report(nic_data, 0, 1);
+		
+		if (received < NIC_NAPI_BUDGET)
+			nic_napi_complete(nic_data);
+		
+		fibril_mutex_unlock(&napi->lock);
+		async_usleep(0);
+		fibril_mutex_lock(&napi->lock);
+	}
+	
+	return 0;
+}
+
+/** Handle a receive interrupt of the NIC
+ *
+ *  The driver calls this from its interrupt handler instead of receiving the
+ *  frames on its own. At most NIC_NAPI_BUDGET frames are received right
+ *  away. If there are more, the NIC is under load: its receive interrupts
+ *  are disabled and the frames are received by polling until the load drops,
+ *  which saves an interrupt and a notification for most frames.
+ *
+ *  When re-enabling the interrupts at the end of its interrupt handler, the
+ *  driver must keep the receive interrupts disabled if the on_napi_irq
+ *  handler asked so.
+ *
+ *  @param nic_data  Nic data structure
+ */
+void nic_napi_interrupt(nic_t *nic_data)
+{
+	struct napi_info *napi = &nic_data->napi;
+	
+	assert(nic_data->on_napi_poll != NULL);
+	
+	fibril_mutex_lock(&napi->lock);
+	nic_napi_report(nic_data, 1, 0);
+	
+	/* The polling fibril takes care of the frames */
+	if (napi->polling) {
+		fibril_mutex_unlock(&napi->lock);
+		return;
+	}
+	
+	size_t received = nic_data->on_napi_poll(nic_data, NIC_NAPI_BUDGET);
+	if (received < NIC_NAPI_BUDGET) {
+		fibril_mutex_unlock(&napi->lock);
+		return;
+	}
+	
+	if (napi->fibril == 0) {
+		napi->fibril = fibril_create(napi_fibril_fun, nic_data);
+		if (napi->fibril == 0) {
+			/* Cannot poll, receive everything now */
+			while (received >= NIC_NAPI_BUDGET) {
+				received = nic_data->on_napi_poll(nic_data,
+				    NIC_NAPI_BUDGET);
+			}
+			
+			fibril_mutex_unlock(&napi->lock);
+			return;
+		}
+		
+		fibril_add_ready(napi->fibril);
+	}
+	
+	nic_data->on_napi_irq(nic_data, false);
+	napi->polling = true;
+	fibril_condvar_signal(&napi->cv);
+	
+	fibril_mutex_unlock(&napi->lock);
+}
+
 /** @}
  */
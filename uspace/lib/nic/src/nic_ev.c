@@ -93,5 +93,17 @@ int nic_ev_received(async_sess_t *sess, void *data, size_t size)
 	return retval;
 }
 
+/** Frames were queued to the receive ring.
+ *
+ * The notification is not waited for, the client drains the ring
+ * asynchronously.
+ */
+void nic_ev_received_ring(async_sess_t *sess)
+{
+	async_exch_t *exch = async_exchange_begin(sess);
+	async_msg_0(exch, NIC_EV_RECEIVED_RING);
+	async_exchange_end(exch);
+}
+
 /** @}
  */
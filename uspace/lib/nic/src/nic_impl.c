@@ -195,6 +195,9 @@ int nic_callback_create_impl(ddf_fun_t *fun)
 	nic_t *nic = nic_get_from_ddf_fun(fun);
 	fibril_rwlock_write_lock(&nic->main_lock);
 	
+	/* The ring of the previous client must not receive frames any more */
+	nic_rx_ring_detach(nic);
+	
 	nic->client_session = async_callback_receive(EXCHANGE_SERIALIZE);
 	if (nic->client_session == NULL) {
 		fibril_rwlock_write_unlock(&nic->main_lock);
@@ -799,6 +802,58 @@ int nic_poll_now_impl(ddf_fun_t *fun) {
 	}
 }
 
+/**
+ * Default implementation of the rx_ring_set method.
+ * Attaches the receive ring shared by the client. The ring can be set only
+ * once per callback session.
+ *
+ * @param fun		The DDF function where the method should be called.
+ * @param callid	Share out call carrying the ring
+ * @param size		Size of the shared area
+ * @param flags		Flags of the shared area
+ *
+ * @return EOK		If the ring was attached
+ * @return EEXIST	If the ring has already been set
+ * @return EINVAL	If the ring is malformed
+ */
+int nic_rx_ring_set_impl(ddf_fun_t *fun, cap_handle_t callid, size_t size,
+    unsigned int flags)
+{
+	nic_t *nic_data = nic_get_from_ddf_fun(fun);
+	fibril_mutex_lock(&nic_data->rx_ring_lock);
+	
+	if (nic_data->rx_ring_active) {
+		fibril_mutex_unlock(&nic_data->rx_ring_lock);
+		async_answer_0(callid, EEXIST);
+		return EEXIST;
+	}
+	
+	int rc = pkt_ring_attach(&nic_data->rx_ring, callid, size, flags);
+	if (rc == EOK)
+		nic_data->rx_ring_active = true;
+	
+	fibril_mutex_unlock(&nic_data->rx_ring_lock);
+	return rc;
+}
+
+/**
+ * Detach the receive ring set by the client, if any.
+ * Received frames are delivered by NIC_EV_RECEIVED calls afterwards.
+ *
+ * @param nic_data	The NIC structure
+ */
+void nic_rx_ring_detach(nic_t *nic_data)
+{
+	fibril_mutex_lock(&nic_data->rx_ring_lock);
+	
+	if (nic_data->rx_ring_active) {
+		nic_data->rx_ring_active = false;
+		pkt_ring_destroy(&nic_data->rx_ring);
+	}
+	
+	fibril_mutex_unlock(&nic_data->rx_ring_lock);
+}
+
 /**
  * Default handler for unknown methods (outside of the NIC interface).
  * Logs a warning message and returns ENOTSUP to the caller.
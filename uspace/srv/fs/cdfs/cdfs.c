@@ -51,6 +51,7 @@ static vfs_info_t cdfs_vfs_info = {
 	.name = NAME,
 	.concurrent_read_write = false,
 	.write_retains_size = false,
+	.cache_lookups = true,
 	.instance = 0,
 };
 
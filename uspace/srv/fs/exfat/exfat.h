@@ -92,6 +92,16 @@ typedef struct exfat_bs {
 	uint16_t signature;				/* the value of 0xAA55 */
 } __attribute__((__packed__)) exfat_bs_t;
 
+/** Run of clusters of a node which are adjacent on the device. */
+typedef struct {
+	/** Index of the first cluster of the run within the node. */
+	uint32_t	lcl;
+	/** First cluster of the run. */
+	exfat_cluster_t	pcl;
+	/** Number of clusters in the run. */
+	uint32_t	count;
+} exfat_extent_t;
+
 typedef enum {
 	EXFAT_UNKNOW,
 	EXFAT_DIRECTORY,
@@ -158,10 +168,17 @@ typedef struct exfat_node {
 	/* Node's last cluster in FAT. */
 	bool		lastc_cached_valid;
 	exfat_cluster_t	lastc_cached_value;
-	/* Node's "current" cluster, i.e. where the last I/O took place. */
-	bool		currc_cached_valid;
-	aoff64_t	currc_cached_bn;
-	exfat_cluster_t	currc_cached_value;
+
+	/*
+	 * Map of the beginning of a fragmented node's cluster chain, built
+	 * lazily as the chain is walked. The extents are sorted and cover the
+	 * first ext_mapped clusters of the node.
+	 */
+	fibril_mutex_t	ext_lock;
+	exfat_extent_t	*extents;
+	size_t		ext_count;
+	size_t		ext_alloc;
+	uint32_t	ext_mapped;
 } exfat_node_t;
 
 
@@ -50,8 +50,12 @@
 #include <mem.h>
 #include <stdlib.h>
 #include <str.h>
+#include <macros.h>
 
 
+/** Maximum number of extents in the extent map of a node. */
+#define EXFAT_EXTENTS_MAX	4096
+
 /**
  * The fat_alloc_lock mutex protects all copies of the File Allocation Table
  * during allocation of clusters. The lock does not have to be held durring
@@ -111,6 +115,156 @@ exfat_cluster_walk(exfat_bs_t *bs, service_id_t service_id,
 	return EOK;
 }
 
+/** Extend the extent map of a fragmented node.
+ *
+ * Walks the cluster chain from the end of the mapped part until at least
+ * @a want clusters are mapped, the chain ends or the map is full.
+ * The caller must hold nodep->ext_lock.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		exFAT node.
+ * @param want		Number of clusters which should be mapped.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+static int exfat_extents_extend(exfat_bs_t *bs, exfat_node_t *nodep,
+    uint32_t want)
+{
+	service_id_t service_id = nodep->idx->service_id;
+	exfat_extent_t *ext;
+	exfat_cluster_t clst;
+	int rc;
+
+	if (nodep->ext_mapped >= want)
+		return EOK;
+
+	if (nodep->ext_count == 0) {
+		clst = nodep->firstc;
+	} else {
+		ext = &nodep->extents[nodep->ext_count - 1];
+		rc = exfat_get_cluster(bs, service_id,
+		    ext->pcl + ext->count - 1, &clst);
+		if (rc != EOK)
+			return rc;
+	}
+
+	while (nodep->ext_mapped < want && clst >= EXFAT_CLST_FIRST &&
+	    clst < EXFAT_CLST_BAD) {
+		ext = (nodep->ext_count > 0) ?
+		    &nodep->extents[nodep->ext_count - 1] : NULL;
+
+		if (ext != NULL && ext->pcl + ext->count == clst) {
+			ext->count++;
+		} else {
+			if (nodep->ext_count == nodep->ext_alloc) {
+				size_t nalloc;
+
+				if (nodep->ext_alloc == EXFAT_EXTENTS_MAX)
+					break;
+				nalloc = max(2 * nodep->ext_alloc, 4);
+				ext = realloc(nodep->extents,
+				    nalloc * sizeof(exfat_extent_t));
+				if (!ext)
+					break;
+				nodep->extents = ext;
+				nodep->ext_alloc = nalloc;
+			}
+
+			ext = &nodep->extents[nodep->ext_count++];
+			ext->lcl = nodep->ext_mapped;
+			ext->pcl = clst;
+			ext->count = 1;
+		}
+		nodep->ext_mapped++;
+
+		if (nodep->ext_mapped < want) {
+			rc = exfat_get_cluster(bs, service_id, clst, &clst);
+			if (rc != EOK)
+				return rc;
+		}
+	}
+
+	return EOK;
+}
+
+/** Find a cluster of a fragmented node.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		exFAT node.
+ * @param lcl		Index of the cluster within the node.
+ * @param clp		Output argument holding the cluster.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+static int exfat_node_cluster(exfat_bs_t *bs, exfat_node_t *nodep,
+    uint32_t lcl, exfat_cluster_t *clp)
+{
+	exfat_extent_t *ext;
+	size_t lo, hi;
+	int rc;
+
+	fibril_mutex_lock(&nodep->ext_lock);
+
+	rc = exfat_extents_extend(bs, nodep, lcl + 1);
+	if (rc != EOK) {
+		fibril_mutex_unlock(&nodep->ext_lock);
+		return rc;
+	}
+
+	if (lcl >= nodep->ext_mapped) {
+		exfat_cluster_t c = nodep->firstc;
+		uint32_t clusters;
+
+		/*
+		 * The map is full. Walk the rest of the chain starting with
+		 * the last mapped cluster.
+		 */
+		if (nodep->ext_count > 0) {
+			ext = &nodep->extents[nodep->ext_count - 1];
+			c = ext->pcl + ext->count - 1;
+			lcl -= nodep->ext_mapped - 1;
+		}
+		fibril_mutex_unlock(&nodep->ext_lock);
+
+		rc = exfat_cluster_walk(bs, nodep->idx->service_id, c, clp,
+		    &clusters, lcl);
+		if (rc != EOK)
+			return rc;
+		assert(clusters == lcl);
+		return EOK;
+	}
+
+	/* Binary search for the extent containing lcl. */
+	lo = 0;
+	hi = nodep->ext_count;
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (nodep->extents[mid].lcl <= lcl)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	ext = &nodep->extents[lo];
+	assert(lcl >= ext->lcl && lcl < ext->lcl + ext->count);
+	*clp = ext->pcl + (lcl - ext->lcl);
+
+	fibril_mutex_unlock(&nodep->ext_lock);
+	return EOK;
+}
+
+/** Forget the extent map of a node.
+ *
+ * @param nodep		exFAT node whose cluster chain has been cut.
+ */
+static void exfat_extents_reset(exfat_node_t *nodep)
+{
+	fibril_mutex_lock(&nodep->ext_lock);
+	nodep->ext_count = 0;
+	nodep->ext_mapped = 0;
+	fibril_mutex_unlock(&nodep->ext_lock);
+}
+
 /** Read block from file located on a exFAT file system.
  *
  * @param block		Pointer to a block pointer for storing result.
@@ -125,49 +279,35 @@ int
 exfat_block_get(block_t **block, exfat_bs_t *bs, exfat_node_t *nodep,
     aoff64_t bn, int flags)
 {
-	exfat_cluster_t firstc = nodep->firstc;
-	exfat_cluster_t currc = 0;
-	aoff64_t relbn = bn;
+	exfat_cluster_t c;
 	int rc;
 
 	if (!nodep->size)
 		return ELIMIT;
 
-	if (nodep->fragmented) {
-		if (((((nodep->size - 1) / BPS(bs)) / SPC(bs)) == bn / SPC(bs)) &&
-		    nodep->lastc_cached_valid) {
-			/*
-			 * This is a request to read a block within the last cluster
-			 * when fortunately we have the last cluster number cached.
-			 */
-			return block_get(block, nodep->idx->service_id, DATA_FS(bs) + 
-		        (nodep->lastc_cached_value-EXFAT_CLST_FIRST)*SPC(bs) + 
-			    (bn % SPC(bs)), flags);
-		}
+	if (!nodep->fragmented) {
+		return exfat_block_get_by_clst(block, bs,
+		    nodep->idx->service_id, false, nodep->firstc, NULL, bn,
+		    flags);
+	}
 
-		if (nodep->currc_cached_valid && bn >= nodep->currc_cached_bn) {
-			/*
-			* We can start with the cluster cached by the previous call to
-			* fat_block_get().
-			*/
-			firstc = nodep->currc_cached_value;
-			relbn -= (nodep->currc_cached_bn / SPC(bs)) * SPC(bs);
-		}
+	if (((((nodep->size - 1) / BPS(bs)) / SPC(bs)) == bn / SPC(bs)) &&
+	    nodep->lastc_cached_valid) {
+		/*
+		 * This is a request to read a block within the last cluster
+		 * when fortunately we have the last cluster number cached.
+		 */
+		return block_get(block, nodep->idx->service_id, DATA_FS(bs) + 
+		    (nodep->lastc_cached_value-EXFAT_CLST_FIRST)*SPC(bs) + 
+		    (bn % SPC(bs)), flags);
 	}
 
-	rc = exfat_block_get_by_clst(block, bs, nodep->idx->service_id,
-	    nodep->fragmented, firstc, &currc, relbn, flags);
+	rc = exfat_node_cluster(bs, nodep, bn / SPC(bs), &c);
 	if (rc != EOK)
 		return rc;
 
-	/*
-	 * Update the "current" cluster cache.
-	 */
-	nodep->currc_cached_valid = true;
-	nodep->currc_cached_bn = bn;
-	nodep->currc_cached_value = currc;
-
-	return rc;
+	return block_get(block, nodep->idx->service_id, DATA_FS(bs) +
+	    (c - EXFAT_CLST_FIRST) * SPC(bs) + (bn % SPC(bs)), flags);
 }
 
 /** Read block from file located on a exFAT file system.
@@ -448,8 +588,7 @@ int exfat_chop_clusters(exfat_bs_t *bs, exfat_node_t *nodep, exfat_cluster_t lcl
 	 * Invalidate cached cluster numbers.
 	 */
 	nodep->lastc_cached_valid = false;
-	if (nodep->currc_cached_value != lcl)
-		nodep->currc_cached_valid = false;
+	exfat_extents_reset(nodep);
 
 	if (lcl == 0) {
 		/* The node will have zero size and no clusters allocated. */
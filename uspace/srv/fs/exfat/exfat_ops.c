@@ -108,9 +108,11 @@ static void exfat_node_initialize(exfat_node_t *node)
 	node->fragmented = false;
 	node->lastc_cached_valid = false;
 	node->lastc_cached_value = 0;
-	node->currc_cached_valid = false;
-	node->currc_cached_bn = 0;
-	node->currc_cached_value = 0;
+	fibril_mutex_initialize(&node->ext_lock);
+	node->extents = NULL;
+	node->ext_count = 0;
+	node->ext_alloc = 0;
+	node->ext_mapped = 0;
 }
 
 static int exfat_node_sync(exfat_node_t *node)
@@ -199,6 +201,7 @@ restart:
 				return rc;
 		}
 		nodep->idx->nodep = NULL;
+		free(nodep->extents);
 		free(nodep->bp);
 		free(nodep);
 
@@ -237,6 +240,7 @@ static int exfat_node_get_new(exfat_node_t **nodepp)
 				idxp_tmp->nodep = NULL;
 				fibril_mutex_unlock(&nodep->lock);
 				fibril_mutex_unlock(&idxp_tmp->lock);
+				free(nodep->extents);
 				free(nodep->bp);
 				free(nodep);
 				return rc;
@@ -245,6 +249,7 @@ static int exfat_node_get_new(exfat_node_t **nodepp)
 		idxp_tmp->nodep = NULL;
 		fibril_mutex_unlock(&nodep->lock);
 		fibril_mutex_unlock(&idxp_tmp->lock);
+		free(nodep->extents);
 		fn = FS_NODE(nodep);
 	} else {
 skip_cache:
@@ -618,6 +623,7 @@ int exfat_node_put(fs_node_t *fn)
 	}
 	fibril_mutex_unlock(&nodep->lock);
 	if (destroy) {
+		free(nodep->extents);
 		free(nodep->bp);
 		free(nodep);
 	}
@@ -712,6 +718,7 @@ int exfat_destroy_node(fs_node_t *fn)
 	} 
 
 	exfat_idx_destroy(nodep->idx);
+	free(nodep->extents);
 	free(nodep->bp);
 	free(nodep);
 	return rc;
@@ -48,6 +48,7 @@
 
 vfs_info_t ext4fs_vfs_info = {
 	.name = NAME,
+	.cache_lookups = true,
 	.instance = 0
 };
 
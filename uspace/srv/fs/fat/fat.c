@@ -53,6 +53,7 @@ vfs_info_t fat_vfs_info = {
 	.name = NAME,
 	.concurrent_read_write = false,
 	.write_retains_size = false,
+	.cache_lookups = true,
 	.instance = 0,
 };
 
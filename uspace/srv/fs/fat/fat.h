@@ -153,6 +153,16 @@ typedef struct {
 	uint8_t sig3[4];
 } __attribute__ ((packed)) fat32_fsinfo_t;
 
+/** Run of clusters of a node which are adjacent on the device. */
+typedef struct {
+	/** Index of the first cluster of the run within the node. */
+	uint32_t	lcl;
+	/** First cluster of the run. */
+	fat_cluster_t	pcl;
+	/** Number of clusters in the run. */
+	uint32_t	count;
+} fat_extent_t;
+
 typedef enum {
 	FAT_INVALID,
 	FAT_DIRECTORY,
@@ -236,10 +246,17 @@ typedef struct fat_node {
 	/* Node's last cluster in FAT. */
 	bool		lastc_cached_valid;
 	fat_cluster_t	lastc_cached_value;
-	/* Node's "current" cluster, i.e. where the last I/O took place. */
-	bool		currc_cached_valid;
-	aoff64_t	currc_cached_bn;
-	fat_cluster_t	currc_cached_value;
+
+	/*
+	 * Map of the beginning of the node's cluster chain, built lazily as
+	 * the chain is walked. The extents are sorted and cover the first
+	 * ext_mapped clusters of the node.
+	 */
+	fibril_mutex_t	ext_lock;
+	fat_extent_t	*extents;
+	size_t		ext_count;
+	size_t		ext_alloc;
+	uint32_t	ext_mapped;
 } fat_node_t;
 
 typedef struct {
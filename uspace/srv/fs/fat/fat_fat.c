@@ -48,14 +48,21 @@
 #include <assert.h>
 #include <fibril_synch.h>
 #include <mem.h>
+#include <macros.h>
 #include <stdlib.h>
+#include <adt/list.h>
 
 #define IS_ODD(number)	(number & 0x1)
 
+/** Maximum number of extents in the extent map of a node. */
+#define FAT_EXTENTS_MAX	4096
+
+/** Number of FAT blocks read at once when building the free cluster map. */
+#define FAT_SCAN_BLOCKS	128
+
 /**
  * The fat_alloc_lock mutex protects all copies of the File Allocation Table
- * during allocation of clusters. The lock does not have to be held durring
- * deallocation of clusters.
+ * during allocation and deallocation of clusters, and the free cluster maps.
  */
 static FIBRIL_MUTEX_INITIALIZE(fat_alloc_lock);
 
@@ -112,6 +119,163 @@ fat_cluster_walk(fat_bs_t *bs, service_id_t service_id, fat_cluster_t firstc,
 	return EOK;
 }
 
+/** Extend the extent map of a node.
+ *
+ * Walks the cluster chain from the end of the mapped part until at least
+ * @a want clusters are mapped, the chain ends or the map is full.
+ * The caller must hold nodep->ext_lock.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		FAT node.
+ * @param want		Number of clusters which should be mapped.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+static int fat_extents_extend(fat_bs_t *bs, fat_node_t *nodep, uint32_t want)
+{
+	service_id_t service_id = nodep->idx->service_id;
+	fat_cluster_t clst_last1 = FAT_CLST_LAST1(bs);
+	fat_extent_t *ext;
+	fat_cluster_t clst;
+	int rc;
+
+	if (nodep->ext_mapped >= want)
+		return EOK;
+
+	if (nodep->ext_count == 0) {
+		clst = nodep->firstc;
+	} else {
+		ext = &nodep->extents[nodep->ext_count - 1];
+		rc = fat_get_cluster(bs, service_id, FAT1,
+		    ext->pcl + ext->count - 1, &clst);
+		if (rc != EOK)
+			return rc;
+	}
+
+	while (nodep->ext_mapped < want && clst >= FAT_CLST_FIRST &&
+	    clst < clst_last1) {
+		ext = (nodep->ext_count > 0) ?
+		    &nodep->extents[nodep->ext_count - 1] : NULL;
+
+		if (ext != NULL && ext->pcl + ext->count == clst) {
+			ext->count++;
+		} else {
+			if (nodep->ext_count == nodep->ext_alloc) {
+				size_t nalloc;
+
+				if (nodep->ext_alloc == FAT_EXTENTS_MAX)
+					break;
+				nalloc = max(2 * nodep->ext_alloc, 4);
+				ext = realloc(nodep->extents,
+				    nalloc * sizeof(fat_extent_t));
+				if (!ext)
+					break;
+				nodep->extents = ext;
+				nodep->ext_alloc = nalloc;
+			}
+
+			ext = &nodep->extents[nodep->ext_count++];
+			ext->lcl = nodep->ext_mapped;
+			ext->pcl = clst;
+			ext->count = 1;
+		}
+		nodep->ext_mapped++;
+
+		if (nodep->ext_mapped < want) {
+			rc = fat_get_cluster(bs, service_id, FAT1, clst, &clst);
+			if (rc != EOK)
+				return rc;
+		}
+	}
+
+	return EOK;
+}
+
+/** Find a cluster of a node.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		FAT node.
+ * @param lcl		Index of the cluster within the node.
+ * @param clp		Output argument holding the cluster.
+ * @param run		If not NULL, output argument holding the number of
+ *			clusters, starting with *clp, which are known to be
+ *			adjacent on the device.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+static int fat_node_cluster(fat_bs_t *bs, fat_node_t *nodep, uint32_t lcl,
+    fat_cluster_t *clp, uint32_t *run)
+{
+	fat_extent_t *ext;
+	size_t lo, hi;
+	int rc;
+
+	fibril_mutex_lock(&nodep->ext_lock);
+
+	rc = fat_extents_extend(bs, nodep, lcl + 1);
+	if (rc != EOK) {
+		fibril_mutex_unlock(&nodep->ext_lock);
+		return rc;
+	}
+
+	if (lcl >= nodep->ext_mapped) {
+		fat_cluster_t c = nodep->firstc;
+		uint32_t clusters;
+
+		/*
+		 * The map is full. Walk the rest of the chain starting with
+		 * the last mapped cluster.
+		 */
+		if (nodep->ext_count > 0) {
+			ext = &nodep->extents[nodep->ext_count - 1];
+			c = ext->pcl + ext->count - 1;
+			lcl -= nodep->ext_mapped - 1;
+		}
+		fibril_mutex_unlock(&nodep->ext_lock);
+
+		rc = fat_cluster_walk(bs, nodep->idx->service_id, c, clp,
+		    &clusters, lcl);
+		if (rc != EOK)
+			return rc;
+		assert(clusters == lcl);
+		if (run)
+			*run = 1;
+		return EOK;
+	}
+
+	/* Binary search for the extent containing lcl. */
+	lo = 0;
+	hi = nodep->ext_count;
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (nodep->extents[mid].lcl <= lcl)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	ext = &nodep->extents[lo];
+	assert(lcl >= ext->lcl && lcl < ext->lcl + ext->count);
+	*clp = ext->pcl + (lcl - ext->lcl);
+	if (run)
+		*run = ext->lcl + ext->count - lcl;
+
+	fibril_mutex_unlock(&nodep->ext_lock);
+	return EOK;
+}
+
+/** Forget the extent map of a node.
+ *
+ * @param nodep		FAT node whose cluster chain has been cut.
+ */
+static void fat_extents_reset(fat_node_t *nodep)
+{
+	fibril_mutex_lock(&nodep->ext_lock);
+	nodep->ext_count = 0;
+	nodep->ext_mapped = 0;
+	fibril_mutex_unlock(&nodep->ext_lock);
+}
+
 /** Read block from file located on a FAT file system.
  *
  * @param block		Pointer to a block pointer for storing result.
@@ -126,16 +290,16 @@ int
 fat_block_get(block_t **block, struct fat_bs *bs, fat_node_t *nodep,
     aoff64_t bn, int flags)
 {
-	fat_cluster_t firstc = nodep->firstc;
-	fat_cluster_t currc = 0;
-	aoff64_t relbn = bn;
+	fat_cluster_t c;
 	int rc;
 
 	if (!nodep->size)
 		return ELIMIT;
 
-	if (!FAT_IS_FAT32(bs) && nodep->firstc == FAT_CLST_ROOT)
-		goto fall_through;
+	if (!FAT_IS_FAT32(bs) && nodep->firstc == FAT_CLST_ROOT) {
+		return _fat_block_get(block, bs, nodep->idx->service_id,
+		    nodep->firstc, NULL, bn, flags);
+	}
 
 	if (((((nodep->size - 1) / BPS(bs)) / SPC(bs)) == bn / SPC(bs)) &&
 	    nodep->lastc_cached_valid) {
@@ -147,29 +311,12 @@ fat_block_get(block_t **block, struct fat_bs *bs, fat_node_t *nodep,
 		    CLBN2PBN(bs, nodep->lastc_cached_value, bn), flags);
 	}
 
-	if (nodep->currc_cached_valid && bn >= nodep->currc_cached_bn) {
-		/*
-		 * We can start with the cluster cached by the previous call to
-		 * fat_block_get().
-		 */
-		firstc = nodep->currc_cached_value;
-		relbn -= (nodep->currc_cached_bn / SPC(bs)) * SPC(bs);
-	}
-
-fall_through:
-	rc = _fat_block_get(block, bs, nodep->idx->service_id, firstc,
-	    &currc, relbn, flags);
+	rc = fat_node_cluster(bs, nodep, bn / SPC(bs), &c, NULL);
 	if (rc != EOK)
 		return rc;
 
-	/*
-	 * Update the "current" cluster cache.
-	 */
-	nodep->currc_cached_valid = true;
-	nodep->currc_cached_bn = bn;
-	nodep->currc_cached_value = currc;
-
-	return rc;
+	return block_get(block, nodep->idx->service_id, CLBN2PBN(bs, c, bn),
+	    flags);
 }
 
 /** Read block from file located on a FAT file system.
@@ -224,6 +371,118 @@ _fat_block_get(block_t **block, fat_bs_t *bs, service_id_t service_id,
 	return rc;
 }
 
+/** Map a run of file blocks to device blocks.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		FAT node.
+ * @param bn		First block number.
+ * @param maxcnt	Maximum number of blocks to map.
+ * @param pbn		Output device block number of block bn.
+ * @param cnt		Output number of blocks, starting with bn, which are
+ *			stored in consecutive device blocks.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+int
+fat_block_map(struct fat_bs *bs, fat_node_t *nodep, aoff64_t bn, size_t maxcnt,
+    aoff64_t *pbn, size_t *cnt)
+{
+	fat_cluster_t c;
+	uint32_t run;
+	int rc;
+
+	if (!nodep->size)
+		return ELIMIT;
+
+	if (!FAT_IS_FAT32(bs) && nodep->firstc == FAT_CLST_ROOT) {
+		return _fat_block_map(bs, nodep->idx->service_id,
+		    nodep->firstc, NULL, bn, maxcnt, pbn, cnt);
+	}
+
+	/* Map all clusters of the requested blocks at once. */
+	fibril_mutex_lock(&nodep->ext_lock);
+	rc = fat_extents_extend(bs, nodep, (bn + maxcnt - 1) / SPC(bs) + 1);
+	fibril_mutex_unlock(&nodep->ext_lock);
+	if (rc != EOK)
+		return rc;
+
+	rc = fat_node_cluster(bs, nodep, bn / SPC(bs), &c, &run);
+	if (rc != EOK)
+		return rc;
+
+	*pbn = CLBN2PBN(bs, c, bn);
+	*cnt = min((aoff64_t) run * SPC(bs) - bn % SPC(bs), maxcnt);
+
+	return EOK;
+}
+
+/** Map a run of file blocks to device blocks.
+ *
+ * Follows the cluster chain for as long as the next cluster immediately
+ * follows the current one on the device.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param service_id	Service ID handle of the file system.
+ * @param fcl		First cluster used by the file.
+ * @param clp		If not NULL, address where the cluster containing the
+ *			last block of the run will be stored.
+ * @param bn		First block number.
+ * @param maxcnt	Maximum number of blocks to map.
+ * @param pbn		Output device block number of block bn.
+ * @param cnt		Output number of blocks in the run.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+int
+_fat_block_map(fat_bs_t *bs, service_id_t service_id, fat_cluster_t fcl,
+    fat_cluster_t *clp, aoff64_t bn, size_t maxcnt, aoff64_t *pbn, size_t *cnt)
+{
+	uint32_t clusters;
+	uint32_t max_clusters;
+	fat_cluster_t c = 0;
+	fat_cluster_t next;
+	size_t n;
+	int rc;
+
+	assert(maxcnt > 0);
+
+	if (fcl == FAT_CLST_RES0)
+		return ELIMIT;
+
+	if (!FAT_IS_FAT32(bs) && fcl == FAT_CLST_ROOT) {
+		/* root directory special case */
+		assert(bn < RDS(bs));
+		*pbn = RSCNT(bs) + FATCNT(bs) * SF(bs) + bn;
+		*cnt = min(maxcnt, RDS(bs) - bn);
+		return EOK;
+	}
+
+	max_clusters = bn / SPC(bs);
+	rc = fat_cluster_walk(bs, service_id, fcl, &c, &clusters, max_clusters);
+	if (rc != EOK)
+		return rc;
+	assert(clusters == max_clusters);
+
+	*pbn = CLBN2PBN(bs, c, bn);
+
+	n = SPC(bs) - bn % SPC(bs);
+	while (n < maxcnt) {
+		rc = fat_get_cluster(bs, service_id, FAT1, c, &next);
+		if (rc != EOK)
+			return rc;
+		if (next != c + 1 || next >= FAT_CLST_LAST1(bs))
+			break;
+		c = next;
+		n += SPC(bs);
+	}
+
+	if (clp)
+		*clp = c;
+	*cnt = min(n, maxcnt);
+
+	return EOK;
+}
+
 /** Fill the gap between EOF and a new file position.
  *
  * @param bs		Buffer holding the boot sector for nodep.
@@ -626,17 +885,322 @@ fat_set_cluster(fat_bs_t *bs, service_id_t service_id, unsigned fatno,
 	return rc;
 }
 
-/** Replay the allocatoin of clusters in all shadow instances of FAT.
+/** Per-instance map of free clusters.
+ *
+ * The map is built when the file system is mounted and kept up to date by
+ * fat_alloc_clusters() and fat_free_clusters() so that allocation does not
+ * have to scan the FAT.
+ */
+typedef struct {
+	link_t link;
+	service_id_t service_id;
+
+	/** Number of FAT entries tracked by the map. */
+	uint32_t clusters;
+	/** Number of free clusters. */
+	uint32_t free;
+	/** Next-fit hint. The next search for free clusters starts here. */
+	fat_cluster_t hint;
+	/** One bit per FAT entry, set if the cluster is in use. */
+	uint32_t *bitmap;
+} fat_free_map_t;
+
+/** List of free cluster maps, protected by fat_alloc_lock. */
+static LIST_INITIALIZE(free_map_list);
+
+static fat_free_map_t *free_map_find(service_id_t service_id)
+{
+	list_foreach(free_map_list, link, fat_free_map_t, map) {
+		if (map->service_id == service_id)
+			return map;
+	}
+
+	return NULL;
+}
+
+static inline bool free_map_used(fat_free_map_t *map, fat_cluster_t clst)
+{
+	return (map->bitmap[clst / 32] & (1U << (clst % 32))) != 0;
+}
+
+static inline void free_map_set(fat_free_map_t *map, fat_cluster_t clst)
+{
+	assert(!free_map_used(map, clst));
+	map->bitmap[clst / 32] |= 1U << (clst % 32);
+	map->free--;
+}
+
+static inline void free_map_clear(fat_free_map_t *map, fat_cluster_t clst)
+{
+	assert(free_map_used(map, clst));
+	map->bitmap[clst / 32] &= ~(1U << (clst % 32));
+	map->free++;
+}
+
+/** Find a run of free clusters.
+ *
+ * @param map		Free cluster map.
+ * @param from		First cluster to consider.
+ * @param to		Cluster following the last cluster to consider.
+ * @param nclsts	Length of the run.
+ * @param start		Output argument holding the first cluster of the run.
  *
+ * @return		True if a run has been found.
+ */
+static bool free_map_find_run(fat_free_map_t *map, fat_cluster_t from,
+    fat_cluster_t to, unsigned nclsts, fat_cluster_t *start)
+{
+	fat_cluster_t clst = from;
+	unsigned len = 0;
+
+	while (clst < to) {
+		if (clst % 32 == 0 && clst + 32 <= to &&
+		    map->bitmap[clst / 32] == UINT32_MAX) {
+			/* skip a fully used word */
+			len = 0;
+			clst += 32;
+			continue;
+		}
+
+		if (free_map_used(map, clst)) {
+			len = 0;
+		} else {
+			if (len == 0)
+				*start = clst;
+			if (++len == nclsts)
+				return true;
+		}
+		clst++;
+	}
+
+	return false;
+}
+
+/** Collect free clusters, not necessarily contiguous.
+ *
+ * @param map		Free cluster map.
+ * @param from		First cluster to consider.
+ * @param to		Cluster following the last cluster to consider.
+ * @param chain		Array where the free clusters will be stored.
+ * @param found		Number of clusters already in the array.
+ * @param nclsts	Number of clusters wanted.
+ *
+ * @return		Number of clusters in the array.
+ */
+static unsigned free_map_gather(fat_free_map_t *map, fat_cluster_t from,
+    fat_cluster_t to, fat_cluster_t *chain, unsigned found, unsigned nclsts)
+{
+	fat_cluster_t clst = from;
+
+	while (clst < to && found < nclsts) {
+		if (clst % 32 == 0 && clst + 32 <= to &&
+		    map->bitmap[clst / 32] == UINT32_MAX) {
+			clst += 32;
+			continue;
+		}
+
+		if (!free_map_used(map, clst))
+			chain[found++] = clst;
+		clst++;
+	}
+
+	return found;
+}
+
+/** Mark the FAT entries read from FAT1 in the free cluster map.
+ *
+ * FAT16 and FAT32 tables are read in large chunks bypassing the block cache.
+ *
+ * @param map		Free cluster map with all clusters marked free.
  * @param bs		Buffer holding the boot sector of the file system.
  * @param service_id	Service ID of the file system.
- * @param lifo		Chain of allocated clusters.
- * @param nclsts	Number of clusters in the lifo chain.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+static int free_map_scan(fat_free_map_t *map, fat_bs_t *bs,
+    service_id_t service_id)
+{
+	fat_cluster_t clst;
+	fat_cluster_t value;
+	int rc;
+
+	if (FAT_IS_FAT12(bs)) {
+		for (clst = FAT_CLST_FIRST; clst < map->clusters; clst++) {
+			rc = fat_get_cluster(bs, service_id, FAT1, clst,
+			    &value);
+			if (rc != EOK)
+				return rc;
+			if (value != FAT_CLST_RES0)
+				free_map_set(map, clst);
+		}
+		return EOK;
+	}
+
+	size_t per_block = BPS(bs) / FAT_CLST_SIZE(bs);
+	size_t nblocks = (map->clusters + per_block - 1) / per_block;
+	uint8_t *buf = malloc(FAT_SCAN_BLOCKS * BPS(bs));
+	if (!buf)
+		return ENOMEM;
+
+	for (size_t blk = 0; blk < nblocks; blk += FAT_SCAN_BLOCKS) {
+		size_t cnt = min(nblocks - blk, FAT_SCAN_BLOCKS);
+
+		rc = block_read_range(service_id, RSCNT(bs) + blk, cnt, buf);
+		if (rc != EOK) {
+			free(buf);
+			return rc;
+		}
+
+		for (size_t i = 0; i < cnt * per_block; i++) {
+			clst = blk * per_block + i;
+			if (clst >= map->clusters)
+				break;
+			if (clst < FAT_CLST_FIRST)
+				continue;
+
+			if (FAT_IS_FAT32(bs)) {
+				value = uint32_t_le2host(
+				    ((uint32_t *) buf)[i]) & FAT32_MASK;
+			} else {
+				value = uint16_t_le2host(
+				    ((uint16_t *) buf)[i]);
+			}
+			if (value != FAT_CLST_RES0)
+				free_map_set(map, clst);
+		}
+	}
+
+	free(buf);
+	return EOK;
+}
+
+/** Build the free cluster map of a file system instance.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param service_id	Service ID of the file system.
+ * @param hint		Cluster where to start looking for free clusters,
+ *			e.g. from the FAT32 FS info sector. Ignored if out of
+ *			range.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+int fat_alloc_init_by_service_id(fat_bs_t *bs, service_id_t service_id,
+    fat_cluster_t hint)
+{
+	fat_free_map_t *map;
+	uint32_t entries;
+	int rc;
+
+	map = malloc(sizeof(fat_free_map_t));
+	if (!map)
+		return ENOMEM;
+
+	/* Do not track clusters which do not have an entry in the FAT. */
+	if (FAT_IS_FAT12(bs))
+		entries = SF(bs) * BPS(bs) * 2 / 3;
+	else
+		entries = SF(bs) * BPS(bs) / FAT_CLST_SIZE(bs);
+
+	link_initialize(&map->link);
+	map->service_id = service_id;
+	map->clusters = min(CC(bs) + 2, entries);
+	map->free = map->clusters;
+	map->hint = FAT_CLST_FIRST;
+	if (hint >= FAT_CLST_FIRST && hint < map->clusters)
+		map->hint = hint;
+
+	map->bitmap = calloc((map->clusters + 31) / 32, sizeof(uint32_t));
+	if (!map->bitmap) {
+		free(map);
+		return ENOMEM;
+	}
+
+	/* The two reserved entries never describe a cluster. */
+	free_map_set(map, 0);
+	free_map_set(map, 1);
+
+	rc = free_map_scan(map, bs, service_id);
+	if (rc != EOK) {
+		free(map->bitmap);
+		free(map);
+		return rc;
+	}
+
+	fibril_mutex_lock(&fat_alloc_lock);
+	if (free_map_find(service_id) != NULL) {
+		fibril_mutex_unlock(&fat_alloc_lock);
+		free(map->bitmap);
+		free(map);
+		return EEXIST;
+	}
+	list_append(&map->link, &free_map_list);
+	fibril_mutex_unlock(&fat_alloc_lock);
+
+	return EOK;
+}
+
+/** Destroy the free cluster map of a file system instance.
+ *
+ * @param service_id	Service ID of the file system.
+ */
+void fat_alloc_fini_by_service_id(service_id_t service_id)
+{
+	fat_free_map_t *map;
+
+	fibril_mutex_lock(&fat_alloc_lock);
+	map = free_map_find(service_id);
+	if (map)
+		list_remove(&map->link);
+	fibril_mutex_unlock(&fat_alloc_lock);
+
+	if (map) {
+		free(map->bitmap);
+		free(map);
+	}
+}
+
+/** Get the allocation state of a file system instance.
+ *
+ * @param service_id	Service ID of the file system.
+ * @param nfree		If not NULL, output argument holding the number of
+ *			free clusters.
+ * @param hint		If not NULL, output argument holding the cluster
+ *			where the next search for free clusters starts.
+ *
+ * @return		EOK on success or ENOENT if the free cluster map
+ *			does not exist.
+ */
+int fat_alloc_info(service_id_t service_id, uint32_t *nfree,
+    fat_cluster_t *hint)
+{
+	fat_free_map_t *map;
+
+	fibril_mutex_lock(&fat_alloc_lock);
+	map = free_map_find(service_id);
+	if (!map) {
+		fibril_mutex_unlock(&fat_alloc_lock);
+		return ENOENT;
+	}
+	if (nfree)
+		*nfree = map->free;
+	if (hint)
+		*hint = map->hint;
+	fibril_mutex_unlock(&fat_alloc_lock);
+
+	return EOK;
+}
+
+/** Replay the allocation of clusters in all shadow instances of FAT.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param service_id	Service ID of the file system.
+ * @param chain		Chain of allocated clusters, in chain order.
+ * @param nclsts	Number of clusters in the chain.
  *
  * @return		EOK on success or a negative error code.
  */
 int fat_alloc_shadow_clusters(fat_bs_t *bs, service_id_t service_id,
-    fat_cluster_t *lifo, unsigned nclsts)
+    fat_cluster_t *chain, unsigned nclsts)
 {
 	uint8_t fatno;
 	unsigned c;
@@ -645,8 +1209,8 @@ int fat_alloc_shadow_clusters(fat_bs_t *bs, service_id_t service_id,
 
 	for (fatno = FAT1 + 1; fatno < FATCNT(bs); fatno++) {
 		for (c = 0; c < nclsts; c++) {
-			rc = fat_set_cluster(bs, service_id, fatno, lifo[c],
-			    c == 0 ? clst_last1 : lifo[c - 1]);
+			rc = fat_set_cluster(bs, service_id, fatno, chain[c],
+			    c == nclsts - 1 ? clst_last1 : chain[c + 1]);
 			if (rc != EOK)
 				return rc;
 		}
@@ -662,6 +1226,10 @@ int fat_alloc_shadow_clusters(fat_bs_t *bs, service_id_t service_id,
  * clusters form an independent chain (i.e. a chain which does not belong to any
  * file yet).
  *
+ * Free clusters are looked up in the free cluster map, starting at the
+ * next-fit hint. A contiguous run of clusters is preferred; if there is none,
+ * the first free clusters found are chained in ascending order.
+ *
  * @param bs		Buffer holding the boot sector of the file system.
  * @param service_id	Device service ID of the file system.
  * @param nclsts	Number of clusters to allocate.
@@ -676,63 +1244,81 @@ int
 fat_alloc_clusters(fat_bs_t *bs, service_id_t service_id, unsigned nclsts,
     fat_cluster_t *mcl, fat_cluster_t *lcl)
 {
-	fat_cluster_t *lifo;    /* stack for storing free cluster numbers */
-	unsigned found = 0;     /* top of the free cluster number stack */
-	fat_cluster_t clst;
-	fat_cluster_t value = 0;
+	fat_free_map_t *map;
+	fat_cluster_t *chain;	/* allocated clusters in chain order */
+	unsigned found = 0;
+	unsigned c;
+	fat_cluster_t start;
 	fat_cluster_t clst_last1 = FAT_CLST_LAST1(bs);
 	int rc = EOK;
 
-	lifo = (fat_cluster_t *) malloc(nclsts * sizeof(fat_cluster_t));
-	if (!lifo)
+	assert(nclsts > 0);
+
+	chain = (fat_cluster_t *) malloc(nclsts * sizeof(fat_cluster_t));
+	if (!chain)
 		return ENOMEM;
-	
+
+	fibril_mutex_lock(&fat_alloc_lock);
+	map = free_map_find(service_id);
+	assert(map != NULL);
+
+	if (map->free < nclsts) {
+		fibril_mutex_unlock(&fat_alloc_lock);
+		free(chain);
+		return ENOSPC;
+	}
+
+	if (free_map_find_run(map, map->hint, map->clusters, nclsts, &start) ||
+	    free_map_find_run(map, FAT_CLST_FIRST,
+	    min(map->hint + nclsts - 1, map->clusters), nclsts, &start)) {
+		for (found = 0; found < nclsts; found++)
+			chain[found] = start + found;
+	} else {
+		found = free_map_gather(map, map->hint, map->clusters, chain,
+		    0, nclsts);
+		found = free_map_gather(map, FAT_CLST_FIRST, map->hint, chain,
+		    found, nclsts);
+	}
+	assert(found == nclsts);
+
 	/*
-	 * Search FAT1 for unused clusters.
+	 * Link the clusters together in FAT1.
 	 */
-	fibril_mutex_lock(&fat_alloc_lock);
-	for (clst = FAT_CLST_FIRST; clst < CC(bs) + 2 && found < nclsts;
-	    clst++) {
-		rc = fat_get_cluster(bs, service_id, FAT1, clst, &value);
+	for (c = 0; c < nclsts; c++) {
+		rc = fat_set_cluster(bs, service_id, FAT1, chain[c],
+		    c == nclsts - 1 ? clst_last1 : chain[c + 1]);
 		if (rc != EOK)
 			break;
-
-		if (value == FAT_CLST_RES0) {
-			/*
-			 * The cluster is free. Put it into our stack
-			 * of found clusters and mark it as non-free.
-			 */
-			lifo[found] = clst;
-			rc = fat_set_cluster(bs, service_id, FAT1, clst,
-			    (found == 0) ?  clst_last1 : lifo[found - 1]);
-			if (rc != EOK)
-				break;
-
-			found++;
-		}
 	}
 
-	if (rc == EOK && found == nclsts) {
-		rc = fat_alloc_shadow_clusters(bs, service_id, lifo, nclsts);
+	if (rc == EOK) {
+		rc = fat_alloc_shadow_clusters(bs, service_id, chain, nclsts);
 		if (rc == EOK) {
-			*mcl = lifo[found - 1];
-			*lcl = lifo[0];
-			free(lifo);
+			for (c = 0; c < nclsts; c++)
+				free_map_set(map, chain[c]);
+			map->hint = chain[nclsts - 1] + 1;
+			if (map->hint >= map->clusters)
+				map->hint = FAT_CLST_FIRST;
+
+			*mcl = chain[0];
+			*lcl = chain[nclsts - 1];
+			free(chain);
 			fibril_mutex_unlock(&fat_alloc_lock);
 			return EOK;
 		}
+		c = nclsts;
 	}
 
 	/* If something wrong - free the clusters */
-	while (found--) {
-		(void) fat_set_cluster(bs, service_id, FAT1, lifo[found],
+	while (c--) {
+		(void) fat_set_cluster(bs, service_id, FAT1, chain[c],
 		    FAT_CLST_RES0);
 	}
 
-	free(lifo);
+	free(chain);
 	fibril_mutex_unlock(&fat_alloc_lock);
 
-	return ENOSPC;
+	return rc;
 }
 
 /** Free clusters forming a cluster chain in all copies of FAT.
@@ -746,10 +1332,15 @@ fat_alloc_clusters(fat_bs_t *bs, service_id_t service_id, unsigned nclsts,
 int
 fat_free_clusters(fat_bs_t *bs, service_id_t service_id, fat_cluster_t firstc)
 {
+	fat_free_map_t *map;
 	unsigned fatno;
 	fat_cluster_t nextc = 0;
 	fat_cluster_t clst_bad = FAT_CLST_BAD(bs);
-	int rc;
+	int rc = EOK;
+
+	/* The lock keeps the free cluster map in sync with FAT1. */
+	fibril_mutex_lock(&fat_alloc_lock);
+	map = free_map_find(service_id);
 
 	/* Mark all clusters in the chain as free in all copies of FAT. */
 	while (firstc < FAT_CLST_LAST1(bs)) {
@@ -757,19 +1348,25 @@ fat_free_clusters(fat_bs_t *bs, service_id_t service_id, fat_cluster_t firstc)
 
 		rc = fat_get_cluster(bs, service_id, FAT1, firstc, &nextc);
 		if (rc != EOK)
-			return rc;
+			break;
 
 		for (fatno = FAT1; fatno < FATCNT(bs); fatno++) {
 			rc = fat_set_cluster(bs, service_id, fatno, firstc,
 			    FAT_CLST_RES0);
 			if (rc != EOK)
-				return rc;
+				break;
 		}
+		if (rc != EOK)
+			break;
+
+		if (map && firstc < map->clusters)
+			free_map_clear(map, firstc);
 
 		firstc = nextc;
 	}
 
-	return EOK;
+	fibril_mutex_unlock(&fat_alloc_lock);
+	return rc;
 }
 
 /** Append a cluster chain to the last file cluster in all FATs.
@@ -838,8 +1435,7 @@ int fat_chop_clusters(fat_bs_t *bs, fat_node_t *nodep, fat_cluster_t lcl)
 	 * Invalidate cached cluster numbers.
 	 */
 	nodep->lastc_cached_valid = false;
-	if (nodep->currc_cached_value != lcl)
-		nodep->currc_cached_valid = false;
+	fat_extents_reset(nodep);
 
 	if (lcl == FAT_CLST_RES0) {
 		/* The node will have zero size and no clusters allocated. */
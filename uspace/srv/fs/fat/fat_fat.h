@@ -114,11 +114,19 @@ extern int fat_block_get(block_t **, struct fat_bs *, struct fat_node *,
     aoff64_t, int);
 extern int _fat_block_get(block_t **, struct fat_bs *, service_id_t,
     fat_cluster_t, fat_cluster_t *, aoff64_t, int);
+extern int fat_block_map(struct fat_bs *, struct fat_node *, aoff64_t,
+    size_t, aoff64_t *, size_t *);
+extern int _fat_block_map(struct fat_bs *, service_id_t, fat_cluster_t,
+    fat_cluster_t *, aoff64_t, size_t, aoff64_t *, size_t *);
 
 extern int fat_append_clusters(struct fat_bs *, struct fat_node *,
     fat_cluster_t, fat_cluster_t);
 extern int fat_chop_clusters(struct fat_bs *, struct fat_node *,
     fat_cluster_t);
+extern int fat_alloc_init_by_service_id(struct fat_bs *, service_id_t,
+    fat_cluster_t);
+extern void fat_alloc_fini_by_service_id(service_id_t);
+extern int fat_alloc_info(service_id_t, uint32_t *, fat_cluster_t *);
 extern int fat_alloc_clusters(struct fat_bs *, service_id_t, unsigned,
     fat_cluster_t *, fat_cluster_t *);
 extern int fat_free_clusters(struct fat_bs *, service_id_t, fat_cluster_t);
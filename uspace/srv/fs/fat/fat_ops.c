@@ -108,9 +108,11 @@ static void fat_node_initialize(fat_node_t *node)
 	node->dirty = false;
 	node->lastc_cached_valid = false;
 	node->lastc_cached_value = 0;
-	node->currc_cached_valid = false;
-	node->currc_cached_bn = 0;
-	node->currc_cached_value = 0;
+	fibril_mutex_initialize(&node->ext_lock);
+	node->extents = NULL;
+	node->ext_count = 0;
+	node->ext_alloc = 0;
+	node->ext_mapped = 0;
 }
 
 static int fat_node_sync(fat_node_t *node)
@@ -192,6 +194,7 @@ restart:
 				return rc;
 		}
 		nodep->idx->nodep = NULL;
+		free(nodep->extents);
 		free(nodep->bp);
 		free(nodep);
 
@@ -230,6 +233,7 @@ static int fat_node_get_new(fat_node_t **nodepp)
 				idxp_tmp->nodep = NULL;
 				fibril_mutex_unlock(&nodep->lock);
 				fibril_mutex_unlock(&idxp_tmp->lock);
+				free(nodep->extents);
 				free(nodep->bp);
 				free(nodep);
 				return rc;
@@ -238,6 +242,7 @@ static int fat_node_get_new(fat_node_t **nodepp)
 		idxp_tmp->nodep = NULL;
 		fibril_mutex_unlock(&nodep->lock);
 		fibril_mutex_unlock(&idxp_tmp->lock);
+		free(nodep->extents);
 		fn = FS_NODE(nodep);
 	} else {
 skip_cache:
@@ -476,6 +481,7 @@ int fat_node_put(fs_node_t *fn)
 	}
 	fibril_mutex_unlock(&nodep->lock);
 	if (destroy) {
+		free(nodep->extents);
 		free(nodep->bp);
 		free(nodep);
 	}
@@ -569,6 +575,7 @@ int fat_destroy_node(fs_node_t *fn)
 	}
 
 	fat_idx_destroy(nodep->idx);
+	free(nodep->extents);
 	free(nodep->bp);
 	free(nodep);
 	return rc;
@@ -864,25 +871,14 @@ int fat_total_block_count(service_id_t service_id, uint64_t *count)
 
 int fat_free_block_count(service_id_t service_id, uint64_t *count)
 {
-	fat_bs_t *bs;
-	fat_cluster_t e0;
-	uint64_t block_count;
+	uint32_t nfree;
 	int rc;
-	uint32_t cluster_no, clusters;
 
-	block_count = 0;
-	bs = block_bb_get(service_id);
-	clusters = (SPC(bs)) ? TS(bs) / SPC(bs) : 0;
-	for (cluster_no = 0; cluster_no < clusters; cluster_no++) {
-		rc = fat_get_cluster(bs, service_id, FAT1, cluster_no, &e0);
-		if (rc != EOK)
-			return EIO;
+	rc = fat_alloc_info(service_id, &nfree, NULL);
+	if (rc != EOK)
+		return rc;
 
-		if (e0 == FAT_CLST_RES0)
-			block_count++;
-	}
-	*count = block_count;
-	
+	*count = nfree;
 	return EOK;
 }
 
@@ -1025,6 +1021,7 @@ static int fat_fs_open(service_id_t service_id, enum cache_mode cmode,
 
 static void fat_fs_close(service_id_t service_id, fs_node_t *rfn)
 {
+	free(FAT_NODE(rfn)->extents);
 	free(rfn->data);
 	free(rfn);
 	(void) block_cache_fini(service_id);
@@ -1075,12 +1072,105 @@ static int fat_fsprobe(service_id_t service_id, vfs_fs_probe_info_t *info)
 	return EOK;
 }
 
+/** Get the FAT32 FS info sector.
+ *
+ * @param service_id	Service ID of the file system.
+ * @param bp		Output argument holding the block with the sector.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+static int fat_fat32_fsinfo_get(service_id_t service_id, block_t **bp)
+{
+	fat_bs_t *bs;
+	fat32_fsinfo_t *info;
+	int rc;
+
+	bs = block_bb_get(service_id);
+	assert(FAT_IS_FAT32(bs));
+
+	rc = block_get(bp, service_id, uint16_t_le2host(bs->fat32.fsinfo_sec),
+	    BLOCK_FLAGS_NONE);
+	if (rc != EOK)
+		return rc;
+
+	info = (fat32_fsinfo_t *) (*bp)->data;
+
+	if (memcmp(info->sig1, FAT32_FSINFO_SIG1, sizeof(info->sig1)) != 0 ||
+	    memcmp(info->sig2, FAT32_FSINFO_SIG2, sizeof(info->sig2)) != 0 ||
+	    memcmp(info->sig3, FAT32_FSINFO_SIG3, sizeof(info->sig3)) != 0) {
+		(void) block_put(*bp);
+		return EINVAL;
+	}
+
+	return EOK;
+}
+
+/** Read the next free cluster hint from the FAT32 FS info sector.
+ *
+ * @param service_id	Service ID of the file system.
+ *
+ * @return		The hint or FAT_CLST_RES0 if it is not available.
+ */
+static fat_cluster_t fat_read_fat32_fsinfo_hint(service_id_t service_id)
+{
+	fat32_fsinfo_t *info;
+	fat_cluster_t hint;
+	block_t *b;
+
+	if (fat_fat32_fsinfo_get(service_id, &b) != EOK)
+		return FAT_CLST_RES0;
+
+	info = (fat32_fsinfo_t *) b->data;
+	hint = uint32_t_le2host(info->last_allocated_cluster);
+
+	(void) block_put(b);
+
+	/* 0xffffffff means the hint is unknown */
+	return (hint == (fat_cluster_t) -1) ? FAT_CLST_RES0 : hint;
+}
+
+/** Store the free cluster count and next free cluster hint in FS info.
+ *
+ * @param service_id	Service ID of the file system.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+static int fat_update_fat32_fsinfo(service_id_t service_id)
+{
+	fat32_fsinfo_t *info;
+	uint32_t nfree;
+	fat_cluster_t hint;
+	block_t *b;
+	int rc;
+
+	rc = fat_alloc_info(service_id, &nfree, &hint);
+	if (rc != EOK)
+		return rc;
+
+	rc = fat_fat32_fsinfo_get(service_id, &b);
+	if (rc != EOK)
+		return rc;
+
+	info = (fat32_fsinfo_t *) b->data;
+
+	if (uint32_t_le2host(info->free_clusters) == nfree &&
+	    uint32_t_le2host(info->last_allocated_cluster) == hint)
+		return block_put(b);
+
+	info->free_clusters = host2uint32_t_le(nfree);
+	info->last_allocated_cluster = host2uint32_t_le(hint);
+
+	b->dirty = true;
+	return block_put(b);
+}
+
 static int
 fat_mounted(service_id_t service_id, const char *opts, fs_index_t *index,
     aoff64_t *size)
 {
 	enum cache_mode cmode = CACHE_MODE_WB;
 	fat_instance_t *instance;
+	fat_bs_t *bs;
 	fat_idx_t *ridxp;
 	fs_node_t *rfn;
 	int rc;
@@ -1095,7 +1185,9 @@ fat_mounted(service_id_t service_id, const char *opts, fs_index_t *index,
 	char *opt;
 	while ((opt = str_tok(mntopts, " ,", &mntopts)) != NULL) {
 		if (str_cmp(opt, "wtcache") == 0)
-			cmode = CACHE_MODE_WT;
+			cmode &= ~CACHE_MODE_WB;
+		else if (str_cmp(opt, "2qcache") == 0)
+			cmode |= CACHE_MODE_2Q;
 		else if (str_cmp(opt, "nolfn") == 0)
 			instance->lfn_enabled = false;
 	}
@@ -1106,11 +1198,22 @@ fat_mounted(service_id_t service_id, const char *opts, fs_index_t *index,
 		return rc;
 	}
 
+	/* Build the map of free clusters. */
+	bs = block_bb_get(service_id);
+	rc = fat_alloc_init_by_service_id(bs, service_id, FAT_IS_FAT32(bs) ?
+	    fat_read_fat32_fsinfo_hint(service_id) : FAT_CLST_RES0);
+	if (rc != EOK) {
+		fat_fs_close(service_id, rfn);
+		free(instance);
+		return rc;
+	}
+
 	fibril_mutex_lock(&ridxp->lock);
 
 	rc = fs_instance_create(service_id, instance);
 	if (rc != EOK) {
 		fibril_mutex_unlock(&ridxp->lock);
+		fat_alloc_fini_by_service_id(service_id);
 		fat_fs_close(service_id, rfn);
 		free(instance);
 		return rc;
@@ -1124,37 +1227,6 @@ fat_mounted(service_id_t service_id, const char *opts, fs_index_t *index,
 	return EOK;
 }
 
-static int fat_update_fat32_fsinfo(service_id_t service_id)
-{
-	fat_bs_t *bs;
-	fat32_fsinfo_t *info;
-	block_t *b;
-	int rc;
-
-	bs = block_bb_get(service_id);
-	assert(FAT_IS_FAT32(bs));
-
-	rc = block_get(&b, service_id, uint16_t_le2host(bs->fat32.fsinfo_sec),
-	    BLOCK_FLAGS_NONE);
-	if (rc != EOK)
-		return rc;
-
-	info = (fat32_fsinfo_t *) b->data;
-
-	if (memcmp(info->sig1, FAT32_FSINFO_SIG1, sizeof(info->sig1)) != 0 ||
-	    memcmp(info->sig2, FAT32_FSINFO_SIG2, sizeof(info->sig2)) != 0 ||
-	    memcmp(info->sig3, FAT32_FSINFO_SIG3, sizeof(info->sig3)) != 0) {
-		(void) block_put(b);
-		return EINVAL;
-	}
-
-	/* For now, invalidate the counter. */
-	info->free_clusters = host2uint16_t_le(-1);
-
-	b->dirty = true;
-	return block_put(b);
-}
-
 static int fat_unmounted(service_id_t service_id)
 {
 	fs_node_t *fn;
@@ -1196,6 +1268,7 @@ static int fat_unmounted(service_id_t service_id)
 	 * stop using libblock for this instance.
 	 */
 	(void) fat_node_fini_by_service_id(service_id);
+	fat_alloc_fini_by_service_id(service_id);
 	fat_fs_close(service_id, fn);
 
 	void *data;
@@ -1207,6 +1280,250 @@ static int fat_unmounted(service_id_t service_id)
 	return EOK;
 }
 
+/** Read file data spanning several blocks.
+ *
+ * Blocks which are adjacent on the device are read with a single request.
+ * On failure the data read request is answered.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		FAT node.
+ * @param callid	Data read request.
+ * @param pos		Position in the file.
+ * @param size		Number of bytes to read, not beyond the end of file.
+ * @param rbytes	Output number of bytes read.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+static int
+fat_read_blocks(fat_bs_t *bs, fat_node_t *nodep, ipc_callid_t callid,
+    aoff64_t pos, size_t size, size_t *rbytes)
+{
+	size_t bytes = min(size, BLOCK_XFER_MAX);
+	size_t count = (pos % BPS(bs) + bytes + BPS(bs) - 1) / BPS(bs);
+	aoff64_t pbn;
+	size_t i, run;
+	uint8_t *buf;
+	int rc;
+
+	buf = malloc(count * BPS(bs));
+	if (!buf) {
+		async_answer_0(callid, ENOMEM);
+		return ENOMEM;
+	}
+
+	for (i = 0; i < count; i += run) {
+		rc = fat_block_map(bs, nodep, pos / BPS(bs) + i, count - i,
+		    &pbn, &run);
+		if (rc != EOK)
+			goto error;
+
+		rc = block_read_range(nodep->idx->service_id, pbn, run,
+		    buf + i * BPS(bs));
+		if (rc != EOK)
+			goto error;
+	}
+
+	rc = async_data_read_finalize(callid, buf + pos % BPS(bs), bytes);
+	free(buf);
+	if (rc != EOK)
+		return rc;
+
+	*rbytes = bytes;
+	return EOK;
+
+error:
+	free(buf);
+	async_answer_0(callid, rc);
+	return rc;
+}
+
+/** Write file data spanning several blocks.
+ *
+ * Clusters needed beyond the end of the node's cluster chain are allocated
+ * up front. Runs of full blocks which are adjacent on the device are written
+ * with a single request. If the write fails after some of the data has been
+ * written, a short write is reported and the new clusters holding the data
+ * are kept.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		FAT node.
+ * @param callid	Data write request.
+ * @param pos		Position in the file.
+ * @param len		Number of bytes offered by the client.
+ * @param wbytes	Output number of bytes written.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+static int
+fat_write_blocks(fat_bs_t *bs, fat_node_t *nodep, ipc_callid_t callid,
+    aoff64_t pos, size_t len, size_t *wbytes)
+{
+	service_id_t service_id = nodep->idx->service_id;
+	size_t bytes = min(len, BLOCK_XFER_MAX);
+	fat_cluster_t mcl = FAT_CLST_RES0;
+	fat_cluster_t lcl;
+	aoff64_t boundary;
+	size_t off = 0;
+	uint8_t *buf;
+	int rc;
+
+	buf = malloc(bytes);
+	if (!buf) {
+		async_answer_0(callid, ENOMEM);
+		return ENOMEM;
+	}
+
+	boundary = ROUND_UP(nodep->size, BPC(bs));
+	if (pos + bytes > boundary) {
+		unsigned nclsts;
+
+		/* create an independent chain for the data beyond boundary */
+		nclsts = (ROUND_UP(pos + bytes, BPC(bs)) - boundary) / BPC(bs);
+		rc = fat_alloc_clusters(bs, service_id, nclsts, &mcl, &lcl);
+		if (rc != EOK) {
+			free(buf);
+			async_answer_0(callid, rc);
+			return rc;
+		}
+	}
+
+	/* zero fill any gaps */
+	rc = fat_fill_gap(bs, nodep, mcl, pos);
+	if (rc != EOK) {
+		if (mcl != FAT_CLST_RES0)
+			(void) fat_free_clusters(bs, service_id, mcl);
+		free(buf);
+		async_answer_0(callid, rc);
+		return rc;
+	}
+
+	rc = async_data_write_finalize(callid, buf, bytes);
+	if (rc != EOK)
+		goto error;
+
+	while (off < bytes) {
+		aoff64_t o = pos + off;
+		aoff64_t bn = o / BPS(bs);
+		block_t *b;
+
+		if (o % BPS(bs) == 0 && bytes - off >= BPS(bs)) {
+			/* a run of full blocks */
+			size_t maxcnt = (bytes - off) / BPS(bs);
+			aoff64_t pbn;
+			size_t cnt;
+
+			if (o < boundary) {
+				maxcnt = min(maxcnt, (boundary - o) / BPS(bs));
+				rc = fat_block_map(bs, nodep, bn, maxcnt,
+				    &pbn, &cnt);
+			} else {
+				rc = _fat_block_map(bs, service_id, mcl, NULL,
+				    bn - boundary / BPS(bs), maxcnt, &pbn,
+				    &cnt);
+			}
+			if (rc != EOK)
+				goto error;
+
+			rc = block_write_range(service_id, pbn, cnt,
+			    buf + off);
+			if (rc != EOK)
+				goto error;
+
+			off += cnt * BPS(bs);
+			continue;
+		}
+
+		/* a partial block */
+		size_t chunk = min(BPS(bs) - o % BPS(bs), bytes - off);
+		bool fresh = o >= boundary && o % BPS(bs) == 0;
+
+		if (o < boundary) {
+			rc = fat_block_get(&b, bs, nodep, bn,
+			    BLOCK_FLAGS_NONE);
+		} else {
+			/*
+			 * Blocks of the new chain which fat_fill_gap() did not
+			 * touch hold no data yet.
+			 */
+			rc = _fat_block_get(&b, bs, service_id, mcl, NULL,
+			    bn - boundary / BPS(bs),
+			    fresh ? BLOCK_FLAGS_NOREAD : BLOCK_FLAGS_NONE);
+		}
+		if (rc != EOK)
+			goto error;
+
+		if (fresh)
+			memset(b->data + chunk, 0, BPS(bs) - chunk);
+		memcpy(b->data + o % BPS(bs), buf + off, chunk);
+		b->dirty = true;		/* need to sync block */
+		rc = block_put(b);
+		if (rc != EOK)
+			goto error;
+
+		off += chunk;
+	}
+
+	free(buf);
+
+	if (mcl != FAT_CLST_RES0) {
+		/*
+		 * Append the cluster chain starting in mcl to the end of the
+		 * node's cluster chain.
+		 */
+		rc = fat_append_clusters(bs, nodep, mcl, lcl);
+		if (rc != EOK) {
+			(void) fat_free_clusters(bs, service_id, mcl);
+			return rc;
+		}
+	}
+
+	if (pos + bytes > nodep->size) {
+		nodep->size = pos + bytes;
+		nodep->dirty = true;		/* need to sync node */
+	}
+	*wbytes = bytes;
+	return EOK;
+
+error:
+	free(buf);
+
+	/*
+	 * Keep the clusters of the new chain which received data and free the
+	 * rest of it.
+	 */
+	bool kept = false;
+	if (mcl != FAT_CLST_RES0 && off > 0 && pos + off > boundary) {
+		unsigned keep;
+		fat_cluster_t kcl;
+
+		keep = (ROUND_UP(pos + off, BPC(bs)) - boundary) / BPC(bs);
+		if (fat_cluster_walk(bs, service_id, mcl, &kcl, NULL,
+		    keep - 1) == EOK &&
+		    fat_append_clusters(bs, nodep, mcl, lcl) == EOK) {
+			(void) fat_chop_clusters(bs, nodep, kcl);
+			kept = true;
+		}
+	}
+	if (mcl != FAT_CLST_RES0 && !kept)
+		(void) fat_free_clusters(bs, service_id, mcl);
+
+	/* Report a short write if some data made it to allocated clusters */
+	if (!kept) {
+		if (pos >= boundary)
+			return rc;
+		off = min(off, boundary - pos);
+	}
+	if (off == 0)
+		return rc;
+
+	if (pos + off > nodep->size) {
+		nodep->size = pos + off;
+		nodep->dirty = true;		/* need to sync node */
+	}
+	*wbytes = off;
+	return EOK;
+}
+
 static int
 fat_read(service_id_t service_id, fs_index_t index, aoff64_t pos,
     size_t *rbytes)
@@ -1237,14 +1554,23 @@ fat_read(service_id_t service_id, fs_index_t index, aoff64_t pos,
 
 	if (nodep->type == FAT_FILE) {
 		/*
-		 * Our strategy for regular file reads is to read one block at
-		 * most and make use of the possibility to return less data than
-		 * requested. This keeps the code very simple.
+		 * Requests spanning several blocks are served with as few
+		 * device transfers as possible. Otherwise we read one block
+		 * through the block cache.
 		 */
 		if (pos >= nodep->size) {
 			/* reading beyond the EOF */
 			bytes = 0;
 			(void) async_data_read_finalize(callid, NULL, 0);
+		} else if (pos % BPS(bs) + min(len, nodep->size - pos) >
+		    BPS(bs)) {
+			/* gather several blocks into one transfer */
+			rc = fat_read_blocks(bs, nodep, callid, pos,
+			    min(len, nodep->size - pos), &bytes);
+			if (rc != EOK) {
+				fat_node_put(fn);
+				return rc;
+			}
 		} else {
 			bytes = min(len, BPS(bs) - pos % BPS(bs));
 			bytes = min(bytes, nodep->size - pos);
@@ -1347,12 +1673,22 @@ fat_write(service_id_t service_id, fs_index_t index, aoff64_t pos,
 
 	bs = block_bb_get(service_id);
 
+	if (len > BPS(bs) - pos % BPS(bs)) {
+		/* receive several blocks in one transfer */
+		rc = fat_write_blocks(bs, nodep, callid, pos, len, wbytes);
+		if (rc != EOK) {
+			(void) fat_node_put(fn);
+			return rc;
+		}
+		*nsize = nodep->size;
+		return fat_node_put(fn);
+	}
+
 	/*
-	 * In all scenarios, we will attempt to write out only one block worth
-	 * of data at maximum. There might be some more efficient approaches,
-	 * but this one greatly simplifies fat_write(). Note that we can afford
-	 * to do this because the client must be ready to handle the return
-	 * value signalizing a smaller number of bytes written.
+	 * Here we will attempt to write out only one block worth of data at
+	 * maximum. Note that we can afford to do this because the client must
+	 * be ready to handle the return value signalizing a smaller number of
+	 * bytes written.
 	 */
 	bytes = min(len, BPS(bs) - pos % BPS(bs));
 	if (bytes == BPS(bs))
@@ -1555,6 +1891,10 @@ static int fat_sync(service_id_t service_id, fs_index_t index)
 	nodep->dirty = true;
 	rc = fat_node_sync(nodep);
 
+	fat_bs_t *bs = block_bb_get(service_id);
+	if (rc == EOK && FAT_IS_FAT32(bs))
+		(void) fat_update_fat32_fsinfo(service_id);
+
 	fat_node_put(fn);
 	return rc;
 }
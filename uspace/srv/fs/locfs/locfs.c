@@ -54,6 +54,7 @@ static vfs_info_t locfs_vfs_info = {
 	.name = NAME,
 	.concurrent_read_write = false,
 	.write_retains_size = false,
+	.cache_lookups = false,
 	.instance = 0,
 };
 
@@ -66,6 +66,10 @@ static bool is_power_of_two(uint32_t n);
 static int mfs_size_block(service_id_t service_id, uint32_t *size);
 static int mfs_total_block_count(service_id_t service_id, uint64_t *count);
 static int mfs_free_block_count(service_id_t service_id, uint64_t *count);
+static int mfs_read_blocks(struct mfs_node *mnode, ipc_callid_t callid,
+    aoff64_t pos, size_t size, size_t *rbytes);
+static int mfs_write_blocks(struct mfs_node *mnode, ipc_callid_t callid,
+    aoff64_t pos, size_t len, size_t *wbytes);
 
 static hash_table_t open_nodes;
 static FIBRIL_MUTEX_INITIALIZE(open_nodes_lock);
@@ -882,6 +886,18 @@ found:
 			goto out_success;
 		}
 
+		if (pos % sbi->block_size + min(len, ino_i->i_size - pos) >
+		    (size_t) sbi->block_size) {
+			/* Gather several blocks into one transfer */
+			rc = mfs_read_blocks(mnode, callid, pos,
+			    min(len, ino_i->i_size - pos), &bytes);
+			if (rc != EOK) {
+				mfs_node_put(fn);
+				return rc;
+			}
+			goto out_success;
+		}
+
 		bytes = min(len, sbi->block_size - pos % sbi->block_size);
 		bytes = min(bytes, ino_i->i_size - pos);
 
@@ -959,6 +975,19 @@ mfs_write(service_id_t service_id, fs_index_t index, aoff64_t pos,
 	size_t bytes = min(len, bs - (pos % bs));
 	uint32_t block;
 
+	if (len > bytes) {
+		/* Receive several blocks in one transfer */
+		r = mfs_write_blocks(mnode, callid, pos, len, wbytes);
+		if (r != EOK) {
+			mfs_node_put(fn);
+			return r;
+		}
+
+		r = mfs_node_put(fn);
+		*nsize = ino_i->i_size;
+		return r;
+	}
+
 	if (bytes == bs)
 		flags = BLOCK_FLAGS_NOREAD;
 
@@ -1014,6 +1043,208 @@ out_err:
 	return r;
 }
 
+/** Read file data spanning several blocks.
+ *
+ * Zones which are adjacent on the device are read with a single request.
+ * On failure the data read request is answered.
+ *
+ * @param mnode		Node to read from.
+ * @param callid	Data read request.
+ * @param pos		Position in the file.
+ * @param size		Number of bytes to read, not beyond the end of file.
+ * @param rbytes	Output number of bytes read.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+static int
+mfs_read_blocks(struct mfs_node *mnode, ipc_callid_t callid, aoff64_t pos,
+    size_t size, size_t *rbytes)
+{
+	struct mfs_sb_info *sbi = mnode->instance->sbi;
+	service_id_t service_id = mnode->instance->service_id;
+	const size_t bs = sbi->block_size;
+	size_t bytes = min(size, BLOCK_XFER_MAX);
+	size_t count = (pos % bs + bytes + bs - 1) / bs;
+	aoff64_t bpos = ALIGN_DOWN(pos, bs);
+	uint32_t zone, next;
+	size_t i, run;
+	uint8_t *buf;
+	int rc;
+
+	buf = malloc(count * bs);
+	if (!buf) {
+		async_answer_0(callid, ENOMEM);
+		return ENOMEM;
+	}
+
+	for (i = 0; i < count; i += run) {
+		rc = mfs_read_map(&zone, mnode, bpos + i * bs);
+		if (rc != EOK)
+			goto error;
+
+		if (zone == 0) {
+			/* sparse file */
+			memset(buf + i * bs, 0, bs);
+			run = 1;
+			continue;
+		}
+
+		for (run = 1; i + run < count; run++) {
+			rc = mfs_read_map(&next, mnode, bpos + (i + run) * bs);
+			if (rc != EOK || next != zone + run)
+				break;
+		}
+
+		rc = block_read_range(service_id, zone, run, buf + i * bs);
+		if (rc != EOK)
+			goto error;
+	}
+
+	rc = async_data_read_finalize(callid, buf + pos % bs, bytes);
+	free(buf);
+	if (rc != EOK)
+		return rc;
+
+	*rbytes = bytes;
+	return EOK;
+
+error:
+	free(buf);
+	async_answer_0(callid, rc);
+	return rc;
+}
+
+/** Write file data spanning several blocks.
+ *
+ * Missing zones are allocated. Runs of full blocks which are adjacent on
+ * the device are written with a single request. If only a part of the data
+ * could be written, a short write is reported.
+ *
+ * @param mnode		Node to write to.
+ * @param callid	Data write request.
+ * @param pos		Position in the file.
+ * @param len		Number of bytes offered by the client.
+ * @param wbytes	Output number of bytes written.
+ *
+ * @return		EOK on success or a negative error code.
+ */
+static int
+mfs_write_blocks(struct mfs_node *mnode, ipc_callid_t callid, aoff64_t pos,
+    size_t len, size_t *wbytes)
+{
+	struct mfs_sb_info *sbi = mnode->instance->sbi;
+	struct mfs_ino_info *ino_i = mnode->ino_i;
+	service_id_t service_id = mnode->instance->service_id;
+	const size_t bs = sbi->block_size;
+	size_t bytes = min(len, BLOCK_XFER_MAX);
+	size_t done = 0;
+	size_t run = 0;
+	uint32_t run_start = 0;
+	uint8_t *buf;
+	int r;
+
+	buf = malloc(bytes);
+	if (!buf) {
+		async_answer_0(callid, ENOMEM);
+		return ENOMEM;
+	}
+
+	r = async_data_write_finalize(callid, buf, bytes);
+	if (r != EOK) {
+		free(buf);
+		return r;
+	}
+
+	while (done + run * bs < bytes) {
+		size_t off = done + run * bs;
+		size_t chunk = min(bs - (pos + off) % bs, bytes - off);
+		bool fresh = false;
+		uint32_t block;
+
+		r = mfs_read_map(&block, mnode, pos + off);
+		if (r != EOK)
+			break;
+
+		if (block == 0) {
+			uint32_t dummy;
+
+			r = mfs_alloc_zone(mnode->instance, &block);
+			if (r != EOK)
+				break;
+
+			r = mfs_write_map(mnode, pos + off, block, &dummy);
+			if (r != EOK) {
+				mfs_free_zone(mnode->instance, block);
+				break;
+			}
+
+			fresh = true;
+		}
+
+		if (chunk == bs && run > 0 && block == run_start + run) {
+			run++;
+			continue;
+		}
+
+		if (run > 0) {
+			r = block_write_range(service_id, run_start, run,
+			    buf + done);
+			if (r != EOK)
+				break;
+			done += run * bs;
+			run = 0;
+		}
+
+		if (chunk == bs) {
+			run_start = block;
+			run = 1;
+			continue;
+		}
+
+		/* Partial block */
+		block_t *b;
+		r = block_get(&b, service_id, block,
+		    fresh ? BLOCK_FLAGS_NOREAD : BLOCK_FLAGS_NONE);
+		if (r != EOK)
+			break;
+
+		if (fresh)
+			memset(b->data, 0, bs);
+
+		memcpy(b->data + (pos + off) % bs, buf + off, chunk);
+		b->dirty = true;
+
+		r = block_put(b);
+		if (r != EOK)
+			break;
+
+		done += chunk;
+	}
+
+	if (run > 0) {
+		int r2 = block_write_range(service_id, run_start, run,
+		    buf + done);
+		if (r2 == EOK)
+			done += run * bs;
+		else if (r == EOK)
+			r = r2;
+	}
+
+	free(buf);
+
+	/* Report a short write if some data made it to the device */
+	if (done == 0)
+		return r;
+
+	if (pos + done > ino_i->i_size) {
+		ino_i->i_size = pos + done;
+		ino_i->dirty = true;
+	}
+
+	*wbytes = done;
+	return EOK;
+}
+
 static int
 mfs_destroy(service_id_t service_id, fs_index_t index)
 {
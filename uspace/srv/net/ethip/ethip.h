@@ -42,6 +42,8 @@
 #include <inet/iplink_srv.h>
 #include <inet/addr.h>
 #include <loc.h>
+#include <pkt_ring.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -56,6 +58,11 @@ typedef struct ethip_nic {
 	char *svc_name;
 	async_sess_t *sess;
 
+	/** Ring through which the NIC delivers received frames */
+	pkt_ring_t rx_ring;
+	/** The NIC accepted rx_ring */
+	bool rx_ring_active;
+
 	iplink_srv_t iplink;
 	service_id_t iplink_sid;
 
@@ -49,6 +49,12 @@
 #include "ethip_nic.h"
 #include "pdu.h"
 
+/** Number of slots of the receive ring shared with the NIC */
+#define ETHIP_RX_RING_SLOTS  256
+
+/** Maximum size of a frame in the receive ring */
+#define ETHIP_RX_RING_FRAME_SIZE  2048
+
 static int ethip_nic_open(service_id_t sid);
 static void ethip_nic_cb_conn(ipc_callid_t iid, ipc_call_t *icall, void *arg);
 
@@ -134,6 +140,9 @@ static ethip_link_addr_t *ethip_nic_addr_new(inet_addr_t *addr)
 
 static void ethip_nic_delete(ethip_nic_t *nic)
 {
+	if (nic->rx_ring_active)
+		pkt_ring_destroy(&nic->rx_ring);
+	
 	if (nic->svc_name != NULL)
 		free(nic->svc_name);
 	
@@ -176,6 +185,23 @@ static int ethip_nic_open(service_id_t sid)
 		goto error;
 	}
 
+	/*
+	 * Have received frames delivered in batches through shared memory.
+	 * Drivers which do not support it keep using NIC_EV_RECEIVED.
+	 */
+	rc = pkt_ring_create(&nic->rx_ring, ETHIP_RX_RING_SLOTS,
+	    ETHIP_RX_RING_FRAME_SIZE);
+	if (rc == EOK) {
+		rc = nic_rx_ring_set(nic->sess, &nic->rx_ring);
+		if (rc == EOK) {
+			nic->rx_ring_active = true;
+		} else {
+			log_msg(LOG_DEFAULT, LVL_DEBUG, "NIC '%s' does not "
+			    "support receive rings.", nic->svc_name);
+			pkt_ring_destroy(&nic->rx_ring);
+		}
+	}
+
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "Opened NIC '%s'", nic->svc_name);
 	list_append(&nic->link, &ethip_nic_list);
 	in_list = true;
@@ -283,6 +309,29 @@ static void ethip_nic_received(ethip_nic_t *nic, ipc_callid_t callid,
 	async_answer_0(callid, rc);
 }
 
+static void ethip_nic_received_ring(ethip_nic_t *nic, ipc_callid_t callid,
+    ipc_call_t *call)
+{
+	void *data;
+	size_t size;
+	uint32_t arg;
+
+	/* The driver does not wait for the answer. */
+	async_answer_0(callid, EOK);
+
+	if (!nic->rx_ring_active)
+		return;
+
+	pkt_ring_arm(&nic->rx_ring);
+
+	while (pkt_ring_get(&nic->rx_ring, &data, &size, &arg)) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "Ethernet PDU from ring "
+		    "(%zu bytes)", size);
+		(void) ethip_received(&nic->iplink, data, size);
+		pkt_ring_release(&nic->rx_ring);
+	}
+}
+
 static void ethip_nic_device_state(ethip_nic_t *nic, ipc_callid_t callid,
     ipc_call_t *call)
 {
@@ -315,6 +364,9 @@ static void ethip_nic_cb_conn(ipc_callid_t iid, ipc_call_t *icall, void *arg)
 		case NIC_EV_DEVICE_STATE:
 			ethip_nic_device_state(nic, callid, &call);
 			break;
+		case NIC_EV_RECEIVED_RING:
+			ethip_nic_received_ring(nic, callid, &call);
+			break;
 		default:
 			log_msg(LOG_DEFAULT, LVL_DEBUG, "unknown IPC method: %" PRIun, IPC_GET_IMETHOD(call));
 			async_answer_0(callid, ENOTSUP);
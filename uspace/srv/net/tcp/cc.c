@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup tcp
+ * @{
+ */
+
+/**
+ * @file TCP congestion control
+ *
+ * Slow start and the loss window are common to all controllers (RFC 5681).
+ * The controller decides how the window grows in congestion avoidance and
+ * how far it is reduced when congestion is detected.
+ */
+
+#include <errno.h>
+#include <macros.h>
+#include <stdint.h>
+#include <str.h>
+#include <sys/time.h>
+
+#include "cc.h"
+#include "std.h"
+#include "tcp_type.h"
+
+/** CUBIC multiplicative decrease factor (beta = 7/10) */
+#define CUBIC_BETA_NUM  7
+#define CUBIC_BETA_DEN  10
+/** Longest time since the start of epoch we evaluate W(t) for (ms) */
+#define CUBIC_T_MAX_MS  (60 * 1000)
+
+static void tcp_cc_newreno_init(tcp_cc_t *);
+static void tcp_cc_newreno_acked(tcp_cc_t *, uint32_t);
+static void tcp_cc_newreno_congestion(tcp_cc_t *, uint32_t);
+static void tcp_cc_cubic_init(tcp_cc_t *);
+static void tcp_cc_cubic_acked(tcp_cc_t *, uint32_t);
+static void tcp_cc_cubic_congestion(tcp_cc_t *, uint32_t);
+
+/** NewReno congestion controller (RFC 5681, RFC 6582) */
+tcp_cc_ops_t tcp_cc_newreno = {
+	.name = "newreno",
+	.init = tcp_cc_newreno_init,
+	.acked = tcp_cc_newreno_acked,
+	.congestion = tcp_cc_newreno_congestion
+};
+
+/** CUBIC congestion controller (RFC 8312) */
+tcp_cc_ops_t tcp_cc_cubic = {
+	.name = "cubic",
+	.init = tcp_cc_cubic_init,
+	.acked = tcp_cc_cubic_acked,
+	.congestion = tcp_cc_cubic_congestion
+};
+
+static tcp_cc_ops_t *tcp_cc_ops[] = {
+	&tcp_cc_newreno,
+	&tcp_cc_cubic
+};
+
+/** Controller used for new connections */
+static tcp_cc_ops_t *tcp_cc_default = &tcp_cc_newreno;
+
+/** Select congestion controller used for new connections.
+ *
+ * @param name Controller name
+ * @return EOK on success, ENOENT if there is no such controller
+ */
+int tcp_cc_set_default(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(tcp_cc_ops) / sizeof(tcp_cc_ops[0]); i++) {
+		if (str_cmp(tcp_cc_ops[i]->name, name) == 0) {
+			tcp_cc_default = tcp_cc_ops[i];
+			return EOK;
+		}
+	}
+
+	return ENOENT;
+}
+
+/** Initialize congestion control state of a new connection.
+ *
+ * @param cc Congestion control state
+ */
+void tcp_cc_init(tcp_cc_t *cc)
+{
+	cc->ops = tcp_cc_default;
+
+	/* Initial window (RFC 5681 section 3.1) */
+	cc->cwnd = min(4 * TCP_MSS, max(2 * TCP_MSS, 4380));
+	cc->ssthresh = UINT32_MAX;
+
+	cc->ops->init(cc);
+}
+
+/** New data has been acknowledged outside of loss recovery.
+ *
+ * @param cc    Congestion control state
+ * @param acked Number of newly acknowledged bytes
+ */
+void tcp_cc_acked(tcp_cc_t *cc, uint32_t acked)
+{
+	if (cc->cwnd < cc->ssthresh) {
+		/* Slow start */
+		cc->cwnd += min(acked, TCP_MSS);
+		return;
+	}
+
+	cc->ops->acked(cc, acked);
+}
+
+/** Congestion has been detected.
+ *
+ * Sets a new slow start threshold. After a retransmission timeout the
+ * window collapses to the loss window and slow start begins again.
+ *
+ * @param cc      Congestion control state
+ * @param flight  Number of bytes outstanding in the network
+ * @param timeout @c true if congestion was detected by retransmission timeout
+ */
+void tcp_cc_congestion(tcp_cc_t *cc, uint32_t flight, bool timeout)
+{
+	cc->ops->congestion(cc, flight);
+
+	if (timeout)
+		cc->cwnd = TCP_MSS;
+}
+
+static void tcp_cc_newreno_init(tcp_cc_t *cc)
+{
+}
+
+/** Congestion avoidance: grow by about one MSS per round-trip time. */
+static void tcp_cc_newreno_acked(tcp_cc_t *cc, uint32_t acked)
+{
+	cc->cwnd += max(1, TCP_MSS * TCP_MSS / cc->cwnd);
+}
+
+static void tcp_cc_newreno_congestion(tcp_cc_t *cc, uint32_t flight)
+{
+	cc->ssthresh = max(flight / 2, 2 * TCP_MSS);
+}
+
+/** Integer cube root.
+ *
+ * @param a Argument
+ * @return Largest @c r such that r^3 <= a
+ */
+static uint64_t tcp_cc_cbrt(uint64_t a)
+{
+	uint64_t r = 0;
+	uint64_t b;
+	int s;
+
+	for (s = 63; s >= 0; s -= 3) {
+		r <<= 1;
+		b = 3 * r * (r + 1) + 1;
+		if ((a >> s) >= b) {
+			a -= b << s;
+			r++;
+		}
+	}
+
+	return r;
+}
+
+static void tcp_cc_cubic_init(tcp_cc_t *cc)
+{
+	cc->w_max = 0;
+	cc->epoch_valid = false;
+}
+
+/** Congestion avoidance: follow the cubic window function.
+ *
+ * W(t) = C * (t - K)^3 + W_origin with C = 0.4 segments / s^3. The window
+ * never grows slower than NewReno would (TCP-friendly region).
+ */
+static void tcp_cc_cubic_acked(tcp_cc_t *cc, uint32_t acked)
+{
+	struct timeval now;
+	int64_t t_ms;
+	int64_t w;
+	uint32_t target;
+	uint32_t inc;
+
+	getuptime(&now);
+
+	if (!cc->epoch_valid) {
+		cc->epoch = now;
+		cc->epoch_valid = true;
+
+		if (cc->cwnd < cc->w_max) {
+			/* K = cbrt(W_max * (1 - beta) / C), in ms */
+			cc->k_ms = tcp_cc_cbrt((uint64_t) (cc->w_max - cc->cwnd) /
+			    TCP_MSS * 2500000000ULL);
+			cc->w_origin = cc->w_max;
+		} else {
+			cc->k_ms = 0;
+			cc->w_origin = cc->cwnd;
+		}
+	}
+
+	t_ms = tv_sub_diff(&now, &cc->epoch) / 1000 - cc->k_ms;
+	if (t_ms > CUBIC_T_MAX_MS)
+		t_ms = CUBIC_T_MAX_MS;
+	if (t_ms < -CUBIC_T_MAX_MS)
+		t_ms = -CUBIC_T_MAX_MS;
+
+	/* C * t^3 in bytes with t in ms: 0.4 * MSS * t^3 / 10^9 */
+	w = (int64_t) cc->w_origin + t_ms * t_ms * t_ms * 4 * TCP_MSS /
+	    10000000000LL;
+	if (w < TCP_MSS)
+		w = TCP_MSS;
+	if (w > UINT32_MAX)
+		w = UINT32_MAX;
+	target = w;
+
+	/* NewReno increment is the lower bound */
+	inc = max(1, TCP_MSS * TCP_MSS / cc->cwnd);
+	if (target > cc->cwnd) {
+		inc = max(inc, (uint64_t) (target - cc->cwnd) *
+		    min(acked, TCP_MSS) / cc->cwnd);
+	}
+
+	cc->cwnd += min(inc, TCP_MSS);
+}
+
+static void tcp_cc_cubic_congestion(tcp_cc_t *cc, uint32_t flight)
+{
+	cc->epoch_valid = false;
+
+	/* Fast convergence: release bandwidth to newer flows */
+	if (cc->cwnd < cc->w_max) {
+		cc->w_max = (uint64_t) cc->cwnd * (CUBIC_BETA_DEN +
+		    CUBIC_BETA_NUM) / (2 * CUBIC_BETA_DEN);
+	} else {
+		cc->w_max = cc->cwnd;
+	}
+
+	cc->ssthresh = max((uint64_t) cc->cwnd * CUBIC_BETA_NUM /
+	    CUBIC_BETA_DEN, 2 * TCP_MSS);
+}
+
+/**
+ * @}
+ */
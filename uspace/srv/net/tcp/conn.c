@@ -45,6 +45,7 @@
 #include "conn.h"
 #include "inet.h"
 #include "iqueue.h"
+#include "ncsim.h"
 #include "pdu.h"
 #include "rqueue.h"
 #include "segment.h"
@@ -661,6 +662,7 @@ static void tcp_conn_sa_syn_sent(tcp_conn_t *conn, tcp_segment_t *seg)
 static void tcp_conn_sa_queue(tcp_conn_t *conn, tcp_segment_t *seg)
 {
 	tcp_segment_t *pseg;
+	bool out_of_order;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_conn_sa_seq(%p, %p)", conn, seg);
 
@@ -672,6 +674,12 @@ static void tcp_conn_sa_queue(tcp_conn_t *conn, tcp_segment_t *seg)
 		return;
 	}
 
+	/*
+	 * Send an immediate duplicate ACK when data arrives out of order
+	 * so that the peer can detect the loss (RFC 5681 section 4.2).
+	 */
+	out_of_order = seg->len > 0 && seg->seq != conn->rcv_nxt;
+
 	/* Queue for processing */
 	tcp_iqueue_insert_seg(&conn->incoming, seg);
 
@@ -683,6 +691,9 @@ static void tcp_conn_sa_queue(tcp_conn_t *conn, tcp_segment_t *seg)
 	 */
 	while (tcp_iqueue_get_ready_seg(&conn->incoming, &pseg) == EOK)
 		tcp_conn_seg_process(conn, pseg);
+
+	if (out_of_order && conn->cstate != st_closed)
+		tcp_tqueue_ctrl_seg(conn, CTL_ACK);
 }
 
 /** Process segment RST field.
@@ -810,12 +821,22 @@ static cproc_t tcp_conn_seg_proc_ack_sr(tcp_conn_t *conn, tcp_segment_t *seg)
  */
 static cproc_t tcp_conn_seg_proc_ack_est(tcp_conn_t *conn, tcp_segment_t *seg)
 {
+	bool dup_ack;
+
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_conn_seg_proc_ack_est(%p, %p)", conn, seg);
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "SEG.ACK=%u, SND.UNA=%u, SND.NXT=%u",
 	    (unsigned)seg->ack, (unsigned)conn->snd_una,
 	    (unsigned)conn->snd_nxt);
 
+	/*
+	 * Duplicate ACK in the sense of RFC 5681: acknowledges SND.UNA
+	 * while data is outstanding, carries no data and does not change
+	 * the window.
+	 */
+	dup_ack = seg->ack == conn->snd_una && seg->len == 0 &&
+	    seg->wnd == conn->snd_wnd && conn->snd_nxt != conn->snd_una;
+
 	if (!seq_no_ack_acceptable(conn, seg->ack)) {
 		log_msg(LOG_DEFAULT, LVL_DEBUG, "ACK not acceptable.");
 		if (!seq_no_ack_duplicate(conn, seg->ack)) {
@@ -843,11 +864,16 @@ static cproc_t tcp_conn_seg_proc_ack_est(tcp_conn_t *conn, tcp_segment_t *seg)
 		    conn->snd_wnd, conn->snd_wl1, conn->snd_wl2);
 	}
 
-	/*
-	 * Prune acked segments from retransmission queue and
-	 * possibly transmit more data.
-	 */
-	tcp_tqueue_ack_received(conn);
+	if (dup_ack) {
+		/* Possibly fast retransmit */
+		tcp_tqueue_dup_ack_received(conn);
+	} else {
+		/*
+		 * Prune acked segments from retransmission queue and
+		 * possibly transmit more data.
+		 */
+		tcp_tqueue_ack_received(conn);
+	}
 
 	return cp_continue;
 }
@@ -1420,15 +1446,17 @@ static void tcp_transmit_segment(inet_ep2_t *epp, tcp_segment_t *seg)
 	tcp_segment_dump(seg);
 
 	if (tcp_conn_lb == tcp_lb_segment) {
-		/* Loop back segment */
-//		tcp_ncsim_bounce_seg(sp, seg);
-
-		/* Reverse the identification */
-		tcp_ep2_flipped(epp, &rident);
-
-		/* Insert segment back into rqueue */
+		/*
+		 * Loop back segment through the network condition simulator,
+		 * which inserts it back into rqueue.
+		 */
 		dseg = tcp_segment_dup(seg);
-		tcp_rqueue_insert_seg(&rident, dseg);
+		if (dseg == NULL) {
+			log_msg(LOG_DEFAULT, LVL_WARN, "Not enough memory. Segment dropped.");
+			return;
+		}
+
+		tcp_ncsim_bounce_seg(epp, dseg);
 		return;
 	}
 
@@ -51,9 +51,14 @@
 #include "segment.h"
 #include "tcp_type.h"
 
-static list_t sim_queue;
-static fibril_mutex_t sim_queue_lock;
-static fibril_condvar_t sim_queue_cv;
+static LIST_INITIALIZE(sim_queue);
+static FIBRIL_MUTEX_INITIALIZE(sim_queue_lock);
+static FIBRIL_CONDVAR_INITIALIZE(sim_queue_cv);
+
+/** Probability of dropping a segment in percent */
+static unsigned sim_drop_pct;
+/** Maximum delay of a segment in microseconds */
+static suseconds_t sim_max_delay;
 
 /** Initialize segment receive queue. */
 void tcp_ncsim_init(void)
@@ -61,6 +66,24 @@ void tcp_ncsim_init(void)
 	list_initialize(&sim_queue);
 	fibril_mutex_initialize(&sim_queue_lock);
 	fibril_condvar_initialize(&sim_queue_cv);
+	sim_drop_pct = 0;
+	sim_max_delay = 0;
+}
+
+/** Set simulated network conditions.
+ *
+ * With both parameters zero (the default) segments are passed through
+ * immediately.
+ *
+ * @param drop_pct	Probability of dropping a segment in percent
+ * @param max_delay	Maximum random delay of a segment in microseconds
+ */
+void tcp_ncsim_set_conditions(unsigned drop_pct, suseconds_t max_delay)
+{
+	fibril_mutex_lock(&sim_queue_lock);
+	sim_drop_pct = drop_pct;
+	sim_max_delay = max_delay;
+	fibril_mutex_unlock(&sim_queue_lock);
 }
 
 /** Bounce segment through simulator into receive queue.
@@ -74,15 +97,31 @@ void tcp_ncsim_bounce_seg(inet_ep2_t *epp, tcp_segment_t *seg)
 	tcp_squeue_entry_t *old_qe;
 	inet_ep2_t rident;
 	link_t *link;
+	unsigned drop_pct;
+	suseconds_t max_delay;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_ncsim_bounce_seg()");
-	tcp_ep2_flipped(epp, &rident);
-	tcp_rqueue_insert_seg(&rident, seg);
-	return;
 
-	if (0 /*random() % 4 == 3*/) {
+	fibril_mutex_lock(&sim_queue_lock);
+	drop_pct = sim_drop_pct;
+	max_delay = sim_max_delay;
+	fibril_mutex_unlock(&sim_queue_lock);
+
+	if (drop_pct == 0 && max_delay == 0) {
+		tcp_ep2_flipped(epp, &rident);
+		tcp_rqueue_insert_seg(&rident, seg);
+		return;
+	}
+
+	/*
+	 * Only drop segments occupying sequence space. These are protected
+	 * by retransmission, whereas a lost window update would stall the
+	 * connection as we do not implement the persist timer.
+	 */
+	if (seg->len > 0 && drop_pct > 0 &&
+	    (unsigned) (random() % 100) < drop_pct) {
 		/* Drop segment */
-		log_msg(LOG_DEFAULT, LVL_ERROR, "NCSim dropping segment");
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "NCSim dropping segment");
 		tcp_segment_delete(seg);
 		return;
 	}
@@ -93,7 +132,7 @@ void tcp_ncsim_bounce_seg(inet_ep2_t *epp, tcp_segment_t *seg)
 		return;
 	}
 
-	sqe->delay = random() % (1000 * 1000);
+	sqe->delay = max_delay > 0 ? random() % max_delay : 0;
 	sqe->epp = *epp;
 	sqe->seg = seg;
 
@@ -140,6 +179,8 @@ static int tcp_ncsim_fibril(void *arg)
 		do {
 			link = list_first(&sim_queue);
 			sqe = list_get_instance(link, tcp_squeue_entry_t, link);
+			if (sqe->delay == 0)
+				break;
 
 			log_msg(LOG_DEFAULT, LVL_DEBUG, "NCSim - Sleep");
 			rc = fibril_condvar_wait_timeout(&sim_queue_cv,
@@ -36,9 +36,11 @@
 #define NCSIM_H
 
 #include <inet/endpoint.h>
+#include <sys/time.h>
 #include "tcp_type.h"
 
 extern void tcp_ncsim_init(void);
+extern void tcp_ncsim_set_conditions(unsigned, suseconds_t);
 extern void tcp_ncsim_bounce_seg(inet_ep2_t *, tcp_segment_t *);
 extern void tcp_ncsim_fibril_start(void);
 
@@ -34,6 +34,7 @@
  * @file HelenOS service implementation
  */
 
+#include <as.h>
 #include <async.h>
 #include <errno.h>
 #include <inet/endpoint.h>
@@ -45,6 +46,7 @@
 #include <macros.h>
 #include <mem.h>
 #include <stdlib.h>
+#include <vfs/vfs.h>
 
 #include "conn.h"
 #include "service.h"
@@ -56,6 +58,9 @@
 /** Maximum amount of data transferred in one send call */
 #define MAX_MSG_SIZE DATA_XFER_LIMIT
 
+/** Amount of file data read at once when sending a file */
+#define SEND_FILE_CHUNK 16384
+
 static void tcp_ev_data(tcp_cconn_t *);
 static void tcp_ev_connected(tcp_cconn_t *);
 static void tcp_ev_conn_failed(tcp_cconn_t *);
@@ -423,6 +428,79 @@ static int tcp_clistener_get(tcp_client_t *client, sysarg_t id,
 	return ENOENT;
 }
 
+/** Create client shared buffer.
+ *
+ * This adds a buffer shared by the client into the client's namespace.
+ *
+ * @param client   TCP client
+ * @param data     Mapping of the shared area
+ * @param size     Size of the shared area
+ * @param rcshbuf  Place to store pointer to new client shared buffer
+ *
+ * @return EOK on success or ENOMEM if out of memory
+ */
+static int tcp_cshbuf_create(tcp_client_t *client, void *data, size_t size,
+    tcp_cshbuf_t **rcshbuf)
+{
+	tcp_cshbuf_t *cshbuf;
+	sysarg_t id;
+
+	cshbuf = calloc(1, sizeof(tcp_cshbuf_t));
+	if (cshbuf == NULL)
+		return ENOMEM;
+
+	/* Allocate new ID */
+	id = 0;
+	list_foreach (client->cshbuf, lclient, tcp_cshbuf_t, cshbuf) {
+		if (cshbuf->id >= id)
+			id = cshbuf->id + 1;
+	}
+
+	cshbuf->id = id;
+	cshbuf->client = client;
+	cshbuf->data = data;
+	cshbuf->size = size;
+
+	list_append(&cshbuf->lclient, &client->cshbuf);
+	*rcshbuf = cshbuf;
+	return EOK;
+}
+
+/** Destroy client shared buffer.
+ *
+ * The shared area is unmapped.
+ *
+ * @param cshbuf Client shared buffer
+ */
+static void tcp_cshbuf_destroy(tcp_cshbuf_t *cshbuf)
+{
+	list_remove(&cshbuf->lclient);
+	as_area_destroy(cshbuf->data);
+	free(cshbuf);
+}
+
+/** Get client shared buffer by ID.
+ *
+ * @param client  Client
+ * @param id      Client shared buffer ID
+ * @param rcshbuf Place to store pointer to client shared buffer
+ *
+ * @return EOK on success, ENOENT if no client shared buffer with the given
+ *         ID is found.
+ */
+static int tcp_cshbuf_get(tcp_client_t *client, sysarg_t id,
+    tcp_cshbuf_t **rcshbuf)
+{
+	list_foreach (client->cshbuf, lclient, tcp_cshbuf_t, cshbuf) {
+		if (cshbuf->id == id) {
+			*rcshbuf = cshbuf;
+			return EOK;
+		}
+	}
+
+	return ENOENT;
+}
+
 /** Create connection.
  *
  * Handle client request to create connection (with parameters unmarshalled).
@@ -671,6 +749,100 @@ static int tcp_conn_send_impl(tcp_client_t *client, sysarg_t conn_id,
 	return EOK;
 }
 
+/** Send data from shared buffer over connection.
+ *
+ * Handle client request to send data from a shared buffer (with parameters
+ * unmarshalled). The data is copied straight from the shared area into
+ * the connection send buffer.
+ *
+ * @param client    TCP client
+ * @param conn_id   Connection ID
+ * @param shbuf_id  Shared buffer ID
+ * @param offset    Offset of the data in the shared buffer
+ * @param size      Data size in bytes
+ *
+ * @return EOK on success or negative error code
+ */
+static int tcp_conn_send_shbuf_impl(tcp_client_t *client, sysarg_t conn_id,
+    sysarg_t shbuf_id, size_t offset, size_t size)
+{
+	tcp_cconn_t *cconn;
+	tcp_cshbuf_t *cshbuf;
+	int rc;
+
+	rc = tcp_cconn_get(client, conn_id, &cconn);
+	if (rc != EOK)
+		return rc;
+
+	rc = tcp_cshbuf_get(client, shbuf_id, &cshbuf);
+	if (rc != EOK)
+		return rc;
+
+	if (offset > cshbuf->size || size > cshbuf->size - offset)
+		return EINVAL;
+
+	if (size == 0)
+		return EOK;
+
+	if (tcp_uc_send(cconn->conn, cshbuf->data + offset, size, 0) != TCP_EOK)
+		return EIO;
+
+	return EOK;
+}
+
+/** Send file contents over connection.
+ *
+ * Handle client request to send data from a file (with parameters
+ * unmarshalled). The file is read directly into a service buffer.
+ *
+ * @param client  TCP client
+ * @param conn_id Connection ID
+ * @param file    VFS file handle open for reading
+ * @param pos     Position in the file
+ * @param size    Number of bytes to send
+ *
+ * @return EOK on success or negative error code
+ */
+static int tcp_conn_send_file_impl(tcp_client_t *client, sysarg_t conn_id,
+    int file, aoff64_t pos, size_t size)
+{
+	tcp_cconn_t *cconn;
+	void *data;
+	size_t nread;
+	int rc;
+
+	rc = tcp_cconn_get(client, conn_id, &cconn);
+	if (rc != EOK)
+		return rc;
+
+	data = malloc(min(size, SEND_FILE_CHUNK));
+	if (data == NULL && size > 0)
+		return ENOMEM;
+
+	while (size > 0) {
+		rc = vfs_read(file, &pos, data, min(size, SEND_FILE_CHUNK),
+		    &nread);
+		if (rc != EOK)
+			break;
+
+		/* File is shorter than requested */
+		if (nread == 0) {
+			rc = EIO;
+			break;
+		}
+
+		if (tcp_uc_send(cconn->conn, data, nread, 0) != TCP_EOK) {
+			rc = EIO;
+			break;
+		}
+
+		size -= nread;
+	}
+
+	free(data);
+	return rc;
+}
+
 /** Receive data from connection.
  *
  * Handle client request to receive data (with parameters unmarshalled).
@@ -999,6 +1171,143 @@ static void tcp_conn_send_srv(tcp_client_t *client, ipc_callid_t iid,
 	free(data);
 }
 
+/** Send data from shared buffer via connection.
+ *
+ * Handle client request to send data from a shared buffer via connection.
+ *
+ * @param client   TCP client
+ * @param iid      Async request ID
+ * @param icall    Async request data
+ */
+static void tcp_conn_send_shbuf_srv(tcp_client_t *client, ipc_callid_t iid,
+    ipc_call_t *icall)
+{
+	sysarg_t conn_id;
+	sysarg_t shbuf_id;
+	size_t offset;
+	size_t size;
+	int rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_conn_send_shbuf_srv()");
+
+	conn_id = IPC_GET_ARG1(*icall);
+	shbuf_id = IPC_GET_ARG2(*icall);
+	offset = IPC_GET_ARG3(*icall);
+	size = IPC_GET_ARG4(*icall);
+
+	rc = tcp_conn_send_shbuf_impl(client, conn_id, shbuf_id, offset, size);
+	async_answer_0(iid, rc);
+}
+
+/** Send file contents via connection.
+ *
+ * Handle client request to send file contents via connection. The file
+ * handle is passed by the client following the request.
+ *
+ * @param client   TCP client
+ * @param iid      Async request ID
+ * @param icall    Async request data
+ */
+static void tcp_conn_send_file_srv(tcp_client_t *client, ipc_callid_t iid,
+    ipc_call_t *icall)
+{
+	sysarg_t conn_id;
+	aoff64_t pos;
+	size_t size;
+	int file;
+	int rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_conn_send_file_srv()");
+
+	conn_id = IPC_GET_ARG1(*icall);
+	pos = MERGE_LOUP32(IPC_GET_ARG2(*icall), IPC_GET_ARG3(*icall));
+	size = IPC_GET_ARG4(*icall);
+
+	file = vfs_receive_handle(true);
+	if (file < 0) {
+		async_answer_0(iid, file);
+		return;
+	}
+
+	rc = vfs_open(file, MODE_READ);
+	if (rc == EOK)
+		rc = tcp_conn_send_file_impl(client, conn_id, file, pos, size);
+
+	vfs_put(file);
+	async_answer_0(iid, rc);
+}
+
+/** Create shared buffer.
+ *
+ * Handle client request to create a shared buffer. The client shares
+ * the buffer memory following the request.
+ *
+ * @param client   TCP client
+ * @param iid      Async request ID
+ * @param icall    Async request data
+ */
+static void tcp_shbuf_create_srv(tcp_client_t *client, ipc_callid_t iid,
+    ipc_call_t *icall)
+{
+	ipc_callid_t callid;
+	tcp_cshbuf_t *cshbuf;
+	unsigned int flags;
+	size_t size;
+	void *data;
+	int rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_shbuf_create_srv()");
+
+	if (!async_share_out_receive(&callid, &size, &flags)) {
+		async_answer_0(iid, EINVAL);
+		return;
+	}
+
+	if ((flags & AS_AREA_READ) == 0) {
+		async_answer_0(callid, EINVAL);
+		async_answer_0(iid, EINVAL);
+		return;
+	}
+
+	rc = async_share_out_finalize(callid, &data);
+	if (rc != EOK || data == AS_MAP_FAILED) {
+		async_answer_0(iid, ENOMEM);
+		return;
+	}
+
+	rc = tcp_cshbuf_create(client, data, size, &cshbuf);
+	if (rc != EOK) {
+		as_area_destroy(data);
+		async_answer_0(iid, rc);
+		return;
+	}
+
+	async_answer_1(iid, EOK, cshbuf->id);
+}
+
+/** Destroy shared buffer.
+ *
+ * Handle client request to destroy a shared buffer.
+ *
+ * @param client   TCP client
+ * @param iid      Async request ID
+ * @param icall    Async request data
+ */
+static void tcp_shbuf_destroy_srv(tcp_client_t *client, ipc_callid_t iid,
+    ipc_call_t *icall)
+{
+	tcp_cshbuf_t *cshbuf;
+	int rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_shbuf_destroy_srv()");
+
+	rc = tcp_cshbuf_get(client, IPC_GET_ARG1(*icall), &cshbuf);
+	if (rc == EOK)
+		tcp_cshbuf_destroy(cshbuf);
+
+	async_answer_0(iid, rc);
+}
+
 /** Read received data from connection without blocking.
  *
  * Handle client request to read received data via connection without blocking.
@@ -1126,6 +1435,7 @@ static void tcp_client_init(tcp_client_t *client)
 	client->sess = NULL;
 	list_initialize(&client->cconn);
 	list_initialize(&client->clst);
+	list_initialize(&client->cshbuf);
 }
 
 /** Finalize TCP client structure.
@@ -1158,6 +1468,11 @@ static void tcp_client_fini(tcp_client_t *client)
 		/* XXX Destroy listeners */
 	}
 
+	while (!list_empty(&client->cshbuf)) {
+		tcp_cshbuf_destroy(list_get_instance(
+		    list_first(&client->cshbuf), tcp_cshbuf_t, lclient));
+	}
+
 	if (client->sess != NULL)
 		async_hangup(client->sess);
 }
@@ -1228,6 +1543,18 @@ static void tcp_client_conn(ipc_callid_t iid, ipc_call_t *icall, void *arg)
 		case TCP_CONN_RECV_WAIT:
 			tcp_conn_recv_wait_srv(&client, callid, &call);
 			break;
+		case TCP_CONN_SEND_SHBUF:
+			tcp_conn_send_shbuf_srv(&client, callid, &call);
+			break;
+		case TCP_CONN_SEND_FILE:
+			tcp_conn_send_file_srv(&client, callid, &call);
+			break;
+		case TCP_SHBUF_CREATE:
+			tcp_shbuf_create_srv(&client, callid, &call);
+			break;
+		case TCP_SHBUF_DESTROY:
+			tcp_shbuf_destroy_srv(&client, callid, &call);
+			break;
 		default:
 			async_answer_0(callid, ENOTSUP);
 			break;
@@ -42,6 +42,9 @@
 
 #define IP_PROTO_TCP  6
 
+/** Maximum segment size we send (fits Ethernet MTU with IPv4 or IPv6) */
+#define TCP_MSS  1440
+
 /** TCP Header (fixed part) */
 typedef struct {
 	/** Source port */
@@ -38,8 +38,10 @@
 #include <errno.h>
 #include <io/log.h>
 #include <stdio.h>
+#include <str.h>
 #include <task.h>
 
+#include "cc.h"
 #include "conn.h"
 #include "inet.h"
 #include "ncsim.h"
@@ -94,6 +96,15 @@ int main(int argc, char **argv)
 
 	printf(NAME ": TCP (Transmission Control Protocol) network module\n");
 
+	if (argc > 1 && str_test_prefix(argv[1], "--cc=")) {
+		rc = tcp_cc_set_default(argv[1] + str_size("--cc="));
+		if (rc != EOK) {
+			printf(NAME ": Unknown congestion controller '%s'.\n",
+			    argv[1] + str_size("--cc="));
+			return 1;
+		}
+	}
+
 	rc = log_init(NAME);
 	if (rc != EOK) {
 		printf(NAME ": Failed to initialize log.\n");
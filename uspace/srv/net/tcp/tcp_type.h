@@ -44,6 +44,7 @@
 #include <stdint.h>
 #include <inet/addr.h>
 #include <inet/endpoint.h>
+#include <sys/time.h>
 
 struct tcp_conn;
 
@@ -224,8 +225,68 @@ typedef struct {
 
 	/** Callbacks */
 	tcp_tqueue_cb_t *cb;
+
+	/** Smoothed round-trip time (SRTT) in microseconds */
+	suseconds_t srtt;
+	/** Round-trip time variation (RTTVAR) in microseconds */
+	suseconds_t rttvar;
+	/** Retransmission timeout (RTO) in microseconds */
+	suseconds_t rto;
+	/** At least one RTT sample has been taken */
+	bool rtt_valid;
+
+	/** A segment is being timed for an RTT sample */
+	bool rtt_timing;
+	/** Sequence number of the segment being timed */
+	uint32_t rtt_seq;
+	/** Time when the segment being timed was sent */
+	struct timeval rtt_start;
+
+	/** Number of consecutive duplicate ACKs received */
+	unsigned dupacks;
+	/** Loss recovery is in progress */
+	bool in_recovery;
+	/** Loss recovery was started by retransmission timeout */
+	bool rto_recovery;
+	/** Highest sequence number sent when loss recovery started */
+	uint32_t recover;
 } tcp_tqueue_t;
 
+struct tcp_cc;
+
+/** Congestion controller operations */
+typedef struct {
+	/** Controller name */
+	const char *name;
+	/** Initialize controller state */
+	void (*init)(struct tcp_cc *);
+	/** New data acknowledged outside of loss recovery */
+	void (*acked)(struct tcp_cc *, uint32_t);
+	/** Congestion detected, set new slow start threshold */
+	void (*congestion)(struct tcp_cc *, uint32_t);
+} tcp_cc_ops_t;
+
+/** Congestion control state */
+typedef struct tcp_cc {
+	/** Controller operations */
+	tcp_cc_ops_t *ops;
+	/** Congestion window in bytes */
+	uint32_t cwnd;
+	/** Slow start threshold in bytes */
+	uint32_t ssthresh;
+
+	/** Window size just before the last reduction (CUBIC) */
+	uint32_t w_max;
+	/** Congestion avoidance epoch has started (CUBIC) */
+	bool epoch_valid;
+	/** Start of the current congestion avoidance epoch (CUBIC) */
+	struct timeval epoch;
+	/** Window at the start of the epoch (CUBIC) */
+	uint32_t w_origin;
+	/** Time to reach w_origin in milliseconds (CUBIC) */
+	uint32_t k_ms;
+} tcp_cc_t;
+
 /** Connection */
 struct tcp_conn {
 	char *name;
@@ -267,6 +328,9 @@ struct tcp_conn {
 	/** Retransmission queue */
 	tcp_tqueue_t retransmit;
 
+	/** Congestion control */
+	tcp_cc_t cc;
+
 	/** Time-Wait timeout timer */
 	fibril_timer_t *tw_timer;
 
@@ -368,6 +432,20 @@ typedef struct tcp_clst {
 	link_t lclient;
 } tcp_clst_t;
 
+/** Buffer shared by TCP client */
+typedef struct tcp_cshbuf {
+	/** Mapping of the shared area */
+	void *data;
+	/** Size of the shared area */
+	size_t size;
+	/** Shared buffer ID for the client */
+	sysarg_t id;
+	/** Client */
+	struct tcp_client *client;
+	/** Link to tcp_client_t.cshbuf */
+	link_t lclient;
+} tcp_cshbuf_t;
+
 /** TCP client */
 typedef struct tcp_client {
 	/** Client callback session */
@@ -376,6 +454,8 @@ typedef struct tcp_client {
 	list_t cconn; /* of tcp_cconn_t */
 	/** Client's listeners */
 	list_t clst;
+	/** Client's shared buffers */
+	list_t cshbuf; /* of tcp_cshbuf_t */
 } tcp_client_t;
 
 /** Internal loopback type */
@@ -31,6 +31,8 @@
 #include <pcut/pcut.h>
 
 #include "../conn.h"
+#include "../segment.h"
+#include "../std.h"
 #include "../tqueue.h"
 
 PCUT_INIT
@@ -254,9 +256,131 @@ PCUT_TEST(ack_received)
 	tcp_conn_delete(conn);
 }
 
+/** Test sending data is limited by congestion window and MSS */
+PCUT_TEST(new_data_cwnd)
+{
+	tcp_conn_t *conn;
+	inet_ep2_t epp;
+
+	/* XXX tqueue can only be created via tcp_conn_new */
+	inet_ep2_init(&epp);
+	conn = tcp_conn_new(&epp);
+	PCUT_ASSERT_NOT_NULL(conn);
+
+	conn->cstate = st_established;
+	conn->snd_una = 10;
+	conn->snd_nxt = 10;
+	conn->snd_wnd = 65535;
+	conn->snd_buf_used = 3 * TCP_MSS;
+	conn->snd_buf_fin = false;
+	conn->cc.cwnd = 2 * TCP_MSS;
+
+	/* Redirect segment transmission */
+	conn->retransmit.cb = &tqueue_test_cb;
+	seg_cnt = 0;
+
+	tcp_conn_lock(conn);
+	tcp_tqueue_new_data(conn);
+	tcp_conn_reset(conn);
+	tcp_conn_unlock(conn);
+
+	PCUT_ASSERT_INT_EQUALS(10 + 2 * TCP_MSS, conn->snd_nxt);
+	PCUT_ASSERT_INT_EQUALS(TCP_MSS, conn->snd_buf_used);
+
+	tcp_conn_delete(conn);
+	PCUT_ASSERT_INT_EQUALS(2, seg_cnt);
+	PCUT_ASSERT_INT_EQUALS(10, trans_seg[0]->seq);
+	PCUT_ASSERT_INT_EQUALS(TCP_MSS, trans_seg[0]->len);
+	PCUT_ASSERT_INT_EQUALS(10 + TCP_MSS, trans_seg[1]->seq);
+	PCUT_ASSERT_INT_EQUALS(TCP_MSS, trans_seg[1]->len);
+}
+
+/** Test fast retransmit after three duplicate ACKs and recovery */
+PCUT_TEST(fast_retransmit)
+{
+	tcp_conn_t *conn;
+	inet_ep2_t epp;
+	int i;
+
+	/* XXX tqueue can only be created via tcp_conn_new */
+	inet_ep2_init(&epp);
+	conn = tcp_conn_new(&epp);
+	PCUT_ASSERT_NOT_NULL(conn);
+
+	conn->cstate = st_established;
+	conn->snd_una = 10;
+	conn->snd_nxt = 10;
+	conn->snd_wnd = 65535;
+	conn->snd_buf_used = 3 * TCP_MSS;
+	conn->snd_buf_fin = false;
+	conn->cc.cwnd = 3 * TCP_MSS;
+
+	/* Redirect segment transmission */
+	conn->retransmit.cb = &tqueue_test_cb;
+	seg_cnt = 0;
+
+	tcp_conn_lock(conn);
+	tcp_tqueue_new_data(conn);
+	PCUT_ASSERT_INT_EQUALS(3, seg_cnt);
+
+	/* Two duplicate ACKs do not trigger retransmission */
+	for (i = 0; i < 2; i++)
+		tcp_tqueue_dup_ack_received(conn);
+	PCUT_ASSERT_INT_EQUALS(3, seg_cnt);
+	PCUT_ASSERT_FALSE(conn->retransmit.in_recovery);
+
+	/* The third one does */
+	tcp_tqueue_dup_ack_received(conn);
+	PCUT_ASSERT_INT_EQUALS(4, seg_cnt);
+	PCUT_ASSERT_INT_EQUALS(10, trans_seg[3]->seq);
+	PCUT_ASSERT_TRUE(conn->retransmit.in_recovery);
+	PCUT_ASSERT_INT_EQUALS(2 * TCP_MSS, conn->cc.ssthresh);
+	PCUT_ASSERT_INT_EQUALS(5 * TCP_MSS, conn->cc.cwnd);
+
+	/* Partial ACK retransmits the next segment */
+	conn->snd_una = 10 + TCP_MSS;
+	tcp_tqueue_ack_received(conn);
+	PCUT_ASSERT_INT_EQUALS(5, seg_cnt);
+	PCUT_ASSERT_INT_EQUALS(10 + TCP_MSS, trans_seg[4]->seq);
+	PCUT_ASSERT_TRUE(conn->retransmit.in_recovery);
+
+	/* Full ACK ends recovery */
+	conn->snd_una = 10 + 3 * TCP_MSS;
+	tcp_tqueue_ack_received(conn);
+	PCUT_ASSERT_FALSE(conn->retransmit.in_recovery);
+	PCUT_ASSERT_INT_EQUALS(2 * TCP_MSS, conn->cc.cwnd);
+	PCUT_ASSERT_INT_EQUALS(0, list_count(&conn->retransmit.list));
+
+	tcp_conn_reset(conn);
+	tcp_conn_unlock(conn);
+	tcp_conn_delete(conn);
+}
+
+/** Test RTO computation from RTT samples */
+PCUT_TEST(rtt_update)
+{
+	tcp_tqueue_t tqueue;
+
+	tqueue.rtt_valid = false;
+
+	/* First sample, RTO is clamped to one second */
+	tcp_tqueue_rtt_update(&tqueue, 100 * 1000);
+	PCUT_ASSERT_TRUE(tqueue.rtt_valid);
+	PCUT_ASSERT_INT_EQUALS(100 * 1000, tqueue.srtt);
+	PCUT_ASSERT_INT_EQUALS(50 * 1000, tqueue.rttvar);
+	PCUT_ASSERT_INT_EQUALS(1000 * 1000, tqueue.rto);
+
+	/* A much longer sample increases variation */
+	tcp_tqueue_rtt_update(&tqueue, 2000 * 1000);
+	PCUT_ASSERT_INT_EQUALS(337500, tqueue.srtt);
+	PCUT_ASSERT_INT_EQUALS(512500, tqueue.rttvar);
+	PCUT_ASSERT_INT_EQUALS(337500 + 4 * 512500, tqueue.rto);
+}
+
 static void tqueue_test_transmit_seg(inet_ep2_t *epp, tcp_segment_t *seg)
 {
-	trans_seg[seg_cnt++] = seg;
+	/* Caller retains ownership of the segment */
+	trans_seg[seg_cnt++] = tcp_segment_dup(seg);
 }
 
 PCUT_EXPORT(tqueue);
@@ -26,12 +26,16 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <async.h>
 #include <errno.h>
+#include <fibril.h>
 #include <inet/endpoint.h>
 #include <io/log.h>
+#include <mem.h>
 #include <pcut/pcut.h>
 
 #include "../conn.h"
+#include "../ncsim.h"
 #include "../rqueue.h"
 #include "../ucall.h"
 
@@ -42,6 +46,7 @@ PCUT_TEST_SUITE(ucall);
 static void test_cstate_change(tcp_conn_t *, void *, tcp_cstate_t);
 static void test_conns_establish(tcp_conn_t **, tcp_conn_t **);
 static void test_conns_tear_down(tcp_conn_t *, tcp_conn_t *);
+static int test_xfer_sender(void *);
 
 static tcp_rqueue_cb_t test_rqueue_cb = {
 	.seg_received = tcp_as_segment_arrived
@@ -57,6 +62,18 @@ static tcp_conn_status_t sconn_status;
 static FIBRIL_MUTEX_INITIALIZE(cst_lock);
 static FIBRIL_CONDVAR_INITIALIZE(cst_cv);
 
+enum {
+	/** Size of data transferred in xfer_loss test */
+	test_xfer_size = 32 * 1024,
+	/** Simulated segment loss in percent */
+	test_xfer_drop_pct = 5,
+	/** Maximum simulated segment delay in microseconds */
+	test_xfer_delay = 10 * 1000
+};
+
+static uint8_t xfer_sbuf[test_xfer_size];
+static uint8_t xfer_rbuf[test_xfer_size];
+
 PCUT_TEST_BEFORE
 {
 	int rc;
@@ -234,6 +251,58 @@ PCUT_TEST(conn_est_close_simult)
 	test_conns_tear_down(cconn, sconn);
 }
 
+/** Test transferring data over a lossy connection with variable delay.
+ *
+ * Lost segments must be recovered by fast retransmit or retransmission
+ * timeout, reordered segments by the receiver.
+ */
+PCUT_TEST(xfer_loss)
+{
+	tcp_conn_t *cconn, *sconn;
+	tcp_error_t trc;
+	size_t rcvd, total;
+	xflags_t xflags;
+	fid_t fid;
+	size_t i;
+
+	test_conns_establish(&cconn, &sconn);
+
+	for (i = 0; i < test_xfer_size; i++)
+		xfer_sbuf[i] = i % 251;
+
+	tcp_ncsim_fibril_start();
+	tcp_ncsim_set_conditions(test_xfer_drop_pct, test_xfer_delay);
+
+	fid = fibril_create(test_xfer_sender, cconn);
+	PCUT_ASSERT_FALSE(fid == 0);
+	fibril_add_ready(fid);
+
+	total = 0;
+	while (total < test_xfer_size) {
+		trc = tcp_uc_receive(sconn, xfer_rbuf + total,
+		    test_xfer_size - total, &rcvd, &xflags);
+		PCUT_ASSERT_INT_EQUALS(TCP_EOK, trc);
+		PCUT_ASSERT_TRUE(rcvd > 0);
+		total += rcvd;
+	}
+
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(xfer_sbuf, xfer_rbuf, test_xfer_size));
+
+	/* Let segments still in the simulator drain */
+	tcp_ncsim_set_conditions(0, 0);
+	async_usleep(2 * test_xfer_delay);
+
+	test_conns_tear_down(cconn, sconn);
+}
+
+static int test_xfer_sender(void *arg)
+{
+	tcp_conn_t *conn = (tcp_conn_t *) arg;
+
+	(void) tcp_uc_send(conn, xfer_sbuf, test_xfer_size, 0);
+	return 0;
+}
+
 static void test_cstate_change(tcp_conn_t *conn, void *arg,
     tcp_cstate_t old_state)
 {
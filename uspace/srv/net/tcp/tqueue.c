@@ -42,17 +42,30 @@
 #include <macros.h>
 #include <mem.h>
 #include <stdlib.h>
+#include <sys/time.h>
 
+#include "cc.h"
 #include "conn.h"
 #include "inet.h"
 #include "ncsim.h"
 #include "rqueue.h"
 #include "segment.h"
 #include "seq_no.h"
+#include "std.h"
 #include "tqueue.h"
 #include "tcp_type.h"
 
-#define RETRANSMIT_TIMEOUT	(2*1000*1000)
+/** Initial retransmission timeout (RFC 6298) */
+#define RTO_INITIAL		(1000*1000)
+/** Lower bound on retransmission timeout */
+#define RTO_MIN			(1000*1000)
+/** Upper bound on retransmission timeout */
+#define RTO_MAX			(60*1000*1000)
+/** Clock granularity assumed in RTO computation */
+#define RTO_CLOCK_G		(10*1000)
+
+/** Number of duplicate ACKs that trigger fast retransmit */
+#define DUPACK_THRESHOLD	3
 
 static void retransmit_timeout_func(void *);
 static void tcp_tqueue_timer_set(tcp_conn_t *);
@@ -61,6 +74,13 @@ static void tcp_tqueue_seg(tcp_conn_t *, tcp_segment_t *);
 static void tcp_conn_transmit_segment(tcp_conn_t *, tcp_segment_t *);
 static void tcp_prepare_transmit_segment(tcp_conn_t *, tcp_segment_t *);
 static void tcp_tqueue_send_immed(tcp_conn_t *, tcp_segment_t *);
+static bool tcp_tqueue_retransmit_first(tcp_conn_t *);
+
+/** a < b modulo sequence space (see seq_no_ack_duplicate()) */
+static bool tcp_tqueue_seq_lt(uint32_t a, uint32_t b)
+{
+	return ((b - a) & (0x1 << 31)) == 0 && a != b;
+}
 
 int tcp_tqueue_init(tcp_tqueue_t *tqueue, tcp_conn_t *conn,
     tcp_tqueue_cb_t *cb)
@@ -73,6 +93,17 @@ int tcp_tqueue_init(tcp_tqueue_t *tqueue, tcp_conn_t *conn,
 
 	list_initialize(&tqueue->list);
 
+	tqueue->srtt = 0;
+	tqueue->rttvar = 0;
+	tqueue->rto = RTO_INITIAL;
+	tqueue->rtt_valid = false;
+	tqueue->rtt_timing = false;
+	tqueue->dupacks = 0;
+	tqueue->in_recovery = false;
+	tqueue->rto_recovery = false;
+
+	tcp_cc_init(&conn->cc);
+
 	return EOK;
 }
 
@@ -149,6 +180,13 @@ static void tcp_tqueue_seg(tcp_conn_t *conn, tcp_segment_t *seg)
 
 		list_append(&tqe->link, &conn->retransmit.list);
 
+		/* Time this segment unless we are already timing one */
+		if (!conn->retransmit.rtt_timing) {
+			conn->retransmit.rtt_timing = true;
+			conn->retransmit.rtt_seq = conn->snd_nxt;
+			getuptime(&conn->retransmit.rtt_start);
+		}
+
 		/* Set retransmission timer */
 		tcp_tqueue_timer_set(conn);
 	}
@@ -172,15 +210,34 @@ static void tcp_prepare_transmit_segment(tcp_conn_t *conn, tcp_segment_t *seg)
 	tcp_conn_transmit_segment(conn, seg);
 }
 
+/** Number of free sequence numbers in the usable window.
+ *
+ * The usable window is the smaller of the peer's receive window and
+ * the congestion window, less the data already in flight.
+ *
+ * @param conn	Connection
+ */
+static size_t tcp_tqueue_avail_wnd(tcp_conn_t *conn)
+{
+	uint32_t flight;
+	uint32_t wnd;
+
+	flight = conn->snd_nxt - conn->snd_una;
+	wnd = min(conn->snd_wnd, conn->cc.cwnd);
+
+	return wnd > flight ? wnd - flight : 0;
+}
+
 /** Transmit data from the send buffer.
+ *
+ * Data is sent in segments of at most TCP_MSS bytes as long as
+ * the usable window allows.
  *
  * @param conn	Connection
  */
 void tcp_tqueue_new_data(tcp_conn_t *conn)
 {
 	size_t avail_wnd;
-	size_t xfer_seqlen;
-	size_t snd_buf_seqlen;
 	size_t data_size;
 	tcp_control_t ctrl;
 	bool send_fin;
@@ -189,52 +246,148 @@ void tcp_tqueue_new_data(tcp_conn_t *conn)
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: tcp_tqueue_new_data()", conn->name);
 
-	/* Number of free sequence numbers in send window */
-	avail_wnd = (conn->snd_una + conn->snd_wnd) - conn->snd_nxt;
-	snd_buf_seqlen = conn->snd_buf_used + (conn->snd_buf_fin ? 1 : 0);
+	while (true) {
+		avail_wnd = tcp_tqueue_avail_wnd(conn);
+		data_size = min(conn->snd_buf_used, min(avail_wnd, TCP_MSS));
 
-	xfer_seqlen = min(snd_buf_seqlen, avail_wnd);
-	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: snd_buf_seqlen = %zu, SND.WND = %" PRIu32 ", "
-	    "xfer_seqlen = %zu", conn->name, snd_buf_seqlen, conn->snd_wnd,
-	    xfer_seqlen);
+		/* FIN goes with the last segment if it fits in the window */
+		send_fin = conn->snd_buf_fin && data_size == conn->snd_buf_used &&
+		    data_size < avail_wnd;
 
-	if (xfer_seqlen == 0)
-		return;
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: snd_buf_used = %zu, "
+		    "SND.WND = %" PRIu32 ", CWND = %" PRIu32 ", data_size = %zu",
+		    conn->name, conn->snd_buf_used, conn->snd_wnd, conn->cc.cwnd,
+		    data_size);
+
+		if (data_size == 0 && !send_fin)
+			return;
+
+		/* XXX Do not always send immediately */
+
+		if (send_fin) {
+			log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: Sending out FIN.", conn->name);
+			/* We are sending out FIN */
+			ctrl = CTL_FIN;
+		} else {
+			ctrl = 0;
+		}
+
+		seg = tcp_segment_make_data(ctrl, conn->snd_buf, data_size);
+		if (seg == NULL) {
+			log_msg(LOG_DEFAULT, LVL_ERROR, "Memory allocation failure.");
+			return;
+		}
+
+		/* Remove data from send buffer */
+		memmove(conn->snd_buf, conn->snd_buf + data_size,
+		    conn->snd_buf_used - data_size);
+		conn->snd_buf_used -= data_size;
+
+		if (send_fin)
+			conn->snd_buf_fin = false;
+
+		fibril_condvar_broadcast(&conn->snd_buf_cv);
 
-	/* XXX Do not always send immediately */
+		if (send_fin)
+			tcp_conn_fin_sent(conn);
 
-	send_fin = conn->snd_buf_fin && xfer_seqlen == snd_buf_seqlen;
-	data_size = xfer_seqlen - (send_fin ? 1 : 0);
+		tcp_tqueue_seg(conn, seg);
+		tcp_segment_delete(seg);
+	}
+}
+
+/** Update retransmission timeout with a new round-trip time sample.
+ *
+ * Implements RFC 6298 section 2.
+ *
+ * @param tqueue	Retransmission queue
+ * @param r		Round-trip time sample in microseconds
+ */
+void tcp_tqueue_rtt_update(tcp_tqueue_t *tqueue, suseconds_t r)
+{
+	suseconds_t delta;
 
-	if (send_fin) {
-		log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: Sending out FIN.", conn->name);
-		/* We are sending out FIN */
-		ctrl = CTL_FIN;
+	if (!tqueue->rtt_valid) {
+		tqueue->srtt = r;
+		tqueue->rttvar = r / 2;
+		tqueue->rtt_valid = true;
 	} else {
-		ctrl = 0;
+		delta = tqueue->srtt > r ? tqueue->srtt - r : r - tqueue->srtt;
+		tqueue->rttvar = (3 * tqueue->rttvar + delta) / 4;
+		tqueue->srtt = (7 * tqueue->srtt + r) / 8;
 	}
 
-	seg = tcp_segment_make_data(ctrl, conn->snd_buf, data_size);
-	if (seg == NULL) {
-		log_msg(LOG_DEFAULT, LVL_ERROR, "Memory allocation failure.");
+	tqueue->rto = tqueue->srtt + max(RTO_CLOCK_G, 4 * tqueue->rttvar);
+	if (tqueue->rto < RTO_MIN)
+		tqueue->rto = RTO_MIN;
+	if (tqueue->rto > RTO_MAX)
+		tqueue->rto = RTO_MAX;
+}
+
+/** Take RTT sample if the segment being timed has been acknowledged. */
+static void tcp_tqueue_rtt_sample(tcp_conn_t *conn)
+{
+	tcp_tqueue_t *tqueue = &conn->retransmit;
+	struct timeval now;
+
+	if (!tqueue->rtt_timing ||
+	    !tcp_tqueue_seq_lt(tqueue->rtt_seq, conn->snd_una))
 		return;
-	}
 
-	/* Remove data from send buffer */
-	memmove(conn->snd_buf, conn->snd_buf + data_size,
-	    conn->snd_buf_used - data_size);
-	conn->snd_buf_used -= data_size;
+	getuptime(&now);
+	tqueue->rtt_timing = false;
+	tcp_tqueue_rtt_update(tqueue, tv_sub_diff(&now, &tqueue->rtt_start));
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: SRTT=%ld RTTVAR=%ld RTO=%ld",
+	    conn->name, (long) tqueue->srtt, (long) tqueue->rttvar,
+	    (long) tqueue->rto);
+}
+
+/** Update congestion window after new data has been acknowledged.
+ *
+ * @param conn	Connection
+ * @param acked	Number of newly acknowledged sequence numbers
+ */
+static void tcp_tqueue_cc_acked(tcp_conn_t *conn, uint32_t acked)
+{
+	tcp_tqueue_t *tqueue = &conn->retransmit;
+	uint32_t flight;
 
-	if (send_fin)
-		conn->snd_buf_fin = false;
+	tqueue->dupacks = 0;
 
-	fibril_condvar_broadcast(&conn->snd_buf_cv);
+	if (!tqueue->in_recovery) {
+		tcp_cc_acked(&conn->cc, acked);
+		return;
+	}
 
-	if (send_fin)
-		tcp_conn_fin_sent(conn);
+	if (!tcp_tqueue_seq_lt(conn->snd_una, tqueue->recover)) {
+		/* Full acknowledgement, leave loss recovery (RFC 6582 3.2.3) */
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: Loss recovery complete",
+		    conn->name);
+		tqueue->in_recovery = false;
+
+		if (tqueue->rto_recovery) {
+			tcp_cc_acked(&conn->cc, acked);
+		} else {
+			flight = conn->snd_nxt - conn->snd_una;
+			conn->cc.cwnd = min(conn->cc.ssthresh,
+			    max(flight, TCP_MSS) + TCP_MSS);
+		}
 
-	tcp_tqueue_seg(conn, seg);
-	tcp_segment_delete(seg);
+		return;
+	}
+
+	/* Partial acknowledgement, the next segment was lost as well */
+	tcp_tqueue_retransmit_first(conn);
+
+	if (tqueue->rto_recovery) {
+		tcp_cc_acked(&conn->cc, acked);
+	} else {
+		/* Deflate by the amount acked (RFC 6582 3.2.5) */
+		conn->cc.cwnd -= min(acked, conn->cc.cwnd - TCP_MSS);
+		if (acked >= TCP_MSS)
+			conn->cc.cwnd += TCP_MSS;
+	}
 }
 
 /** Remove ACKed segments from retransmission queue and possibly transmit
@@ -245,10 +398,12 @@ void tcp_tqueue_new_data(tcp_conn_t *conn)
 void tcp_tqueue_ack_received(tcp_conn_t *conn)
 {
 	link_t *cur, *next;
+	uint32_t acked;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: tcp_tqueue_ack_received(%p)", conn->name,
 	    conn);
 
+	acked = 0;
 	cur = conn->retransmit.list.head.next;
 
 	while (cur != &conn->retransmit.list.head) {
@@ -270,6 +425,7 @@ void tcp_tqueue_ack_received(tcp_conn_t *conn)
 				conn->fin_is_acked = true;
 			}
 
+			acked += tqe->seg->len;
 			tcp_segment_delete(tqe->seg);
 			free(tqe);
 
@@ -280,6 +436,11 @@ void tcp_tqueue_ack_received(tcp_conn_t *conn)
 		cur = next;
 	}
 
+	if (acked > 0) {
+		tcp_tqueue_rtt_sample(conn);
+		tcp_tqueue_cc_acked(conn, acked);
+	}
+
 	/* Clear retransmission timer if the queue is empty. */
 	if (list_empty(&conn->retransmit.list))
 		tcp_tqueue_timer_clear(conn);
@@ -288,6 +449,44 @@ void tcp_tqueue_ack_received(tcp_conn_t *conn)
 	tcp_tqueue_new_data(conn);
 }
 
+/** Process duplicate acknowledgement.
+ *
+ * The third duplicate ACK in a row triggers fast retransmit and starts
+ * fast recovery (RFC 5681 section 3.2, RFC 6582). Further duplicate ACKs
+ * inflate the congestion window, possibly allowing new data to be sent.
+ *
+ * @param conn	Connection
+ */
+void tcp_tqueue_dup_ack_received(tcp_conn_t *conn)
+{
+	tcp_tqueue_t *tqueue = &conn->retransmit;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: tcp_tqueue_dup_ack_received()",
+	    conn->name);
+
+	++tqueue->dupacks;
+
+	if (tqueue->in_recovery) {
+		if (!tqueue->rto_recovery)
+			conn->cc.cwnd += TCP_MSS;
+	} else if (tqueue->dupacks == DUPACK_THRESHOLD) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: Fast retransmit", conn->name);
+
+		tqueue->in_recovery = true;
+		tqueue->rto_recovery = false;
+		tqueue->recover = conn->snd_nxt;
+
+		tcp_cc_congestion(&conn->cc, conn->snd_nxt - conn->snd_una,
+		    false);
+		conn->cc.cwnd = conn->cc.ssthresh + DUPACK_THRESHOLD * TCP_MSS;
+
+		tcp_tqueue_retransmit_first(conn);
+	}
+
+	/* Possibly transmit more data */
+	tcp_tqueue_new_data(conn);
+}
+
 static void tcp_conn_transmit_segment(tcp_conn_t *conn, tcp_segment_t *seg)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: tcp_conn_transmit_segment(%p, %p)",
@@ -317,13 +516,46 @@ void tcp_tqueue_send_immed(tcp_conn_t *conn, tcp_segment_t *seg)
 	conn->retransmit.cb->transmit_seg(&conn->ident, seg);
 }
 
-static void retransmit_timeout_func(void *arg)
+/** Retransmit the first segment in the retransmission queue.
+ *
+ * @param conn	Connection
+ * @return	@c true if a segment was retransmitted
+ */
+static bool tcp_tqueue_retransmit_first(tcp_conn_t *conn)
 {
-	tcp_conn_t *conn = (tcp_conn_t *) arg;
 	tcp_tqueue_entry_t *tqe;
 	tcp_segment_t *rt_seg;
 	link_t *link;
 
+	link = list_first(&conn->retransmit.list);
+	if (link == NULL) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "Nothing to retransmit");
+		return false;
+	}
+
+	tqe = list_get_instance(link, tcp_tqueue_entry_t, link);
+
+	rt_seg = tcp_segment_dup(tqe->seg);
+	if (rt_seg == NULL) {
+		log_msg(LOG_DEFAULT, LVL_ERROR, "Memory allocation failed.");
+		/* XXX Handle properly */
+		return false;
+	}
+
+	/* Karn's algorithm: do not time retransmitted segments */
+	conn->retransmit.rtt_timing = false;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "### %s: retransmitting segment", conn->name);
+	tcp_conn_transmit_segment(tqe->conn, rt_seg);
+	tcp_segment_delete(rt_seg);
+	return true;
+}
+
+static void retransmit_timeout_func(void *arg)
+{
+	tcp_conn_t *conn = (tcp_conn_t *) arg;
+	tcp_tqueue_t *tqueue = &conn->retransmit;
+
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "### %s: retransmit_timeout_func(%p)", conn->name, conn);
 
 	tcp_conn_lock(conn);
@@ -335,30 +567,41 @@ static void retransmit_timeout_func(void *arg)
 		return;
 	}
 
-	link = list_first(&conn->retransmit.list);
-	if (link == NULL) {
+	if (list_empty(&tqueue->list)) {
 		log_msg(LOG_DEFAULT, LVL_DEBUG, "Nothing to retransmit");
 		tcp_conn_unlock(conn);
 		tcp_conn_delref(conn);
 		return;
 	}
 
-	tqe = list_get_instance(link, tcp_tqueue_entry_t, link);
+	/*
+	 * Reduce ssthresh only on the first timeout of a loss episode
+	 * (RFC 5681 section 3.1), the window restarts from one segment.
+	 */
+	if (tqueue->in_recovery && tqueue->rto_recovery) {
+		conn->cc.cwnd = TCP_MSS;
+	} else {
+		tcp_cc_congestion(&conn->cc, conn->snd_nxt - conn->snd_una,
+		    true);
+	}
 
-	rt_seg = tcp_segment_dup(tqe->seg);
-	if (rt_seg == NULL) {
-		log_msg(LOG_DEFAULT, LVL_ERROR, "Memory allocation failed.");
+	tqueue->in_recovery = true;
+	tqueue->rto_recovery = true;
+	tqueue->recover = conn->snd_nxt;
+	tqueue->dupacks = 0;
+
+	if (!tcp_tqueue_retransmit_first(conn)) {
 		tcp_conn_unlock(conn);
 		tcp_conn_delref(conn);
 		/* XXX Handle properly */
 		return;
 	}
 
-	log_msg(LOG_DEFAULT, LVL_DEBUG, "### %s: retransmitting segment", conn->name);
-	tcp_conn_transmit_segment(tqe->conn, rt_seg);
+	/* Back off the timer (RFC 6298 section 5.5) */
+	tqueue->rto = min(2 * tqueue->rto, RTO_MAX);
 
 	/* Reset retransmission timer */
-	fibril_timer_set_locked(conn->retransmit.timer, RETRANSMIT_TIMEOUT,
+	fibril_timer_set_locked(tqueue->timer, tqueue->rto,
 	    retransmit_timeout_func, (void *) conn);
 
 	tcp_conn_unlock(conn);
@@ -377,7 +620,7 @@ static void tcp_tqueue_timer_set(tcp_conn_t *conn)
 	tcp_tqueue_timer_clear(conn);
 
 	tcp_conn_addref(conn);
-	fibril_timer_set_locked(conn->retransmit.timer, RETRANSMIT_TIMEOUT,
+	fibril_timer_set_locked(conn->retransmit.timer, conn->retransmit.rto,
 	    retransmit_timeout_func, (void *) conn);
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "### %s: tcp_tqueue_timer_set() end", conn->name);
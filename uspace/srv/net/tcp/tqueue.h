@@ -36,6 +36,7 @@
 #define TQUEUE_H
 
 #include <inet/endpoint.h>
+#include <sys/time.h>
 #include "std.h"
 #include "tcp_type.h"
 
@@ -46,6 +47,8 @@ extern void tcp_tqueue_fini(tcp_tqueue_t *);
 extern void tcp_tqueue_ctrl_seg(tcp_conn_t *, tcp_control_t);
 extern void tcp_tqueue_new_data(tcp_conn_t *);
 extern void tcp_tqueue_ack_received(tcp_conn_t *);
+extern void tcp_tqueue_dup_ack_received(tcp_conn_t *);
+extern void tcp_tqueue_rtt_update(tcp_tqueue_t *, suseconds_t);
 
 #endif
 
@@ -99,6 +99,14 @@ int main(int argc, char **argv)
 		return ENOMEM;
 	}
 	
+	/*
+	 * Initialize the lookup cache.
+	 */
+	if (!vfs_lookup_cache_init()) {
+		printf("%s: Failed to initialize lookup cache\n", NAME);
+		return ENOMEM;
+	}
+	
 	/*
 	 * Allocate and initialize the Path Lookup Buffer.
 	 */
@@ -180,6 +180,10 @@ extern int vfs_get_fstypes(vfs_fstypes_t *);
 extern int vfs_lookup_internal(vfs_node_t *, char *, int, vfs_lookup_res_t *);
 extern int vfs_link_internal(vfs_node_t *, char *, vfs_triplet_t *);
 
+extern bool vfs_lookup_cache_init(void);
+extern void vfs_lookup_cache_flush(void);
+extern void vfs_lookup_cache_node_destroyed(vfs_node_t *);
+
 extern bool vfs_nodes_init(void);
 extern vfs_node_t *vfs_node_get(vfs_lookup_res_t *);
 extern vfs_node_t *vfs_node_peek(vfs_lookup_res_t *result);
@@ -214,6 +218,9 @@ extern int vfs_op_put(int fd);
 extern int vfs_op_read(int fd, aoff64_t, size_t *out_bytes);
 extern int vfs_op_rename(int basefd, char *old, char *new);
 extern int vfs_op_resize(int fd, int64_t size);
+extern int vfs_op_ring_destroy(sysarg_t);
+extern int vfs_op_ring_enter(sysarg_t, size_t *);
+extern int vfs_op_ring_setup(uint32_t, sysarg_t *);
 extern int vfs_op_stat(int fd);
 extern int vfs_op_statfs(int fd);
 extern int vfs_op_sync(int fd);
@@ -234,6 +241,8 @@ typedef struct {
 
 extern int vfs_rdwr_internal(int, aoff64_t, bool, rdwr_io_chunk_t *);
 
+extern void vfs_ring_cleanup(void *);
+
 extern void vfs_connection(ipc_callid_t iid, ipc_call_t *icall, void *arg);
 
 #endif
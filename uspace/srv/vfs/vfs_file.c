@@ -127,6 +127,7 @@ void vfs_client_data_destroy(void *data)
 {
 	vfs_client_data_t *vfs_data = (vfs_client_data_t *) data;
 
+	vfs_ring_cleanup(vfs_data);
 	vfs_files_done(vfs_data);
 	free(vfs_data);
 }
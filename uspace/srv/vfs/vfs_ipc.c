@@ -233,6 +233,31 @@ static void vfs_in_resize(ipc_callid_t rid, ipc_call_t *request)
 	async_answer_0(rid, rc);
 }
 
+static void vfs_in_ring_destroy(ipc_callid_t rid, ipc_call_t *request)
+{
+	sysarg_t id = IPC_GET_ARG1(*request);
+	int rc = vfs_op_ring_destroy(id);
+	async_answer_0(rid, rc);
+}
+
+static void vfs_in_ring_enter(ipc_callid_t rid, ipc_call_t *request)
+{
+	sysarg_t id = IPC_GET_ARG1(*request);
+
+	size_t completed = 0;
+	int rc = vfs_op_ring_enter(id, &completed);
+	async_answer_1(rid, rc, completed);
+}
+
+static void vfs_in_ring_setup(ipc_callid_t rid, ipc_call_t *request)
+{
+	uint32_t entries = IPC_GET_ARG1(*request);
+
+	sysarg_t id = 0;
+	int rc = vfs_op_ring_setup(entries, &id);
+	async_answer_1(rid, rc, id);
+}
+
 static void vfs_in_stat(ipc_callid_t rid, ipc_call_t *request)
 {
 	int fd = IPC_GET_ARG1(*request);
@@ -361,6 +386,15 @@ void vfs_connection(ipc_callid_t iid, ipc_call_t *icall, void *arg)
 		case VFS_IN_RESIZE:
 			vfs_in_resize(callid, &call);
 			break;
+		case VFS_IN_RING_DESTROY:
+			vfs_in_ring_destroy(callid, &call);
+			break;
+		case VFS_IN_RING_ENTER:
+			vfs_in_ring_enter(callid, &call);
+			break;
+		case VFS_IN_RING_SETUP:
+			vfs_in_ring_setup(callid, &call);
+			break;
 		case VFS_IN_STAT:
 			vfs_in_stat(callid, &call);
 			break;
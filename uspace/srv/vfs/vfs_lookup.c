@@ -47,11 +47,296 @@
 #include <vfs/canonify.h>
 #include <dirent.h>
 #include <assert.h>
+#include <stdlib.h>
+#include <adt/hash_table.h>
+#include <adt/hash.h>
 
 FIBRIL_MUTEX_INITIALIZE(plb_mutex);
 LIST_INITIALIZE(plb_entries);	/**< PLB entry ring buffer. */
 uint8_t *plb = NULL;
 
+/** Maximum number of entries in the lookup cache. */
+#define LOOKUP_CACHE_MAX	256
+
+/** Lookup flags which may be used with the lookup cache. */
+#define LOOKUP_CACHE_FLAGS \
+	(L_FILE | L_DIRECTORY | L_DISABLE_MOUNTS | L_MP)
+
+/**
+ * The lookup cache remembers results of recent path lookups, including the
+ * failed ones, so that frequently used paths do not need to be resolved by the
+ * endpoint FS servers over and over again. An entry maps a base node and a
+ * canonical path relative to it to the looked up node.
+ *
+ * Only lookups which do not leave the file systems with cacheable lookups are
+ * remembered. The whole cache is flushed when a file system is mounted or
+ * unmounted. Linking or unlinking a name only drops the entries whose paths
+ * pass through that name.
+ */
+typedef struct {
+	ht_link_t link;
+	link_t lru_link;
+	
+	/* Key */
+	vfs_triplet_t base;
+	int lflag;
+	char *path;
+	size_t len;
+	
+	/** Result of the lookup, either EOK or ENOENT. */
+	int rc;
+	vfs_lookup_res_t res;
+} lookup_cache_entry_t;
+
+typedef struct {
+	vfs_triplet_t *base;
+	int lflag;
+	const char *path;
+	size_t len;
+} lookup_cache_key_t;
+
+static FIBRIL_MUTEX_INITIALIZE(lookup_cache_mutex);
+static hash_table_t lookup_cache;
+static LIST_INITIALIZE(lookup_cache_lru);
+/** Incremented each time the cache is flushed. */
+static unsigned int lookup_cache_gen;
+
+static size_t lookup_cache_key_hash(void *arg)
+{
+	lookup_cache_key_t *key = (lookup_cache_key_t *) arg;
+	size_t hash = hash_combine(key->base->fs_handle, key->base->index);
+	hash = hash_combine(hash, key->base->service_id);
+	hash = hash_combine(hash, key->lflag);
+	
+	for (size_t i = 0; i < key->len; i++)
+		hash = hash * 31 + (uint8_t) key->path[i];
+	
+	return hash;
+}
+
+static size_t lookup_cache_hash(const ht_link_t *item)
+{
+	lookup_cache_entry_t *entry =
+	    hash_table_get_inst(item, lookup_cache_entry_t, link);
+	lookup_cache_key_t key = {
+		.base = &entry->base,
+		.lflag = entry->lflag,
+		.path = entry->path,
+		.len = entry->len
+	};
+	
+	return lookup_cache_key_hash(&key);
+}
+
+static bool lookup_cache_key_equal(void *arg, const ht_link_t *item)
+{
+	lookup_cache_key_t *key = (lookup_cache_key_t *) arg;
+	lookup_cache_entry_t *entry =
+	    hash_table_get_inst(item, lookup_cache_entry_t, link);
+	
+	return entry->base.fs_handle == key->base->fs_handle &&
+	    entry->base.service_id == key->base->service_id &&
+	    entry->base.index == key->base->index &&
+	    entry->lflag == key->lflag && entry->len == key->len &&
+	    memcmp(entry->path, key->path, key->len) == 0;
+}
+
+static void lookup_cache_remove_callback(ht_link_t *item)
+{
+	lookup_cache_entry_t *entry =
+	    hash_table_get_inst(item, lookup_cache_entry_t, link);
+	
+	list_remove(&entry->lru_link);
+	free(entry->path);
+	free(entry);
+}
+
+static hash_table_ops_t lookup_cache_ops = {
+	.hash = lookup_cache_hash,
+	.key_hash = lookup_cache_key_hash,
+	.key_equal = lookup_cache_key_equal,
+	.equal = NULL,
+	.remove_callback = lookup_cache_remove_callback
+};
+
+/** Initialize the lookup cache.
+ *
+ * @return		Return true on success, false on failure.
+ */
+bool vfs_lookup_cache_init(void)
+{
+	return hash_table_create(&lookup_cache, 0, 0, &lookup_cache_ops);
+}
+
+/** Forget all remembered lookups.
+ *
+ * Needs to be called whenever the file system namespace changes.
+ */
+void vfs_lookup_cache_flush(void)
+{
+	fibril_mutex_lock(&lookup_cache_mutex);
+	hash_table_clear(&lookup_cache);
+	lookup_cache_gen++;
+	fibril_mutex_unlock(&lookup_cache_mutex);
+}
+
+/** Check whether a canonical path contains a name as one of its components.
+ *
+ * @param path		Canonical path.
+ * @param len		Length of the path.
+ * @param name		Name of a single path component.
+ *
+ * @return		True if a walk along the path passes through the name.
+ */
+static bool lookup_cache_path_has(const char *path, size_t len,
+    const char *name)
+{
+	size_t nlen = str_size(name);
+	size_t i = 0;
+	
+	while ((i < len) && (path[i] == '/')) {
+		size_t start = ++i;
+		while ((i < len) && (path[i] != '/') && (path[i] != '\0'))
+			i++;
+		
+		if ((i - start == nlen) && (memcmp(path + start, name, nlen) == 0))
+			return true;
+	}
+	
+	return false;
+}
+
+/** Update the lookup cache when a name was linked or unlinked.
+ *
+ * Linking a name can only make failed lookups through it succeed, unlinking
+ * it can only make successful lookups through it fail. Lookups not passing
+ * through a component of the same name are not affected.
+ *
+ * @param name		Name which was linked or unlinked.
+ * @param linked	True if the name was linked, false if unlinked.
+ */
+static void lookup_cache_name_changed(const char *name, bool linked)
+{
+	fibril_mutex_lock(&lookup_cache_mutex);
+	
+	list_foreach_safe(lookup_cache_lru, cur, next) {
+		lookup_cache_entry_t *entry = list_get_instance(cur,
+		    lookup_cache_entry_t, lru_link);
+		
+		if (((entry->rc == EOK) != linked) &&
+		    lookup_cache_path_has(entry->path, entry->len, name))
+			hash_table_remove_item(&lookup_cache, &entry->link);
+	}
+	
+	/* Lookups in progress may have seen the name before the change. */
+	lookup_cache_gen++;
+	
+	fibril_mutex_unlock(&lookup_cache_mutex);
+}
+
+/** Update the lookup cache when a VFS node is being destroyed.
+ *
+ * The size of a file is tracked by its VFS node while the node exists. The
+ * lookups of the file resolved from the cache after the node is destroyed
+ * need to report the last known size.
+ *
+ * @param node		VFS node being destroyed.
+ */
+void vfs_lookup_cache_node_destroyed(vfs_node_t *node)
+{
+	fibril_mutex_lock(&lookup_cache_mutex);
+	list_foreach(lookup_cache_lru, lru_link, lookup_cache_entry_t, entry) {
+		vfs_triplet_t *tri = &entry->res.triplet;
+		if ((entry->rc == EOK) && (tri->fs_handle == node->fs_handle) &&
+		    (tri->service_id == node->service_id) &&
+		    (tri->index == node->index))
+			entry->res.size = node->size;
+	}
+	fibril_mutex_unlock(&lookup_cache_mutex);
+}
+
+static bool lookup_cache_get(vfs_node_t *base, const char *path, size_t len,
+    int lflag, int *rc, vfs_lookup_res_t *result, unsigned int *gen)
+{
+	lookup_cache_key_t key = {
+		.base = (vfs_triplet_t *) base,
+		.lflag = lflag,
+		.path = path,
+		.len = len
+	};
+	
+	fibril_mutex_lock(&lookup_cache_mutex);
+	
+	*gen = lookup_cache_gen;
+	
+	ht_link_t *item = hash_table_find(&lookup_cache, &key);
+	if (!item) {
+		fibril_mutex_unlock(&lookup_cache_mutex);
+		return false;
+	}
+	
+	lookup_cache_entry_t *entry =
+	    hash_table_get_inst(item, lookup_cache_entry_t, link);
+	
+	list_remove(&entry->lru_link);
+	list_prepend(&entry->lru_link, &lookup_cache_lru);
+	
+	*rc = entry->rc;
+	if (entry->rc == EOK)
+		*result = entry->res;
+	
+	fibril_mutex_unlock(&lookup_cache_mutex);
+	return true;
+}
+
+static void lookup_cache_put(vfs_node_t *base, const char *path, size_t len,
+    int lflag, int rc, vfs_lookup_res_t *result, unsigned int gen)
+{
+	lookup_cache_entry_t *entry = malloc(sizeof(lookup_cache_entry_t));
+	if (!entry)
+		return;
+	
+	entry->path = malloc(len);
+	if (!entry->path) {
+		free(entry);
+		return;
+	}
+	
+	memcpy(entry->path, path, len);
+	entry->len = len;
+	entry->base = *((vfs_triplet_t *) base);
+	entry->lflag = lflag;
+	entry->rc = rc;
+	if (rc == EOK)
+		entry->res = *result;
+	link_initialize(&entry->lru_link);
+	
+	fibril_mutex_lock(&lookup_cache_mutex);
+	
+	/*
+	 * Do not remember the result if the namespace changed while the
+	 * lookup was in progress or if another fibril was faster.
+	 */
+	if ((gen != lookup_cache_gen) ||
+	    (!hash_table_insert_unique(&lookup_cache, &entry->link))) {
+		fibril_mutex_unlock(&lookup_cache_mutex);
+		free(entry->path);
+		free(entry);
+		return;
+	}
+	
+	list_prepend(&entry->lru_link, &lookup_cache_lru);
+	
+	if (hash_table_size(&lookup_cache) > LOOKUP_CACHE_MAX) {
+		lookup_cache_entry_t *victim = list_get_instance(
+		    list_last(&lookup_cache_lru), lookup_cache_entry_t,
+		    lru_link);
+		hash_table_remove_item(&lookup_cache, &victim->link);
+	}
+	
+	fibril_mutex_unlock(&lookup_cache_mutex);
+}
+
 static int plb_insert_entry(plb_entry_t *entry, char *path, size_t *start,
     size_t len)
 {
@@ -202,6 +487,9 @@ int vfs_link_internal(vfs_node_t *base, char *path, vfs_triplet_t *child)
 	if (orig_rc != EOK)
 		rc = orig_rc;
 	
+	if (rc == EOK)
+		lookup_cache_name_changed(component, true);
+	
 out:
 	return rc;
 }
@@ -238,7 +526,7 @@ static int out_lookup(vfs_triplet_t *base, size_t *pfirst, size_t *plen,
 }
 
 static int _vfs_lookup_internal(vfs_node_t *base, char *path, int lflag,
-    vfs_lookup_res_t *result, size_t len)
+    vfs_lookup_res_t *result, size_t len, bool *cacheable)
 {
 	size_t first;
 	int rc;
@@ -253,6 +541,9 @@ static int _vfs_lookup_internal(vfs_node_t *base, char *path, int lflag,
 	
 	vfs_lookup_res_t res;
 	
+	if (cacheable)
+		*cacheable = true;
+	
 	/* Resolve path as long as there are mount points to cross. */
 	while (nlen > 0) {
 		while (base->mount) {
@@ -264,6 +555,10 @@ static int _vfs_lookup_internal(vfs_node_t *base, char *path, int lflag,
 			base = base->mount;
 		}
 		
+		if ((cacheable) &&
+		    (!fs_handle_to_info(base->fs_handle)->cache_lookups))
+			*cacheable = false;
+		
 		rc = out_lookup((vfs_triplet_t *) base, &next, &nlen, lflag,
 		    &res);
 		if (rc != EOK)
@@ -272,11 +567,15 @@ static int _vfs_lookup_internal(vfs_node_t *base, char *path, int lflag,
 		if (nlen > 0) {
 			base = vfs_node_peek(&res);
 			if (!base) {
+				if (cacheable)
+					*cacheable = false;
 				rc = ENOENT;
 				goto out;
 			}
 	       		if (!base->mount) {
 				vfs_node_put(base);
+				if (cacheable)
+					*cacheable = false;
 				rc = ENOENT;
 				goto out;
 			}
@@ -374,7 +673,7 @@ int vfs_lookup_internal(vfs_node_t *base, char *path, int lflag,
 			tflag &= ~(L_CREATE | L_EXCLUSIVE | L_UNLINK | L_FILE);
 			tflag |= L_DIRECTORY;
 			rc = _vfs_lookup_internal(base, path, tflag, &tres,
-			    slash - path);
+			    slash - path, NULL);
 			if (rc != EOK)
 				return rc;
 			parent = vfs_node_get(&tres);
@@ -384,12 +683,30 @@ int vfs_lookup_internal(vfs_node_t *base, char *path, int lflag,
 			vfs_node_addref(parent);
 
 		rc = _vfs_lookup_internal(parent, slash, lflag, result,
-		    len - (slash - path));
+		    len - (slash - path), NULL);
 
 		vfs_node_put(parent);
 
+		/*
+		 * L_CREATE also succeeds if the name already exists. No
+		 * failed lookup through the name is remembered then, so
+		 * nothing is dropped.
+		 */
+		if (rc == EOK)
+			lookup_cache_name_changed(slash + 1,
+			    (lflag & L_CREATE) != 0);
+	} else if ((result != NULL) && !(lflag & ~LOOKUP_CACHE_FLAGS)) {
+		unsigned int gen;
+		if (lookup_cache_get(base, path, len, lflag, &rc, result, &gen))
+			return rc;
+		
+		bool cacheable;
+		rc = _vfs_lookup_internal(base, path, lflag, result, len,
+		    &cacheable);
+		if (cacheable && ((rc == EOK) || (rc == ENOENT)))
+			lookup_cache_put(base, path, len, lflag, rc, result, gen);
 	} else {
-		rc = _vfs_lookup_internal(base, path, lflag, result, len);
+		rc = _vfs_lookup_internal(base, path, lflag, result, len, NULL);
 	}
 	
 	return rc;
@@ -124,6 +124,8 @@ void vfs_node_delref(vfs_node_t *node)
 	fibril_mutex_unlock(&nodes_mutex);
 	
 	if (free_node) {
+		vfs_lookup_cache_node_destroyed(node);
+		
 		/*
 		 * VFS_OUT_DESTROY will free up the file's resources if there
 		 * are no more hard links.
@@ -270,6 +270,7 @@ int vfs_op_mount(int mpfd, unsigned service_id, unsigned flags,
 		vfs_node_addref(mp->node);
 		vfs_node_addref(root);
 		mp->node->mount = root;
+		vfs_lookup_cache_flush();
 	}
 	
 	fibril_rwlock_write_unlock(&namespace_rwlock);
@@ -393,7 +394,14 @@ static int rdwr_ipc_internal(async_exch_t *exch, vfs_file_t *file, aoff64_t pos,
 	if (msg == 0)
 		return EINVAL;
 
-	int retval = async_data_read_start(exch, chunk->buffer, chunk->size);
+	int retval;
+	if (read) {
+		retval = async_data_read_start(exch, chunk->buffer,
+		    chunk->size);
+	} else {
+		retval = async_data_write_start(exch, chunk->buffer,
+		    chunk->size);
+	}
 	if (retval != EOK) {
 		async_forget(msg);
 		return retval;
@@ -820,6 +828,7 @@ int vfs_op_unmount(int mpfd)
 	vfs_node_forget(mp->node->mount);
 	vfs_node_put(mp->node);
 	mp->node->mount = NULL;
+	vfs_lookup_cache_flush();
 	
 	fibril_rwlock_write_unlock(&namespace_rwlock);
 	
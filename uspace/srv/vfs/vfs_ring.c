@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2017 HelenOS project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup fs
+ * @{
+ */
+
+/**
+ * @file vfs_ring.c
+ * @brief Shared memory submission and completion rings.
+ *
+ * A client can share a ring with VFS and queue many reads and writes in it.
+ * All the queued requests are then processed on behalf of a single
+ * VFS_IN_RING_ENTER call. The data is transferred between the endpoint FS
+ * servers and the data area of the ring directly, without passing through
+ * the client.
+ */
+
+#include "vfs.h"
+#include <as.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <macros.h>
+
+typedef struct {
+	link_t link;
+	/** Client which owns the ring. */
+	void *client;
+	/** Ring identifier passed to the client. */
+	sysarg_t id;
+	/** Number of references to the ring. */
+	unsigned int refcnt;
+
+	/** Serializes processing of the submitted entries. */
+	fibril_mutex_t lock;
+
+	/** Shared memory area. */
+	void *area;
+	/** Number of entries in each queue. Power of two. */
+	uint32_t entries;
+	vfs_ring_hdr_t *hdr;
+	vfs_ring_sqe_t *sq;
+	vfs_ring_cqe_t *cq;
+	uint8_t *data;
+	size_t data_size;
+
+	/*
+	 * Private copies of the indices produced by VFS. The copies in the
+	 * shared header are only written, so that the client cannot confuse
+	 * VFS by modifying them.
+	 */
+	uint32_t sq_head;
+	uint32_t cq_tail;
+} vfs_ring_t;
+
+static FIBRIL_MUTEX_INITIALIZE(rings_lock);
+static LIST_INITIALIZE(rings);
+static sysarg_t rings_next_id = 1;
+
+static vfs_ring_t *vfs_ring_get(sysarg_t id)
+{
+	void *client = async_get_client_data();
+
+	fibril_mutex_lock(&rings_lock);
+	list_foreach(rings, link, vfs_ring_t, ring) {
+		if ((ring->client == client) && (ring->id == id)) {
+			ring->refcnt++;
+			fibril_mutex_unlock(&rings_lock);
+			return ring;
+		}
+	}
+	fibril_mutex_unlock(&rings_lock);
+
+	return NULL;
+}
+
+static void vfs_ring_put(vfs_ring_t *ring)
+{
+	fibril_mutex_lock(&rings_lock);
+	bool last = (--ring->refcnt == 0);
+	fibril_mutex_unlock(&rings_lock);
+
+	if (last) {
+		as_area_destroy(ring->area);
+		free(ring);
+	}
+}
+
+/** Remove a ring from the list of rings and drop the list's reference. */
+static void vfs_ring_remove(vfs_ring_t *ring)
+{
+	fibril_mutex_lock(&rings_lock);
+	list_remove(&ring->link);
+	fibril_mutex_unlock(&rings_lock);
+
+	vfs_ring_put(ring);
+}
+
+/** Destroy all rings of a client which is going away.
+ *
+ * @param client Client data of the client.
+ */
+void vfs_ring_cleanup(void *client)
+{
+	fibril_mutex_lock(&rings_lock);
+	list_foreach_safe(rings, cur, next) {
+		vfs_ring_t *ring = list_get_instance(cur, vfs_ring_t, link);
+		if (ring->client != client)
+			continue;
+
+		list_remove(&ring->link);
+		if (--ring->refcnt == 0) {
+			as_area_destroy(ring->area);
+			free(ring);
+		}
+	}
+	fibril_mutex_unlock(&rings_lock);
+}
+
+/** Set up a new ring shared by the client.
+ *
+ * @param entries Number of entries in each queue.
+ * @param out_id  Place to store the identifier of the new ring.
+ *
+ * @return EOK on success or a negative error code.
+ */
+int vfs_op_ring_setup(uint32_t entries, sysarg_t *out_id)
+{
+	ipc_callid_t callid;
+	size_t size;
+	unsigned int flags;
+	if (!async_share_out_receive(&callid, &size, &flags))
+		return EINVAL;
+
+	if ((entries == 0) || (entries > VFS_RING_ENTRIES_MAX) ||
+	    ((entries & (entries - 1)) != 0) ||
+	    (size < VFS_RING_DATA_OFFSET(entries)) ||
+	    ((flags & (AS_AREA_READ | AS_AREA_WRITE)) !=
+	    (AS_AREA_READ | AS_AREA_WRITE))) {
+		async_answer_0(callid, EINVAL);
+		return EINVAL;
+	}
+
+	vfs_ring_t *ring = malloc(sizeof(vfs_ring_t));
+	if (!ring) {
+		async_answer_0(callid, ENOMEM);
+		return ENOMEM;
+	}
+
+	int rc = async_share_out_finalize(callid, &ring->area);
+	if ((rc != EOK) || (ring->area == AS_MAP_FAILED)) {
+		free(ring);
+		return ENOMEM;
+	}
+
+	link_initialize(&ring->link);
+	ring->client = async_get_client_data();
+	ring->refcnt = 1;
+	fibril_mutex_initialize(&ring->lock);
+	ring->entries = entries;
+	ring->hdr = (vfs_ring_hdr_t *) ring->area;
+	ring->sq = (vfs_ring_sqe_t *) ((uint8_t *) ring->area +
+	    VFS_RING_SQ_OFFSET);
+	ring->cq = (vfs_ring_cqe_t *) ((uint8_t *) ring->area +
+	    VFS_RING_CQ_OFFSET(entries));
+	ring->data = (uint8_t *) ring->area + VFS_RING_DATA_OFFSET(entries);
+	ring->data_size = size - VFS_RING_DATA_OFFSET(entries);
+	ring->sq_head = ring->hdr->sq_head;
+	ring->cq_tail = ring->hdr->cq_tail;
+
+	fibril_mutex_lock(&rings_lock);
+	ring->id = rings_next_id++;
+	list_append(&ring->link, &rings);
+	fibril_mutex_unlock(&rings_lock);
+
+	*out_id = ring->id;
+	return EOK;
+}
+
+/** Destroy a ring.
+ *
+ * @param id Identifier of the ring.
+ *
+ * @return EOK on success or a negative error code.
+ */
+int vfs_op_ring_destroy(sysarg_t id)
+{
+	vfs_ring_t *ring = vfs_ring_get(id);
+	if (!ring)
+		return ENOENT;
+
+	vfs_ring_remove(ring);
+	vfs_ring_put(ring);
+	return EOK;
+}
+
+/** Perform a read or a write described by a submission entry.
+ *
+ * Unlike read() and write(), the whole buffer is transferred unless the end
+ * of the file is reached or an error occurs.
+ */
+static int vfs_ring_rdwr(vfs_ring_t *ring, vfs_ring_sqe_t *sqe, size_t *bytes)
+{
+	bool read;
+
+	switch (sqe->op) {
+	case VFS_RING_OP_READ:
+		read = true;
+		break;
+	case VFS_RING_OP_WRITE:
+		read = false;
+		break;
+	default:
+		return ENOTSUP;
+	}
+
+	if ((sqe->offset > ring->data_size) ||
+	    (sqe->size > ring->data_size - sqe->offset))
+		return EINVAL;
+
+	size_t done = 0;
+	int rc = EOK;
+
+	while (done < sqe->size) {
+		rdwr_io_chunk_t chunk = {
+			.buffer = ring->data + sqe->offset + done,
+			.size = sqe->size - done
+		};
+
+		rc = vfs_rdwr_internal(sqe->file, sqe->pos + done, read,
+		    &chunk);
+		if ((rc != EOK) || (chunk.size == 0))
+			break;
+
+		done += chunk.size;
+	}
+
+	*bytes = done;
+	return rc;
+}
+
+/** Process the entries submitted to a ring.
+ *
+ * Processing stops when the submission queue is empty or when the completion
+ * queue is full.
+ *
+ * @param id            Identifier of the ring.
+ * @param out_completed Place to store the number of processed entries.
+ *
+ * @return EOK on success or a negative error code.
+ */
+int vfs_op_ring_enter(sysarg_t id, size_t *out_completed)
+{
+	vfs_ring_t *ring = vfs_ring_get(id);
+	if (!ring)
+		return ENOENT;
+
+	fibril_mutex_lock(&ring->lock);
+
+	uint32_t mask = ring->entries - 1;
+	uint32_t sq_tail = ring->hdr->sq_tail;
+	uint32_t cq_head = ring->hdr->cq_head;
+	size_t completed = 0;
+	int rc = EOK;
+
+	if ((uint32_t) (sq_tail - ring->sq_head) > ring->entries ||
+	    (uint32_t) (ring->cq_tail - cq_head) > ring->entries)
+		rc = EINVAL;
+
+	while ((rc == EOK) && (ring->sq_head != sq_tail) &&
+	    ((uint32_t) (ring->cq_tail - cq_head) < ring->entries)) {
+		/* Copy the entry so that the client cannot change it. */
+		vfs_ring_sqe_t sqe = ring->sq[ring->sq_head & mask];
+		ring->sq_head++;
+
+		size_t bytes = 0;
+		int orc = vfs_ring_rdwr(ring, &sqe, &bytes);
+
+		vfs_ring_cqe_t *cqe = &ring->cq[ring->cq_tail & mask];
+		cqe->user = sqe.user;
+		cqe->bytes = bytes;
+		cqe->rc = orc;
+		ring->cq_tail++;
+
+		completed++;
+	}
+
+	ring->hdr->sq_head = ring->sq_head;
+	ring->hdr->cq_tail = ring->cq_tail;
+
+	fibril_mutex_unlock(&ring->lock);
+	vfs_ring_put(ring);
+
+	*out_completed = completed;
+	return rc;
+}
+
+/**
+ * @}
+ */